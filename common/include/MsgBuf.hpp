@@ -5,8 +5,10 @@
 #include <string>
 #include <map>
 #include <stdint.h>
+#include <google/protobuf/arena.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/descriptor.h>
+#include <zmq.h>
 #include "TraceException.hpp"
 
 
@@ -29,6 +31,11 @@
  * message framing information is created automatically, and, similarly, when
  * a message is received, the framing is used to automatically unserialize the
  * message.
+ *
+ * A received message body is held in the zeromq message it arrived in (see
+ * attachMessage) and is unserialized directly from it, and serialized bodies
+ * are handed off to zeromq when sent, so message payloads are never copied
+ * between zeromq and the MsgBuf.
  */
 class MsgBuf
 {
@@ -52,6 +59,13 @@ public:
         EC_UNSERIALIZE
     };
 
+    /// Frame flags (sent in extended frame)
+    enum FrameFlags
+    {
+        FLAG_STREAM     = 0x01,     ///< Request: client accepts a reply streamed as partial frames
+        FLAG_PARTIAL    = 0x02      ///< Reply: partial frame, more frames of the reply follow
+    };
+
     /// Framing structure that wraps a serialized message
     struct Frame
     {
@@ -82,7 +96,7 @@ public:
      * 
      * @param a_capacity - Buffer capacity in bytes
      */
-    MsgBuf( uint32_t a_capacity = 0 ) : m_buffer(0), m_capacity(0)
+    MsgBuf( uint32_t a_capacity = 0 ) : m_buffer(0), m_capacity(0), m_msg_attached(false), m_stamp(0), m_timeout(0), m_flags(0)
     {
         m_route[0] = 0;
 
@@ -100,7 +114,7 @@ public:
      * This constructor version is used by trusted agents that need to send/
      * recv messages on behalf of a user specified by UID.
      */
-    MsgBuf( const std::string & a_uid, uint16_t a_context = 0, uint32_t a_capacity = 0 ) : m_buffer(0), m_capacity(0), m_uid(a_uid)
+    MsgBuf( const std::string & a_uid, uint16_t a_context = 0, uint32_t a_capacity = 0 ) : m_buffer(0), m_capacity(0), m_msg_attached(false), m_uid(a_uid), m_stamp(0), m_timeout(0), m_flags(0)
     {
         m_frame.context = a_context;
         m_route[0] = 0;
@@ -114,10 +128,15 @@ public:
      */
     ~MsgBuf()
     {
+        releaseMessage();
+
         if ( m_buffer )
             delete[] m_buffer;
     }
 
+    MsgBuf( const MsgBuf & ) = delete;
+    MsgBuf & operator=( const MsgBuf & ) = delete;
+
     /**
      * @brief Frees memory used by MsgBuf
      */
@@ -126,6 +145,11 @@ public:
         m_route[0] = 0;
         m_uid.clear();
         m_frame.clear();
+        m_stamp = 0;
+        m_timeout = 0;
+        m_flags = 0;
+
+        releaseMessage();
 
         if ( m_buffer )
         {
@@ -168,21 +192,66 @@ public:
     /**
      * @brief Get the Buffer pointer of the MsgBuf instance
      * 
-     * @return char*
+     * @return char* - Attached zeromq message data if present, otherwise local buffer
      */
     inline char * getBuffer()
     {
-        return m_buffer;
+        return m_msg_attached ? (char *)zmq_msg_data( &m_msg ) : m_buffer;
     }
 
     /**
      * @brief Get a const Buffer pointer of the MsgBuf instance
      * 
-     * @return char*
+     * @return char* - Attached zeromq message data if present, otherwise local buffer
      */
     inline const char * getBuffer() const
     {
-        return m_buffer;
+        return m_msg_attached ? (const char *)zmq_msg_data( const_cast<zmq_msg_t*>( &m_msg )) : m_buffer;
+    }
+
+    /**
+     * @brief Take ownership of a zeromq message as the message body
+     *
+     * @param a_msg - Received zeromq message (left empty on return)
+     *
+     * The message data is used in place (no copy) until the MsgBuf is
+     * serialized into, cleared, or destroyed.
+     */
+    void attachMessage( zmq_msg_t & a_msg )
+    {
+        releaseMessage();
+
+        zmq_msg_init( &m_msg );
+        zmq_msg_move( &m_msg, &a_msg );
+        m_msg_attached = true;
+    }
+
+    /**
+     * @brief Transfer attached zeromq message (if any) to caller
+     *
+     * @param a_msg - Initialized zeromq message to receive attached message
+     * @return true if a message was attached and transferred
+     */
+    bool detachMessage( zmq_msg_t & a_msg )
+    {
+        if ( !m_msg_attached )
+            return false;
+
+        zmq_msg_move( &a_msg, &m_msg );
+        zmq_msg_close( &m_msg );
+        m_msg_attached = false;
+
+        return true;
+    }
+
+    /// Release attached zeromq message, if any
+    inline void releaseMessage()
+    {
+        if ( m_msg_attached )
+        {
+            zmq_msg_close( &m_msg );
+            m_msg_attached = false;
+        }
     }
 
     /**
@@ -242,6 +311,42 @@ public:
         m_uid.clear();
     }
 
+    /// Get receive timestamp (steady clock nanoseconds, set by server proxy), 0 if none
+    inline uint64_t getStamp() const
+    {
+        return m_stamp;
+    }
+
+    /// Set receive timestamp
+    inline void setStamp( uint64_t a_stamp )
+    {
+        m_stamp = a_stamp;
+    }
+
+    /// Get client request timeout (msec, sent in extended frame), 0 if none
+    inline uint32_t getTimeout() const
+    {
+        return m_timeout;
+    }
+
+    /// Set client request timeout (msec), 0 for none - must be cleared before sending a reply
+    inline void setTimeout( uint32_t a_timeout )
+    {
+        m_timeout = a_timeout;
+    }
+
+    /// Get frame flags (see FrameFlags), 0 if none
+    inline uint32_t getFlags() const
+    {
+        return m_flags;
+    }
+
+    /// Set frame flags - request flags must be cleared before sending a reply
+    inline void setFlags( uint32_t a_flags )
+    {
+        m_flags = a_flags;
+    }
+
     /// Acquire (take ownership of) contained buffer
     char * acquireBuffer()
     {
@@ -345,14 +450,31 @@ public:
         return i_mt->second;
     }
 
+    /**
+     * @brief Find message name of given message type
+     *
+     * @param a_msg_type - Message type
+     * @return std::string - Message name, or empty string if not registered
+     */
+    static std::string findMessageName( uint16_t a_msg_type )
+    {
+        DescriptorMap::iterator iDesc = getDescriptorMap().find( a_msg_type );
+
+        if ( iDesc == getDescriptorMap().end() )
+            return std::string();
+
+        return iDesc->second->name();
+    }
+
     /**
      * @brief Unserialize and return a contained message
      * 
-     * @return Message* - message from buffer (receiver must free)
+     * @param a_arena - Optional arena to allocate message on
+     * @return Message* - message from buffer (receiver must free if not arena allocated)
      */
-    inline Message* unserialize() const
+    inline Message* unserialize( ::google::protobuf::Arena * a_arena = 0 ) const
     {
-        return unserialize( m_frame, m_buffer );
+        return unserialize( m_frame, getBuffer(), a_arena );
     }
 
     /**
@@ -360,9 +482,13 @@ public:
      * 
      * @param a_frame - Framing information
      * @param a_buffer - MsgBuf instance to unserialize
-     * @return Message* - message from buffer (receiver must free)
+     * @param a_arena - Optional arena to allocate message on
+     * @return Message* - message from buffer (receiver must free if not arena allocated)
+     *
+     * Messages allocated on an arena are owned by the arena and are freed when
+     * the arena is reset or destroyed.
      */
-    static Message* unserialize( const Frame & a_frame, const char * a_buffer )
+    static Message* unserialize( const Frame & a_frame, const char * a_buffer, ::google::protobuf::Arena * a_arena = 0 )
     {
         DescriptorMap::iterator iDesc = getDescriptorMap().find( a_frame.getMsgType() );
         if ( iDesc != getDescriptorMap().end() )
@@ -370,14 +496,14 @@ public:
             const DescriptorType * msg_descriptor = iDesc->second;
             const Message * default_msg = getFactory().GetPrototype( msg_descriptor );
 
-            Message * msg = default_msg->New();
+            Message * msg = default_msg->New( a_arena );
 
             if ( msg )
             {
                 // Some message types do not have any content and will not need to be parsed (and buffer may be null/empty)
                 if ( msg->ParseFromArray( a_buffer, a_frame.size ))
                     return msg;
-                else
+                else if ( !a_arena )
                     delete msg;
             }
         }
@@ -401,6 +527,9 @@ public:
         if ( !a_msg.IsInitialized() )
             EXCEPT( EC_SERIALIZE, "Message is missing required fields" );
 
+        // Serialized content replaces any attached (received) message
+        releaseMessage();
+
         const DescriptorType * desc = a_msg.GetDescriptor();
         MsgTypeMap & mt_map = getMsgTypeMap();
         MsgTypeMap::iterator i_mt = mt_map.find( desc );
@@ -457,8 +586,13 @@ private:
     Frame       m_frame;
     char *      m_buffer;
     uint32_t    m_capacity;
+    zmq_msg_t   m_msg;          ///< Attached zeromq message (received body)
+    bool        m_msg_attached;
     uint8_t     m_route[MAX_ROUTE_LEN]; // Byte 0 = length
     std::string m_uid;
+    uint64_t    m_stamp;        ///< Receive timestamp from optional trailing frame (0 if none)
+    uint32_t    m_timeout;      ///< Client request timeout from extended frame (0 if none)
+    uint32_t    m_flags;        ///< Frame flags from extended frame (0 if none)
 };
 
 
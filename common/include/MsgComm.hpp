@@ -28,6 +28,16 @@ public:
         std::string                 server_key;     ///< Remote server public key (used by clients only)
     };
 
+    /// Optional socket settings (applied before binding or connecting)
+    struct SocketOptions
+    {
+        SocketOptions() : immediate( false ), send_hwm( 0 ), linger( 100 ) {}
+
+        bool                        immediate;      ///< Queue messages only on completed connections (ZMQ_IMMEDIATE)
+        int                         send_hwm;       ///< Send high water mark in messages (ZMQ_SNDHWM, 0 = zeromq default)
+        int                         linger;         ///< Msec unsent messages are kept after close (ZMQ_LINGER)
+    };
+
     /// Wrapper for zeromq socket types
     enum SockType
     {
@@ -53,8 +63,9 @@ public:
      * @param a_bind - Bind socket if true; otherwise connect
      * @param a_sec_ctx - Optional security settings
      * @param a_zmq_cxt - Optional zeromq context (uses shared context if omitted)
+     * @param a_sock_opts - Optional socket settings
      */
-    MsgComm( const std::string & a_address, SockType a_sock_type, bool a_bind, const SecurityContext * a_sec_ctx = 0, void * a_zmq_cxt = 0 );
+    MsgComm( const std::string & a_address, SockType a_sock_type, bool a_bind, const SecurityContext * a_sec_ctx = 0, void * a_zmq_cxt = 0, const SocketOptions * a_sock_opts = 0 );
 
     /**
      * @brief Construct a new Msg Comm object from host and port
@@ -81,14 +92,21 @@ public:
     void            reset();
 
     /**
-     * @brief Send a message with optional context
+     * @brief Send a message with optional context and request timeout
      * 
      * @param a_msg - Message to send
      * @param a_context - Optional context value
+     * @param a_timeout - Optional request timeout in milliseconds (0 = none)
+     * @param a_flags - Optional frame flags (see MsgBuf::FrameFlags)
      *
-     * Serializes, then sends the message.
+     * Serializes, then sends the message. If a timeout is specified, it is
+     * sent in an extended message frame so that the server can discard the
+     * request if it can not be processed before the client gives up (requires
+     * message API minor version 4 or later). Flags are likewise sent in an
+     * extended frame; MsgBuf::FLAG_STREAM allows the server to stream large
+     * replies as partial frames (requires message API minor version 7).
      */
-    void            send( MsgBuf::Message & a_msg, uint16_t a_context = 0 );
+    void            send( MsgBuf::Message & a_msg, uint16_t a_context = 0, uint32_t a_timeout = 0, uint32_t a_flags = 0 );
 
     /**
      * @brief Send a message with UID and optional context
@@ -109,12 +127,17 @@ public:
      * 
      * @param a_message - Message buffer to send
      * @param a_proc_uid - Include UID in framing if true; otherwise omit UID
+     * @param a_dont_wait - Do not block if the message can not be queued
+     * @return false if a_dont_wait is set and the message was not queued
      *
      * This is a low-level send that accepts a message buffer that is already
      * serialized. The proc_uid param controls whether the UID field is sent
-     * or not (this is typically only used by trusted agents).
+     * or not (this is typically only used by trusted agents). With dont_wait,
+     * the message is not sent (and the buffer is left intact) if zeromq can
+     * not queue it right away, i.e. the send high water mark is reached or,
+     * with SocketOptions::immediate, no connection is established.
      */
-    void            send( MsgBuf & a_message, bool a_proc_uid = false );
+    bool            send( MsgBuf & a_message, bool a_proc_uid = false, bool a_dont_wait = false );
 
     /**
      * @brief Receive a message and frame with optional timeout
@@ -128,7 +151,10 @@ public:
      * Receive a message with framing information and optional timeout.
      * Malformed incoming messages or communication errors may throw
      * TraceExceptions. The receiver is responsible for freeing the memory
-     * associated with the received message.
+     * associated with the received message. A streamed reply is received as
+     * a sequence of partial frames (each a message of the reply type holding
+     * part of the results); the frames are merged into one message as they
+     * arrive, and the timeout applies to each frame.
      */
     bool            recv( MsgBuf::Message *& a_msg, MsgBuf::Frame & a_frame, uint32_t a_timeout = 0 );
 
@@ -202,7 +228,7 @@ public:
 
 private:
     void            setupSecurityContext( const SecurityContext * a_sec_ctx );
-    void            init( SockType a_sock_type, const SecurityContext * a_sec_ctx, void * a_zmq_cxt );
+    void            init( SockType a_sock_type, const SecurityContext * a_sec_ctx, void * a_zmq_cxt, const SocketOptions * a_sock_opts = 0 );
 
     void           *m_socket;
     bool            m_bound;
@@ -7,6 +7,8 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <utility>
+#include <functional>
 #include "fpconv.h"
 #include "TraceException.hpp"
 
@@ -41,6 +43,7 @@ namespace libjson {
         size_t          m_pos;
 
         friend class Value;
+        friend class Reader;
     };
 
     #define  ERR_INVALID_CHAR( p ) throw ParseError( "Invalid character", (size_t)p )
@@ -53,11 +56,229 @@ namespace libjson {
     #define  ERR_INVALID_ESC( p ) throw ParseError( "Invalid escape sequence", (size_t)p )
     #define  ERR_INVALID_UNICODE( p ) throw ParseError( "Invalid unicode escape sequence", (size_t)p )
 
-    class Value
+    /**
+    * @class ParserBase
+    * @brief Character-level parsing methods shared by DOM (Value) and SAX (Reader) parsers
+    */
+    class ParserBase
+    {
+    protected:
+        static inline bool notWS( char c )
+        {
+            return !(c == ' ' || c == '\n' || c == '\t' || c == '\r');
+        }
+
+        static inline bool isDigit( char c )
+        {
+            return (c >= '0' && c <= '9');
+        }
+
+        static uint8_t toHex( const char* C )
+        {
+            char c = *C;
+
+            if ( c >= '0' && c <= '9' )
+                return (uint8_t)(c - '0');
+            else if ( c >= 'A' && c <= 'F' )
+                return (uint8_t)(10 + c - 'A');
+            else if ( c >= 'a' && c <= 'f' )
+                return (uint8_t)(10 + c - 'a');
+            else
+                ERR_INVALID_CHAR( C );
+        }
+
+        enum ParseState : uint8_t
+        {
+            PS_SEEK_BEG,
+            PS_SEEK_KEY,
+            PS_IN_KEY,
+            PS_SEEK_SEP,
+            PS_SEEK_VAL,
+            PS_IN_VAL_STR,
+            PS_IN_VAL_BOOL,
+            PS_IN_VAL_NUM,
+            PS_NUM_INT,
+            PS_NUM_FRAC,
+            PS_NUM_EXP,
+            PS_SEEK_OBJ_END,
+            PS_SEEK_ARR_END,
+            PS_SEEK_END,
+        };
+
+        static inline const char* parseString( std::string& a_value, const char* start )
+        {
+            // On entry, c is next char after "
+            const char* c = start;
+            const char* a = start;
+            uint32_t        utf8;
+
+            a_value.clear();
+
+            while ( *c )
+            {
+                if ( *c == '\\' )
+                {
+                    if ( c != a )
+                        a_value.append( a, (unsigned int)( c - a ));
+
+                    switch ( *(c + 1) )
+                    {
+                    case 'b':  a_value.append( "\b" ); break;
+                    case 'f':  a_value.append( "\f" ); break;
+                    case 'n':  a_value.append( "\n" ); break;
+                    case 'r':  a_value.append( "\r" ); break;
+                    case 't':  a_value.append( "\t" ); break;
+                    case '/':  a_value.append( "/" ); break;
+                    case '"':  a_value.append( "\"" ); break;
+                    case '\\':  a_value.append( "\\" ); break;
+                    case 'u':
+                        utf8 = ( uint32_t )((toHex( c + 2 ) << 12) | (toHex( c + 3 ) << 8) | (toHex( c + 4 ) << 4) | toHex( c + 5 ));
+
+                        if ( utf8 < 0x80 )
+                            a_value.append( 1, (char)utf8 );
+                        else if ( utf8 < 0x800 )
+                        {
+                            a_value.append( 1, (char)(0xC0 | (utf8 >> 6)) );
+                            a_value.append( 1, (char)(0x80 | (utf8 & 0x3F)) );
+                        }
+                        else if ( utf8 < 0x10000 )
+                        {
+                            a_value.append( 1, (char)(0xE0 | (utf8 >> 12)) );
+                            a_value.append( 1, (char)(0x80 | ((utf8 >> 6) & 0x3F)) );
+                            a_value.append( 1, (char)(0x80 | (utf8 & 0x3F)) );
+                        }
+                        else if ( utf8 < 0x110000 )
+                        {
+                            a_value.append( 1, (char)(0xF0 | (utf8 >> 18)) );
+                            a_value.append( 1, (char)(0x80 | ((utf8 >> 12) & 0x3F)) );
+                            a_value.append( 1, (char)(0x80 | ((utf8 >> 6) & 0x3F)) );
+                            a_value.append( 1, (char)(0x80 | (utf8 & 0x3F)) );
+                        }
+                        else
+                            ERR_INVALID_UNICODE( c );
+
+                        c += 4;
+                        break;
+                    default:
+                        ERR_INVALID_CHAR( c );
+                    }
+
+                    c++;
+                    a = c + 1;
+                }
+                else if ( *c == '"' )
+                {
+                    if ( c != a )
+                        a_value.append( a, (unsigned int)(c - a));
+                    return c;
+                }
+                else if ( *c >= 0 && *c < 0x20 )
+                {
+                    ERR_INVALID_CHAR( c );
+                }
+
+                c++;
+            }
+
+            ERR_UNTERMINATED_VALUE( start );
+        }
+
+        static inline const char* parseNumber( double& a_value, const char* start )
+        {
+            char* end;
+            a_value = strtod( start, &end );
+
+            return end - 1;
+        }
+    };
+
+    /// Object size at which a hash index of entries is built
+    #define LIBJSON_OBJ_INDEX_MIN 16
+    /// Max string capacity (bytes) and object/array capacity (entries) retained by pooled nodes
+    #define LIBJSON_POOL_MAX_STR 256
+    #define LIBJSON_POOL_MAX_ENTRIES 64
+
+    /**
+    * @class NodePool
+    * @brief Per-thread free list of Value storage nodes (strings, objects, arrays)
+    *
+    * Nodes released by destroyed Values are kept, with their allocated
+    * capacity (see Value::freeNode), and reused by subsequent parses on the
+    * same thread. A parsed document therefore mostly reuses the storage of
+    * previously freed documents rather than allocating each node and string
+    * buffer from the heap. At most a_max nodes are retained per thread.
+    */
+    template<typename T, size_t a_max>
+    class NodePool
     {
     public:
-        typedef std::map<std::string, Value>::iterator ObjectIter;
-        typedef std::map<std::string, Value>::const_iterator ObjectConstIter;
+        static inline T * alloc()
+        {
+            if ( !closed() )
+            {
+                std::vector<T*> & nodes = getList().nodes;
+
+                if ( nodes.size() )
+                {
+                    T * node = nodes.back();
+                    nodes.pop_back();
+                    return node;
+                }
+            }
+
+            return new T();
+        }
+
+        /// Node must be cleared by caller
+        static inline void release( T * a_node )
+        {
+            if ( !closed() )
+            {
+                std::vector<T*> & nodes = getList().nodes;
+
+                if ( nodes.size() < a_max )
+                {
+                    nodes.push_back( a_node );
+                    return;
+                }
+            }
+
+            delete a_node;
+        }
+
+    private:
+        struct List
+        {
+            ~List()
+            {
+                closed() = true;
+
+                for ( typename std::vector<T*>::iterator n = nodes.begin(); n != nodes.end(); n++ )
+                    delete *n;
+            }
+
+            std::vector<T*> nodes;
+        };
+
+        static inline List & getList()
+        {
+            static thread_local List list;
+            return list;
+        }
+
+        /// Set when thread's list is destroyed (Values freed later at thread exit bypass the pool)
+        static inline bool & closed()
+        {
+            static thread_local bool is_closed = false;
+            return is_closed;
+        }
+    };
+
+    class Value : private ParserBase
+    {
+    public:
+        typedef std::vector<std::pair<std::string, Value>>::iterator ObjectIter;
+        typedef std::vector<std::pair<std::string, Value>>::const_iterator ObjectConstIter;
         typedef std::vector<Value> Array;
         typedef std::string String;
         typedef std::vector<Value>::iterator ArrayIter;
@@ -75,342 +296,433 @@ namespace libjson {
 
         /**
         * @class Object
-        * @brief Provides a wrapper around underlying map to provide helper methods
+        * @brief Provides a wrapper around underlying key/value storage to provide helper methods
+        *
+        * Entries are held in a contiguous vector in insertion order. Small
+        * objects are searched linearly; once an object reaches
+        * LIBJSON_OBJ_INDEX_MIN entries an open-addressed hash index of the
+        * entries is built and maintained. The "current" entry set by has() is
+        * held as an index so that it remains valid when entries are added.
         */
         class Object
         {
         public:
-            Object()
-            {
-                m_iter = m_map.end();
-            }
+            Object() :
+                m_cur( npos )
+            {}
 
             ~Object()
             {}
 
             inline size_t size()
             {
-                return m_map.size();
+                return m_items.size();
             }
 
             inline void clear()
             {
-                m_map.clear();
-                m_iter = m_map.end();
+                m_items.clear();
+                m_index.clear();
+                m_cur = npos;
             }
 
             // The following methods look-up a value from key and attempt to return a specific type
 
             Value & getValue( const std::string& a_key )
             {
-                ObjectIter iter = m_map.find( a_key );
-
-                if ( iter == m_map.end() )
-                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
-
-                return (Value &) iter->second;
+                return entry( a_key ).second;
             }
 
             const Value & getValue( const std::string& a_key ) const
             {
-                ObjectConstIter iter = m_map.find( a_key );
-
-                if ( iter == m_map.end() )
-                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
-
-                return iter->second;
+                return entry( a_key ).second;
             }
 
             Object & getObject( const std::string& a_key )
             {
-                ObjectIter iter = m_map.find( a_key );
-
-                if ( iter == m_map.end() )
-                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
+                Entry & e = entry( a_key );
 
-                if ( iter->second.m_type == VT_OBJECT )
-                    return (Object &)*iter->second.m_value.o;
+                if ( e.second.m_type == VT_OBJECT )
+                    return *e.second.m_value.o;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << iter->second.getTypeString() << " value to object for key " << a_key );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to object for key " << a_key );
             }
 
             const Object& getObject( const std::string& a_key ) const
             {
-                ObjectConstIter iter = m_map.find( a_key );
+                const Entry & e = entry( a_key );
 
-                if ( iter == m_map.end() )
-                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
-
-                if ( iter->second.m_type == VT_OBJECT )
-                    return (const Object&)*iter->second.m_value.o;
+                if ( e.second.m_type == VT_OBJECT )
+                    return *e.second.m_value.o;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << iter->second.getTypeString() << " value to object for key " << a_key );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to object for key " << a_key );
             }
 
 
             Array& getArray( const std::string& a_key )
             {
-                ObjectIter iter = m_map.find( a_key );
+                Entry & e = entry( a_key );
 
-                if ( iter == m_map.end() )
-                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
+                if ( e.second.m_type == VT_ARRAY )
+                    return *e.second.m_value.a;
 
-                if ( iter->second.m_type == VT_ARRAY )
-                    return *iter->second.m_value.a;
-
-                EXCEPT_PARAM( 1, "Invalid conversion of " << iter->second.getTypeString() << " value to array for key " << a_key );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to array for key " << a_key );
             }
 
             const Array& getArray( const std::string& a_key ) const
             {
-                ObjectConstIter iter = m_map.find( a_key );
-
-                if ( iter == m_map.end() )
-                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
+                const Entry & e = entry( a_key );
 
-                if ( iter->second.m_type == VT_ARRAY )
-                    return *iter->second.m_value.a;
+                if ( e.second.m_type == VT_ARRAY )
+                    return *e.second.m_value.a;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << iter->second.getTypeString() << " value to array for key " << a_key );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to array for key " << a_key );
             }
 
 
             bool getBool( const std::string& a_key ) const
             {
-                ObjectConstIter iter = m_map.find( a_key );
-
-                if ( iter == m_map.end() )
-                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
+                const Entry & e = entry( a_key );
 
-                if ( iter->second.m_type == VT_BOOL )
-                    return iter->second.m_value.b;
-                else if ( iter->second.m_type == VT_NUMBER )
-                    return (bool)iter->second.m_value.n;
+                if ( e.second.m_type == VT_BOOL )
+                    return e.second.m_value.b;
+                else if ( e.second.m_type == VT_NUMBER )
+                    return (bool)e.second.m_value.n;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << iter->second.getTypeString() << " value to boolean for key " << a_key );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to boolean for key " << a_key );
             }
 
             double getNumber( const std::string& a_key ) const
             {
-                ObjectConstIter iter = m_map.find( a_key );
-
-                if ( iter == m_map.end() )
-                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
+                const Entry & e = entry( a_key );
 
-                if ( iter->second.m_type == VT_NUMBER )
-                    return iter->second.m_value.n;
-                else if ( iter->second.m_type == VT_BOOL )
-                    return iter->second.m_value.b ? 1 : 0;
+                if ( e.second.m_type == VT_NUMBER )
+                    return e.second.m_value.n;
+                else if ( e.second.m_type == VT_BOOL )
+                    return e.second.m_value.b ? 1 : 0;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << iter->second.getTypeString() << " value to number for key " << a_key );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to number for key " << a_key );
             }
 
             const std::string& getString( const std::string& a_key ) const
             {
-                ObjectConstIter iter = m_map.find( a_key );
+                const Entry & e = entry( a_key );
 
-                if ( iter == m_map.end() )
-                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
-
-                if ( iter->second.m_type == VT_STRING )
-                    return *iter->second.m_value.s;
+                if ( e.second.m_type == VT_STRING )
+                    return *e.second.m_value.s;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << iter->second.getTypeString() << " value to string for key " << a_key );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to string for key " << a_key );
             }
 
             std::string& getString( const std::string& a_key )
             {
-                ObjectIter iter = m_map.find( a_key );
+                Entry & e = entry( a_key );
 
-                if ( iter == m_map.end() )
-                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
+                if ( e.second.m_type == VT_STRING )
+                    return *e.second.m_value.s;
 
-                if ( iter->second.m_type == VT_STRING )
-                    return *iter->second.m_value.s;
-
-                EXCEPT_PARAM( 1, "Invalid conversion of " << iter->second.getTypeString() << " value to string for key " << a_key );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to string for key " << a_key );
             }
 
             // Checks if key is present, sets internal iterator to entry
 
             inline bool has( const std::string& a_key ) const
             {
-                return (m_iter = m_map.find( a_key )) != m_map.end();
+                return (m_cur = lookup( a_key )) != npos;
             }
 
             // The following methods can be called after has() (sets internal iterator to entry)
 
             Value & value()
             {
-                if ( m_iter == m_map.end() )
-                    EXCEPT( 1, "Key not set" );
-
-                return (Value &) m_iter->second;
+                return current().second;
             }
 
             const Value & value() const
             {
-                if ( m_iter == m_map.end() )
-                    EXCEPT( 1, "Key not set" );
-
-                return m_iter->second;
+                return current().second;
             }
 
             std::string & asString()
             {
-                if ( m_iter == m_map.end() )
-                    EXCEPT( 1, "Key not set" );
+                Entry & e = current();
 
-                if ( m_iter->second.m_type == VT_STRING )
-                    return *m_iter->second.m_value.s;
+                if ( e.second.m_type == VT_STRING )
+                    return *e.second.m_value.s;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << m_iter->second.getTypeString() << " value to string for key " << m_iter->first);
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to string for key " << e.first);
             }
 
             const std::string& asString() const
             {
-                if ( m_iter == m_map.end() )
-                    EXCEPT( 1, "Key not set" );
+                const Entry & e = current();
 
-                if ( m_iter->second.m_type == VT_STRING )
-                    return *m_iter->second.m_value.s;
+                if ( e.second.m_type == VT_STRING )
+                    return *e.second.m_value.s;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << m_iter->second.getTypeString() << " value to string for key " << m_iter->first );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to string for key " << e.first );
             }
 
             double asNumber() const
             {
-                if ( m_iter == m_map.end() )
-                    EXCEPT( 1, "No key set" );
+                const Entry & e = current();
 
-                if ( m_iter->second.m_type == VT_NUMBER )
-                    return m_iter->second.m_value.n;
-                else if ( m_iter->second.m_type == VT_BOOL )
-                    return m_iter->second.m_value.b ? 1 : 0;
+                if ( e.second.m_type == VT_NUMBER )
+                    return e.second.m_value.n;
+                else if ( e.second.m_type == VT_BOOL )
+                    return e.second.m_value.b ? 1 : 0;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << m_iter->second.getTypeString() << " value to number for key " << m_iter->first );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to number for key " << e.first );
             }
 
             bool asBool() const
             {
-                if ( m_iter == m_map.end() )
-                    EXCEPT( 1, "Key not set" );
+                const Entry & e = current();
 
-                if ( m_iter->second.m_type == VT_BOOL )
-                    return m_iter->second.m_value.b;
-                else if ( m_iter->second.m_type == VT_NUMBER )
-                    return (bool)m_iter->second.m_value.n;
+                if ( e.second.m_type == VT_BOOL )
+                    return e.second.m_value.b;
+                else if ( e.second.m_type == VT_NUMBER )
+                    return (bool)e.second.m_value.n;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << m_iter->second.getTypeString() << " value to boolean for key " << m_iter->first );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to boolean for key " << e.first );
             }
 
             Object& asObject()
             {
-                if ( m_iter == m_map.end() )
-                    EXCEPT( 1, "Key not set" );
+                Entry & e = current();
 
-                if ( m_iter->second.m_type == VT_OBJECT )
-                    return *m_iter->second.m_value.o;
+                if ( e.second.m_type == VT_OBJECT )
+                    return *e.second.m_value.o;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << m_iter->second.getTypeString() << " value to object for key " << m_iter->first );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to object for key " << e.first );
             }
 
             const Object& asObject() const
             {
-                if ( m_iter == m_map.end() )
-                    EXCEPT( 1, "Key not set" );
+                const Entry & e = current();
 
-                if ( m_iter->second.m_type == VT_OBJECT )
-                    return *m_iter->second.m_value.o;
+                if ( e.second.m_type == VT_OBJECT )
+                    return *e.second.m_value.o;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << m_iter->second.getTypeString() << " value to object for key " << m_iter->first );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to object for key " << e.first );
             }
 
             Array& asArray()
             {
-                if ( m_iter == m_map.end() )
-                    EXCEPT( 1, "Key not set" );
+                Entry & e = current();
 
-                if ( m_iter->second.m_type == VT_ARRAY )
-                    return *m_iter->second.m_value.a;
+                if ( e.second.m_type == VT_ARRAY )
+                    return *e.second.m_value.a;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << m_iter->second.getTypeString() << " value to array for key " << m_iter->first );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to array for key " << e.first );
             }
 
             const Array& asArray() const
             {
-                if ( m_iter == m_map.end() )
-                    EXCEPT( 1, "Key not set" );
+                const Entry & e = current();
 
-                if ( m_iter->second.m_type == VT_ARRAY )
-                    return *m_iter->second.m_value.a;
+                if ( e.second.m_type == VT_ARRAY )
+                    return *e.second.m_value.a;
 
-                EXCEPT_PARAM( 1, "Invalid conversion of " << m_iter->second.getTypeString() << " value to array for key " << m_iter->first );
+                EXCEPT_PARAM( 1, "Invalid conversion of " << e.second.getTypeString() << " value to array for key " << e.first );
             }
 
-            // The following methods provide a lower-level map-like interface
+            // The following methods provide a lower-level map-like interface (iteration is in insertion order)
 
             inline ObjectIter find( const std::string& a_key )
             {
-                return m_map.find( a_key );
+                size_t i = lookup( a_key );
+
+                return i == npos ? m_items.end() : m_items.begin() + i;
             }
 
             inline ObjectConstIter find( const std::string& a_key ) const
             {
-                return m_map.find( a_key );
+                size_t i = lookup( a_key );
+
+                return i == npos ? m_items.end() : m_items.begin() + i;
             }
 
             inline ObjectIter begin()
             {
-                return m_map.begin();
+                return m_items.begin();
             }
 
             inline ObjectConstIter begin() const
             {
-                return m_map.begin();
+                return m_items.begin();
             }
 
             inline ObjectIter end()
             {
-                return m_map.end();
+                return m_items.end();
             }
 
             inline ObjectConstIter end() const
             {
-                return m_map.end();
+                return m_items.end();
             }
 
             Value& operator[]( const std::string& a_key )
             {
-                return m_map[a_key];
+                size_t i = lookup( a_key );
+
+                if ( i == npos )
+                    return insert( a_key );
+
+                return m_items[i].second;
             }
 
             Value& at( const std::string& a_key )
             {
-                ObjectIter iter = m_map.find( a_key );
-                if ( iter != m_map.end())
-                    return iter->second;
+                size_t i = lookup( a_key );
+                if ( i != npos )
+                    return m_items[i].second;
 
                 EXCEPT_PARAM( 1, "Key " << a_key << " not present" );
             }
 
             const Value& at( const std::string& a_key ) const
             {
-                ObjectConstIter iter = m_map.find( a_key );
-                if ( iter != m_map.end() )
-                    return iter->second;
+                size_t i = lookup( a_key );
+                if ( i != npos )
+                    return m_items[i].second;
 
                 EXCEPT_PARAM( 1, "Key " << a_key << " not present" );
             }
 
             void erase( const std::string& a_key )
             {
-                m_map.erase( a_key );
+                size_t i = lookup( a_key );
+
+                if ( i != npos )
+                {
+                    m_items.erase( m_items.begin() + i );
+                    m_cur = npos;
+
+                    if ( m_index.size() )
+                        buildIndex();
+                }
             }
 
         private:
-            std::map<std::string, Value>    m_map;
-            mutable ObjectConstIter         m_iter;
+            typedef std::pair<std::string, Value> Entry;
+
+            static const size_t npos = (size_t)-1;
+
+            inline Entry & entry( const std::string& a_key )
+            {
+                size_t i = lookup( a_key );
+
+                if ( i == npos )
+                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
+
+                return m_items[i];
+            }
+
+            inline const Entry & entry( const std::string& a_key ) const
+            {
+                size_t i = lookup( a_key );
+
+                if ( i == npos )
+                    EXCEPT_PARAM( 1, "Key not found: " << a_key );
+
+                return m_items[i];
+            }
+
+            inline Entry & current()
+            {
+                if ( m_cur == npos )
+                    EXCEPT( 1, "Key not set" );
+
+                return m_items[m_cur];
+            }
+
+            inline const Entry & current() const
+            {
+                if ( m_cur == npos )
+                    EXCEPT( 1, "Key not set" );
+
+                return m_items[m_cur];
+            }
+
+            inline size_t lookup( const std::string& a_key ) const
+            {
+                if ( m_index.size() )
+                {
+                    size_t      mask = m_index.size() - 1;
+                    size_t      h = std::hash<std::string>()( a_key ) & mask;
+                    uint32_t    i;
+
+                    while (( i = m_index[h] ) != 0 )
+                    {
+                        if ( m_items[i - 1].first == a_key )
+                            return i - 1;
+
+                        h = ( h + 1 ) & mask;
+                    }
+
+                    return npos;
+                }
+
+                size_t n = m_items.size();
+
+                for ( size_t i = 0; i < n; i++ )
+                {
+                    if ( m_items[i].first.size() == a_key.size() && m_items[i].first == a_key )
+                        return i;
+                }
+
+                return npos;
+            }
+
+            Value & insert( const std::string& a_key )
+            {
+                m_items.push_back( Entry( a_key, Value() ));
+
+                if ( m_index.size() )
+                {
+                    // Keep index load factor at or below 1/2
+                    if ( m_items.size() * 2 > m_index.size() )
+                        buildIndex();
+                    else
+                        indexEntry( m_items.size() - 1 );
+                }
+                else if ( m_items.size() >= LIBJSON_OBJ_INDEX_MIN )
+                    buildIndex();
+
+                return m_items.back().second;
+            }
+
+            void buildIndex()
+            {
+                size_t sz = 2 * LIBJSON_OBJ_INDEX_MIN;
+
+                while ( sz < m_items.size() * 4 )
+                    sz <<= 1;
+
+                m_index.assign( sz, 0 );
+
+                for ( size_t i = 0; i < m_items.size(); i++ )
+                    indexEntry( i );
+            }
+
+            inline void indexEntry( size_t a_item )
+            {
+                size_t mask = m_index.size() - 1;
+                size_t h = std::hash<std::string>()( m_items[a_item].first ) & mask;
+
+                while ( m_index[h] != 0 )
+                    h = ( h + 1 ) & mask;
+
+                m_index[h] = (uint32_t)( a_item + 1 );
+            }
+
+            std::vector<Entry>      m_items;
+            std::vector<uint32_t>   m_index;    ///< Hash index of m_items (entry index + 1, 0 = empty); empty if not indexed
+            mutable size_t          m_cur;      ///< Entry set by has(), npos if none
+
+            friend class Value;
         };
 
 
@@ -439,18 +751,18 @@ namespace libjson {
         Value( const std::string& a_value ) :
             m_type( VT_STRING )
         {
-            m_value.s = new String( a_value );
+            m_value.s = newString( a_value );
         }
 
         Value( const char* a_value ) :
             m_type( VT_STRING )
         {
-            m_value.s = new String( a_value );
+            m_value.s = newString( a_value );
         }
 
         Value( const Value& a_source ) = delete;
 
-        Value( Value&& a_source ) :
+        Value( Value&& a_source ) noexcept :
             m_type( a_source.m_type ), m_value( a_source.m_value )
         {
             a_source.m_type = VT_NULL;
@@ -463,15 +775,15 @@ namespace libjson {
         {
             if ( m_type == VT_OBJECT )
             {
-                m_value.o = new Object();
+                m_value.o = newObject();
             }
             else if ( m_type == VT_ARRAY )
             {
-                m_value.a = new Array();
+                m_value.a = newArray();
             }
             else if ( m_type == VT_STRING )
             {
-                m_value.s = new String();
+                m_value.s = newString();
             }
             else
             {
@@ -482,11 +794,11 @@ namespace libjson {
         ~Value()
         {
             if ( m_type == VT_STRING )
-                delete m_value.s;
+                freeNode( m_value.s );
             else if ( m_type == VT_OBJECT )
-                delete m_value.o;
+                freeNode( m_value.o );
             else if ( m_type == VT_ARRAY )
-                delete m_value.a;
+                freeNode( m_value.a );
         }
 
         Value& operator=( Value&& a_source )
@@ -589,7 +901,7 @@ namespace libjson {
             {
                 this->~Value();
                 m_type = VT_STRING;
-                m_value.s = new String( a_value );
+                m_value.s = newString( a_value );
             }
 
             *m_value.s = a_value;
@@ -603,7 +915,7 @@ namespace libjson {
             {
                 this->~Value();
                 m_type = VT_STRING;
-                m_value.s = new String( a_value );
+                m_value.s = newString( a_value );
             }
 
             *m_value.s = a_value;
@@ -757,7 +1069,7 @@ namespace libjson {
         {
             this->~Value();
             m_type = VT_OBJECT;
-            m_value.o = new Object();
+            m_value.o = newObject();
 
             return *m_value.o;
         }
@@ -784,7 +1096,7 @@ namespace libjson {
         {
             this->~Value();
             m_type = VT_ARRAY;
-            m_value.a = new Array();
+            m_value.a = newArray();
 
             return *m_value.a;
         }
@@ -884,49 +1196,7 @@ namespace libjson {
         }
 
 
-    private:
-
-        inline bool notWS( char c ) const
-        {
-            return !(c == ' ' || c == '\n' || c == '\t' || c == '\r');
-        }
-
-        inline bool isDigit( char c ) const
-        {
-            return (c >= '0' && c <= '9');
-        }
-
-        uint8_t toHex( const char* C )
-        {
-            char c = *C;
-
-            if ( c >= '0' && c <= '9' )
-                return (uint8_t)(c - '0');
-            else if ( c >= 'A' && c <= 'F' )
-                return (uint8_t)(10 + c - 'A');
-            else if ( c >= 'a' && c <= 'f' )
-                return (uint8_t)(10 + c - 'a');
-            else
-                ERR_INVALID_CHAR( C );
-        }
-
-        enum ParseState : uint8_t
-        {
-            PS_SEEK_BEG,
-            PS_SEEK_KEY,
-            PS_IN_KEY,
-            PS_SEEK_SEP,
-            PS_SEEK_VAL,
-            PS_IN_VAL_STR,
-            PS_IN_VAL_BOOL,
-            PS_IN_VAL_NUM,
-            PS_NUM_INT,
-            PS_NUM_FRAC,
-            PS_NUM_EXP,
-            PS_SEEK_OBJ_END,
-            PS_SEEK_ARR_END,
-            PS_SEEK_END,
-        };
+    private:
 
         ValueType   m_type;
 
@@ -940,6 +1210,74 @@ namespace libjson {
         } m_value;
 
 
+        typedef NodePool<String,8192>                   StringPool;
+        typedef NodePool<Object,1024>                   ObjectPool;
+        typedef NodePool<Array,1024>                    ArrayPool;
+
+        static inline String * newString()
+        {
+            return StringPool::alloc();
+        }
+
+        static inline String * newString( const std::string & a_value )
+        {
+            String * s = StringPool::alloc();
+            s->assign( a_value );
+            return s;
+        }
+
+        static inline String * newString( const char * a_value )
+        {
+            String * s = StringPool::alloc();
+            s->assign( a_value );
+            return s;
+        }
+
+        static inline Object * newObject()
+        {
+            return ObjectPool::alloc();
+        }
+
+        static inline Array * newArray()
+        {
+            return ArrayPool::alloc();
+        }
+
+        // Nodes are cleared before release; storage beyond the retention limits is freed
+
+        static inline void freeNode( String * a_node )
+        {
+            if ( a_node->capacity() > LIBJSON_POOL_MAX_STR )
+                String().swap( *a_node );
+            else
+                a_node->clear();
+
+            StringPool::release( a_node );
+        }
+
+        static inline void freeNode( Object * a_node )
+        {
+            if ( a_node->m_items.capacity() > LIBJSON_POOL_MAX_ENTRIES )
+            {
+                std::vector<Object::Entry>().swap( a_node->m_items );
+                std::vector<uint32_t>().swap( a_node->m_index );
+            }
+
+            a_node->clear();
+
+            ObjectPool::release( a_node );
+        }
+
+        static inline void freeNode( Array * a_node )
+        {
+            if ( a_node->capacity() > LIBJSON_POOL_MAX_ENTRIES )
+                Array().swap( *a_node );
+            else
+                a_node->clear();
+
+            ArrayPool::release( a_node );
+        }
+
         void toStringRecurse( std::string& a_buffer ) const
         {
             switch ( m_type )
@@ -1045,7 +1383,7 @@ namespace libjson {
             std::string     key;
 
             a_parent.m_type = VT_OBJECT;
-            a_parent.m_value.o = new Object();
+            a_parent.m_value.o = newObject();
 
             while ( *c )
             {
@@ -1104,7 +1442,7 @@ namespace libjson {
             Value           value;
 
             a_parent.m_type = VT_ARRAY;
-            a_parent.m_value.a = new Array();
+            a_parent.m_value.a = newArray();
             a_parent.m_value.a->reserve( 20 );
 
             while ( *c )
@@ -1153,7 +1491,7 @@ namespace libjson {
                     return c;
                 case '"':
                     a_value.m_type = VT_STRING;
-                    a_value.m_value.s = new String();
+                    a_value.m_value.s = newString();
                     c = parseString( *a_value.m_value.s, c + 1 );
                     return c;
                 case 't':
@@ -1205,92 +1543,286 @@ namespace libjson {
 
             ERR_UNTERMINATED_VALUE( start );
         }
+    };
 
-        inline const char* parseString( std::string& a_value, const char* start )
+    /**
+    * @class Reader
+    * @brief Streaming (SAX-style) JSON parser
+    *
+    * Parses JSON text and reports containers, keys, and values to a handler
+    * as they are encountered, without building a Value tree. String arguments
+    * passed to the handler refer to reused buffers and are only valid for the
+    * duration of the call. The handler type must provide these methods:
+    *
+    *   void startObject();
+    *   void endObject();
+    *   void startArray();
+    *   void endArray();
+    *   bool key( const std::string & a_key );
+    *   void raw( const char * a_json, size_t a_len );
+    *   void stringValue( const std::string & a_value );
+    *   void numberValue( double a_value );
+    *   void boolValue( bool a_value );
+    *   void nullValue();
+    *
+    * If key() returns true, the value of that key is not decoded; instead its
+    * JSON text is passed to raw(). This is used to skip unneeded values or to
+    * capture nested documents verbatim.
+    */
+    class Reader : private ParserBase
+    {
+    public:
+        template<typename H>
+        inline void parse( const std::string & a_raw_json, H & a_handler )
         {
-            // On entry, c is next char after "
-            const char* c = start;
-            const char* a = start;
-            uint32_t        utf8;
+            parse( a_raw_json.c_str(), a_handler );
+        }
 
-            a_value.clear();
+        template<typename H>
+        void parse( const char* a_raw_json, H & a_handler )
+        {
+            const char* c = a_raw_json;
+            uint8_t         state = PS_SEEK_BEG;
 
-            while ( *c )
+            try
             {
-                if ( *c == '\\' )
+                while ( *c )
                 {
-                    if ( c != a )
-                        a_value.append( a, (unsigned int)( c - a ));
-
-                    switch ( *(c + 1) )
+                    switch ( state )
                     {
-                    case 'b':  a_value.append( "\b" ); break;
-                    case 'f':  a_value.append( "\f" ); break;
-                    case 'n':  a_value.append( "\n" ); break;
-                    case 'r':  a_value.append( "\r" ); break;
-                    case 't':  a_value.append( "\t" ); break;
-                    case '/':  a_value.append( "/" ); break;
-                    case '"':  a_value.append( "\"" ); break;
-                    case '\\':  a_value.append( "\\" ); break;
-                    case 'u':
-                        utf8 = ( uint32_t )((toHex( c + 2 ) << 12) | (toHex( c + 3 ) << 8) | (toHex( c + 4 ) << 4) | toHex( c + 5 ));
-
-                        if ( utf8 < 0x80 )
-                            a_value.append( 1, (char)utf8 );
-                        else if ( utf8 < 0x800 )
-                        {
-                            a_value.append( 1, (char)(0xC0 | (utf8 >> 6)) );
-                            a_value.append( 1, (char)(0x80 | (utf8 & 0x3F)) );
-                        }
-                        else if ( utf8 < 0x10000 )
+                    case PS_SEEK_BEG:
+                        if ( *c == '{' )
                         {
-                            a_value.append( 1, (char)(0xE0 | (utf8 >> 12)) );
-                            a_value.append( 1, (char)(0x80 | ((utf8 >> 6) & 0x3F)) );
-                            a_value.append( 1, (char)(0x80 | (utf8 & 0x3F)) );
+                            c = parseObject( a_handler, c + 1 );
+                            state = PS_SEEK_END;
                         }
-                        else if ( utf8 < 0x110000 )
+                        else if ( *c == '[' )
                         {
-                            a_value.append( 1, (char)(0xF0 | (utf8 >> 18)) );
-                            a_value.append( 1, (char)(0x80 | ((utf8 >> 12) & 0x3F)) );
-                            a_value.append( 1, (char)(0x80 | ((utf8 >> 6) & 0x3F)) );
-                            a_value.append( 1, (char)(0x80 | (utf8 & 0x3F)) );
+                            c = parseArray( a_handler, c + 1 );
+                            state = PS_SEEK_END;
                         }
-                        else
-                            ERR_INVALID_UNICODE( c );
-
-                        c += 4;
+                        else if ( notWS( *c ) )
+                            ERR_INVALID_CHAR( c );
+                        break;
+                    case PS_SEEK_END:
+                        if ( notWS( *c ) )
+                            ERR_INVALID_CHAR( c );
                         break;
-                    default:
-                        ERR_INVALID_CHAR( c );
                     }
 
                     c++;
-                    a = c + 1;
                 }
-                else if ( *c == '"' )
+            }
+            catch ( ParseError& e )
+            {
+                e.setOffset( (size_t)a_raw_json );
+                throw;
+            }
+        }
+
+    private:
+        /// Handler used to scan over values that are delivered raw
+        struct SkipHandler
+        {
+            inline void startObject() {}
+            inline void endObject() {}
+            inline void startArray() {}
+            inline void endArray() {}
+            inline bool key( const std::string & ) { return false; }
+            inline void raw( const char *, size_t ) {}
+            inline void stringValue( const std::string & ) {}
+            inline void numberValue( double ) {}
+            inline void boolValue( bool ) {}
+            inline void nullValue() {}
+        };
+
+        template<typename H>
+        const char* parseObject( H & a_handler, const char* start )
+        {
+            // On function entry, c is next char after '{'
+
+            uint8_t         state = PS_SEEK_KEY;
+            const char*     c = start;
+            const char*     v;
+            bool            raw = false;
+
+            a_handler.startObject();
+
+            while ( *c )
+            {
+                switch ( state )
                 {
-                    if ( c != a )
-                        a_value.append( a, (unsigned int)(c - a));
-                    return c;
+                case PS_SEEK_KEY:
+                    if ( *c == '}' )
+                    {
+                        a_handler.endObject();
+                        return c;
+                    }
+                    else if ( *c == '"' )
+                    {
+                        c = parseString( m_key, c + 1 );
+
+                        if ( !m_key.size() )
+                            ERR_INVALID_KEY( c );
+
+                        raw = a_handler.key( m_key );
+                        state = PS_SEEK_SEP;
+                    }
+                    else if ( notWS( *c ) )
+                        ERR_INVALID_CHAR( c );
+                    break;
+                case PS_SEEK_SEP:
+                    if ( *c == ':' )
+                        state = PS_SEEK_VAL;
+                    else if ( notWS( *c ) )
+                        ERR_INVALID_CHAR( c );
+                    break;
+                case PS_SEEK_VAL:
+                    if ( notWS( *c ) )
+                    {
+                        if ( raw )
+                        {
+                            SkipHandler skip;
+
+                            v = c;
+                            c = parseValue( skip, c );
+                            a_handler.raw( v, (size_t)( c - v + 1 ));
+                        }
+                        else
+                            c = parseValue( a_handler, c );
+
+                        state = PS_SEEK_OBJ_END;
+                    }
+                    break;
+
+                case PS_SEEK_OBJ_END:
+                    if ( *c == ',' )
+                        state = PS_SEEK_KEY;
+                    else if ( *c == '}' )
+                    {
+                        a_handler.endObject();
+                        return c;
+                    }
+                    else if ( notWS( *c ) )
+                        ERR_INVALID_CHAR( c );
+                    break;
                 }
-                else if ( *c >= 0 && *c < 0x20 )
+
+                c++;
+            }
+
+            ERR_UNTERMINATED_OBJECT( start );
+        }
+
+        template<typename H>
+        const char* parseArray( H & a_handler, const char* start )
+        {
+            // On function entry, c is next char after '['
+            const char*     c = start;
+            uint8_t         state = PS_SEEK_VAL;
+
+            a_handler.startArray();
+
+            while ( *c )
+            {
+                switch ( state )
                 {
-                    ERR_INVALID_CHAR( c );
+                case PS_SEEK_VAL:
+                    if ( *c == ']' )
+                    {
+                        a_handler.endArray();
+                        return c;
+                    }
+                    else if ( notWS( *c ) )
+                    {
+                        c = parseValue( a_handler, c );
+                        state = PS_SEEK_SEP;
+                    }
+                    break;
+                case PS_SEEK_SEP:
+                    if ( *c == ',' )
+                        state = PS_SEEK_VAL;
+                    else if ( *c == ']' )
+                    {
+                        a_handler.endArray();
+                        return c;
+                    }
+                    else if ( notWS( *c ) )
+                        ERR_INVALID_CHAR( c );
+                    break;
                 }
 
                 c++;
             }
 
-            ERR_UNTERMINATED_VALUE( start );
+            ERR_UNTERMINATED_ARRAY( start );
         }
 
-        inline const char* parseNumber( double& a_value, const char* start )
+        template<typename H>
+        inline const char* parseValue( H & a_handler, const char* start )
         {
-            char* end;
-            a_value = strtod( start, &end );
+            const char* c = start;
+            double      num;
 
-            return end - 1;
+            while ( *c )
+            {
+                switch ( *c )
+                {
+                case '{':
+                    return parseObject( a_handler, c + 1 );
+                case '[':
+                    return parseArray( a_handler, c + 1 );
+                case '"':
+                    c = parseString( m_value, c + 1 );
+                    a_handler.stringValue( m_value );
+                    return c;
+                case 't':
+                    if ( *(c + 1) == 'r' && *(c + 2) == 'u' && *(c + 3) == 'e' )
+                    {
+                        a_handler.boolValue( true );
+                        return c + 3;
+                    }
+                    else
+                        ERR_INVALID_VALUE( c );
+                    break;
+                case 'f':
+                    if ( *(c + 1) == 'a' && *(c + 2) == 'l' && *(c + 3) == 's' && *(c + 4) == 'e' )
+                    {
+                        a_handler.boolValue( false );
+                        return c + 4;
+                    }
+                    else
+                        ERR_INVALID_VALUE( c );
+                    break;
+                case 'n':
+                    if ( *(c + 1) == 'u' && *(c + 2) == 'l' && *(c + 3) == 'l' )
+                    {
+                        a_handler.nullValue();
+                        return c + 3;
+                    }
+                    else
+                        ERR_INVALID_VALUE( c );
+                    break;
+                default:
+                    if ( *c == '-' || isDigit( *c ) || *c == '.' )
+                    {
+                        c = parseNumber( num, c );
+                        a_handler.numberValue( num );
+                        return c;
+                    }
+                    else if ( notWS( *c ) )
+                        ERR_INVALID_CHAR( c );
+                    break;
+                }
+
+                c++;
+            }
+
+            ERR_UNTERMINATED_VALUE( start );
         }
+
+        std::string     m_key;      ///< Reused key buffer
+        std::string     m_value;    ///< Reused string value buffer
     };
 }
 
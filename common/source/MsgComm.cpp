@@ -1,5 +1,6 @@
 #include <iostream>
 #include <iomanip>
+#include <memory>
 #include <arpa/inet.h>
 #include "TraceException.hpp"
 #include "MsgComm.hpp"
@@ -10,18 +11,23 @@ using namespace std;
 
 #define MAX_ADDR_LEN 1000
 
+// Message frame: size, proto ID, msg ID, context; extended frame adds request timeout, then flags
+#define FRAME_LEN 8
+#define FRAME_EXT_LEN 12
+#define FRAME_FLAGS_LEN 16
+
 
 void freeBuffer( void * a_data, void * a_hint )
 {
     (void) a_hint;
-    delete (char*) a_data;
+    delete[] (char*) a_data;
 }
 
 
-MsgComm::MsgComm( const std::string & a_address, SockType a_sock_type, bool a_bind, const SecurityContext * a_sec_ctx, void * a_zmq_ctx )
+MsgComm::MsgComm( const std::string & a_address, SockType a_sock_type, bool a_bind, const SecurityContext * a_sec_ctx, void * a_zmq_ctx, const SocketOptions * a_sock_opts )
     : m_socket(0), m_bound(a_bind), m_address(a_address)
 {
-    init( a_sock_type, a_sec_ctx, a_zmq_ctx );
+    init( a_sock_type, a_sec_ctx, a_zmq_ctx, a_sock_opts );
 }
 
 
@@ -38,11 +44,13 @@ MsgComm::~MsgComm()
 }
 
 void
-MsgComm::send( MsgBuf::Message & a_msg, uint16_t a_context )
+MsgComm::send( MsgBuf::Message & a_msg, uint16_t a_context, uint32_t a_timeout, uint32_t a_flags )
 {
     MsgBuf buf( "", a_context, 0 );
 
     buf.serialize( a_msg );
+    buf.setTimeout( a_timeout );
+    buf.setFlags( a_flags );
 
     send( buf, false );
 }
@@ -57,11 +65,14 @@ MsgComm::send( MsgBuf::Message & a_msg, const std::string & a_uid, uint16_t a_co
     send( buf, true );
 }
 
-void
-MsgComm::send( MsgBuf & a_msg_buf, bool a_proc_uid )
+bool
+MsgComm::send( MsgBuf & a_msg_buf, bool a_proc_uid, bool a_dont_wait )
 {
     zmq_msg_t msg;
     int rc;
+    uint32_t body_size = a_msg_buf.getFrame().size;
+    // Only the first part can block; the rest of an accepted message is always queued
+    int first = a_dont_wait ? ZMQ_DONTWAIT : 0;
 
     uint8_t * route = a_msg_buf.getRouteBuffer();
     if ( *route )
@@ -78,38 +89,59 @@ MsgComm::send( MsgBuf & a_msg_buf, bool a_proc_uid )
             zmq_msg_init_size( &msg, *rptr );
             memcpy( zmq_msg_data( &msg ), rptr + 1, *rptr );
 
-            if (( rc = zmq_msg_send( &msg, m_socket, ZMQ_SNDMORE )) < 0 )
+            if (( rc = zmq_msg_send( &msg, m_socket, ZMQ_SNDMORE | first )) < 0 )
+            {
+                zmq_msg_close( &msg );
+
+                if ( first && zmq_errno() == EAGAIN )
+                    return false;
+
                 EXCEPT( 1, "zmq_msg_send (route) failed." );
+            }
+
+            first = 0;
         }
     }
 
     // Send NULL delimiter
 
     zmq_msg_init( &msg );
-    if (( rc = zmq_msg_send( &msg, m_socket, ZMQ_SNDMORE )) < 0 )
+    if (( rc = zmq_msg_send( &msg, m_socket, ZMQ_SNDMORE | first )) < 0 )
+    {
+        if ( first && zmq_errno() == EAGAIN )
+            return false;
+
         EXCEPT( 1, "zmq_msg_send (delimiter) failed." );
+    }
 
-    // Send message Frame
+    // Send message Frame (extended frame only if a request timeout or flags are set)
     // Convert host binary to network (big-endian)
-    zmq_msg_init_size( &msg, 8 );
+    zmq_msg_init_size( &msg, a_msg_buf.getFlags() ? FRAME_FLAGS_LEN : a_msg_buf.getTimeout() ? FRAME_EXT_LEN : FRAME_LEN );
     unsigned char * dest = (unsigned char *)zmq_msg_data( &msg );
     MsgBuf::Frame & frame = a_msg_buf.getFrame();
     *((uint32_t*)dest) = htonl( frame.size );
     *(dest+4) = frame.proto_id;
     *(dest+5) = frame.msg_id;
     *((uint16_t*)(dest+6)) = htons( frame.context );
+    if ( a_msg_buf.getTimeout() || a_msg_buf.getFlags() )
+        *((uint32_t*)(dest+8)) = htonl( a_msg_buf.getTimeout() );
+    if ( a_msg_buf.getFlags() )
+        *((uint32_t*)(dest+12)) = htonl( a_msg_buf.getFlags() );
 
     //zmq_msg_init_size( &msg, sizeof( MsgBuf::Frame ));
     //memcpy( zmq_msg_data( &msg ), &a_msg_buf.getFrame(), sizeof( MsgBuf::Frame ));
 
-    if (( rc = zmq_msg_send( &msg, m_socket, (a_msg_buf.getFrame().size || a_proc_uid )?ZMQ_SNDMORE:0 )) < 0 )
+    if (( rc = zmq_msg_send( &msg, m_socket, (body_size || a_proc_uid )?ZMQ_SNDMORE:0 )) < 0 )
         EXCEPT( 1, "zmq_msg_send (frame) failed." );
 
-    if ( a_msg_buf.getFrame().size )
+    if ( body_size )
     {
         //cout << "send body\n";
 
-        zmq_msg_init_data( &msg, a_msg_buf.acquireBuffer(), a_msg_buf.getFrame().size, freeBuffer, 0 );
+        // Forward an attached (received) body as-is, otherwise hand serialized buffer to zeromq - no copies either way
+        zmq_msg_init( &msg );
+        if ( !a_msg_buf.detachMessage( msg ))
+            zmq_msg_init_data( &msg, a_msg_buf.acquireBuffer(), body_size, freeBuffer, 0 );
 
         if (( rc = zmq_msg_send( &msg, m_socket, a_proc_uid?ZMQ_SNDMORE:0 )) < 0 )
             EXCEPT( 1, "zmq_msg_send (body) failed." );
@@ -128,9 +160,23 @@ MsgComm::send( MsgBuf & a_msg_buf, bool a_proc_uid )
             zmq_msg_init( &msg );
         }
 
-        if (( rc = zmq_msg_send( &msg, m_socket, 0 )) < 0 )
+        if (( rc = zmq_msg_send( &msg, m_socket, a_msg_buf.getStamp() ? ZMQ_SNDMORE : 0 )) < 0 )
             EXCEPT( 1, "zmq_msg_send (uid) failed." );
+
+        // Send receive timestamp, if set
+        if ( a_msg_buf.getStamp() )
+        {
+            uint64_t stamp = a_msg_buf.getStamp();
+
+            zmq_msg_init_size( &msg, sizeof( stamp ));
+            memcpy( zmq_msg_data( &msg ), &stamp, sizeof( stamp ));
+
+            if (( rc = zmq_msg_send( &msg, m_socket, 0 )) < 0 )
+                EXCEPT( 1, "zmq_msg_send (stamp) failed." );
+        }
     }
+
+    return true;
 }
 
 
@@ -139,14 +185,36 @@ MsgComm::recv( MsgBuf::Message *& a_msg, MsgBuf::Frame & a_frame, uint32_t a_tim
 {
     MsgBuf buf;
 
-    if ( recv( buf, false, a_timeout ))
+    if ( !recv( buf, false, a_timeout ))
+        return false;
+
+    a_frame = buf.getFrame();
+    a_msg = buf.unserialize();
+
+    // Merge partial frames of a streamed reply as they arrive
+    while ( buf.getFlags() & MsgBuf::FLAG_PARTIAL )
     {
-        a_frame = buf.getFrame();
-        a_msg = buf.unserialize();
-        return true;
+        if ( !recv( buf, false, a_timeout ))
+        {
+            delete a_msg;
+            a_msg = 0;
+            return false;
+        }
+
+        if ( buf.getFrame().context != a_frame.context || buf.getMsgType() != a_frame.getMsgType() )
+        {
+            delete a_msg;
+            a_msg = 0;
+            EXCEPT_PARAM( 1, "RCV Invalid partial reply frame, msg type: " << buf.getMsgType() << ", context: " << buf.getFrame().context );
+        }
+
+        unique_ptr<MsgBuf::Message> part( buf.unserialize() );
+
+        a_msg->MergeFrom( *part );
+        a_frame.size += buf.getFrame().size;
     }
 
-    return false;
+    return true;
 }
 
 bool
@@ -186,6 +254,8 @@ MsgComm::recv( MsgBuf & a_msg_buf, bool a_proc_uid, uint32_t a_timeout )
     uint8_t * rptr = route + 1;
 
     *route = 0;
+    a_msg_buf.releaseMessage();
+    a_msg_buf.setStamp( 0 );
 
     while ( 1 )
     {
@@ -221,10 +291,12 @@ MsgComm::recv( MsgBuf & a_msg_buf, bool a_proc_uid, uint32_t a_timeout )
     if (( rc = zmq_msg_recv( &msg, m_socket, ZMQ_DONTWAIT )) < 0 )
         EXCEPT_PARAM( 1, "RCV zmq_msg_recv (frame) failed: " << zmq_strerror(errno) );
 
-    if ( zmq_msg_size( &msg ) != sizeof( MsgBuf::Frame ))
+    len = zmq_msg_size( &msg );
+
+    if ( len != FRAME_LEN && len != FRAME_EXT_LEN && len != FRAME_FLAGS_LEN )
     {
         //hexDump( (char *)zmq_msg_data( &msg ), ((char *)zmq_msg_data( &msg )) + zmq_msg_size( &msg ), cout );
-        EXCEPT_PARAM( 1, "RCV Invalid message frame received. Expected " << sizeof( MsgBuf::Frame ) << " got " << zmq_msg_size( &msg ) );
+        EXCEPT_PARAM( 1, "RCV Invalid message frame received. Expected " << FRAME_LEN << ", " << FRAME_EXT_LEN << ", or " << FRAME_FLAGS_LEN << " got " << len );
     }
 
     unsigned char * src = (unsigned char *)zmq_msg_data( &msg );
@@ -234,6 +306,8 @@ MsgComm::recv( MsgBuf & a_msg_buf, bool a_proc_uid, uint32_t a_timeout )
     frame.proto_id = *(src+4);
     frame.msg_id = *(src+5);
     frame.context = ntohs( *((uint16_t*)( src + 6 )));
+    a_msg_buf.setTimeout( len >= FRAME_EXT_LEN ? ntohl( *((uint32_t*)( src + 8 ))) : 0 );
+    a_msg_buf.setFlags( len == FRAME_FLAGS_LEN ? ntohl( *((uint32_t*)( src + 12 ))) : 0 );
 
     //a_msg_buf.getFrame() = *((MsgBuf::Frame*) zmq_msg_data( &msg ));
 
@@ -250,11 +324,14 @@ MsgComm::recv( MsgBuf & a_msg_buf, bool a_proc_uid, uint32_t a_timeout )
         if (( rc = zmq_msg_recv( &msg, m_socket, ZMQ_DONTWAIT )) < 0 )
             EXCEPT( 1, "RCV zmq_msg_recv (body) failed." );
 
-        if ( zmq_msg_size( &msg ) != a_msg_buf.getFrame().size )
-            EXCEPT_PARAM( 1, "RCV Invalid message body received. Expected: " << a_msg_buf.getFrame().size << ", got: " << zmq_msg_size( &msg ) );
+        if (( len = zmq_msg_size( &msg )) != a_msg_buf.getFrame().size )
+        {
+            zmq_msg_close( &msg );
+            EXCEPT_PARAM( 1, "RCV Invalid message body received. Expected: " << a_msg_buf.getFrame().size << ", got: " << len );
+        }
 
-        a_msg_buf.ensureCapacity( a_msg_buf.getFrame().size );
-        memcpy( a_msg_buf.getBuffer(), zmq_msg_data( &msg ), a_msg_buf.getFrame().size );
+        // MsgBuf takes ownership of received body (no copy)
+        a_msg_buf.attachMessage( msg );
 
         //cout << "Body:\n";
         //hexDump( a_msg_buf.getBuffer(), a_msg_buf.getBuffer() + a_msg_buf.getFrame().size, cout );
@@ -285,6 +362,19 @@ MsgComm::recv( MsgBuf & a_msg_buf, bool a_proc_uid, uint32_t a_timeout )
             else
                 a_msg_buf.clearUID();
 
+            // Receive timestamp may follow UID (added by core server I/O threads)
+            if ( zmq_msg_more( &msg ))
+            {
+                zmq_msg_close( &msg );
+                zmq_msg_init( &msg );
+
+                if (( rc = zmq_msg_recv( &msg, m_socket, ZMQ_DONTWAIT )) < 0 )
+                    EXCEPT( 1, "RCV zmq_msg_recv (stamp) failed." );
+
+                if ( zmq_msg_size( &msg ) == sizeof( uint64_t ))
+                    a_msg_buf.setStamp( *((uint64_t*) zmq_msg_data( &msg )));
+            }
+
             zmq_msg_close( &msg );
         }
     }
@@ -527,7 +617,7 @@ MsgComm::reset()
 }
 
 void
-MsgComm::init( SockType a_sock_type, const SecurityContext * a_sec_ctx, void * a_zmq_ctx )
+MsgComm::init( SockType a_sock_type, const SecurityContext * a_sec_ctx, void * a_zmq_ctx, const SocketOptions * a_sock_opts )
 {
     //cout << "Init conn to " << m_address << "\n";
 
@@ -564,6 +654,20 @@ MsgComm::init( SockType a_sock_type, const SecurityContext * a_sec_ctx, void * a
     value = 4000;
     zmq_setsockopt( m_socket, ZMQ_RECONNECT_IVL_MAX, &value, sizeof( int ));
 
+    if ( a_sock_opts )
+    {
+        value = a_sock_opts->immediate ? 1 : 0;
+        if (( rc = zmq_setsockopt( m_socket, ZMQ_IMMEDIATE, &value, sizeof( int ))) == -1 )
+            EXCEPT( 1, "Set ZMQ_IMMEDIATE failed." );
+
+        if ( a_sock_opts->send_hwm )
+        {
+            value = a_sock_opts->send_hwm;
+            if (( rc = zmq_setsockopt( m_socket, ZMQ_SNDHWM, &value, sizeof( int ))) == -1 )
+                EXCEPT( 1, "Set ZMQ_SNDHWM failed." );
+        }
+    }
+
     //cerr << "init 5" << endl;
 
     if ( m_bound )
@@ -585,7 +689,7 @@ MsgComm::init( SockType a_sock_type, const SecurityContext * a_sec_ctx, void * a
 
     //cerr << "init 6" << endl;
 
-    value = 100;
+    value = a_sock_opts ? a_sock_opts->linger : 100;
     zmq_setsockopt( m_socket, ZMQ_LINGER, &value, sizeof( int ));
 
     m_poll_item.socket = m_socket;
@@ -387,18 +387,50 @@ router.get('/read', function (req, res) {
             throw g_lib.ERR_PERM_DENIED;
         }
 
-        var qry = "for v in 1..1 outbound @coll item sort is_same_collection('c',v) DESC, v.title",
-            result, params = { coll: coll_id }, item;
+        var qry = "for v in 1..1 outbound @coll item let c = is_same_collection('c',v)",
+            result, params = { coll: coll_id }, item, cur, paging,
+            ret = " return { id: v._id, title: v.title, alias: v.alias, owner: v.owner, creator: v.creator, size: v.size, external: v.external, md_err: v.md_err, locked: v.locked }";
+
+        // Items are sorted collections first, then by title; ID makes the order unique for keyset paging
+        if ( req.queryParams.cont ){
+            cur = g_lib.decodeCursor( req.queryParams.cont );
+            if ( !Array.isArray( cur.k ) || cur.k.length != 2 || req.queryParams.count == undefined )
+                throw [g_lib.ERR_INVALID_PARAM,"Invalid continuation token or missing count."];
+
+            qry += " filter c < @kc or (c == @kc and (v.title > @kt or (v.title == @kt and v._id > @ki)))";
+            params.kc = cur.k[0];
+            params.kt = cur.k[1];
+            params.ki = cur.i;
+        }
 
-        if ( req.queryParams.offset != undefined && req.queryParams.count != undefined ){
-            qry += " limit " + req.queryParams.offset + ", " + req.queryParams.count;
-            qry += " return { id: v._id, title: v.title, alias: v.alias, owner: v.owner, creator: v.creator, size: v.size, external: v.external, md_err: v.md_err, locked: v.locked }";
-            result = g_db._query( qry, params,{},{fullCount:true});
-            var tot = result.getExtra().stats.fullCount;
-            result = result.toArray();
-            result.push({paging:{off:req.queryParams.offset,cnt:req.queryParams.count,tot:tot}});
+        qry += " sort c DESC, v.title, v._id";
+
+        if ( req.queryParams.count != undefined && ( cur || req.queryParams.offset != undefined )){
+            // One extra item is read to detect a next page
+            qry += " limit " + ( cur ? 0 : req.queryParams.offset ) + ", " + ( req.queryParams.count + 1 ) + ret;
+
+            if ( cur ){
+                result = g_db._query( qry, params ).toArray();
+                paging = { cnt: req.queryParams.count };
+                if ( req.queryParams.total )
+                    paging.tot = g_db._query( "for v in 1..1 outbound @coll item collect with count into n return n", { coll: coll_id }).next();
+            }else{
+                result = g_db._query( qry, params, {}, { fullCount: req.queryParams.total });
+                paging = { off: req.queryParams.offset, cnt: req.queryParams.count };
+                if ( req.queryParams.total )
+                    paging.tot = result.getExtra().stats.fullCount;
+                result = result.toArray();
+            }
+
+            if ( result.length > req.queryParams.count ){
+                result.length = req.queryParams.count;
+                item = result[result.length - 1];
+                paging.next = g_lib.encodeCursor({ k: [ item.id.startsWith( "c/" ), item.title ], i: item.id });
+            }
+
+            result.push({ paging: paging });
         }else{
-            qry += " return { id: v._id, title: v.title, alias: v.alias, owner: v.owner, creator: v.creator, size: v.size, external: v.external, md_err: v.md_err, locked: v.locked }";
+            qry += ret;
             result = g_db._query( qry, params ).toArray();
         }
 
@@ -418,6 +450,8 @@ router.get('/read', function (req, res) {
 .queryParam('id', joi.string().required(), "Collection ID or alias to list")
 .queryParam('offset', joi.number().integer().min(0).optional(), "Offset")
 .queryParam('count', joi.number().integer().min(1).optional(), "Count")
+.queryParam('cont', joi.string().optional(), "Continuation token (replaces offset)")
+.queryParam('total', joi.boolean().optional().default(true), "Compute total count of items when paging")
 .summary('Read contents of a collection by ID or alias')
 .description('Read contents of a collection by ID or alias');
 
@@ -732,6 +732,41 @@ router.post('/update/md_err_msg', function (req, res) {
 .summary('Update data record schema validation error message')
 .description('Update data record schema validation error message');
 
+router.post('/update/md_err_msg/batch', function (req, res) {
+    try {
+        g_db._executeTransaction({
+            collections: {
+                write: ["d"]
+            },
+            action: function() {
+                const client = g_lib.getUserFromClientID( req.queryParams.client );
+                var rec, data_id;
+
+                for ( var i in req.body.records ){
+                    rec = req.body.records[i];
+                    data_id = g_lib.resolveDataID( rec.id, client );
+
+                    if ( !g_db.d.exists({ _id: data_id }))
+                        throw [g_lib.ERR_INVALID_PARAM,"Record, " + data_id + ", does not exist."];
+
+                    g_db._update( data_id, { md_err_msg: rec.md_err_msg, md_err: true }, { keepNull: false });
+                }
+            }
+        });
+    } catch( e ) {
+        g_lib.handleException( e, res );
+    }
+})
+.queryParam('client', joi.string().optional(), "Client ID")
+.body(joi.object({
+    records: joi.array().items(joi.object({
+        id: joi.string().required(),
+        md_err_msg: joi.string().required()
+    })).required()
+}).required(), 'Record IDs and error messages')
+.summary('Update schema validation error messages of a batch of data records')
+.description('Update schema validation error messages of a batch of data records');
+
 // Only called after upload of raw data for managed records
 router.post('/update/size', function (req, res) {
         var retry = 10;
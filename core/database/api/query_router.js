@@ -246,8 +246,24 @@ router.get('/list', function (req, res) {
 .summary('List client saved queries')
 .description('List client saved queries');
 
-function execQuery( client, mode, published, query ){
-    var col_chk = true, ctxt = client._id;
+function execQuery( client, mode, published, query, cont ){
+    var col_chk = true, ctxt = client._id, cur;
+
+    // Queries compiled for keyset paging have keyset parameters (kc, ks, ki); others continue by offset
+    if ( cont ){
+        cur = g_lib.decodeCursor( cont );
+
+        if ( cur.o !== undefined ){
+            query.params.off = cur.o;
+        }else if ( query.params.kc !== undefined ){
+            query.params.kc = true;
+            query.params.ks = cur.k === undefined ? null : cur.k;
+            query.params.ki = cur.i;
+            query.params.off = 0;
+        }else{
+            throw [g_lib.ERR_INVALID_PARAM,"Invalid continuation token"];
+        }
+    }
 
     if ( !published ){
         // For searches over private data, must perform access checks based on owner field and client id
@@ -367,14 +383,15 @@ function execQuery( client, mode, published, query ){
         query.params.cnt = g_lib.MAX_PAGE_SIZE;
     }
 
-    if ( query.params.off + query.params.cnt > g_lib.MAX_QRY_ITEMS ){
+    // Keyset paging does not skip results, so is not subject to the result offset limit
+    if ( !query.params.kc && query.params.off + query.params.cnt > g_lib.MAX_QRY_ITEMS ){
         query.params.off = g_lib.MAX_QRY_ITEMS - query.params.cnt;
     }
 
     // Increase limit by 1 to detect more results
     query.params.cnt += 1;
 
-    var item,
+    var item, next,
         result = g_db._query( qry, query.params, {}, {}).toArray(),
         cnt = result.length;
 
@@ -384,6 +401,12 @@ function execQuery( client, mode, published, query ){
     if ( result.length == query.params.cnt ){
         query.params.cnt -= 1;
         result.length = query.params.cnt;
+
+        item = result[result.length - 1];
+        if ( query.params.kc !== undefined )
+            next = g_lib.encodeCursor({ k: item.sk, i: item._id });
+        else
+            next = g_lib.encodeCursor({ o: query.params.off + query.params.cnt });
     }
 
     for ( var i in result ){
@@ -399,9 +422,14 @@ function execQuery( client, mode, published, query ){
         }
 
         item.notes = g_lib.getNoteMask( client, item );
+        delete item.sk;
     }
 
-    result.push({ paging: { off: query.params.off, cnt: result.length, tot: query.params.off + cnt }});
+    // Offset and total are unknown on keyset continuation pages (as for collection reads)
+    if ( query.params.kc )
+        result.push({ paging: { cnt: result.length, next: next }});
+    else
+        result.push({ paging: { off: query.params.off, cnt: result.length, tot: query.params.off + cnt, next: next }});
 
     return result;
 }
@@ -420,7 +448,7 @@ router.get('/exec', function (req, res) {
             qry.params.cnt = req.queryParams.count;
         }
 
-        var results = execQuery( client, qry.query.mode, qry.query.published, qry );
+        var results = execQuery( client, qry.query.mode, qry.query.published, qry, req.queryParams.cont );
 
         res.send( results );
     } catch( e ) {
@@ -431,6 +459,7 @@ router.get('/exec', function (req, res) {
 .queryParam('id', joi.string().required(), "Query ID")
 .queryParam('offset', joi.number().integer().min(0).max(999).optional(), "Offset")
 .queryParam('count', joi.number().integer().min(1).max(1000).optional(), "Count")
+.queryParam('cont', joi.string().optional(), "Continuation token (replaces offset)")
 .summary('Execute specified query')
 .description('Execute specified query');
 
@@ -439,7 +468,7 @@ router.post('/exec/direct', function (req, res) {
     try {
         const client = g_lib.getUserFromClientID_noexcept( req.queryParams.client );
 
-        var results = execQuery( client, req.body.mode, req.body.published, req.body );
+        var results = execQuery( client, req.body.mode, req.body.published, req.body, req.body.cont );
 
         res.send( results );
     } catch( e ) {
@@ -454,7 +483,8 @@ router.post('/exec/direct', function (req, res) {
     qry_end: joi.string().required(),
     qry_filter: joi.string().optional().allow(""),
     params: joi.object().required(),
-    limit: joi.number().integer().required()
+    limit: joi.number().integer().required(),
+    cont: joi.string().optional()
 }).required(), 'Collection fields')
 .summary('Execute published data search query')
 .description('Execute published data search query');
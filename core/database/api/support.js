@@ -375,6 +375,27 @@ module.exports = ( function() {
         return false;
     };
 
+    // Listing continuation tokens are opaque to clients. A token holds the sort key (k) and ID (i)
+    // of the last item of a page for keyset paging, or the offset (o) of the next page.
+    obj.encodeCursor = function( a_cursor ){
+        return Buffer.from( JSON.stringify( a_cursor )).toString( "base64" );
+    };
+
+    obj.decodeCursor = function( a_token ){
+        var cur;
+
+        try {
+            cur = JSON.parse( Buffer.from( a_token, "base64" ).toString() );
+        } catch( e ) {
+            cur = null;
+        }
+
+        if ( !cur || typeof cur !== "object" || ( cur.o === undefined && cur.i === undefined ) || ( cur.o !== undefined && !obj.isInteger( cur.o )))
+            throw [obj.ERR_INVALID_PARAM,"Invalid continuation token"];
+
+        return cur;
+    };
+
     obj.isFullGlobusPath = function( a_path, a_is_file = true ){
         // Full Globus path can be UUID/<som_path> or legacy#name/<some_path>
         var idx = a_path.indexOf("/");
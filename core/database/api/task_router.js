@@ -250,7 +250,39 @@ router.get('/reload', function (req, res) {
                 exclusive: ["task","lock","block"]
             },
             action: function() {
-                result = g_db._query( "for i in task filter i.status > 0 and i.status < 3 sort i.status desc return i._id" ).toArray();
+                if ( req.queryParams.count ){
+                    // Paged mode - returns task descriptors, running tasks first, then ready tasks, each in key order. The cursor
+                    // holds status and key of last task returned and is only set if more tasks may remain.
+                    var qry = "for i in task filter i.status > 0 and i.status < 3",
+                        params = { count: req.queryParams.count },
+                        page, cur;
+
+                    if ( req.queryParams.cursor ){
+                        cur = req.queryParams.cursor.split(":");
+                        if ( cur.length != 2 )
+                            throw [g_lib.ERR_INVALID_PARAM,"Invalid task cursor."];
+
+                        qry += " and ( i.status < @st or ( i.status == @st and i._key > @key ))";
+                        params.st = parseInt( cur[0] );
+                        params.key = cur[1];
+                    }
+
+                    qry += " sort i.status desc, i._key limit @count return { id: i._id, type: i.type, client: i.client, key: i._key, st: i.status }";
+
+                    page = g_db._query( qry, params ).toArray();
+                    result = { task: [] };
+
+                    for ( var i in page ){
+                        result.task.push({ id: page[i].id, type: page[i].type, client: page[i].client });
+                    }
+
+                    if ( page.length == req.queryParams.count ){
+                        cur = page[page.length-1];
+                        result.cursor = cur.st + ":" + cur.key;
+                    }
+                }else{
+                    result = g_db._query( "for i in task filter i.status > 0 and i.status < 3 sort i.status desc return i._id" ).toArray();
+                }
             }
         });
 
@@ -259,8 +291,10 @@ router.get('/reload', function (req, res) {
         g_lib.handleException( e, res );
     }
 })
+.queryParam('cursor', joi.string().optional(), "Cursor returned with previous page")
+.queryParam('count', joi.number().integer().min(1).optional(), "Page size (returns all tasks if omitted)")
 .summary('Reload ready/running task records')
-.description('Reload ready/running task records.');
+.description('Reload ready/running task records. If count is specified, returns a page of task descriptors and a cursor for the next page.');
 
 router.get('/purge', function (req, res) {
     try{
@@ -1076,9 +1076,10 @@ var tasks_func = function() {
             dep_blocks = g_db.block.byExample({_from:dep}).toArray();
             // If blocked task has only one block, then it's this task being finalized and will be able to run now
             if ( dep_blocks.length == 1 ){
-                ready_tasks.push( dep );
                 //console.log("taskComplete - task", dep, "ready");
-                g_db.task.update( dep, { status: g_lib.TS_READY, msg: "Pending", ut: time }, { returnNew: true, waitForSync: true });
+                dep = g_db.task.update( dep, { status: g_lib.TS_READY, msg: "Pending", ut: time }, { returnNew: true, waitForSync: true }).new;
+                // Descriptor used by core server for task scheduling
+                ready_tasks.push({ id: dep._id, type: dep.type, client: dep.client });
             }
         }
         //console.log("taskComplete 3");
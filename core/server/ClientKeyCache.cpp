@@ -0,0 +1,186 @@
+#include "ClientKeyCache.hpp"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+#define KEY_CACHE_WHEEL_SLOTS 512
+
+ClientKeyCache::ClientKeyCache( size_t a_max, uint32_t a_ttl, uint32_t a_neg_ttl ) :
+    m_max( a_max ),
+    m_ttl( a_ttl ),
+    m_neg_ttl( a_neg_ttl ),
+    m_expiry( chrono::seconds( 1 ), KEY_CACHE_WHEEL_SLOTS ),
+    m_hits(0),
+    m_neg_hits(0),
+    m_misses(0),
+    m_evictions(0)
+{
+}
+
+ClientKeyCache::~ClientKeyCache()
+{
+}
+
+/**
+ * @brief Look up a client key
+ * @return True if key is cached; a_anon is set for negative entries (a_uid is not set)
+ */
+bool
+ClientKeyCache::get( const std::string & a_key, std::string & a_uid, bool & a_anon )
+{
+    lock_guard<mutex> lock( m_mutex );
+
+    index_t::iterator i = m_index.find( a_key );
+
+    if ( i == m_index.end() || i->second->expires <= chrono::steady_clock::now() )
+    {
+        m_misses++;
+        return false;
+    }
+
+    // Move to front of LRU list
+    m_lru.splice( m_lru.begin(), m_lru, i->second );
+
+    if ( i->second->uid.empty() )
+    {
+        a_anon = true;
+        m_neg_hits++;
+    }
+    else
+    {
+        a_anon = false;
+        a_uid = i->second->uid;
+        m_hits++;
+    }
+
+    return true;
+}
+
+void
+ClientKeyCache::put( const std::string & a_key, const std::string & a_uid )
+{
+    lock_guard<mutex> lock( m_mutex );
+
+    insert( a_key, a_uid, m_ttl );
+}
+
+void
+ClientKeyCache::putAnon( const std::string & a_key )
+{
+    lock_guard<mutex> lock( m_mutex );
+
+    insert( a_key, string(), m_neg_ttl );
+}
+
+/**
+ * @brief Remove entry for a key (i.e. a key newly assigned to a user)
+ */
+void
+ClientKeyCache::invalidateKey( const std::string & a_key )
+{
+    lock_guard<mutex> lock( m_mutex );
+
+    index_t::iterator i = m_index.find( a_key );
+
+    if ( i != m_index.end() )
+    {
+        m_lru.erase( i->second );
+        m_index.erase( i );
+    }
+}
+
+/**
+ * @brief Remove all entries for a user (i.e. after credentials are revoked)
+ */
+void
+ClientKeyCache::invalidateUser( const std::string & a_uid )
+{
+    lock_guard<mutex> lock( m_mutex );
+
+    for ( lru_t::iterator e = m_lru.begin(); e != m_lru.end(); )
+    {
+        if ( e->uid == a_uid )
+        {
+            m_index.erase( e->key );
+            e = m_lru.erase( e );
+        }
+        else
+            e++;
+    }
+}
+
+/**
+ * @brief Remove expired entries
+ *
+ * Wheel items for entries that were refreshed or evicted since being
+ * scheduled are ignored.
+ */
+void
+ClientKeyCache::purge()
+{
+    lock_guard<mutex> lock( m_mutex );
+
+    timepoint_t now = chrono::steady_clock::now();
+
+    m_expiry.expire( now, [this,now]( const string & a_key )
+    {
+        index_t::iterator i = m_index.find( a_key );
+
+        if ( i != m_index.end() && i->second->expires <= now )
+        {
+            m_lru.erase( i->second );
+            m_index.erase( i );
+        }
+    });
+}
+
+void
+ClientKeyCache::getStats( Stats & a_stats )
+{
+    lock_guard<mutex> lock( m_mutex );
+
+    a_stats.hits = m_hits;
+    a_stats.neg_hits = m_neg_hits;
+    a_stats.misses = m_misses;
+    a_stats.evictions = m_evictions;
+    a_stats.entries = m_index.size();
+}
+
+/// Mutex must be held by caller
+void
+ClientKeyCache::insert( const std::string & a_key, const std::string & a_uid, std::chrono::seconds a_ttl )
+{
+    if ( !m_max || !a_ttl.count() )
+        return;
+
+    timepoint_t expires = chrono::steady_clock::now() + a_ttl;
+    index_t::iterator i = m_index.find( a_key );
+
+    if ( i != m_index.end() )
+    {
+        m_lru.splice( m_lru.begin(), m_lru, i->second );
+    }
+    else
+    {
+        if ( m_index.size() >= m_max )
+        {
+            m_index.erase( m_lru.back().key );
+            m_lru.pop_back();
+            m_evictions++;
+        }
+
+        m_lru.push_front( Entry() );
+        m_lru.front().key = a_key;
+        m_index[a_key] = m_lru.begin();
+    }
+
+    m_lru.front().uid = a_uid;
+    m_lru.front().expires = expires;
+
+    // Scheduled one tick late so that the entry has expired when purged
+    m_expiry.insert( expires + chrono::seconds( 1 ), a_key );
+}
+
+}}
@@ -0,0 +1,78 @@
+#ifndef CLIENTKEYCACHE_HPP
+#define CLIENTKEYCACHE_HPP
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <stdint.h>
+#include "TimerWheel.hpp"
+
+namespace SDMS {
+namespace Core {
+
+/**
+ * @brief Bounded LRU cache of client public key to DataFed user ID
+ *
+ * Used by the ZAP handler to avoid a DB lookup for every new CURVE
+ * connection. Keys that do not belong to any user (anonymous clients) are
+ * cached as negative entries with a shorter TTL. Entries are expired by a
+ * timer wheel (see purge) and the least recently used entry is evicted when
+ * the cache is full. Access is thread-safe so that credential revocation from
+ * client workers can invalidate entries.
+ */
+class ClientKeyCache
+{
+public:
+    struct Stats
+    {
+        uint64_t    hits;
+        uint64_t    neg_hits;
+        uint64_t    misses;
+        uint64_t    evictions;
+        size_t      entries;
+    };
+
+    ClientKeyCache( size_t a_max, uint32_t a_ttl, uint32_t a_neg_ttl );
+    ~ClientKeyCache();
+
+    bool        get( const std::string & a_key, std::string & a_uid, bool & a_anon );
+    void        put( const std::string & a_key, const std::string & a_uid );
+    void        putAnon( const std::string & a_key );
+    void        invalidateKey( const std::string & a_key );
+    void        invalidateUser( const std::string & a_uid );
+    void        purge();
+    void        getStats( Stats & a_stats );
+
+private:
+    typedef std::chrono::steady_clock::time_point   timepoint_t;
+
+    struct Entry
+    {
+        std::string     key;
+        std::string     uid;        ///< Empty for anonymous (negative) entries
+        timepoint_t     expires;
+    };
+
+    typedef std::list<Entry>                                        lru_t;
+    typedef std::unordered_map<std::string,lru_t::iterator>         index_t;
+
+    void        insert( const std::string & a_key, const std::string & a_uid, std::chrono::seconds a_ttl );
+
+    size_t                                              m_max;
+    std::chrono::seconds                                m_ttl;
+    std::chrono::seconds                                m_neg_ttl;
+    lru_t                                               m_lru;      ///< Most recently used at front
+    index_t                                             m_index;
+    TimerWheel<std::string,std::chrono::steady_clock>   m_expiry;
+    std::mutex                                          m_mutex;
+    uint64_t                                            m_hits;
+    uint64_t                                            m_neg_hits;
+    uint64_t                                            m_misses;
+    uint64_t                                            m_evictions;
+};
+
+}}
+
+#endif
@@ -1,5 +1,9 @@
 #include <iostream>
 #include <atomic>
+#include <memory>
+#include <condition_variable>
+#include <unistd.h>
+#include <fcntl.h>
 #include <boost/tokenizer.hpp>
 #include <ClientWorker.hpp>
 #include <TraceException.hpp>
@@ -9,6 +13,9 @@
 #include <SDMS_Anon.pb.h>
 #include <SDMS_Auth.pb.h>
 #include "TaskMgr.hpp"
+#include "CoreMetrics.hpp"
+#include "SchemaCache.hpp"
+#include "ComputePool.hpp"
 #include "libjson.hpp"
 
 using namespace std;
@@ -22,14 +29,42 @@ namespace Core {
 
 
 map<uint16_t,ClientWorker::msg_fun_t> ClientWorker::m_msg_handlers;
+map<uint16_t,ClientWorker::async_fun_t> ClientWorker::m_msg_handlers_async;
 
 // TODO - This should be defined in proto files
 #define NOTE_MASK_MD_ERR 0x2000
 
-ClientWorker::ClientWorker( ICoreServer & a_core, size_t a_tid ) :
-    m_config(Config::getInstance()), m_core(a_core), m_tid(a_tid), m_worker_thread(0), m_run(true),
-    m_db_client( m_config.db_url , m_config.db_user, m_config.db_pass )
+/// Size of initial arena block; typical requests/replies fit without further allocation
+#define ARENA_BLOCK_SIZE 262144
+
+ClientWorker::ClientWorker( ICoreServer & a_core, size_t a_tid, const std::string & a_address ) :
+    m_config(Config::getInstance()), m_core(a_core), m_tid(a_tid), m_address(a_address), m_worker_thread(0), m_run(true),
+    m_db_client( m_config.db_url , m_config.db_user, m_config.db_pass ), m_stream_accept(false), m_stream_reply(0),
+    m_task_list_msg_type(0), m_async_count(0), m_metrics( a_core.metricsCreate() )
 {
+    m_async_pipe[0] = m_async_pipe[1] = -1;
+
+    google::protobuf::ArenaOptions arena_opt;
+
+    m_arena_block = new char[ARENA_BLOCK_SIZE];
+    arena_opt.initial_block = m_arena_block;
+    arena_opt.initial_block_size = ARENA_BLOCK_SIZE;
+    m_arena = new google::protobuf::Arena( arena_opt );
+
+    if ( m_config.client_async )
+    {
+        if ( pipe( m_async_pipe ) != 0 )
+            EXCEPT( ID_INTERNAL_ERROR, "Failed to create async wake-up pipe" );
+
+        fcntl( m_async_pipe[0], F_SETFL, O_NONBLOCK );
+        fcntl( m_async_pipe[1], F_SETFL, O_NONBLOCK );
+    }
+
+    m_schema_loader = [this]( const std::string & a_id, libjson::Value & a_result )
+    {
+        m_db_client.schemaView( a_id, a_result );
+    };
+
     setupMsgHandlers();
     m_worker_thread = new thread( &ClientWorker::workerThread, this );
 }
@@ -38,6 +73,15 @@ ClientWorker::~ClientWorker()
 {
     stop();
     wait();
+
+    if ( m_async_pipe[0] >= 0 )
+    {
+        close( m_async_pipe[0] );
+        close( m_async_pipe[1] );
+    }
+
+    delete m_arena;
+    delete[] m_arena_block;
 }
 
 void
@@ -58,7 +102,12 @@ ClientWorker::wait()
 }
 
 #define SET_MSG_HANDLER(proto_id,msg,func)  m_msg_handlers[MsgBuf::findMessageType( proto_id, #msg )] = func
-#define SET_MSG_HANDLER_DB(proto_id,rq,rp,func) m_msg_handlers[MsgBuf::findMessageType( proto_id, #rq )] = &ClientWorker::dbPassThrough<rq,rp,&DatabaseAPI::func>
+#define SET_MSG_HANDLER_DB(proto_id,rq,rp,func) \
+{ \
+    uint16_t msg_type = MsgBuf::findMessageType( proto_id, #rq ); \
+    m_msg_handlers[msg_type] = &ClientWorker::dbPassThrough<rq,rp,&DatabaseAPI::func>; \
+    m_msg_handlers_async[msg_type] = &ClientWorker::dbPassThroughAsync<rq,rp,&DatabaseAPI::func>; \
+}
 
 /**
  * This method configures message handling by creating a map from message type to handler function.
@@ -66,6 +115,7 @@ ClientWorker::wait()
  * Google protobuf interface (in /common/proto). Most requests can be handled directly by the
  * DB (via DatabaseAPI class), but some require local processing. This method maps the two classes
  * of requests using the macros SET_MSG_HANDLER (for local) and SET_MSG_HANDLER_DB (for DB only).
+ * DB-only requests are also registered with an async handler used when config.client_async is set.
  */
 void
 ClientWorker::setupMsgHandlers()
@@ -103,6 +153,7 @@ ClientWorker::setupMsgHandlers()
         SET_MSG_HANDLER( proto_id, DataPutRequest, &ClientWorker::procDataPutRequest );
         SET_MSG_HANDLER( proto_id, RecordCreateRequest, &ClientWorker::procRecordCreateRequest );
         SET_MSG_HANDLER( proto_id, RecordUpdateRequest, &ClientWorker::procRecordUpdateRequest );
+        SET_MSG_HANDLER( proto_id, RecordCreateBatchRequest, &ClientWorker::procRecordCreateBatchRequest );
         SET_MSG_HANDLER( proto_id, RecordUpdateBatchRequest, &ClientWorker::procRecordUpdateBatchRequest );
         SET_MSG_HANDLER( proto_id, RecordDeleteRequest, &ClientWorker::procRecordDeleteRequest );
         SET_MSG_HANDLER( proto_id, RecordAllocChangeRequest, &ClientWorker::procRecordAllocChangeRequest );
@@ -118,6 +169,7 @@ ClientWorker::setupMsgHandlers()
         SET_MSG_HANDLER( proto_id, SchemaReviseRequest, &ClientWorker::procSchemaReviseRequest );
         SET_MSG_HANDLER( proto_id, SchemaUpdateRequest, &ClientWorker::procSchemaUpdateRequest );
         SET_MSG_HANDLER( proto_id, MetadataValidateRequest, &ClientWorker::procMetadataValidateRequest );
+        SET_MSG_HANDLER( proto_id, BatchRequest, &ClientWorker::procBatchRequest );
 
         // Requests that can be handled by DB client directly
         SET_MSG_HANDLER_DB( proto_id, CheckPermsRequest, CheckPermsReply, checkPerms );
@@ -138,7 +190,6 @@ ClientWorker::setupMsgHandlers()
         SET_MSG_HANDLER_DB( proto_id, ProjectListRequest, ListingReply, projList );
         SET_MSG_HANDLER_DB( proto_id, ProjectGetRoleRequest, ProjectGetRoleReply, projGetRole );
         SET_MSG_HANDLER_DB( proto_id, RecordViewRequest, RecordDataReply, recordView );
-        SET_MSG_HANDLER_DB( proto_id, RecordCreateBatchRequest, RecordDataReply, recordCreateBatch );
         SET_MSG_HANDLER_DB( proto_id, RecordExportRequest, RecordExportReply, recordExport );
         SET_MSG_HANDLER_DB( proto_id, RecordLockRequest, ListingReply, recordLock );
         SET_MSG_HANDLER_DB( proto_id, RecordListByAllocRequest, ListingReply, recordListByAlloc );
@@ -209,17 +260,35 @@ ClientWorker::setupMsgHandlers()
 
 /**
  * ClientWorker message handling thread.
+ *
+ * In synchronous mode, each message is fully processed before the next is
+ * received. In async mode (config.client_async), DB-only requests are parked
+ * while their DB calls are in-flight, allowing up to config.client_async_max
+ * requests to be processed concurrently by this thread. Requests that require
+ * local processing are always handled synchronously.
  */
 void
 ClientWorker::workerThread()
 {
     DL_DEBUG( "W" << m_tid << " thread started" );
 
-    MsgComm         comm( "inproc://workers", MsgComm::DEALER, false );
+    MsgComm         comm( m_address, MsgComm::DEALER, false );
     uint16_t        msg_type;
     map<uint16_t,msg_fun_t>::iterator handler;
+    map<uint16_t,async_fun_t>::iterator async_handler;
+    chrono::steady_clock::time_point handler_start;
+    bool            handled;
+    bool            credit_due;
+    chrono::steady_clock::time_point deadline;
+    zmq_pollitem_t  poll_items[2];
+    int             poll_count = m_config.client_async ? 2 : 1;
+
+    m_task_list_msg_type = MsgBuf::findMessageType( 2, "TaskListRequest" );
 
-    uint16_t task_list_msg_type = MsgBuf::findMessageType( 2, "TaskListRequest" );
+    comm.getPollInfo( poll_items[0] );
+    poll_items[1].socket = 0;
+    poll_items[1].fd = m_async_pipe[0];
+    poll_items[1].events = ZMQ_POLLIN;
 
     Anon::NackReply nack;
     nack.set_err_code( ID_AUTHN_REQUIRED );
@@ -227,13 +296,40 @@ ClientWorker::workerThread()
 
     //int delay;
 
-    while ( m_run )
+    // Grant initial credits to router (each reply returns one credit)
+    sendCredit( comm, m_config.client_async ? m_config.client_async_max : 1 );
+
+    // In async mode, in-flight requests are allowed to finish before exiting
+    while ( m_run || m_async_count )
     {
+        credit_due = false;
+
         try
         {
-            if ( comm.recv( m_msg_buf, true, 1000 ))
+            // Stop accepting new messages when stopping or when max in-flight requests reached
+            poll_items[0].events = ( m_run && m_async_count < m_config.client_async_max ) ? ZMQ_POLLIN : 0;
+            poll_items[0].revents = 0;
+            poll_items[1].revents = 0;
+
+            if ( zmq_poll( poll_items, poll_count, 1000 ) < 1 )
+                continue;
+
+            if ( poll_items[1].revents & ZMQ_POLLIN )
+                processAsyncCompletions( comm );
+
+            if (( poll_items[0].revents & ZMQ_POLLIN ) && comm.recv( m_msg_buf, true, 1000 ))
             {
+                credit_due = true;
                 msg_type = m_msg_buf.getMsgType();
+                m_metrics->receive();
+
+                // Request flags are not sent back with the reply
+                m_stream_accept = m_msg_buf.getFlags() & MsgBuf::FLAG_STREAM;
+                m_stream_reply = 0;
+                m_msg_buf.setFlags( 0 );
+
+                if ( m_msg_buf.getStamp() )
+                    CoreMetrics::getInstance().recordMsg( msg_type, CoreMetrics::MP_QUEUE, CoreMetrics::usecSinceStamp( m_msg_buf.getStamp() ));
 
                 // DEBUG - Inject random delay in message processing
                 /*delay = (rand() % 2000)*1000;
@@ -242,16 +338,28 @@ ClientWorker::workerThread()
                     usleep( delay );
                 }*/
 
-                if ( msg_type != task_list_msg_type )
+                if ( msg_type != m_task_list_msg_type )
                 {
                     DL_DEBUG( "W" << m_tid << " msg " << msg_type << " ["<< m_msg_buf.getUID() <<"]" );
                 }
 
-                if ( strncmp( m_msg_buf.getUID().c_str(), "anon_", 5 ) == 0 && msg_type > 0x1FF )
+                if ( !checkDeadline( deadline ))
+                {
+                    // Client has given up - no reply
+                    DL_DEBUG( "W" << m_tid << " msg " << msg_type << " [" << m_msg_buf.getUID() << "] expired, discarded" );
+                }
+                else if ( strncmp( m_msg_buf.getUID().c_str(), "anon_", 5 ) == 0 && msg_type > 0x1FF )
                 {
                     DL_WARN( "W" << m_tid << " unauthorized access attempt from anon user" );
                     m_msg_buf.serialize( nack );
                     comm.send( m_msg_buf );
+                    credit_due = false;
+                }
+                else if ( m_config.client_async && ( async_handler = m_msg_handlers_async.find( msg_type )) != m_msg_handlers_async.end() )
+                {
+                    // Reply (and credit) is sent when request completes
+                    startAsyncRequest( comm, async_handler->second, deadline );
+                    credit_due = false;
                 }
                 else
                 {
@@ -260,14 +368,24 @@ ClientWorker::workerThread()
                     {
                         //DL_TRACE( "W"<<m_tid<<" calling handler" );
 
-                        if ( (this->*handler->second)( m_msg_buf.getUID() ))
+                        handler_start = chrono::steady_clock::now();
+                        m_db_client.takeDBTime();
+                        m_db_client.setDeadline( deadline );
+
+                        handled = (this->*handler->second)( m_msg_buf.getUID() );
+
+                        CoreMetrics::getInstance().recordMsg( msg_type, CoreMetrics::MP_HANDLER, CoreMetrics::usecSince( handler_start ));
+                        CoreMetrics::getInstance().recordMsg( msg_type, CoreMetrics::MP_DB, m_db_client.takeDBTime() );
+
+                        if ( handled )
                         {
                             // Gather msg metrics except on task lists (web clients poll)
-                            if ( msg_type != task_list_msg_type )
-                                m_core.metricsUpdateMsgCount( m_msg_buf.getUID(), msg_type );
+                            if ( msg_type != m_task_list_msg_type )
+                                m_metrics->update( m_msg_buf.getUID(), msg_type );
 
-                            comm.send( m_msg_buf );
-                            /*if ( msg_type != task_list_msg_type )
+                            sendReply( comm, m_msg_buf, m_stream_reply );
+                            credit_due = false;
+                            /*if ( msg_type != m_task_list_msg_type )
                             {
                                 DL_DEBUG( "W"<<m_tid<<" reply sent." );
                             }*/
@@ -290,6 +408,345 @@ ClientWorker::workerThread()
         {
             DL_ERROR( "W" << m_tid << " unknown exception type" );
         }
+
+        // Return credit to router if request did not produce a reply
+        if ( credit_due )
+        {
+            try
+            {
+                sendCredit( comm, 1 );
+            }
+            catch( ... )
+            {
+                DL_ERROR( "W" << m_tid << " failed to return credit to router" );
+            }
+        }
+
+        // Frees request and reply messages of synchronously handled requests
+        m_arena->Reset();
+    }
+}
+
+/**
+ * Converts the client timeout of the request in m_msg_buf (if any) to a
+ * deadline, measured from receipt by the I/O thread. Returns false if the
+ * deadline has passed (client has given up), in which case the request is
+ * counted and should be discarded without reply. The timeout is cleared so
+ * that it is not sent back with the reply.
+ */
+bool
+ClientWorker::checkDeadline( chrono::steady_clock::time_point & a_deadline )
+{
+    uint64_t timeout = m_msg_buf.getTimeout() * 1000ULL;
+
+    if ( !timeout )
+    {
+        a_deadline = chrono::steady_clock::time_point();
+        return true;
+    }
+
+    m_msg_buf.setTimeout( 0 );
+
+    uint64_t elapsed = m_msg_buf.getStamp() ? CoreMetrics::usecSinceStamp( m_msg_buf.getStamp() ) : 0;
+
+    if ( elapsed >= timeout )
+    {
+        CoreMetrics::getInstance().recordExpired();
+        return false;
+    }
+
+    a_deadline = chrono::steady_clock::now() + chrono::microseconds( timeout - elapsed );
+
+    return true;
+}
+
+/**
+ * Returns true if a_reply is to be streamed to the client rather than sent as
+ * a single message. Listing, record export, and task data replies larger
+ * than config.stream_chunk_size are streamed if the client accepts it.
+ */
+bool
+ClientWorker::streamReply( bool a_accept, const ::google::protobuf::Message & a_reply )
+{
+    if ( !a_accept || !m_config.stream_chunk_size )
+        return false;
+
+    const google::protobuf::Descriptor * desc = a_reply.GetDescriptor();
+
+    if ( desc != ListingReply::descriptor() && desc != RecordExportReply::descriptor() && desc != TaskDataReply::descriptor() )
+        return false;
+
+    return a_reply.ByteSizeLong() > m_config.stream_chunk_size;
+}
+
+/// Sends the reply serialized in a_buf, or streams a_stream_reply if set
+void
+ClientWorker::sendReply( MsgComm & a_comm, MsgBuf & a_buf, ::google::protobuf::Message * a_stream_reply )
+{
+    if ( a_stream_reply )
+        sendStream( a_comm, a_buf, *a_stream_reply );
+    else
+        a_comm.send( a_buf );
+}
+
+/**
+ * Streams a reply as a sequence of frames sharing the route and context of
+ * the request in a_buf. The results (repeated field 1) of a_reply are split
+ * into partial frames of about config.stream_chunk_size bytes, each holding
+ * a reply message with only that part of the results; the final frame holds
+ * the remaining results and all other reply fields. Partial frames are
+ * flagged (in the frame and the traffic class route segment) so that the
+ * client keeps receiving and the router does not return worker credit.
+ * Merging the frames in order restores the complete reply. a_reply is
+ * modified.
+ */
+void
+ClientWorker::sendStream( MsgComm & a_comm, MsgBuf & a_buf, ::google::protobuf::Message & a_reply )
+{
+    const google::protobuf::Reflection *        refl = a_reply.GetReflection();
+    const google::protobuf::FieldDescriptor *   field = a_reply.GetDescriptor()->FindFieldByNumber( 1 );
+    uint8_t *   route = a_buf.getRouteBuffer();
+    uint16_t    context = a_buf.getFrame().context;
+
+    if ( !field || !field->is_repeated() || !route[0] || route[1] != 1 )
+        EXCEPT( ID_INTERNAL_ERROR, "Reply can not be streamed" );
+
+    bool        is_msg = field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE;
+    int         count = refl->FieldSize( a_reply, field );
+    int         beg = 0, end, i;
+    size_t      size;
+    string      scratch;
+    unique_ptr<google::protobuf::Message> part( a_reply.New() );
+
+    while ( 1 )
+    {
+        for ( end = beg, size = 0; end < count && size < m_config.stream_chunk_size; end++ )
+            size += is_msg ? refl->GetRepeatedMessage( a_reply, field, end ).ByteSizeLong() : refl->GetRepeatedStringReference( a_reply, field, end, &scratch ).size();
+
+        // Last chunk is sent with the rest of the reply
+        if ( end == count )
+            break;
+
+        part->Clear();
+
+        for ( i = beg; i < end; i++ )
+        {
+            if ( is_msg )
+                refl->AddMessage( part.get(), field )->CopyFrom( refl->GetRepeatedMessage( a_reply, field, i ));
+            else
+                refl->AddString( part.get(), field, refl->GetRepeatedString( a_reply, field, i ));
+        }
+
+        // Sending hands off the buffer and clears the frame, so context is restored for each part
+        a_buf.serialize( *part );
+        a_buf.getFrame().context = context;
+        a_buf.setFlags( MsgBuf::FLAG_PARTIAL );
+        route[2] |= TC_PARTIAL_REPLY;
+        a_comm.send( a_buf );
+
+        beg = end;
+    }
+
+    // Drop streamed results from reply
+    for ( i = beg; i < count; i++ )
+        refl->SwapElements( &a_reply, field, i - beg, i );
+
+    for ( i = 0; i < beg; i++ )
+        refl->RemoveLast( &a_reply, field );
+
+    a_buf.serialize( a_reply );
+    a_buf.getFrame().context = context;
+    a_buf.setFlags( 0 );
+    route[2] &= ~TC_PARTIAL_REPLY;
+    a_comm.send( a_buf );
+}
+
+/**
+ * Grants a_credit request credits to the message router. Credits tell the
+ * router how many more requests this worker will accept.
+ */
+void
+ClientWorker::sendCredit( MsgComm & a_comm, uint32_t a_credit )
+{
+    if ( zmq_send( a_comm.getSocket(), &a_credit, sizeof( a_credit ), 0 ) < 0 )
+        EXCEPT_PARAM( ID_INTERNAL_ERROR, "Credit send failed: " << zmq_strerror( errno ));
+}
+
+/**
+ * Parks the request currently held in m_msg_buf and begins async processing.
+ * The request message is unserialized once; the route, UID, and context of
+ * the request are retained so that the reply can be sent when DB calls
+ * complete.
+ */
+void
+ClientWorker::startAsyncRequest( MsgComm & a_comm, async_fun_t a_handler, chrono::steady_clock::time_point a_deadline )
+{
+    AsyncRequest * req = new AsyncRequest( m_msg_buf.getMsgType(), a_handler );
+
+    memcpy( req->msg_buf.getRouteBuffer(), m_msg_buf.getRouteBuffer(), m_msg_buf.getRouteMaxLen() );
+    req->msg_buf.getFrame() = m_msg_buf.getFrame();
+    req->msg_buf.setUID( m_msg_buf.getUID() );
+    req->stream_accept = m_stream_accept;
+    req->db_ctx.on_complete = [this,req](){ asyncCallComplete( req ); };
+    req->db_ctx.deadline = a_deadline;
+
+    try
+    {
+        req->request = m_msg_buf.unserialize( &req->arena );
+    }
+    catch( ... )
+    {
+        delete req;
+        throw;
+    }
+
+    if ( !req->request )
+    {
+        DL_ERROR( "W"<<m_tid<<": message parse failed (malformed or unregistered msg type)." );
+        NackReply nack;
+        nack.set_err_code( ID_BAD_REQUEST );
+        nack.set_err_msg( "Message parse failed (malformed or unregistered msg type)" );
+        req->msg_buf.serialize( nack );
+        a_comm.send( req->msg_buf );
+        delete req;
+        return;
+    }
+
+    DL_TRACE( "Rcvd [" << req->request->DebugString() << "]");
+
+    m_async_count++;
+
+    runAsyncRequest( a_comm, req );
+}
+
+/**
+ * Runs (or re-runs) the handler of a parked request. If the handler issues a
+ * DB call without a stored result, the request remains parked until the call
+ * completes; otherwise the reply (or NACK) is sent and the request is freed.
+ */
+void
+ClientWorker::runAsyncRequest( MsgComm & a_comm, AsyncRequest * a_request )
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    bool done = runAsyncHandler( *a_request );
+
+    a_request->handler_usec += CoreMetrics::usecSince( start );
+
+    if ( !done )
+        return;
+
+    unique_ptr<AsyncRequest> req( a_request );
+
+    m_async_count--;
+
+    CoreMetrics::getInstance().recordMsg( req->msg_type, CoreMetrics::MP_HANDLER, req->handler_usec );
+    CoreMetrics::getInstance().recordMsg( req->msg_type, CoreMetrics::MP_DB, req->db_ctx.db_usec );
+
+    // Gather msg metrics except on task lists (web clients poll)
+    if ( req->msg_type != m_task_list_msg_type )
+        m_metrics->update( req->msg_buf.getUID(), req->msg_type );
+
+    sendReply( a_comm, req->msg_buf, req->stream_reply );
+}
+
+/**
+ * Runs the handler of an async request with its DB calls captured in the
+ * request's async context. Returns false if a DB call was deferred (handler
+ * must be re-run when it completes); otherwise the reply, or a NACK if the
+ * handler failed, is serialized into the request's msg_buf.
+ */
+bool
+ClientWorker::runAsyncHandler( AsyncRequest & a_request )
+{
+    m_db_client.setAsyncContext( &a_request.db_ctx );
+    a_request.db_ctx.rewind();
+
+    try
+    {
+        (this->*a_request.handler)( a_request );
+    }
+    catch( DatabaseAPI::DeferredCall & )
+    {
+        m_db_client.setAsyncContext( 0 );
+        return false;
+    }
+    catch( TraceException &e )
+    {
+        DL_ERROR( "W"<<m_tid<<" " << e.toString() );
+        NackReply nack;
+        nack.set_err_code( (ErrorCode) e.getErrorCode() );
+        nack.set_err_msg( e.toString( true ) );
+        a_request.msg_buf.serialize( nack );
+    }
+    catch( exception &e )
+    {
+        DL_ERROR( "W"<<m_tid<<" " << e.what() );
+        NackReply nack;
+        nack.set_err_code( ID_INTERNAL_ERROR );
+        nack.set_err_msg( e.what() );
+        a_request.msg_buf.serialize( nack );
+    }
+    catch(...)
+    {
+        DL_ERROR( "W"<<m_tid<<" unkown exception while processing message!" );
+        NackReply nack;
+        nack.set_err_code( ID_INTERNAL_ERROR );
+        nack.set_err_msg( "Unknown exception type" );
+        a_request.msg_buf.serialize( nack );
+    }
+
+    m_db_client.setAsyncContext( 0 );
+
+    return true;
+}
+
+/**
+ * Called from the DB transport thread when a DB call of a parked request
+ * completes. Queues the request and wakes the worker thread.
+ */
+void
+ClientWorker::asyncCallComplete( AsyncRequest * a_request )
+{
+    {
+        lock_guard<mutex> lock( m_async_mutex );
+        m_async_done.push_back( a_request );
+    }
+
+    char c = 0;
+    if ( write( m_async_pipe[1], &c, 1 ) < 0 && errno != EAGAIN )
+        DL_ERROR( "W" << m_tid << " async wake-up write failed: " << errno );
+}
+
+void
+ClientWorker::processAsyncCompletions( MsgComm & a_comm )
+{
+    char                    buf[64];
+    vector<AsyncRequest*>   done;
+
+    // Drain wake-up pipe
+    while ( read( m_async_pipe[0], buf, sizeof( buf )) > 0 )
+    {}
+
+    {
+        lock_guard<mutex> lock( m_async_mutex );
+        done.swap( m_async_done );
+    }
+
+    for ( vector<AsyncRequest*>::iterator r = done.begin(); r != done.end(); r++ )
+    {
+        try
+        {
+            runAsyncRequest( a_comm, *r );
+        }
+        catch( TraceException & e )
+        {
+            DL_ERROR( "W" << m_tid << " " << e.toString() );
+        }
+        catch( exception & e )
+        {
+            DL_ERROR( "W" << m_tid << " " << e.what() );
+        }
     }
 }
 
@@ -300,22 +757,25 @@ ClientWorker::workerThread()
 #define PROC_MSG_BEGIN( msgclass, replyclass ) \
 msgclass *request = 0; \
 bool send_reply = true; \
-::google::protobuf::Message *base_msg = m_msg_buf.unserialize(); \
+::google::protobuf::Message *base_msg = m_msg_buf.unserialize( m_arena ); \
 if ( base_msg ) \
 { \
     request = dynamic_cast<msgclass*>( base_msg ); \
     if ( request ) \
     { \
         DL_TRACE( "Rcvd [" << request->DebugString() << "]"); \
-        replyclass reply; \
+        replyclass & reply = *google::protobuf::Arena::CreateMessage<replyclass>( m_arena ); \
         try \
         {
 
 /// This macro defines the end of the common message handling code for all local handlers
 
 #define PROC_MSG_END \
-            if ( send_reply ) \
-                m_msg_buf.serialize( reply ); \
+            if ( send_reply ) { \
+                if ( streamReply( m_stream_accept, reply )) \
+                    m_stream_reply = &reply; \
+                else \
+                    m_msg_buf.serialize( reply ); } \
         } \
         catch( TraceException &e ) \
         { \
@@ -349,7 +809,6 @@ if ( base_msg ) \
     else { \
         DL_ERROR( "W"<<m_tid<<": dynamic cast of msg buffer failed!" );\
     } \
-    delete base_msg; \
 } \
 else { \
     DL_ERROR( "W"<<m_tid<<": message parse failed (malformed or unregistered msg type)." ); \
@@ -360,6 +819,32 @@ else { \
 } \
 return send_reply;
 
+/// Stores the message serialized in a_buf as a batch item
+static void
+setBatchItem( BatchItem & a_item, const MsgBuf & a_buf )
+{
+    a_item.set_msg_type( a_buf.getMsgType() );
+
+    if ( a_buf.getFrame().size )
+        a_item.set_data( a_buf.getBuffer(), a_buf.getFrame().size );
+    else
+        a_item.clear_data();
+}
+
+/// Stores a NackReply as a batch item
+static void
+setBatchNack( BatchItem & a_item, ErrorCode a_err_code, const std::string & a_err_msg )
+{
+    MsgBuf      buf;
+    NackReply   nack;
+
+    nack.set_err_code( a_err_code );
+    nack.set_err_msg( a_err_msg );
+    buf.serialize( nack );
+
+    setBatchItem( a_item, buf );
+}
+
 /// This method wraps all direct-to-DB message handler calls
 template<typename RQ, typename RP, void (DatabaseAPI::*func)( const RQ &, RP &)>
 bool
@@ -374,6 +859,29 @@ ClientWorker::dbPassThrough( const std::string & a_uid )
     PROC_MSG_END
 }
 
+/// This method wraps direct-to-DB message handler calls in async mode (see runAsyncRequest)
+template<typename RQ, typename RP, void (DatabaseAPI::*func)( const RQ &, RP &)>
+void
+ClientWorker::dbPassThroughAsync( AsyncRequest & a_request )
+{
+    RQ * request = dynamic_cast<RQ*>( a_request.request );
+    if ( !request )
+        EXCEPT( ID_INTERNAL_ERROR, "Dynamic cast of request message failed" );
+
+    RP & reply = *google::protobuf::Arena::CreateMessage<RP>( &a_request.arena );
+
+    m_db_client.setClient( a_request.msg_buf.getUID() );
+
+    (m_db_client.*func)( *request, reply );
+
+    if ( streamReply( a_request.stream_accept, reply ))
+        a_request.stream_reply = &reply;
+    else
+        a_request.msg_buf.serialize( reply );
+
+    DL_TRACE( "Sent: " << reply.DebugString());
+}
+
 bool
 ClientWorker::procVersionRequest( const std::string & a_uid )
 {
@@ -473,6 +981,7 @@ ClientWorker::procGenerateCredentialsRequest( const std::string & a_uid )
         priv_key = secret_key;
 
         m_db_client.userSetKeys( pub_key, priv_key );
+        m_core.clientKeysChanged( a_uid, pub_key );
     }
 
     reply.set_pub_key( pub_key );
@@ -497,6 +1006,7 @@ ClientWorker::procRevokeCredentialsRequest( const std::string & a_uid )
 
     m_db_client.setClient( a_uid );
     m_db_client.userClearKeys();
+    m_core.clientKeysChanged( a_uid, "" );
 
     PROC_MSG_END
 }
@@ -575,9 +1085,7 @@ ClientWorker::procSchemaCreateRequest( const std::string & a_uid )
 
         schemaEnforceRequiredProperties( schema );
 
-        nlohmann::json_schema::json_validator validator( bind( &ClientWorker::schemaLoader, this, placeholders::_1, placeholders::_2 ));
-
-        validator.set_root_schema( schema );
+        SchemaCache::getInstance().compile( schema, a_uid, m_schema_loader );
 
         m_db_client.schemaCreate( *request );
     }
@@ -608,9 +1116,7 @@ ClientWorker::procSchemaReviseRequest( const std::string & a_uid )
 
             schemaEnforceRequiredProperties( schema );
 
-            nlohmann::json_schema::json_validator validator( bind( &ClientWorker::schemaLoader, this, placeholders::_1, placeholders::_2 ));
-
-            validator.set_root_schema( schema );
+            SchemaCache::getInstance().compile( schema, a_uid, m_schema_loader );
         }
         catch( exception & e )
         {
@@ -641,9 +1147,7 @@ ClientWorker::procSchemaUpdateRequest( const std::string & a_uid )
 
             schemaEnforceRequiredProperties( schema );
 
-            nlohmann::json_schema::json_validator validator( bind( &ClientWorker::schemaLoader, this, placeholders::_1, placeholders::_2 ));
-
-            validator.set_root_schema( schema );
+            SchemaCache::getInstance().compile( schema, a_uid, m_schema_loader );
         }
         catch( exception & e )
         {
@@ -666,44 +1170,25 @@ ClientWorker::procMetadataValidateRequest( const std::string & a_uid )
 
     m_db_client.setClient( a_uid );
 
-    nlohmann::json schema;
+    SchemaCache::validator_t validator;
+
+    DL_INFO( "Schema " << request->sch_id() );
+
+    m_validator_err.clear();
 
     try
     {
-        libjson::Value sch;
-        DL_INFO( "Schema " << request->sch_id() );
-
-        m_db_client.schemaView( request->sch_id(), sch );
+        validator = SchemaCache::getInstance().getValidator( request->sch_id(), a_uid, m_schema_loader );
 
-        DL_INFO( "Schema: " << sch.asArray().begin()->asObject().getValue("def").toString() );
+        nlohmann::json md = nlohmann::json::parse( request->metadata() );
 
-        schema = nlohmann::json::parse( sch.asArray().begin()->asObject().getValue("def").toString() );
+        validator->validate( md, *this );
     }
     catch( TraceException & e )
     {
         throw;
     }
     catch( exception & e )
-    {
-        EXCEPT_PARAM(1,"Schema parse error: " << e.what() );
-    }
-
-    //DL_INFO( "Schema " << schema );
-
-    nlohmann::json_schema::json_validator validator( bind( &ClientWorker::schemaLoader, this, placeholders::_1, placeholders::_2 ));
-
-    try
-    {
-        //DL_INFO( "Setting root schema" );
-        validator.set_root_schema( schema );
-        //DL_INFO( "Validating" );
-
-        nlohmann::json md = nlohmann::json::parse( request->metadata() );
-
-        m_validator_err.clear();
-        validator.validate( md, *this );
-    }
-    catch( exception & e )
     {
         m_validator_err = string( "Invalid metadata schema: ") + e.what() + "\n";
         DL_ERROR( "Invalid metadata schema: " << e.what() );
@@ -744,26 +1229,16 @@ ClientWorker::procRecordCreateRequest( const std::string & a_uid )
         //DL_INFO("Has metadata/schema");
         //DL_INFO( "Must validate JSON, schema " << s->second.asString() );
 
-        nlohmann::json schema;
-
         try
         {
-            libjson::Value sch;
-            m_db_client.schemaView( request->sch_id(), sch );
-            schema = nlohmann::json::parse( sch.asArray().begin()->asObject().getValue("def").toString() );
-
-            nlohmann::json_schema::json_validator validator( bind( &ClientWorker::schemaLoader, this, placeholders::_1, placeholders::_2 ));
+            SchemaCache::validator_t validator = SchemaCache::getInstance().getValidator( request->sch_id(), a_uid, m_schema_loader );
 
             try
             {
-                //DL_INFO( "Setting root schema" );
-                validator.set_root_schema( schema );
-                //DL_INFO( "Validating" );
-
                 nlohmann::json md = nlohmann::json::parse( request->metadata() );
 
                 m_validator_err.clear();
-                validator.validate( md, *this );
+                validator->validate( md, *this );
             }
             catch( exception & e )
             {
@@ -869,22 +1344,11 @@ ClientWorker::procRecordUpdateRequest( const std::string & a_uid )
         {
             DL_INFO( "Must validate JSON, schema " << sch_id );
 
-            libjson::Value sch;
-            m_db_client.schemaView( sch_id, sch );
-
-            DL_INFO( "Schema record JSON:" << sch.toString() );
-            //DL_INFO( "Schema def STR:" << sch.asObject().getValue("def").toString() );
-
-            nlohmann::json schema = nlohmann::json::parse( sch.asArray().begin()->asObject().getValue("def").toString() );
-
-            DL_INFO( "Schema nlohmann: " << schema );
-
-            nlohmann::json_schema::json_validator validator( bind( &ClientWorker::schemaLoader, this, placeholders::_1, placeholders::_2 ));
+            SchemaCache::validator_t validator;
 
             try
             {
-                DL_INFO( "Setting root schema" );
-                validator.set_root_schema( schema );
+                validator = SchemaCache::getInstance().getValidator( sch_id, a_uid, m_schema_loader );
 
                 // TODO This is a hacky way to convert between JSON implementations...
                 DL_INFO( "Parse md" );
@@ -901,7 +1365,11 @@ ClientWorker::procRecordUpdateRequest( const std::string & a_uid )
 
                 DL_INFO( "Validating" );
 
-                validator.validate( md, *this );
+                validator->validate( md, *this );
+            }
+            catch( TraceException & e )
+            {
+                throw;
             }
             catch( exception & e )
             {
@@ -948,6 +1416,27 @@ ClientWorker::procRecordUpdateRequest( const std::string & a_uid )
 }
 
 
+bool
+ClientWorker::procRecordCreateBatchRequest( const std::string & a_uid )
+{
+    PROC_MSG_BEGIN( RecordCreateBatchRequest, RecordDataReply )
+
+    m_db_client.setClient( a_uid );
+
+    vector<string> errors;
+
+    if ( m_config.batch_validate )
+        validateRecordBatch( request->records(), a_uid, false, errors );
+
+    m_db_client.recordCreateBatch( *request, reply );
+
+    if ( setRecordBatchErrors( errors, reply ))
+        DL_ERROR( "Validation error - create batch records" );
+
+    PROC_MSG_END
+}
+
+
 bool
 ClientWorker::procRecordUpdateBatchRequest( const std::string & a_uid )
 {
@@ -956,15 +1445,263 @@ ClientWorker::procRecordUpdateBatchRequest( const std::string & a_uid )
     m_db_client.setClient( a_uid );
 
     libjson::Value result;
+    vector<string> errors;
+
+    if ( m_config.batch_validate )
+        validateRecordBatch( request->records(), a_uid, true, errors );
 
     m_db_client.recordUpdateBatch( *request, reply, result );
 
+    if ( setRecordBatchErrors( errors, reply ))
+        DL_ERROR( "Validation error - update batch records" );
+
     handleTaskResponse( result );
 
     PROC_MSG_END
 }
 
 
+/// Find the extents (offset, length) of the elements of a JSON array document; false if not an array
+static bool
+splitJSONArray( const std::string & a_doc, std::vector<std::pair<size_t,size_t>> & a_elems )
+{
+    size_t  i = a_doc.find_first_not_of( " \t\r\n" ), beg = 0;
+    size_t  depth = 0;
+    bool    in_str = false;
+    char    c;
+
+    if ( i == string::npos || a_doc[i] != '[' )
+        return false;
+
+    // beg == 0 means no element started (offset 0 is always the opening bracket or whitespace)
+    for ( i++; i < a_doc.size(); i++ )
+    {
+        c = a_doc[i];
+
+        if ( in_str )
+        {
+            if ( c == '\\' )
+                i++;
+            else if ( c == '"' )
+                in_str = false;
+            continue;
+        }
+
+        switch ( c )
+        {
+        case '"':
+            in_str = true;
+            if ( !depth && !beg )
+                beg = i;
+            break;
+        case '{':
+        case '[':
+            if ( !depth && !beg )
+                beg = i;
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if ( !depth )
+            {
+                if ( beg )
+                    a_elems.push_back( make_pair( beg, i - beg ));
+                return true;
+            }
+            depth--;
+            break;
+        case ',':
+            if ( !depth )
+            {
+                if ( !beg )
+                    return false;
+                a_elems.push_back( make_pair( beg, i - beg ));
+                beg = 0;
+            }
+            break;
+        default:
+            if ( !depth && !beg && !isspace( c ))
+                beg = i;
+            break;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief Validate metadata of batch records against their schemas
+ *
+ * Records are parsed and validated on the shared compute pool; validators are
+ * resolved on this thread since loading a schema requires the local DB client.
+ * On return, a_errors holds the validation errors of each record (empty if
+ * none) in request order. For updates, only records that set (not merge)
+ * metadata and specify a schema can be validated without loading the current
+ * record, so other records are not validated. Returns false, without errors,
+ * if the records document is malformed (rejected by the DB). Only used if
+ * config.batch_validate is set; otherwise batch records go to the DB as is.
+ */
+bool
+ClientWorker::validateRecordBatch( const std::string & a_records, const std::string & a_uid, bool a_update, std::vector<std::string> & a_errors )
+{
+    vector<pair<size_t,size_t>> extents;
+
+    a_errors.clear();
+
+    if ( !splitJSONArray( a_records, extents ))
+        return false;
+
+    size_t                              count = extents.size();
+    vector<nlohmann::json>              mds( count );
+    vector<string>                      sch_ids( count );
+    vector<SchemaCache::validator_t>    validators( count );
+    atomic<bool>                        malformed( false );
+    ComputePool &                       pool = ComputePool::getInstance();
+
+    a_errors.resize( count );
+
+    pool.parallelFor( count, [&]( size_t i )
+    {
+        try
+        {
+            nlohmann::json rec = nlohmann::json::parse( a_records.begin() + extents[i].first, a_records.begin() + extents[i].first + extents[i].second );
+
+            if ( !rec.is_object() )
+            {
+                malformed = true;
+                return;
+            }
+
+            nlohmann::json::iterator md = rec.find( "md" );
+            nlohmann::json::iterator sch = rec.find( "sch_id" );
+
+            if ( md == rec.end() || md->is_null() || ( md->is_string() && md->get_ref<const string&>().empty() ) ||
+                sch == rec.end() || !sch->is_string() || sch->get_ref<const string&>().empty() )
+                return;
+
+            if ( a_update )
+            {
+                nlohmann::json::iterator mdset = rec.find( "mdset" );
+
+                if ( mdset == rec.end() || !mdset->is_boolean() || !mdset->get<bool>() )
+                    return;
+            }
+
+            sch_ids[i] = sch->get<string>();
+            mds[i] = std::move( *md );
+        }
+        catch( exception & e )
+        {
+            malformed = true;
+        }
+    });
+
+    if ( malformed )
+    {
+        a_errors.clear();
+        return false;
+    }
+
+    map<string,pair<SchemaCache::validator_t,string>> schemas;
+    map<string,pair<SchemaCache::validator_t,string>>::iterator s;
+
+    for ( size_t i = 0; i < count; i++ )
+    {
+        if ( sch_ids[i].empty() )
+            continue;
+
+        if (( s = schemas.find( sch_ids[i] )) == schemas.end() )
+        {
+            s = schemas.insert( make_pair( sch_ids[i], make_pair( SchemaCache::validator_t(), string() ))).first;
+
+            try
+            {
+                s->second.first = SchemaCache::getInstance().getValidator( sch_ids[i], a_uid, m_schema_loader );
+            }
+            catch( exception & e )
+            {
+                s->second.second = string( "Metadata schema error: ") + e.what() + "\n";
+                DL_ERROR( "Could not load metadata schema: " << e.what() );
+            }
+        }
+
+        validators[i] = s->second.first;
+        a_errors[i] = s->second.second;
+    }
+
+    pool.parallelFor( count, [&]( size_t i )
+    {
+        if ( !validators[i] )
+            return;
+
+        try
+        {
+            SchemaErrorCollector collector( a_errors[i] );
+
+            validators[i]->validate( mds[i], collector );
+        }
+        catch( exception & e )
+        {
+            a_errors[i] = string( "Invalid metadata schema: ") + e.what() + "\n";
+        }
+
+        mds[i] = nlohmann::json();
+    });
+
+    return true;
+}
+
+
+/// Record metadata validation errors of batch records (a_errors in request order) in the DB and reply; false if none
+bool
+ClientWorker::setRecordBatchErrors( const std::vector<std::string> & a_errors, Auth::RecordDataReply & a_reply )
+{
+    if ( find_if( a_errors.begin(), a_errors.end(), []( const string & a_err ){ return a_err.size() > 0; }) == a_errors.end() )
+        return false;
+
+    // DB returns records in request order
+    if ( (size_t)a_reply.data_size() != a_errors.size() )
+    {
+        DL_ERROR( "Batch reply record count mismatch - validation errors not recorded" );
+        return false;
+    }
+
+    vector<pair<string,string>> db_errors;
+
+    for ( size_t i = 0; i < a_errors.size(); i++ )
+    {
+        if ( a_errors[i].size() )
+            db_errors.push_back( make_pair( a_reply.data( i ).id(), a_errors[i] ));
+    }
+
+    m_db_client.recordUpdateSchemaErrorBatch( db_errors );
+
+    for ( size_t i = 0; i < a_errors.size(); i++ )
+    {
+        if ( a_errors[i].empty() )
+            continue;
+
+        RecordData * data = a_reply.mutable_data( i );
+
+        data->set_notes( data->notes() | NOTE_MASK_MD_ERR );
+        data->set_md_err_msg( a_errors[i] );
+
+        for ( int j = 0; j < a_reply.update_size(); j++ )
+        {
+            ListingData * item = a_reply.mutable_update( j );
+            if ( item->id() == data->id() )
+            {
+                item->set_notes( item->notes() | NOTE_MASK_MD_ERR );
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+
 bool
 ClientWorker::procRecordDeleteRequest( const std::string & a_uid )
 {
@@ -1162,6 +1899,118 @@ ClientWorker::procUserGetAccessTokenRequest( const std::string & a_uid )
     PROC_MSG_END
 }
 
+/**
+ * Processes the items of a BatchRequest with the async (DB pass-through)
+ * handlers, so that the DB calls of up to config.batch_concurrency items (one
+ * if the batch is ordered) are in-flight at once. Items are started in
+ * request order and each gets its own reply or NACK. The worker thread waits
+ * for the whole batch; in async mode, completions of other parked requests
+ * are processed after the batch.
+ */
+bool
+ClientWorker::procBatchRequest( const std::string & a_uid )
+{
+    PROC_MSG_BEGIN( BatchRequest, BatchReply )
+
+    size_t count = request->item_size();
+
+    if ( count > m_config.batch_max_items )
+        EXCEPT_PARAM( ID_BAD_REQUEST, "Batch request exceeds max items (" << m_config.batch_max_items << ")" );
+
+    vector<unique_ptr<AsyncRequest>>    items( count );
+    mutex                               done_mutex;
+    condition_variable                  done_cvar;
+    vector<size_t>                      done, completed;
+    size_t                              limit = request->ordered() ? 1 : max( 1u, m_config.batch_concurrency );
+    size_t                              next = 0, in_flight = 0, i;
+    chrono::steady_clock::time_point    deadline = m_db_client.getDeadline();
+    map<uint16_t,async_fun_t>::iterator handler;
+    MsgBuf::Frame                       frame;
+
+    for ( i = 0; i < count; i++ )
+    {
+        const BatchItem & item = request->item( i );
+        BatchItem & item_reply = *reply.add_item();
+
+        if ( item.msg_type() > 0xFFFF || ( handler = m_msg_handlers_async.find( item.msg_type() )) == m_msg_handlers_async.end() )
+        {
+            setBatchNack( item_reply, ID_BAD_REQUEST, "Request type can not be batched" );
+            continue;
+        }
+
+        AsyncRequest * req = new AsyncRequest( item.msg_type(), handler->second );
+
+        items[i].reset( req );
+        req->msg_buf.setUID( a_uid );
+        req->db_ctx.deadline = deadline;
+        req->db_ctx.on_complete = [&done_mutex,&done_cvar,&done,i]()
+        {
+            lock_guard<mutex> lock( done_mutex );
+            done.push_back( i );
+            done_cvar.notify_one();
+        };
+
+        frame.size = item.data().size();
+        frame.proto_id = item.msg_type() >> 8;
+        frame.msg_id = item.msg_type() & 0xFF;
+
+        req->request = MsgBuf::unserialize( frame, item.data().data(), &req->arena );
+
+        if ( !req->request )
+        {
+            setBatchNack( item_reply, ID_BAD_REQUEST, "Message parse failed (malformed msg)" );
+            items[i].reset();
+        }
+    }
+
+    auto finish = [&]( size_t a_idx )
+    {
+        setBatchItem( *reply.mutable_item( a_idx ), items[a_idx]->msg_buf );
+        m_metrics->update( a_uid, items[a_idx]->msg_type );
+        items[a_idx].reset();
+    };
+
+    // Items must not be freed while DB calls are in-flight (all handler exceptions are caught)
+    while ( next < count || in_flight )
+    {
+        for ( ; in_flight < limit && next < count; next++ )
+        {
+            if ( !items[next] )
+                continue;
+
+            if ( runAsyncHandler( *items[next] ))
+                finish( next );
+            else
+                in_flight++;
+        }
+
+        if ( !in_flight )
+            continue;
+
+        {
+            unique_lock<mutex> lock( done_mutex );
+
+            while ( done.empty() )
+                done_cvar.wait( lock );
+
+            completed.swap( done );
+        }
+
+        for ( vector<size_t>::iterator c = completed.begin(); c != completed.end(); c++ )
+        {
+            if ( runAsyncHandler( *items[*c] ))
+            {
+                finish( *c );
+                in_flight--;
+            }
+        }
+
+        completed.clear();
+    }
+
+    PROC_MSG_END
+}
+
 void
 ClientWorker::handleTaskResponse( libjson::Value & a_result )
 {
@@ -1172,7 +2021,7 @@ ClientWorker::handleTaskResponse( libjson::Value & a_result )
         libjson::Value::Object & task_obj = obj.asObject();
 
         if ( task_obj.getNumber( "status" ) != TS_BLOCKED )
-            TaskMgr::getInstance().newTask( task_obj.getString( "_id" ));
+            TaskMgr::getInstance().newTask( task_obj.getString( "_id" ), (uint32_t)task_obj.getNumber( "type" ), task_obj.getString( "client" ));
     }
 }
 
@@ -1221,19 +2070,4 @@ ClientWorker::parseProjectQuery( const string & a_text_query, const vector<strin
 }
 */
 
-void
-ClientWorker::schemaLoader( const nlohmann::json_uri & a_uri, nlohmann::json & a_value )
-{
-    DL_INFO( "Load schema, scheme: " << a_uri.scheme() << ", path: " << a_uri.path() << ", auth: " << a_uri.authority() << ", id: " << a_uri.identifier() );
-
-    libjson::Value sch;
-    std::string id = a_uri.path();
-
-    id = id.substr( 1 ); // Skip leading "/"
-    m_db_client.schemaView( id, sch );
-
-    a_value = nlohmann::json::parse( sch.asArray().begin()->asObject().getValue("def").toString() );
-    DL_INFO( "Loaded schema: " << a_value );
-}
-
 }}
@@ -14,11 +14,15 @@
 #include "DatabaseAPI.hpp"
 #include "ICoreServer.hpp"
 #include "GlobusAPI.hpp"
+#include "SchemaCache.hpp"
 #include <DynaLog.hpp>
 
 namespace SDMS {
 namespace Core {
 
+/// Set in the traffic class route segment of partial (streamed) reply frames; router returns no credit for these
+#define TC_PARTIAL_REPLY 0x80
+
 /**
  * The ClientWorker class provides client message processing on a dedicated thread.
  *
@@ -30,8 +34,8 @@ namespace Core {
 class ClientWorker : public nlohmann::json_schema::basic_error_handler
 {
 public:
-    /// ClientWorker constructor
-    ClientWorker( ICoreServer & a_core, size_t a_tid );
+    /// ClientWorker constructor (a_address is the worker queue of the router shard)
+    ClientWorker( ICoreServer & a_core, size_t a_tid, const std::string & a_address );
 
     /// ClientWorker destructor
     ~ClientWorker();
@@ -43,10 +47,45 @@ public:
     void wait();
 
 private:
+    struct AsyncRequest;
+
+    typedef bool (ClientWorker::*msg_fun_t)( const std::string & a_uid );
+    typedef void (ClientWorker::*async_fun_t)( AsyncRequest & a_request );
+
+    /// Parked request state for asynchronous (client_async) message processing
+    struct AsyncRequest
+    {
+        AsyncRequest( uint16_t a_msg_type, async_fun_t a_handler ) :
+            msg_type( a_msg_type ), handler( a_handler ), request( 0 ), stream_accept( false ), stream_reply( 0 ), handler_usec( 0 )
+        {}
+
+        uint16_t                        msg_type;   ///< Message type of request
+        async_fun_t                     handler;    ///< Async message handler
+        ::google::protobuf::Arena       arena;      ///< Owns request and reply messages
+        ::google::protobuf::Message *   request;    ///< Unserialized request message (arena allocated)
+        MsgBuf                          msg_buf;    ///< Route, UID, and context of request; receives reply
+        bool                            stream_accept; ///< Client accepts a streamed reply
+        ::google::protobuf::Message *   stream_reply; ///< Reply to be streamed (arena allocated), instead of serialized in msg_buf
+        DatabaseAPI::AsyncContext       db_ctx;     ///< Captured DB calls of request
+        uint64_t                        handler_usec; ///< Total time spent in handler (all runs)
+    };
+
     void setupMsgHandlers();
     void workerThread();
+    void startAsyncRequest( MsgComm & a_comm, async_fun_t a_handler, std::chrono::steady_clock::time_point a_deadline );
+    bool runAsyncHandler( AsyncRequest & a_request );
+    void runAsyncRequest( MsgComm & a_comm, AsyncRequest * a_request );
+    void asyncCallComplete( AsyncRequest * a_request );
+    void processAsyncCompletions( MsgComm & a_comm );
+    void sendCredit( MsgComm & a_comm, uint32_t a_credit );
+    bool checkDeadline( std::chrono::steady_clock::time_point & a_deadline );
+    bool streamReply( bool a_accept, const ::google::protobuf::Message & a_reply );
+    void sendReply( MsgComm & a_comm, MsgBuf & a_buf, ::google::protobuf::Message * a_stream_reply );
+    void sendStream( MsgComm & a_comm, MsgBuf & a_buf, ::google::protobuf::Message & a_reply );
     template<typename RQ, typename RP, void (DatabaseAPI::*func)( const RQ &, RP &)>
     bool dbPassThrough( const std::string & a_uid );
+    template<typename RQ, typename RP, void (DatabaseAPI::*func)( const RQ &, RP &)>
+    void dbPassThroughAsync( AsyncRequest & a_request );
     bool procGetAuthStatusRequest( const std::string & a_uid );
     bool procVersionRequest( const std::string & a_uid );
     bool procAuthenticateByPasswordRequest( const std::string & a_uid );
@@ -58,6 +97,7 @@ private:
     bool procDataCopyRequest( const std::string & a_uid );
     bool procRecordCreateRequest( const std::string & a_uid );
     bool procRecordUpdateRequest( const std::string & a_uid );
+    bool procRecordCreateBatchRequest( const std::string & a_uid );
     bool procRecordUpdateBatchRequest( const std::string & a_uid );
     bool procRecordDeleteRequest( const std::string & a_uid );
     bool procRecordAllocChangeRequest( const std::string & a_uid );
@@ -73,6 +113,9 @@ private:
     bool procSchemaCreateRequest( const std::string & a_uid );
     bool procSchemaReviseRequest( const std::string & a_uid );
     bool procSchemaUpdateRequest( const std::string & a_uid );
+    bool procBatchRequest( const std::string & a_uid );
+    bool validateRecordBatch( const std::string & a_records, const std::string & a_uid, bool a_update, std::vector<std::string> & a_errors );
+    bool setRecordBatchErrors( const std::vector<std::string> & a_errors, Auth::RecordDataReply & a_reply );
     void schemaEnforceRequiredProperties( const nlohmann::json & a_schema );
     void recordCollectionDelete( const std::vector<std::string> & a_ids, Auth::TaskDataReply & a_reply );
     void handleTaskResponse( libjson::Value & a_result );
@@ -82,34 +125,37 @@ private:
         return find_if(str.begin(), str.end(), []( char c ){ return !isalnum(c); }) != str.end();
     }
 
-    typedef bool (ClientWorker::*msg_fun_t)( const std::string & a_uid );
-
-    void schemaLoader( const nlohmann::json_uri & a_uri, nlohmann::json & a_value );
-
     void error( const nlohmann::json_pointer<nlohmann::basic_json<>> & a_ptr, const nlohmann::json & a_inst, const std::string & a_err_msg ) override
     {
-        (void) a_ptr;
-        (void) a_inst;
-        const std::string & path = a_ptr.to_string();
-
-        if ( m_validator_err.size() == 0 )
-            m_validator_err = "Schema Validation Error(s):\n";
-
-        m_validator_err += "At " + (path.size()?path:"top-level") + ": " + a_err_msg + "\n";
+        SchemaErrorCollector( m_validator_err ).error( a_ptr, a_inst, a_err_msg );
     }
 
     Config &            m_config;           ///< Ref to configuration singleton
     ICoreServer &       m_core;             ///< Ref to parent CoreServer interface
     size_t              m_tid;              ///< Thread ID
+    std::string         m_address;          ///< Worker queue address
     std::thread *       m_worker_thread;    ///< Local thread handle
     bool                m_run;              ///< Thread run flag
     DatabaseAPI         m_db_client;        ///< Local DB client instance
     MsgBuf              m_msg_buf;          ///< Reusable message buffer
+    char *              m_arena_block;      ///< Initial block of m_arena (retained across resets)
+    google::protobuf::Arena * m_arena;      ///< Request/reply message arena, reset after each request
+    bool                m_stream_accept;    ///< Client of current request accepts a streamed reply
+    ::google::protobuf::Message * m_stream_reply; ///< Reply of current request to be streamed (in m_arena), if any
     GlobusAPI           m_globus_api;       ///< Local GlobusAPI instance
     std::string         m_validator_err;    ///< String buffer for metadata validation errors
+    SchemaCache::loader_t m_schema_loader;  ///< Loads schemas for the schema cache via local DB client
+    uint16_t            m_task_list_msg_type; ///< Message type of TaskListRequest (excluded from metrics)
+    size_t              m_async_count;      ///< Number of in-flight async requests
+    MsgMetrics *        m_metrics;          ///< Message request metrics of this worker (owned by server)
+    int                 m_async_pipe[2];    ///< Wake-up pipe for async DB call completions
+    std::mutex          m_async_mutex;      ///< Protects m_async_done
+    std::vector<AsyncRequest*> m_async_done; ///< Async requests with completed DB calls
 
     /// Map of message type to message handler functions
     static std::map<uint16_t,msg_fun_t> m_msg_handlers;
+    /// Map of message type to async message handler functions (DB pass-through only)
+    static std::map<uint16_t,async_fun_t> m_msg_handlers_async;
 };
 
 }}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include "DynaLog.hpp"
+#include "Config.hpp"
+#include "ComputePool.hpp"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+ComputePool::ComputePool() :
+    m_jobs_run(0)
+{
+    size_t count = Config::getInstance().compute_threads;
+
+    if ( !count )
+        count = max( 1u, thread::hardware_concurrency() );
+
+    DL_DEBUG( "Compute pool threads: " << count );
+
+    for ( size_t i = 0; i < count; i++ )
+        m_threads.push_back( new thread( &ComputePool::threadFunc, this ));
+}
+
+ComputePool::~ComputePool()
+{
+}
+
+ComputePool &
+ComputePool::getInstance()
+{
+    static ComputePool * pool = new ComputePool();
+
+    return *pool;
+}
+
+void
+ComputePool::parallelFor( size_t a_count, const std::function<void( size_t )> & a_func )
+{
+    if ( !a_count )
+        return;
+
+    m_jobs_run.fetch_add( 1, memory_order_relaxed );
+
+    // A few chunks per thread balances uneven per-index cost without much contention
+    size_t grain = max<size_t>( 1, a_count / (( m_threads.size() + 1 ) * 4 ));
+
+    if ( a_count <= grain )
+    {
+        for ( size_t i = 0; i < a_count; i++ )
+            a_func( i );
+        return;
+    }
+
+    shared_ptr<Job> job = make_shared<Job>( a_func, a_count, grain );
+
+    {
+        lock_guard<mutex> lock( m_mutex );
+        m_jobs.push_back( job );
+    }
+
+    m_cvar.notify_all();
+
+    work( *job );
+
+    unique_lock<mutex> lock( job->mutex );
+
+    while ( job->finished < job->chunks )
+        job->cvar.wait( lock );
+
+    if ( job->error )
+        rethrow_exception( job->error );
+}
+
+void
+ComputePool::threadFunc()
+{
+    shared_ptr<Job> job;
+
+    while ( 1 )
+    {
+        {
+            unique_lock<mutex> lock( m_mutex );
+
+            while ( 1 )
+            {
+                while ( m_jobs.size() && m_jobs.front()->next.load() >= m_jobs.front()->chunks )
+                    m_jobs.pop_front();
+
+                if ( m_jobs.size() )
+                    break;
+
+                m_cvar.wait( lock );
+            }
+
+            job = m_jobs.front();
+        }
+
+        work( *job );
+        job.reset();
+    }
+}
+
+/// Take and run chunks of a job until none are left
+void
+ComputePool::work( Job & a_job )
+{
+    size_t chunk, i, end;
+
+    while (( chunk = a_job.next.fetch_add( 1 )) < a_job.chunks )
+    {
+        i = chunk * a_job.grain;
+        end = min( a_job.count, i + a_job.grain );
+
+        try
+        {
+            for ( ; i < end; i++ )
+                a_job.func( i );
+        }
+        catch( ... )
+        {
+            lock_guard<mutex> lock( a_job.mutex );
+
+            if ( !a_job.error )
+                a_job.error = current_exception();
+        }
+
+        lock_guard<mutex> lock( a_job.mutex );
+
+        if ( ++a_job.finished == a_job.chunks )
+            a_job.cvar.notify_all();
+    }
+}
+
+}}
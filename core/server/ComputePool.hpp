@@ -0,0 +1,78 @@
+#ifndef COMPUTEPOOL_HPP
+#define COMPUTEPOOL_HPP
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <functional>
+#include <stdint.h>
+
+namespace SDMS {
+namespace Core {
+
+/**
+ * @brief Shared pool of threads for CPU-bound request processing
+ *
+ * Client workers use the pool to spread CPU-heavy work of a single request
+ * (e.g. parsing and schema validation of batch records) across cores. Work
+ * is submitted as a parallel-for over an index range that is split into
+ * chunks; pool threads and the calling thread take chunks until none are
+ * left, and the call returns when all chunks are done. Jobs of concurrent
+ * callers are served in submission order. The pool size is set by
+ * config.compute_threads (0 = number of CPU cores).
+ */
+class ComputePool
+{
+public:
+    static ComputePool & getInstance();
+
+    /**
+     * @brief Call a_func( i ) for every i in [0,a_count) on pool threads and the calling thread
+     *
+     * The order of calls is unspecified. Returns when all calls are done; the
+     * first exception thrown by a_func (if any) is then rethrown.
+     */
+    void            parallelFor( size_t a_count, const std::function<void( size_t )> & a_func );
+
+    inline size_t   size() const { return m_threads.size(); }
+    inline uint64_t jobs() const { return m_jobs_run.load( std::memory_order_relaxed ); }
+
+private:
+    struct Job
+    {
+        Job( const std::function<void( size_t )> & a_func, size_t a_count, size_t a_grain ) :
+            func( a_func ), count( a_count ), grain( a_grain ), chunks(( a_count + a_grain - 1 ) / a_grain ), next( 0 ), finished( 0 )
+        {}
+
+        const std::function<void( size_t )> &   func;
+        size_t                  count;
+        size_t                  grain;      ///< Indices per chunk
+        size_t                  chunks;
+        std::atomic<size_t>     next;       ///< Next chunk to take
+        size_t                  finished;   ///< Completed chunks (guarded by mutex)
+        std::exception_ptr      error;      ///< First exception thrown (guarded by mutex)
+        std::mutex              mutex;
+        std::condition_variable cvar;
+    };
+
+    ComputePool();
+    ~ComputePool();
+
+    void            threadFunc();
+    void            work( Job & a_job );
+
+    std::vector<std::thread*>           m_threads;
+    std::mutex                          m_mutex;
+    std::condition_variable             m_cvar;
+    std::deque<std::shared_ptr<Job>>    m_jobs;     ///< Jobs with chunks left to take
+    std::atomic<uint64_t>               m_jobs_run;
+};
+
+}}
+
+#endif
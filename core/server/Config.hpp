@@ -22,50 +22,113 @@ struct Config
     //glob_xfr_url("https://transfer.api.globusonline.org/v0.10/"),
 
     Config():
+        db_max_conn( 16 ),
+        db_timeout( 0 ),
+        db_h2c( false ),
         glob_oauth_url("https://auth.globus.org/v2/oauth2/"),
         glob_xfr_url("https://transfer.api.globus.org/v0.10/"),
         port(7512),
         timeout( 5 ),
+        io_threads( 1 ),
+        router_shards( 1 ),
+        sched_user_rate( 100 ),
+        sched_user_burst( 200 ),
+        sched_user_queue( 256 ),
+        sched_queue_max( 8192 ),
+        sched_web_weight( 4 ),
+        sched_bulk_weight( 1 ),
         num_client_worker_threads( 4 ),
+        client_async( false ),
+        client_async_max( 64 ),
+        batch_max_items( 1000 ),
+        batch_concurrency( 16 ),
+        batch_validate( false ),
+        compute_threads( 0 ),
+        stream_chunk_size( 1048576 ),
         num_task_worker_threads( 10 ),
         task_purge_age( 14*24*3600 ),
         task_purge_period( 6*3600 ),
         task_retry_time_fail( 3600 ),
         task_retry_time_init( 30 ), // Double every retry until max backoff
         task_retry_backoff_max( 4 ),
+        task_load_page_size( 500 ),
+        task_quick_workers( 2 ),
+        xfr_poll_min( 5 ),
+        xfr_poll_max( 60 ),
         repo_chunk_size( 100 ),
         repo_timeout( 60000 ),
+        repo_window( 4 ),
         note_purge_age( 7*24*3600 ),
         note_purge_period( 6*3600 ),
         metrics_period( 300 ),
         metrics_purge_period( 3600 ),
-        metrics_purge_age( 24*3600 )
+        metrics_purge_age( 24*3600 ),
+        perm_cache_ttl( 30 ),
+        perm_cache_max( 100000 ),
+        schema_cache_ttl( 600 ),
+        schema_cache_max( 1000 ),
+        search_plan_cache_max( 1000 ),
+        zap_cache_max( 10000 ),
+        zap_cache_ttl( 300 ),
+        zap_cache_neg_ttl( 10 )
     {}
 
     std::string     cred_dir;
     std::string     db_url;
     std::string     db_user;
     std::string     db_pass;
+    uint32_t        db_max_conn;
+    uint32_t        db_timeout;
+    bool            db_h2c;
     std::string     glob_oauth_url;
     std::string     glob_xfr_url;
     std::string     client_id;
     std::string     client_secret;
     uint32_t        port;
     uint32_t        timeout;
+    uint32_t        io_threads;
+    std::string     io_cpus;
+    uint32_t        router_shards;
+    uint32_t        sched_user_rate;
+    uint32_t        sched_user_burst;
+    uint32_t        sched_user_queue;
+    uint32_t        sched_queue_max;
+    uint32_t        sched_web_weight;
+    uint32_t        sched_bulk_weight;
     uint32_t        num_client_worker_threads;
+    bool            client_async;
+    uint32_t        client_async_max;
+    uint32_t        batch_max_items;
+    uint32_t        batch_concurrency;
+    bool            batch_validate;
+    uint32_t        compute_threads;
+    uint32_t        stream_chunk_size;
     uint32_t        num_task_worker_threads;
     uint32_t        task_purge_age;
     uint32_t        task_purge_period;
     uint32_t        task_retry_time_fail;
     uint32_t        task_retry_time_init;
     uint32_t        task_retry_backoff_max;
+    uint32_t        task_load_page_size;
+    uint32_t        task_quick_workers;
+    uint32_t        xfr_poll_min;
+    uint32_t        xfr_poll_max;
     uint32_t        repo_chunk_size;
     uint32_t        repo_timeout;
+    uint32_t        repo_window;
     uint32_t        note_purge_age;
     uint32_t        note_purge_period;
     uint32_t        metrics_period;
     uint32_t        metrics_purge_period;
     uint32_t        metrics_purge_age;
+    uint32_t        perm_cache_ttl;
+    uint32_t        perm_cache_max;
+    uint32_t        schema_cache_ttl;
+    uint32_t        schema_cache_max;
+    uint32_t        search_plan_cache_max;
+    uint32_t        zap_cache_max;
+    uint32_t        zap_cache_ttl;
+    uint32_t        zap_cache_neg_ttl;
 
     MsgComm::SecurityContext            sec_ctx;
     std::map<std::string,RepoData*>     repos;
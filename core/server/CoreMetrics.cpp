@@ -0,0 +1,175 @@
+#include <unordered_map>
+#include <sstream>
+#include "MsgBuf.hpp"
+#include "CoreMetrics.hpp"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+static const char * g_phase_names[CoreMetrics::MP_COUNT] = { "queue", "handler", "db" };
+
+CoreMetrics &
+CoreMetrics::getInstance()
+{
+    static CoreMetrics metrics;
+
+    return metrics;
+}
+
+CoreMetrics::CoreMetrics() :
+    m_expired( 0 )
+{
+    for ( size_t t = 0; t < MSG_METRICS_TYPES; t++ )
+    {
+        for ( size_t p = 0; p < MP_COUNT; p++ )
+            m_msg_hist[t][p].store( 0, memory_order_relaxed );
+    }
+}
+
+void
+CoreMetrics::recordMsg( uint16_t a_msg_type, MsgPhase a_phase, uint64_t a_usec )
+{
+    if ( a_msg_type >= MSG_METRICS_TYPES )
+        return;
+
+    atomic<LatencyHistogram*> & slot = m_msg_hist[a_msg_type][a_phase];
+    LatencyHistogram * hist = slot.load( memory_order_acquire );
+
+    if ( !hist )
+    {
+        LatencyHistogram * expected = 0;
+
+        hist = new LatencyHistogram();
+
+        // Another thread may have created the histogram first
+        if ( !slot.compare_exchange_strong( expected, hist, memory_order_acq_rel ))
+        {
+            delete hist;
+            hist = expected;
+        }
+    }
+
+    hist->record( a_usec );
+}
+
+/**
+ * Each thread keeps its own route to histogram lookup table so that the
+ * shared table (and its mutex) is only used on the first call to a route.
+ */
+void
+CoreMetrics::recordRoute( const char * a_route, uint64_t a_usec )
+{
+    static thread_local unordered_map<string,LatencyHistogram*> local_hist;
+
+    string route( a_route );
+    unordered_map<string,LatencyHistogram*>::iterator h = local_hist.find( route );
+
+    if ( h == local_hist.end() )
+    {
+        lock_guard<mutex> lock( m_route_mutex );
+
+        LatencyHistogram *& hist = m_route_hist[route];
+
+        if ( !hist )
+            hist = new LatencyHistogram();
+
+        h = local_hist.insert( make_pair( route, hist )).first;
+    }
+
+    h->second->record( a_usec );
+}
+
+void
+CoreMetrics::getLatencies( Anon::MetricsReply & a_reply )
+{
+    LatencyHistogram *  hist;
+    string              name;
+
+    for ( uint16_t t = 0; t < MSG_METRICS_TYPES; t++ )
+    {
+        name.clear();
+
+        for ( size_t p = 0; p < MP_COUNT; p++ )
+        {
+            if (( hist = m_msg_hist[t][p].load( memory_order_acquire )) == 0 )
+                continue;
+
+            if ( name.empty() )
+            {
+                name = MsgBuf::findMessageName( t );
+                if ( name.empty() )
+                    name = to_string( t );
+            }
+
+            addLatency( a_reply, "msg." + name + "." + g_phase_names[p], *hist );
+        }
+    }
+
+    lock_guard<mutex> lock( m_route_mutex );
+
+    for ( map<string,LatencyHistogram*>::iterator r = m_route_hist.begin(); r != m_route_hist.end(); r++ )
+        addLatency( a_reply, "db." + r->first, *r->second );
+}
+
+void
+CoreMetrics::addLatency( Anon::MetricsReply & a_reply, const std::string & a_name, const LatencyHistogram & a_hist )
+{
+    LatencyHistogram::Summary summary;
+
+    a_hist.summarize( summary );
+
+    if ( !summary.count )
+        return;
+
+    LatencyData * lat = a_reply.add_latency();
+
+    lat->set_name( a_name );
+    lat->set_count( summary.count );
+    lat->set_sum( summary.sum );
+    lat->set_max( summary.max );
+    lat->set_p50( summary.p50 );
+    lat->set_p90( summary.p90 );
+    lat->set_p99( summary.p99 );
+    lat->set_p999( summary.p999 );
+}
+
+/**
+ * @brief Format metrics reply as text (Prometheus exposition format)
+ */
+void
+CoreMetrics::formatText( const Anon::MetricsReply & a_reply, std::string & a_text )
+{
+    ostringstream   out;
+    int             i;
+
+    out << "# TYPE datafed_core_latency_us summary\n";
+
+    for ( i = 0; i < a_reply.latency_size(); i++ )
+    {
+        const LatencyData & lat = a_reply.latency( i );
+        const string & n = lat.name();
+
+        out << "datafed_core_latency_us{name=\"" << n << "\",quantile=\"0.5\"} " << lat.p50() << "\n";
+        out << "datafed_core_latency_us{name=\"" << n << "\",quantile=\"0.9\"} " << lat.p90() << "\n";
+        out << "datafed_core_latency_us{name=\"" << n << "\",quantile=\"0.99\"} " << lat.p99() << "\n";
+        out << "datafed_core_latency_us{name=\"" << n << "\",quantile=\"0.999\"} " << lat.p999() << "\n";
+        out << "datafed_core_latency_us_sum{name=\"" << n << "\"} " << lat.sum() << "\n";
+        out << "datafed_core_latency_us_count{name=\"" << n << "\"} " << lat.count() << "\n";
+    }
+
+    out << "# TYPE datafed_core_latency_max_us gauge\n";
+
+    for ( i = 0; i < a_reply.latency_size(); i++ )
+        out << "datafed_core_latency_max_us{name=\"" << a_reply.latency( i ).name() << "\"} " << a_reply.latency( i ).max() << "\n";
+
+    out << "# TYPE datafed_core_gauge gauge\n";
+
+    for ( i = 0; i < a_reply.gauge_size(); i++ )
+        out << "datafed_core_gauge{name=\"" << a_reply.gauge( i ).name() << "\"} " << a_reply.gauge( i ).value() << "\n";
+
+    a_text = out.str();
+}
+
+}}
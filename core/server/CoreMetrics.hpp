@@ -0,0 +1,83 @@
+#ifndef COREMETRICS_HPP
+#define COREMETRICS_HPP
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "LatencyHistogram.hpp"
+#include "MsgMetrics.hpp"
+#include "SDMS_Anon.pb.h"
+
+namespace SDMS {
+namespace Core {
+
+/**
+ * @brief Registry of core server latency histograms
+ *
+ * Holds per-message-type latency histograms, split into queue wait (I/O
+ * thread receipt to worker pick-up), handler time, and DB time, and per-route
+ * DB (Foxx service) request latencies. Histograms are created on first use
+ * and live for the life of the process; recording is lock-free except for the
+ * first use of a DB route by a thread. Gauges are gathered by the server when
+ * metrics are requested (see Server::procMetricsRequest).
+ */
+class CoreMetrics
+{
+public:
+    enum MsgPhase
+    {
+        MP_QUEUE = 0,
+        MP_HANDLER,
+        MP_DB,
+        MP_COUNT
+    };
+
+    static CoreMetrics & getInstance();
+
+    /// Microseconds elapsed since a_start
+    static inline uint64_t usecSince( std::chrono::steady_clock::time_point a_start )
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - a_start ).count();
+    }
+
+    /// Current time as a message receive timestamp (steady clock nanoseconds)
+    static inline uint64_t stamp()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    /// Microseconds elapsed since a receive timestamp
+    static inline uint64_t usecSinceStamp( uint64_t a_stamp )
+    {
+        uint64_t now = stamp();
+
+        return now > a_stamp ? ( now - a_stamp ) / 1000 : 0;
+    }
+
+    void            recordMsg( uint16_t a_msg_type, MsgPhase a_phase, uint64_t a_usec );
+    void            recordRoute( const char * a_route, uint64_t a_usec );
+    void            getLatencies( Anon::MetricsReply & a_reply );
+
+    /// Count a request discarded because its client deadline passed
+    inline void     recordExpired() { m_expired.fetch_add( 1, std::memory_order_relaxed ); }
+    inline uint64_t expired() const { return m_expired.load( std::memory_order_relaxed ); }
+
+    static void     formatText( const Anon::MetricsReply & a_reply, std::string & a_text );
+
+private:
+    CoreMetrics();
+
+    void            addLatency( Anon::MetricsReply & a_reply, const std::string & a_name, const LatencyHistogram & a_hist );
+
+    std::atomic<LatencyHistogram*>              m_msg_hist[MSG_METRICS_TYPES][MP_COUNT];
+    std::map<std::string,LatencyHistogram*>     m_route_hist;
+    std::mutex                                  m_route_mutex;
+    std::atomic<uint64_t>                       m_expired;
+};
+
+}}
+
+#endif
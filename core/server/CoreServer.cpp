@@ -1,5 +1,7 @@
 #include <fstream>
 #include <chrono>
+#include <algorithm>
+#include <functional>
 #include <time.h>
 #include <curl/curl.h>
 #include "DynaLog.hpp"
@@ -9,6 +11,13 @@
 #include "ClientWorker.hpp"
 #include "MsgComm.hpp"
 #include "DatabaseAPI.hpp"
+#include "PermCache.hpp"
+#include "SchemaCache.hpp"
+#include "SearchPlanCache.hpp"
+#include "ComputePool.hpp"
+#include "RepoConnMgr.hpp"
+#include "CoreMetrics.hpp"
+#include "SDMS_Anon.pb.h"
 
 
 #define timerDef() struct timespec _T0 = {0,0}, _T1 = {0,0}
@@ -18,6 +27,11 @@
 
 #define MAINT_POLL_INTERVAL 5
 #define CLIENT_IDLE_TIMEOUT 3600
+#define TRANS_CLIENT_TTL 30
+#define TRANS_CLIENT_WHEEL_SLOTS 64
+#define ZAP_POLL_IDLE 1000
+#define ZAP_POLL_PENDING 5
+#define ROUTER_PURGE_INTERVAL 10
 
 using namespace std;
 
@@ -30,12 +44,18 @@ Server::Server() :
     m_io_secure_thread(0),
     m_io_insecure_thread(0),
     m_zap_thread(0),
-    m_msg_router_thread(0),
+    m_trans_expiry( chrono::seconds( 1 ), TRANS_CLIENT_WHEEL_SLOTS ),
+    m_key_cache( m_config.zap_cache_max, m_config.zap_cache_ttl, m_config.zap_cache_neg_ttl ),
+    m_router_shards(1),
+    m_msg_forwarded(0),
     m_db_maint_thread(0)
 {
     // One-time global libcurl init
     curl_global_init( CURL_GLOBAL_DEFAULT );
 
+    // Must be configured before any sockets are created
+    configureIO();
+
     // Load ZMQ keys
     loadKeys( m_config.cred_dir );
 
@@ -177,54 +197,337 @@ Server::run()
 {
     DL_INFO( "Public/private MAPI starting on ports " << m_config.port << "/" << ( m_config.port + 1))
 
-    m_msg_router_thread = new thread( &Server::msgRouter, this );
+    // Each shard must have at least one worker
+    m_router_shards = max( 1u, min( m_config.router_shards, m_config.num_client_worker_threads ));
+
+    DL_INFO( "Message router shards: " << m_router_shards );
+
+    for ( uint32_t s = 0; s < m_router_shards; s++ )
+        m_schedulers.push_back( new Scheduler_t( m_config.sched_user_rate, m_config.sched_user_burst, m_config.sched_user_queue,
+            m_config.sched_queue_max, m_config.sched_web_weight, m_config.sched_bulk_weight ));
+
+    for ( uint32_t s = 0; s < m_router_shards; s++ )
+        m_msg_router_threads.push_back( new thread( &Server::msgRouter, this, s ));
+
     m_io_secure_thread = new thread( &Server::ioSecure, this );
     ioInsecure();
 
-    m_msg_router_thread->join();
-    delete m_msg_router_thread;
-    m_msg_router_thread = 0;
-}
+    for ( vector<thread*>::iterator t = m_msg_router_threads.begin(); t != m_msg_router_threads.end(); t++ )
+    {
+        (*t)->join();
+        delete *t;
+    }
 
+    m_msg_router_threads.clear();
+}
 
+/**
+ * @brief Apply ZeroMQ I/O thread count and CPU affinity to the shared context
+ *
+ * All CURVE encryption and TCP I/O is performed by the ZeroMQ I/O threads of
+ * the shared context, so these settings must be applied before any sockets
+ * are created. CPU affinity is a comma-separated list of CPU numbers.
+ */
 void
-Server::msgRouter()
+Server::configureIO()
 {
     void * ctx = MsgComm::getContext();
 
-    void *frontend = zmq_socket( ctx, ZMQ_ROUTER );
-    int linger = 100;
-    zmq_setsockopt( frontend, ZMQ_LINGER, &linger, sizeof( int ));
-    zmq_bind( frontend, "inproc://msg_proc" );
+    if ( m_config.io_threads < 1 )
+        EXCEPT( ID_SERVICE_ERROR, "Number of I/O threads must be at least 1" );
+
+    if ( zmq_ctx_set( ctx, ZMQ_IO_THREADS, m_config.io_threads ) != 0 )
+        EXCEPT_PARAM( ID_SERVICE_ERROR, "Failed to set ZeroMQ I/O threads: " << zmq_strerror( errno ));
+
+    if ( m_config.io_cpus.size() )
+    {
+#ifdef ZMQ_THREAD_AFFINITY_CPU_ADD
+        size_t  pos = 0, end;
+        string  cpu;
+
+        while ( pos <= m_config.io_cpus.size() )
+        {
+            end = m_config.io_cpus.find( ',', pos );
+            if ( end == string::npos )
+                end = m_config.io_cpus.size();
 
-    void *backend = zmq_socket( ctx, ZMQ_DEALER );
-    zmq_setsockopt( backend, ZMQ_LINGER, &linger, sizeof( int ));
+            cpu = m_config.io_cpus.substr( pos, end - pos );
+            pos = end + 1;
 
-    zmq_bind( backend, "inproc://workers" );
+            if ( cpu.empty() )
+                continue;
 
-    void *control = zmq_socket( ctx, ZMQ_SUB );
-    zmq_setsockopt( control, ZMQ_LINGER, &linger, sizeof( int ));
-    zmq_connect( control, "inproc://control" );
-    zmq_setsockopt( control, ZMQ_SUBSCRIBE, "", 0 );
+            if ( cpu.find_first_not_of( "0123456789" ) != string::npos )
+                EXCEPT_PARAM( ID_SERVICE_ERROR, "Invalid I/O thread CPU number: " << cpu );
+
+            if ( zmq_ctx_set( ctx, ZMQ_THREAD_AFFINITY_CPU_ADD, stoi( cpu )) != 0 )
+                EXCEPT_PARAM( ID_SERVICE_ERROR, "Failed to set ZeroMQ I/O thread CPU affinity (" << cpu << "): " << zmq_strerror( errno ));
+        }
+#else
+        DL_WARN( "I/O thread CPU affinity not supported by this ZeroMQ version - ignored" );
+#endif
+    }
+
+    DL_INFO( "ZeroMQ I/O threads: " << m_config.io_threads << ( m_config.io_cpus.size() ? ", CPUs: " + m_config.io_cpus : "" ));
+}
+
+/**
+ * @brief Schedule requests from I/O threads to the client workers of one shard
+ *
+ * Requests from the secure interface (CLI, Python API, repositories) are
+ * bulk class, and requests from the local interface (web server) are
+ * interactive class. Requests are admitted and ordered by the shard's
+ * RequestScheduler, and rejected requests are answered here with a NackReply
+ * carrying a retry-after delay.
+ *
+ * Workers are assigned to shards round-robin by worker ID. Each worker grants
+ * credits (the number of requests it will accept concurrently) when started;
+ * a credit is returned with each reply, or explicitly if a request produces no
+ * reply. Requests are only sent to workers with credit so that queuing (and
+ * thus ordering) happens here rather than in worker socket buffers. A traffic
+ * class route segment is prepended to each request so that the reply can be
+ * returned to the originating I/O thread. The partial frames of a streamed
+ * reply are marked in this segment, and only the final frame returns credit.
+ */
+void
+Server::msgRouter( uint32_t a_shard )
+{
+    string              shard_id = to_string( a_shard );
+    Scheduler_t &       sched = *m_schedulers[a_shard];
+    MsgComm             bulk( "inproc://msg_proc_" + shard_id, MsgComm::ROUTER, true );
+    MsgComm             interactive( "inproc://msg_web_" + shard_id, MsgComm::ROUTER, true );
+    MsgComm             backend( "inproc://workers_" + shard_id, MsgComm::ROUTER, true );
+    MsgComm *           frontend[Scheduler_t::TC_COUNT] = { &interactive, &bulk };
+    void *              back_sock = backend.getSocket();
+    zmq_pollitem_t      items[3];
+    vector<pair<string,uint32_t>> credits;  // Worker ID, credits
+    vector<pair<string,uint32_t>>::iterator w, best;
+    vector<MsgBuf*>     pool;
+    MsgBuf *            buf;
+    Scheduler_t::TrafficClass tc;
+    uint8_t             tc_seg;
+    zmq_msg_t           msg;
+    int                 more;
+    size_t              more_len;
+    string              worker_id;
+    uint32_t            credit, retry_after, n;
+    int                 events;
+    size_t              events_len;
+    chrono::steady_clock::time_point now, purge_time = chrono::steady_clock::now();
+    Anon::NackReply     nack;
+
+    nack.set_err_code( ID_SERVICE_ERROR );
+    nack.set_err_msg( "Server busy, retry later" );
+
+    interactive.getPollInfo( items[Scheduler_t::TC_INTERACTIVE] );
+    bulk.getPollInfo( items[Scheduler_t::TC_BULK] );
+    backend.getPollInfo( items[2] );
 
     // Ceate worker threads
-    for ( uint16_t t = 0; t < m_config.num_client_worker_threads; ++t )
-        m_workers.push_back( new ClientWorker( *this, t+1 ));
+    vector<ClientWorker*> workers;
+
+    for ( uint32_t t = a_shard; t < m_config.num_client_worker_threads; t += m_router_shards )
+        workers.push_back( new ClientWorker( *this, t+1, "inproc://workers_" + shard_id ));
+
+    while ( 1 )
+    {
+        try
+        {
+            if ( zmq_poll( items, 3, 1000 ) < 0 )
+                continue;
+
+            now = chrono::steady_clock::now();
+
+            if ( items[2].revents & ZMQ_POLLIN )
+            {
+                // Process pending replies and credits (bounded) before admitting requests
+                for ( n = 0; n < 100; n++ )
+                {
+                    if ( n )
+                    {
+                        events_len = sizeof( events );
+                        if ( zmq_getsockopt( back_sock, ZMQ_EVENTS, &events, &events_len ) != 0 || !( events & ZMQ_POLLIN ))
+                            break;
+                    }
+
+                    // Worker ID frame, then either a credit frame or a reply
+                    zmq_msg_init( &msg );
+                    if ( zmq_msg_recv( &msg, back_sock, ZMQ_DONTWAIT ) < 0 )
+                    {
+                        zmq_msg_close( &msg );
+                        EXCEPT_PARAM( ID_SERVICE_ERROR, "Router recv from worker failed: " << zmq_strerror( errno ));
+                    }
+                    worker_id.assign( (char*)zmq_msg_data( &msg ), zmq_msg_size( &msg ));
+                    zmq_msg_close( &msg );
+
+                    zmq_msg_init( &msg );
+                    zmq_msg_recv( &msg, back_sock, ZMQ_DONTWAIT );
+                    more = zmq_msg_more( &msg );
+
+                    if ( more )
+                    {
+                        // Reply - first route segment is traffic class, flagged on partial (streamed) reply frames
+                        tc_seg = zmq_msg_size( &msg ) == 1 ? *(uint8_t*)zmq_msg_data( &msg ) : 0;
+                        tc = ( tc_seg & ~TC_PARTIAL_REPLY ) == Scheduler_t::TC_BULK ? Scheduler_t::TC_BULK : Scheduler_t::TC_INTERACTIVE;
+                        zmq_msg_close( &msg );
+                        credit = ( tc_seg & TC_PARTIAL_REPLY ) ? 0 : 1;
+
+                        while ( more )
+                        {
+                            zmq_msg_init( &msg );
+                            zmq_msg_recv( &msg, back_sock, ZMQ_DONTWAIT );
+                            more = zmq_msg_more( &msg );
+                            zmq_msg_send( &msg, frontend[tc]->getSocket(), more ? ZMQ_SNDMORE : 0 );
+                        }
+                    }
+                    else
+                    {
+                        credit = zmq_msg_size( &msg ) == sizeof( credit ) ? *(uint32_t*)zmq_msg_data( &msg ) : 0;
+                        zmq_msg_close( &msg );
+                    }
+
+                    for ( w = credits.begin(); w != credits.end(); w++ )
+                    {
+                        if ( w->first == worker_id )
+                            break;
+                    }
+
+                    if ( w == credits.end() )
+                        credits.push_back( make_pair( worker_id, credit ));
+                    else
+                        w->second += credit;
+                }
+            }
+
+            for ( n = 0; n < Scheduler_t::TC_COUNT; n++ )
+            {
+                if ( !( items[n].revents & ZMQ_POLLIN ))
+                    continue;
+
+                // Admit all pending requests (bounded) before dispatching
+                for ( uint32_t count = 0; count < 100; count++ )
+                {
+                    if ( count )
+                    {
+                        events_len = sizeof( events );
+                        if ( zmq_getsockopt( frontend[n]->getSocket(), ZMQ_EVENTS, &events, &events_len ) != 0 || !( events & ZMQ_POLLIN ))
+                            break;
+                    }
+
+                    if ( pool.size() )
+                    {
+                        buf = pool.back();
+                        pool.pop_back();
+                    }
+                    else
+                        buf = new MsgBuf();
+
+                    try
+                    {
+                        if ( !frontend[n]->recv( *buf, true, 1 ))
+                        {
+                            pool.push_back( buf );
+                            break;
+                        }
+                    }
+                    catch( ... )
+                    {
+                        pool.push_back( buf );
+
+                        // Discard remaining parts of malformed message
+                        more_len = sizeof( more );
+                        while ( zmq_getsockopt( frontend[n]->getSocket(), ZMQ_RCVMORE, &more, &more_len ) == 0 && more )
+                        {
+                            zmq_msg_init( &msg );
+                            zmq_msg_recv( &msg, frontend[n]->getSocket(), ZMQ_DONTWAIT );
+                            zmq_msg_close( &msg );
+                        }
+
+                        throw;
+                    }
+
+                    // Repositories are trusted system clients and are not rate limited
+                    retry_after = sched.push( buf->getUID(), (Scheduler_t::TrafficClass)n, buf, now, buf->getUID().compare( 0, 5, "repo/" ) != 0 );
+
+                    if ( retry_after )
+                    {
+                        DL_DEBUG( "Router " << a_shard << " rejected msg " << buf->getMsgType() << " from " << buf->getUID() << ", retry after " << retry_after );
+
+                        nack.set_retry_after( retry_after );
+                        buf->setTimeout( 0 );
+                        buf->setFlags( 0 );
+                        buf->serialize( nack );
+                        frontend[n]->send( *buf );
+                        pool.push_back( buf );
+                    }
+                }
+            }
+
+            // Dispatch to workers with most credit
+            while ( !sched.empty() )
+            {
+                best = credits.end();
+                for ( w = credits.begin(); w != credits.end(); w++ )
+                {
+                    if ( w->second && ( best == credits.end() || w->second > best->second ))
+                        best = w;
+                }
 
-    // Connect backend to frontend via a proxy
-    zmq_proxy_steerable( frontend, backend, 0, control );
+                if ( best == credits.end() )
+                    break;
 
-    zmq_close( backend );
-    zmq_close( control );
+                buf = sched.pop( now, tc );
+
+                // Discard requests whose client has already given up
+                if ( buf->getTimeout() && buf->getStamp() && CoreMetrics::usecSinceStamp( buf->getStamp() ) >= buf->getTimeout() * 1000ULL )
+                {
+                    DL_DEBUG( "Router " << a_shard << " msg " << buf->getMsgType() << " [" << buf->getUID() << "] expired, discarded" );
+                    CoreMetrics::getInstance().recordExpired();
+                    pool.push_back( buf );
+                    continue;
+                }
+
+                best->second--;
+
+                zmq_send( back_sock, best->first.data(), best->first.size(), ZMQ_SNDMORE );
+                tc_seg = (uint8_t)tc;
+                zmq_send( back_sock, &tc_seg, 1, ZMQ_SNDMORE );
+                backend.send( *buf, true );
+
+                pool.push_back( buf );
+            }
+
+            if ( now - purge_time > chrono::seconds( ROUTER_PURGE_INTERVAL ))
+            {
+                sched.purge( now );
+                purge_time = now;
+            }
+        }
+        catch( TraceException & e )
+        {
+            DL_ERROR( "Router " << a_shard << ": " << e.toString() );
+        }
+        catch( exception & e )
+        {
+            DL_ERROR( "Router " << a_shard << ": " << e.what() );
+        }
+        catch( ... )
+        {
+            DL_ERROR( "Router " << a_shard << ": unknown exception" );
+        }
+    }
 
     // Clean-up workers
     vector<ClientWorker*>::iterator iwrk;
 
-    for ( iwrk = m_workers.begin(); iwrk != m_workers.end(); ++iwrk )
+    for ( iwrk = workers.begin(); iwrk != workers.end(); ++iwrk )
         (*iwrk)->stop();
 
-    for ( iwrk = m_workers.begin(); iwrk != m_workers.end(); ++iwrk )
+    for ( iwrk = workers.begin(); iwrk != workers.end(); ++iwrk )
         delete *iwrk;
+
+    for ( vector<MsgBuf*>::iterator b = pool.begin(); b != pool.end(); b++ )
+        delete *b;
 }
 
 void
@@ -233,10 +536,16 @@ Server::ioSecure()
     try
     {
         MsgComm frontend( "tcp://*:" + to_string(m_config.port), MsgComm::ROUTER, true, &m_config.sec_ctx );
-        MsgComm backend( "inproc://msg_proc", MsgComm::DEALER, false );
+        vector<MsgComm*> backends;
+
+        for ( uint32_t s = 0; s < m_router_shards; s++ )
+            backends.push_back( new MsgComm( "inproc://msg_proc_" + to_string( s ), MsgComm::DEALER, false ));
 
         // Must use custom proxy to inject ZAP User-Id into message frame
-        frontend.proxy( backend );
+        ioProxy( frontend, backends, true );
+
+        for ( vector<MsgComm*>::iterator b = backends.begin(); b != backends.end(); b++ )
+            delete *b;
     }
     catch( exception & e)
     {
@@ -250,9 +559,15 @@ Server::ioInsecure()
     try
     {
         MsgComm frontend( "tcp://*:" + to_string(m_config.port + 1), MsgComm::ROUTER, true );
-        MsgComm backend( "inproc://msg_proc", MsgComm::DEALER, false );
+        vector<MsgComm*> backends;
 
-        zmq_proxy( frontend.getSocket(), backend.getSocket(), 0 );
+        for ( uint32_t s = 0; s < m_router_shards; s++ )
+            backends.push_back( new MsgComm( "inproc://msg_web_" + to_string( s ), MsgComm::DEALER, false ));
+
+        ioProxy( frontend, backends, false );
+
+        for ( vector<MsgComm*>::iterator b = backends.begin(); b != backends.end(); b++ )
+            delete *b;
     }
     catch( exception & e)
     {
@@ -260,6 +575,339 @@ Server::ioInsecure()
     }
 }
 
+/**
+ * @brief Select router shard for a client route (FNV-1a hash)
+ */
+static inline size_t
+routeShard( const uint8_t * a_route, size_t a_len, size_t a_shards )
+{
+    if ( a_shards < 2 )
+        return 0;
+
+    uint32_t hash = 2166136261u;
+
+    for ( size_t i = 0; i < a_len; i++ )
+        hash = ( hash ^ a_route[i] ) * 16777619u;
+
+    return hash % a_shards;
+}
+
+/**
+ * @brief Route messages between a client interface and the worker queue
+ *
+ * Replies from workers are forwarded as-is. Each request is forwarded with a
+ * receive timestamp frame appended (after the UID frame) so that workers can
+ * measure queue wait. Requests on the secure interface are forwarded frame by
+ * frame, with the ZAP User-Id metadata injected as the UID frame since zeromq
+ * does not forward metadata itself. Requests on the insecure (local)
+ * interface already carry a UID frame; MetricsRequests received there are
+ * answered directly by this thread so that metrics are available even when
+ * all workers are busy.
+ *
+ * Requests are sent to the router shard selected by a hash of the client
+ * route (connection identity); replies from all shards are forwarded back.
+ */
+void
+Server::ioProxy( MsgComm & a_frontend, vector<MsgComm*> & a_backends, bool a_secure )
+{
+    const size_t    max_parts = 20;
+    void *          in_sock = a_frontend.getSocket();
+    void *          out_sock;
+    size_t          nshards = a_backends.size();
+    vector<zmq_pollitem_t> items( nshards + 1 );
+    uint16_t        metrics_msg_type = MsgBuf::findMessageType( 1, "MetricsRequest" );
+    zmq_msg_t       msg;
+    zmq_msg_t       parts[max_parts];
+    size_t          i, nparts;
+    const char *    meta_uid;
+    string          uid;
+    uint64_t        stamp;
+    int             more;
+    size_t          more_len;
+    bool            bad_msg;
+    size_t          s;
+    MsgBuf          buf;
+
+    a_frontend.getPollInfo( items[0] );
+    for ( s = 0; s < nshards; s++ )
+        a_backends[s]->getPollInfo( items[s+1] );
+
+    while ( 1 )
+    {
+        try
+        {
+            if ( zmq_poll( &items[0], items.size(), 1000 ) < 1 )
+                continue;
+
+            for ( s = 0; s < nshards; s++ )
+            {
+                if ( !( items[s+1].revents & ZMQ_POLLIN ))
+                    continue;
+
+                out_sock = items[s+1].socket;
+
+                // Forward reply from worker to client
+                do
+                {
+                    zmq_msg_init( &msg );
+
+                    if ( zmq_msg_recv( &msg, out_sock, ZMQ_DONTWAIT ) < 0 )
+                    {
+                        DL_ERROR( "I/O proxy: recv error from worker: " << zmq_strerror( errno ));
+                        zmq_msg_close( &msg );
+                        break;
+                    }
+
+                    more = zmq_msg_more( &msg );
+                    zmq_msg_send( &msg, in_sock, more ? ZMQ_SNDMORE : 0 );
+                }
+                while ( more );
+            }
+
+            if ( !( items[0].revents & ZMQ_POLLIN ))
+                continue;
+
+            if ( !a_secure )
+            {
+                try
+                {
+                    if ( !a_frontend.recv( buf, true, 1 ))
+                        continue;
+                }
+                catch( ... )
+                {
+                    // Discard remaining parts of malformed message
+                    more_len = sizeof( more );
+                    while ( zmq_getsockopt( in_sock, ZMQ_RCVMORE, &more, &more_len ) == 0 && more )
+                    {
+                        zmq_msg_init( &msg );
+                        zmq_msg_recv( &msg, in_sock, ZMQ_DONTWAIT );
+                        zmq_msg_close( &msg );
+                    }
+
+                    throw;
+                }
+
+                if ( buf.getMsgType() == metrics_msg_type )
+                {
+                    procMetricsRequest( buf );
+                    a_frontend.send( buf );
+                }
+                else
+                {
+                    // First route segment is the client connection identity
+                    const uint8_t * route = buf.getRouteBuffer();
+
+                    s = *route ? routeShard( route + 2, route[1], nshards ) : 0;
+                    buf.setStamp( CoreMetrics::stamp() );
+                    a_backends[s]->send( buf, true );
+                    m_msg_forwarded++;
+                }
+
+                continue;
+            }
+
+            nparts = 0;
+            bad_msg = false;
+
+            do
+            {
+                if ( nparts == max_parts )
+                {
+                    DL_ERROR( "I/O proxy: in-bound message has too many parts" );
+                    bad_msg = true;
+
+                    // Flush any remaining, pending parts
+                    while ( more )
+                    {
+                        zmq_msg_init( &msg );
+                        if ( zmq_msg_recv( &msg, in_sock, ZMQ_DONTWAIT ) < 0 )
+                            more = 0;
+                        else
+                            more = zmq_msg_more( &msg );
+                        zmq_msg_close( &msg );
+                    }
+                    break;
+                }
+
+                zmq_msg_init( &parts[nparts] );
+
+                if ( zmq_msg_recv( &parts[nparts], in_sock, ZMQ_DONTWAIT ) < 0 )
+                {
+                    DL_ERROR( "I/O proxy: failed to read in-bound message" );
+                    zmq_msg_close( &parts[nparts] );
+                    bad_msg = true;
+                    break;
+                }
+
+                more = zmq_msg_more( &parts[nparts++] );
+            }
+            while ( more );
+
+            if ( bad_msg )
+            {
+                for ( i = 0; i < nparts; i++ )
+                    zmq_msg_close( &parts[i] );
+                continue;
+            }
+
+            // Must get ZAP user-id from non-routing msg parts - last part is always safe
+            meta_uid = zmq_msg_gets( &parts[nparts-1], "User-Id" );
+            uid = meta_uid ? meta_uid : "";
+
+            // First part is the client connection identity (added by ROUTER socket)
+            out_sock = a_backends[routeShard( (const uint8_t*)zmq_msg_data( &parts[0] ), zmq_msg_size( &parts[0] ), nshards )]->getSocket();
+
+            for ( i = 0; i < nparts; i++ )
+                zmq_msg_send( &parts[i], out_sock, ZMQ_SNDMORE );
+
+            // Send UID frame, or empty frame if no UID set
+            if ( uid.size() )
+            {
+                zmq_msg_init_size( &msg, uid.size() );
+                memcpy( zmq_msg_data( &msg ), uid.c_str(), uid.size() );
+            }
+            else
+                zmq_msg_init( &msg );
+
+            zmq_msg_send( &msg, out_sock, ZMQ_SNDMORE );
+
+            stamp = CoreMetrics::stamp();
+            zmq_msg_init_size( &msg, sizeof( stamp ));
+            memcpy( zmq_msg_data( &msg ), &stamp, sizeof( stamp ));
+            zmq_msg_send( &msg, out_sock, 0 );
+
+            m_msg_forwarded++;
+        }
+        catch( TraceException & e )
+        {
+            DL_ERROR( "I/O proxy: " << e.toString() );
+        }
+        catch( exception & e )
+        {
+            DL_ERROR( "I/O proxy: " << e.what() );
+        }
+        catch( ... )
+        {
+            DL_ERROR( "I/O proxy: unknown exception" );
+        }
+    }
+}
+
+/**
+ * @brief Answer a MetricsRequest (reply is serialized into a_buf)
+ *
+ * Latencies are cumulative since server start; gauges are current values.
+ */
+void
+Server::procMetricsRequest( MsgBuf & a_buf )
+{
+    unique_ptr<MsgBuf::Message>     msg( a_buf.unserialize() );
+    Anon::MetricsRequest *          request = dynamic_cast<Anon::MetricsRequest*>( msg.get() );
+    Anon::MetricsReply              reply;
+    PermCache::Stats                perm_stats;
+    SchemaCache::Stats              schema_stats;
+    SearchPlanCache::Stats          plan_stats;
+    RepoConnMgr::Stats              repo_stats;
+    ClientKeyCache::Stats           key_stats;
+    TaskMgr::LaneStats              lane_stats[TaskMgr::TL_COUNT];
+    size_t                          retry_depth, xfr_count;
+    uint64_t                        received = 0;
+    vector<MsgMetrics*>             blocks;
+    Scheduler_t::Stats              sched_stats;
+    uint64_t                        queued = 0, rejected = 0, rejected_rate = 0;
+
+    auto gauge = [&reply]( const string & a_name, double a_value )
+    {
+        GaugeData * g = reply.add_gauge();
+        g->set_name( a_name );
+        g->set_value( a_value );
+    };
+
+    // Reply must not carry request timeout or flags
+    a_buf.setTimeout( 0 );
+    a_buf.setFlags( 0 );
+
+    CoreMetrics::getInstance().getLatencies( reply );
+
+    {
+        lock_guard<mutex> lock( m_msg_metrics_mutex );
+        blocks = m_msg_metrics;
+    }
+
+    for ( vector<MsgMetrics*>::iterator b = blocks.begin(); b != blocks.end(); b++ )
+        received += (*b)->received();
+
+    for ( vector<Scheduler_t*>::iterator s = m_schedulers.begin(); s != m_schedulers.end(); s++ )
+    {
+        (*s)->getStats( sched_stats );
+        queued += sched_stats.queued;
+        rejected += sched_stats.rejected_rate + sched_stats.rejected_queue;
+        rejected_rate += sched_stats.rejected_rate;
+    }
+
+    // Requests forwarded (and not rejected) but not yet picked up by a worker - includes scheduler queues
+    uint64_t forwarded = m_msg_forwarded.load() - rejected;
+    gauge( "worker.backlog", forwarded > received ? forwarded - received : 0 );
+    gauge( "worker.count", blocks.size() );
+
+    gauge( "msg.expired", CoreMetrics::getInstance().expired() );
+    gauge( "db.coalesced", DatabaseTransport::getInstance().coalesced() );
+    gauge( "compute.threads", ComputePool::getInstance().size() );
+    gauge( "compute.jobs", ComputePool::getInstance().jobs() );
+    gauge( "sched.queued", queued );
+    gauge( "sched.rejected_rate", rejected_rate );
+    gauge( "sched.rejected_queue", rejected - rejected_rate );
+
+    TaskMgr::getInstance().getStats( lane_stats, retry_depth, xfr_count, false );
+    for ( uint32_t l = 0; l < TaskMgr::TL_COUNT; l++ )
+    {
+        gauge( string( "task." ) + TaskMgr::laneName( l ) + ".ready", lane_stats[l].depth );
+        gauge( string( "task." ) + TaskMgr::laneName( l ) + ".running", lane_stats[l].running );
+    }
+
+    gauge( "task.retry", retry_depth );
+    gauge( "task.transfers", xfr_count );
+
+    PermCache::getInstance().getStats( perm_stats );
+    gauge( "perm_cache.entries", perm_stats.entries );
+    gauge( "perm_cache.hits", perm_stats.hits );
+    gauge( "perm_cache.misses", perm_stats.misses );
+    gauge( "perm_cache.evictions", perm_stats.evictions );
+    gauge( "perm_cache.invalidations", perm_stats.invalidations );
+
+    SchemaCache::getInstance().getStats( schema_stats );
+    gauge( "schema_cache.entries", schema_stats.entries );
+    gauge( "schema_cache.hits", schema_stats.hits );
+    gauge( "schema_cache.misses", schema_stats.misses );
+    gauge( "schema_cache.invalidations", schema_stats.invalidations );
+
+    SearchPlanCache::getInstance().getStats( plan_stats );
+    gauge( "search_plan_cache.entries", plan_stats.entries );
+    gauge( "search_plan_cache.hits", plan_stats.hits );
+    gauge( "search_plan_cache.misses", plan_stats.misses );
+    gauge( "search_plan_cache.compile_usec", plan_stats.compile_usec );
+
+    RepoConnMgr::getInstance().getStats( repo_stats );
+    gauge( "repo_conn.connected", repo_stats.repos );
+    gauge( "repo_conn.down", repo_stats.down );
+    gauge( "repo_conn.in_flight", repo_stats.in_flight );
+    gauge( "repo_conn.reconnects", repo_stats.reconnects );
+    gauge( "repo_conn.timeouts", repo_stats.timeouts );
+
+    m_key_cache.getStats( key_stats );
+    gauge( "key_cache.entries", key_stats.entries );
+    gauge( "key_cache.hits", key_stats.hits );
+    gauge( "key_cache.anon_hits", key_stats.neg_hits );
+    gauge( "key_cache.misses", key_stats.misses );
+    gauge( "key_cache.evictions", key_stats.evictions );
+
+    if ( request && request->has_text() && request->text() )
+        CoreMetrics::formatText( reply, *reply.mutable_text() );
+
+    a_buf.serialize( reply );
+}
+
 void
 Server::dbMaintenance()
 {
@@ -302,6 +950,13 @@ Server::metricsThread()
     uint32_t total, subtot;
     uint32_t timestamp;
     map<string,MsgMetrics_t> metrics;
+    vector<MsgMetrics*> blocks;
+    vector<uint32_t> type_counts( MSG_METRICS_TYPES, 0 );
+    vector<pair<uint32_t,uint16_t>> busiest;
+    PermCache::Stats cache_stats;
+    ClientKeyCache::Stats key_stats;
+    TaskMgr::LaneStats lane_stats[TaskMgr::TL_COUNT];
+    size_t retry_depth, xfr_count;
 
     pc = purge_count;
 
@@ -313,13 +968,16 @@ Server::metricsThread()
         {
             //DL_DEBUG( "metrics: updating" );
 
-            // Lock mutex, swap metrics to local store, release lock
+            // Collect metrics from per-worker blocks (workers are not blocked)
             {
                 lock_guard<mutex> lock( m_msg_metrics_mutex );
 
-                m_msg_metrics.swap(metrics);
+                blocks = m_msg_metrics;
             }
 
+            for ( vector<MsgMetrics*>::iterator b = blocks.begin(); b != blocks.end(); b++ )
+                (*b)->collect( metrics, type_counts );
+
             timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
             total = 0;
 
@@ -338,6 +996,38 @@ Server::metricsThread()
             db.metricsUpdateMsgCounts( timestamp, total, metrics );
             metrics.clear();
 
+            for ( uint16_t t = 0; t < MSG_METRICS_TYPES; t++ )
+            {
+                if ( type_counts[t] )
+                    busiest.push_back( make_pair( type_counts[t], t ));
+            }
+
+            sort( busiest.begin(), busiest.end(), greater<pair<uint32_t,uint16_t>>() );
+            for ( size_t i = 0; i < busiest.size() && i < 5; i++ )
+            {
+                DL_DEBUG( "metrics: msg type " << busiest[i].second << " count " << busiest[i].first );
+            }
+
+            busiest.clear();
+            fill( type_counts.begin(), type_counts.end(), 0 );
+
+            PermCache::getInstance().getStats( cache_stats );
+            DL_INFO( "Perm cache: entries " << cache_stats.entries << ", hits " << cache_stats.hits << ", misses " << cache_stats.misses
+                << ", evictions " << cache_stats.evictions << ", invalidations " << cache_stats.invalidations );
+
+            m_key_cache.getStats( key_stats );
+            DL_INFO( "Client key cache: entries " << key_stats.entries << ", hits " << key_stats.hits << ", anon hits " << key_stats.neg_hits
+                << ", misses " << key_stats.misses << ", evictions " << key_stats.evictions );
+
+            TaskMgr::getInstance().getStats( lane_stats, retry_depth, xfr_count );
+            for ( uint32_t l = 0; l < TaskMgr::TL_COUNT; l++ )
+            {
+                DL_INFO( "Task lane " << TaskMgr::laneName( l ) << ": depth " << lane_stats[l].depth << ", running " << lane_stats[l].running
+                    << "/" << lane_stats[l].max_running << ", dispatched " << lane_stats[l].dispatched << ", latency avg " << lane_stats[l].latency_avg
+                    << " us, max " << lane_stats[l].latency_max << " us" );
+            }
+            DL_INFO( "Task retry queue: " << retry_depth << ", monitored transfers: " << xfr_count );
+
             if ( --pc == 0 )
             {
                 DL_DEBUG( "metrics: purging" );
@@ -363,6 +1053,35 @@ Server::metricsThread()
     DL_ERROR( "Metrics thread exiting" );
 }
 
+/**
+ * @brief Send a ZAP reply via the ROUTER socket of the ZAP handler
+ *
+ * All clients are accepted; the user ID is either a known DataFed ID or an
+ * anonymous ID derived from the client key.
+ */
+static void
+zapReply( void * a_socket, const string & a_identity, const string & a_request_id, const string & a_uid )
+{
+    zmq_send( a_socket, a_identity.c_str(), a_identity.size(), ZMQ_SNDMORE );
+    zmq_send( a_socket, "", 0, ZMQ_SNDMORE );
+    zmq_send( a_socket, "1.0", 3, ZMQ_SNDMORE );
+    zmq_send( a_socket, a_request_id.c_str(), a_request_id.size(), ZMQ_SNDMORE );
+    zmq_send( a_socket, "200", 3, ZMQ_SNDMORE );
+    zmq_send( a_socket, "", 0, ZMQ_SNDMORE );
+    zmq_send( a_socket, a_uid.c_str(), a_uid.size(), ZMQ_SNDMORE );
+    zmq_send( a_socket, "", 0, 0 );
+}
+
+/**
+ * @brief ZeroMQ authentication (ZAP) handler thread
+ *
+ * A ROUTER socket is used so that replies can be sent out of order. Client
+ * keys are resolved from the pre-authorized and transient client lists, then
+ * from the client key cache. On a cache miss, a DB lookup is started and the
+ * request is answered when the lookup completes (ZAP requests with the same
+ * key share one lookup). Unknown keys are cached as anonymous; keys that could
+ * not be looked up (DB errors) are answered as anonymous but not cached.
+ */
 void
 Server::zapHandler()
 {
@@ -370,10 +1089,18 @@ Server::zapHandler()
 
     try
     {
+        /// Pending DB lookup of a client key and the ZAP requests (identity, request_id) waiting on it
+        struct Lookup
+        {
+            DatabaseAPI::AsyncContext *             ctx;
+            vector<pair<string,string>>             waiters;
+        };
+
         void *      ctx = MsgComm::getContext();
         char        client_key_text[41];
-        void *      socket = zmq_socket( ctx, ZMQ_REP );
+        void *      socket = zmq_socket( ctx, ZMQ_ROUTER );
         int         rc;
+        char        identity[256];
         char        version[100];
         char        request_id[100];
         char        domain[100];
@@ -381,51 +1108,114 @@ Server::zapHandler()
         char        identity_property[100];
         char        mechanism[100];
         char        client_key[100];
-        string      uid;
-        time_t      now, next_purge;
+        string      uid, key, ident;
+        bool        anon, found;
+        time_t      now;
         auth_client_map_t::iterator     iclient;
         trans_client_map_t::iterator    itrans_client;
+        map<string,Lookup>              lookups;
+        map<string,Lookup>::iterator    ilookup;
+        vector<string>                  done;
+        vector<pair<string,string>>::iterator   w;
+        DatabaseAPI::AsyncContext *     actx;
         zmq_pollitem_t                  poll_items[] = { socket, 0, ZMQ_POLLIN, 0 };
         DatabaseAPI                  db( m_config.db_url, m_config.db_user, m_config.db_pass );
 
         if (( rc = zmq_bind( socket, "inproc://zeromq.zap.01" )) == -1 )
             EXCEPT( 1, "Bind on ZAP failed." );
 
-        next_purge = time(0) + 30;
-
         while ( 1 )
         {
             try
             {
-                if (( rc = zmq_poll( poll_items, 1, 10000 )) == -1 )
+                // Poll briefly while DB lookups are outstanding so that completions are handled promptly
+                if (( rc = zmq_poll( poll_items, 1, lookups.size() ? ZAP_POLL_PENDING : ZAP_POLL_IDLE )) == -1 )
                     EXCEPT( 1, "Poll on ZAP socket failed." );
 
-                if ( m_trans_auth_clients.size() )
                 {
-                    now = time( 0 );
-                    if ( now > next_purge )
+                    lock_guard<mutex> lock( m_trans_client_mutex );
+
+                    if ( m_trans_expiry.size() )
                     {
-                        DL_DEBUG( "ZAP: Purging expired transient clients" );
-                        lock_guard<mutex> lock( m_trans_client_mutex );
+                        now = time( 0 );
 
-                        for ( itrans_client = m_trans_auth_clients.begin(); itrans_client != m_trans_auth_clients.end(); )
+                        m_trans_expiry.expire( chrono::system_clock::now(), [this,now]( const string & a_key )
                         {
-                            if ( itrans_client->second.second < now )
+                            trans_client_map_t::iterator i = m_trans_auth_clients.find( a_key );
+
+                            // Entry may have been used or refreshed since being scheduled
+                            if ( i != m_trans_auth_clients.end() && i->second.second < now )
                             {
-                                DL_DEBUG( "ZAP: Purging client " << itrans_client->second.first );
-                                itrans_client = m_trans_auth_clients.erase( itrans_client );
+                                DL_DEBUG( "ZAP: Purging client " << i->second.first );
+                                m_trans_auth_clients.erase( i );
                             }
-                            else
-                                itrans_client++;
-                        }
+                        });
+                    }
+                }
+
+                m_key_cache.purge();
+
+                // Answer requests waiting on completed DB lookups
+                {
+                    lock_guard<mutex> lock( m_zap_done_mutex );
+                    done.swap( m_zap_done );
+                }
+
+                for ( vector<string>::iterator k = done.begin(); k != done.end(); k++ )
+                {
+                    if (( ilookup = lookups.find( *k )) == lookups.end() )
+                        continue;
+
+                    actx = ilookup->second.ctx;
+                    actx->rewind();
+                    db.setAsyncContext( actx );
 
-                        next_purge = now + 30;
+                    try
+                    {
+                        found = db.uidByPubKey( *k, uid );
+                    }
+                    catch( ... )
+                    {
+                        found = false;
+                    }
+
+                    db.setAsyncContext( 0 );
+
+                    if ( found )
+                    {
+                        DL_DEBUG( "ZAP: Known client connected: " << uid );
+                        m_key_cache.put( *k, uid );
+                    }
+                    else
+                    {
+                        DatabaseTransport::Request & call = *actx->calls[0];
+
+                        if ( call.result == CURLE_OK && call.http_code >= 400 && call.http_code < 500 )
+                            m_key_cache.putAnon( *k );
+                        else
+                            DL_WARN( "ZAP: Client key lookup failed (" << call.result << ", " << call.http_code << ")" );
+
+                        uid = string("anon_") + *k;
+                        DL_DEBUG( "ZAP: Unknown client connected: " << uid );
                     }
+
+                    for ( w = ilookup->second.waiters.begin(); w != ilookup->second.waiters.end(); w++ )
+                        zapReply( socket, w->first, w->second, uid );
+
+                    delete actx;
+                    lookups.erase( ilookup );
                 }
 
+                done.clear();
+
                 if ( !(poll_items[0].revents & ZMQ_POLLIN ))
                     continue;
 
+                if (( rc = zmq_recv( socket, identity, sizeof( identity ), 0 )) == -1 )
+                    EXCEPT( 1, "Rcv identity failed." );
+                ident.assign( identity, min( rc, (int)sizeof( identity )));
+                if (( rc = zmq_recv( socket, version, 100, 0 )) == -1 )
+                    EXCEPT( 1, "Rcv delimiter failed." );
                 if (( rc = zmq_recv( socket, version, 100, 0 )) == -1 )
                     EXCEPT( 1, "Rcv version failed." );
                 version[rc] = 0;
@@ -454,48 +1244,73 @@ Server::zapHandler()
                 if ( !zmq_z85_encode( client_key_text, (uint8_t*)client_key, 32 ))
                     EXCEPT( 1, "Encode of client_key failed." );
 
-                /* cout << "ZAP request:" <<
-                    "\n\tversion: " << version <<
-                    "\n\trequest_id: " << request_id <<
-                    "\n\tdomain: " << domain <<
-                    "\n\taddress: " << address <<
-                    "\n\tidentity_property: " << identity_property <<
-                    "\n\tmechanism: " << mechanism <<
-                    "\n\tclient_key: " << client_key_text << "\n";
-                */
-
-                //cout << "ZAP client key ["<< client_key_text << "]\n";
+                key = client_key_text;
 
                 // Always accept - but only set UID if it's a known client (by key)
-                if (( iclient = m_auth_clients.find( client_key_text )) != m_auth_clients.end())
+                if (( iclient = m_auth_clients.find( key )) != m_auth_clients.end())
                 {
                     uid = iclient->second;
                     DL_DEBUG( "ZAP: Known pre-authorized client connected: " << uid );
                 }
-                else if ( isClientAuthenticated( client_key_text, uid ))
+                else if ( isClientAuthenticated( key, uid ))
                 {
                     DL_DEBUG( "ZAP: Known transient client connected: " << uid );
                 }
+                else if ( m_key_cache.get( key, uid, anon ))
+                {
+                    if ( anon )
+                        uid = string("anon_") + key;
+
+                    DL_DEBUG( "ZAP: Cached client connected: " << uid );
+                }
+                else if (( ilookup = lookups.find( key )) != lookups.end() )
+                {
+                    // Lookup of same key already outstanding
+                    ilookup->second.waiters.push_back( make_pair( ident, string( request_id )));
+                    continue;
+                }
                 else
                 {
-                    if ( db.uidByPubKey( client_key_text, uid ) )
+                    actx = new DatabaseAPI::AsyncContext();
+                    actx->on_complete = [this,key]()
                     {
-                        DL_DEBUG( "ZAP: Known client connected: " << uid );
+                        lock_guard<mutex> lock( m_zap_done_mutex );
+                        m_zap_done.push_back( key );
+                    };
+
+                    db.setAsyncContext( actx );
+
+                    try
+                    {
+                        found = db.uidByPubKey( key, uid );
+                        db.setAsyncContext( 0 );
+                        delete actx;
                     }
-                    else
+                    catch( DatabaseAPI::DeferredCall & )
                     {
-                        uid = string("anon_") + client_key_text;
+                        db.setAsyncContext( 0 );
+
+                        Lookup & lookup = lookups[key];
+                        lookup.ctx = actx;
+                        lookup.waiters.push_back( make_pair( ident, string( request_id )));
+                        continue;
+                    }
+                    catch( ... )
+                    {
+                        db.setAsyncContext( 0 );
+                        delete actx;
+                        DL_ERROR( "ZAP: Client key lookup failed" );
+                        found = false;
+                    }
+
+                    if ( !found )
+                    {
+                        uid = string("anon_") + key;
                         DL_DEBUG( "ZAP: Unknown client connected: " << uid );
                     }
                 }
 
-                zmq_send( socket, "1.0", 3, ZMQ_SNDMORE );
-                zmq_send( socket, request_id, strlen(request_id), ZMQ_SNDMORE );
-                zmq_send( socket, "200", 3, ZMQ_SNDMORE );
-                zmq_send( socket, "", 0, ZMQ_SNDMORE );
-                zmq_send( socket, uid.c_str(), uid.size(), ZMQ_SNDMORE );
-                zmq_send( socket, "", 0, 0 );
-
+                zapReply( socket, ident, request_id, uid );
             }
             catch( TraceException & e )
             {
@@ -534,12 +1349,29 @@ Server::authenticateClient( const std::string & a_cert_uid, const std::string &
 {
     if ( strncmp( a_cert_uid.c_str(), "anon_", 5 ) == 0 )
     {
+        string  key = a_cert_uid.substr( 5 );
+        time_t  expires = time(0) + TRANS_CLIENT_TTL;
+
         lock_guard<mutex> lock( m_trans_client_mutex );
 
-        m_trans_auth_clients[a_cert_uid.substr( 5 )] = make_pair<>( a_uid, time(0) + 30 );
+        m_trans_auth_clients[key] = make_pair<>( a_uid, expires );
+        // Scheduled one tick late so that the entry has expired when purged
+        m_trans_expiry.insert( chrono::system_clock::from_time_t( expires + 1 ), key );
     }
 }
 
+/**
+ * @brief Invalidate cached client keys after a user's keys are set or revoked
+ */
+void
+Server::clientKeysChanged( const std::string & a_uid, const std::string & a_pub_key )
+{
+    m_key_cache.invalidateUser( a_uid );
+
+    if ( a_pub_key.size() )
+        m_key_cache.invalidateKey( a_pub_key );
+}
+
 bool
 Server::isClientAuthenticated( const std::string & a_client_key, std::string & a_uid )
 {
@@ -557,27 +1389,21 @@ Server::isClientAuthenticated( const std::string & a_client_key, std::string & a
     return false;
 }
 
-void
-Server::metricsUpdateMsgCount( const std::string & a_uid, uint16_t a_msg_type )
+/**
+ * @brief Create message metrics block for a client worker
+ *
+ * Blocks are owned by the server and are collected by the metrics thread.
+ */
+MsgMetrics *
+Server::metricsCreate()
 {
+    MsgMetrics * metrics = new MsgMetrics();
+
     lock_guard<mutex> lock( m_msg_metrics_mutex );
-    map<string,MsgMetrics_t>::iterator u = m_msg_metrics.find( a_uid );
-    if ( u == m_msg_metrics.end() )
-    {
-        m_msg_metrics[a_uid][a_msg_type] = 1;
-    }
-    else
-    {
-        MsgMetrics_t::iterator m = u->second.find( a_msg_type );
-        if ( m == u->second.end() )
-        {
-            u->second[a_msg_type] = 1;
-        }
-        else
-        {
-            m->second++;
-        }
-    }
+
+    m_msg_metrics.push_back( metrics );
+
+    return metrics;
 }
 
 }}
@@ -3,14 +3,20 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include <stdint.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include "Config.hpp"
+#include "MsgComm.hpp"
 #include "ICoreServer.hpp"
+#include "ClientKeyCache.hpp"
+#include "TimerWheel.hpp"
+#include "RequestScheduler.hpp"
 
 
 namespace SDMS {
@@ -37,8 +43,18 @@ class ClientWorker;
  * is insecure for use by trusted local processes. Messages received from either interface are
  * routed to the same worker threads for processing.
  *
+ * Client workers are partitioned into one or more router shards (config.router_shards), each
+ * with its own router thread and worker queue. The I/O threads select a shard by hashing the
+ * client route so that requests from a given client are always processed by the same shard.
+ * CURVE encryption and socket I/O are performed by the ZeroMQ I/O threads, the number and CPU
+ * affinity of which are also configurable (config.io_threads, config.io_cpus).
+ *
  * The ICoreServer interface class exposes an authenticateClient method to client workers for
  * manual (password) and token-based authentication.
+ *
+ * Client keys of incoming secure connections are resolved to DataFed user IDs by the ZAP
+ * handler. Resolved (and unknown) keys are cached, and DB lookups are issued asynchronously so
+ * that other ZAP requests can be answered while a lookup is outstanding.
  */
 class Server : public ICoreServer
 {
@@ -63,17 +79,24 @@ private:
     typedef std::map<std::string,std::pair<std::string,time_t>> trans_client_map_t;
 
     /// Message request metrics - maps message type to count per metrics period
-    typedef std::map<uint16_t,uint32_t> MsgMetrics_t;
+    typedef MsgMetrics::counts_t MsgMetrics_t;
+
+    /// Client request scheduler (one per router shard)
+    typedef RequestScheduler<MsgBuf> Scheduler_t;
 
     void waitForDB();
     void authenticateClient( const std::string & a_cert_uid, const std::string & a_uid );
-    void metricsUpdateMsgCount( const std::string & a_uid, uint16_t a_msg_type );
+    void clientKeysChanged( const std::string & a_uid, const std::string & a_pub_key );
+    MsgMetrics * metricsCreate();
     bool isClientAuthenticated( const std::string & a_client_key, std::string & a_uid );
     void loadKeys( const std::string & a_cred_dir );
     void loadRepositoryConfig();
-    void msgRouter();
+    void configureIO();
+    void msgRouter( uint32_t a_shard );
     void ioSecure();
     void ioInsecure();
+    void ioProxy( MsgComm & a_frontend, std::vector<MsgComm*> & a_backends, bool a_secure );
+    void procMetricsRequest( MsgBuf & a_buf );
     void zapHandler();
     void dbMaintenance();
     void metricsThread();
@@ -87,12 +110,18 @@ private:
     std::thread *                   m_zap_thread;           ///< ZeroMQ client authentication (ZAP) thread
     auth_client_map_t               m_auth_clients;         ///< List of known authenticated clients
     trans_client_map_t              m_trans_auth_clients;   ///< List of transient authenticated clients
-    std::thread *                   m_msg_router_thread;    ///< Main message router thread handle
-    std::vector<ClientWorker*>      m_workers;              ///< List of ClientWorker instances
+    TimerWheel<std::string>         m_trans_expiry;         ///< Expiration of transient authenticated clients
+    ClientKeyCache                  m_key_cache;            ///< Cache of client key to DataFed ID (or anonymous)
+    std::vector<std::string>        m_zap_done;             ///< Client keys of completed ZAP DB lookups
+    std::mutex                      m_zap_done_mutex;       ///< Mutex for completed ZAP DB lookups
+    uint32_t                        m_router_shards;        ///< Number of message router shards
+    std::vector<std::thread*>       m_msg_router_threads;   ///< Message router (shard) thread handles
+    std::vector<Scheduler_t*>       m_schedulers;           ///< Request schedulers (per router shard)
+    std::atomic<uint64_t>           m_msg_forwarded;        ///< Number of requests forwarded to workers
     std::thread *                   m_db_maint_thread;      ///< DB maintenance thread handle
     std::thread *                   m_metrics_thread;       ///< Metrics gathering thread handle
-    std::map<std::string,MsgMetrics_t> m_msg_metrics;       ///< Map of UID to message request metrics
-    std::mutex                      m_msg_metrics_mutex;    ///< Mutex for metrics updates
+    std::vector<MsgMetrics*>        m_msg_metrics;          ///< Per-worker message request metrics
+    std::mutex                      m_msg_metrics_mutex;    ///< Mutex for metrics list (not used per message)
 };
 
 
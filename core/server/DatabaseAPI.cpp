@@ -1,4 +1,5 @@
 #include <cctype>
+#include <string.h>
 #include <algorithm>
 #include <zmq.h>
 #include <unistd.h>
@@ -9,6 +10,11 @@
 #include "DynaLog.hpp"
 #include "TraceException.hpp"
 #include "DatabaseAPI.hpp"
+#include "PermCache.hpp"
+#include "SchemaCache.hpp"
+#include "SearchPlanCache.hpp"
+#include "DatabaseReplyReader.hpp"
+#include "CoreMetrics.hpp"
 
 using namespace std;
 
@@ -21,29 +27,39 @@ using namespace libjson;
 #define TRANSLATE_BEGIN() try{
 #define TRANSLATE_END( json ) }catch( TraceException &e ){ DL_ERROR( "INVALID JSON FROM DB: " << json.toString() ); EXCEPT_CONTEXT( e, "Invalid response from DB" ); throw; }
 
-DatabaseAPI::DatabaseAPI( const std::string & a_db_url, const std::string & a_db_user, const std::string & a_db_pass ) :
-    m_client(0), m_db_url(a_db_url)
+/**
+ * Read-only DB routes whose concurrent identical calls are coalesced by the
+ * transport (see DatabaseTransport). Results of client-scoped routes depend on
+ * the permissions of the client, so only calls of the same client are shared.
+ */
+static const struct
+{
+    const char *    route;
+    bool            client_scope;
+} g_coalesce_routes[] =
 {
-    m_curl = curl_easy_init();
-    if ( !m_curl )
-        EXCEPT( ID_INTERNAL_ERROR, "libcurl init failed" );
+    { "col/read", true },
+    { "col/published/list", true },
+    { "topic/list/topics", false },
+    { "tag/list/by_count", false }
+};
 
+DatabaseAPI::DatabaseAPI( const std::string & a_db_url, const std::string & a_db_user, const std::string & a_db_pass ) :
+    m_transport( DatabaseTransport::getInstance() ), m_async_ctx(0), m_db_usec(0), m_client(0), m_db_url(a_db_url), m_db_user(a_db_user), m_db_pass(a_db_pass)
+{
     setClient("");
-
-    curl_easy_setopt( m_curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1 );
-    curl_easy_setopt( m_curl, CURLOPT_USERNAME, a_db_user.c_str() );
-    curl_easy_setopt( m_curl, CURLOPT_PASSWORD, a_db_pass.c_str() );
-    curl_easy_setopt( m_curl, CURLOPT_WRITEFUNCTION, curlResponseWriteCB );
-    curl_easy_setopt( m_curl, CURLOPT_SSL_VERIFYPEER, 0 );
-    curl_easy_setopt( m_curl, CURLOPT_TCP_NODELAY, 1 );
 }
 
 DatabaseAPI::~DatabaseAPI()
 {
     if ( m_client )
         curl_free( m_client );
+}
 
-    curl_easy_cleanup( m_curl );
+DatabaseAPI::AsyncContext::~AsyncContext()
+{
+    for ( vector<DatabaseTransport::Request*>::iterator c = calls.begin(); c != calls.end(); c++ )
+        delete *c;
 }
 
 void
@@ -57,30 +73,23 @@ DatabaseAPI::setClient( const std::string & a_client )
     if ( m_client )
         curl_free( m_client );
 
-    m_client = curl_easy_escape( m_curl, a_client.c_str(), 0 );
+    // Escaping does not require an easy handle (handle is only used for charset conversion)
+    m_client = curl_easy_escape( 0, a_client.c_str(), 0 );
 }
 
-long
-DatabaseAPI::dbGet( const char * a_url_path, const vector<pair<string,string>> &a_params, libjson::Value & a_result, bool a_log )
+void
+DatabaseAPI::dbRequest( DatabaseTransport::Request & a_request, const char * a_url_path, const vector<pair<string,string>> &a_params )
 {
-    (void)a_log;
-
-    a_result.clear();
-
-    string  url;
-    string  res_json;
-    char    error[CURL_ERROR_SIZE];
-
-    error[0] = 0;
+    string & url = a_request.url;
 
     url.reserve( 512 );
 
-    // TODO Get URL base from ctor
     url.append( m_db_url );
     url.append( a_url_path );
     url.append( "?client=" );
     url.append( m_client );
 
+    size_t params_pos = url.size();
     char * esc_txt;
 
     for ( vector<pair<string,string>>::const_iterator iparam = a_params.begin(); iparam != a_params.end(); ++iparam )
@@ -88,108 +97,167 @@ DatabaseAPI::dbGet( const char * a_url_path, const vector<pair<string,string>> &
         url.append( "&" );
         url.append( iparam->first.c_str() );
         url.append( "=" );
-        esc_txt = curl_easy_escape( m_curl, iparam->second.c_str(), 0 );
+        esc_txt = curl_easy_escape( 0, iparam->second.c_str(), 0 );
         url.append( esc_txt );
         curl_free( esc_txt );
     }
 
-    /*if ( a_log )
+    a_request.user = m_db_user.c_str();
+    a_request.pass = m_db_pass.c_str();
+
+    for ( size_t r = 0; r < sizeof( g_coalesce_routes ) / sizeof( g_coalesce_routes[0] ); r++ )
     {
-        DL_DEBUG( "get url: " << url );
-    }*/
+        if ( strcmp( a_url_path, g_coalesce_routes[r].route ) == 0 )
+        {
+            string & key = a_request.coalesce_key;
+
+            key.append( a_url_path );
+            if ( g_coalesce_routes[r].client_scope )
+                key.append( url, m_db_url.size() + strlen( a_url_path ), string::npos );
+            else
+                key.append( url, params_pos, string::npos );
+            key.append( "\n" );
+            key.append( a_request.body );
+            break;
+        }
+    }
 
-    curl_easy_setopt( m_curl, CURLOPT_URL, url.c_str() );
-    curl_easy_setopt( m_curl, CURLOPT_WRITEDATA, &res_json );
-    curl_easy_setopt( m_curl, CURLOPT_ERRORBUFFER, error );
-    curl_easy_setopt( m_curl, CURLOPT_HTTPGET, 1 );
+    // Limit call to time remaining before client gives up (replayed calls are not limited)
+    chrono::steady_clock::time_point deadline = m_async_ctx ? m_async_ctx->deadline : m_deadline;
 
-    CURLcode res = curl_easy_perform( m_curl );
+    if ( deadline != chrono::steady_clock::time_point() && !( m_async_ctx && m_async_ctx->next < m_async_ctx->calls.size() ))
+    {
+        int64_t msec = chrono::duration_cast<chrono::milliseconds>( deadline - chrono::steady_clock::now() ).count();
 
-    long http_code = 0;
-    curl_easy_getinfo( m_curl, CURLINFO_RESPONSE_CODE, &http_code );
+        if ( msec <= 0 )
+        {
+            CoreMetrics::getInstance().recordExpired();
+            EXCEPT( ID_SERVICE_ERROR, "Request deadline expired" );
+        }
+
+        a_request.timeout_ms = (uint32_t) msec;
+    }
 
-    if ( res == CURLE_OK )
+    if ( m_async_ctx )
     {
-        if ( res_json.size() )
+        if ( m_async_ctx->next < m_async_ctx->calls.size() )
+        {
+            // Replay result of a previously completed call
+            DatabaseTransport::Request & call = *m_async_ctx->calls[m_async_ctx->next++];
+
+            if ( call.url != a_request.url )
+                EXCEPT_PARAM( ID_INTERNAL_ERROR, "DB call replay mismatch: " << a_request.url );
+
+            a_request.result = call.result;
+            a_request.http_code = call.http_code;
+            a_request.response = call.response;
+            memcpy( a_request.error, call.error, CURL_ERROR_SIZE );
+        }
+        else
+        {
+            DatabaseTransport::Request * call = new DatabaseTransport::Request( a_request );
+            AsyncContext * ctx = m_async_ctx;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            string route( a_url_path );
+
+            call->on_complete = [ctx,start,route]( DatabaseTransport::Request & )
+            {
+                uint64_t usec = CoreMetrics::usecSince( start );
+
+                CoreMetrics::getInstance().recordRoute( route.c_str(), usec );
+                ctx->db_usec += usec;
+                ctx->on_complete();
+            };
+            ctx->calls.push_back( call );
+            ctx->next++;
+
+            m_transport.submit( *call );
+
+            throw DeferredCall();
+        }
+    }
+    else
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        m_transport.perform( a_request );
+
+        uint64_t usec = CoreMetrics::usecSince( start );
+
+        CoreMetrics::getInstance().recordRoute( a_url_path, usec );
+        m_db_usec += usec;
+    }
+}
+
+long
+DatabaseAPI::dbResult( DatabaseTransport::Request & a_request, Value & a_result )
+{
+    if ( a_request.result == CURLE_OK )
+    {
+        if ( a_request.response.size() )
         {
             try
             {
-                a_result.fromString( res_json );
+                a_result.fromString( a_request.response );
             }
             catch( libjson::ParseError & e )
             {
-                DL_DEBUG( "PARSE [" << res_json << "]" );
+                DL_DEBUG( "PARSE [" << a_request.response << "]" );
                 EXCEPT_PARAM( ID_SERVICE_ERROR, "Invalid JSON returned from DB: " << e.toString() );
             }
         }
 
-        if ( http_code >= 200 && http_code < 300 )
+        if ( a_request.http_code >= 200 && a_request.http_code < 300 )
         {
-            return http_code;
+            return a_request.http_code;
         }
         else
         {
-            if ( res_json.size() && a_result.asObject().has( "errorMessage" ))
+            if ( a_request.response.size() && a_result.asObject().has( "errorMessage" ))
             {
+                DL_DEBUG( "DB request FAILED " << a_request.url << " [" << a_request.body << "]" );
+
                 EXCEPT_PARAM( ID_BAD_REQUEST, a_result.asObject().asString());
             }
             else
             {
-                EXCEPT_PARAM( ID_BAD_REQUEST, "SDMS DB service call failed. Code: " << http_code << ", err: " << error );
+                EXCEPT_PARAM( ID_BAD_REQUEST, "SDMS DB service call failed. Code: " << a_request.http_code << ", err: " << a_request.error );
             }
         }
     }
     else
     {
-        EXCEPT_PARAM( ID_SERVICE_ERROR, "SDMS DB interface failed. error: " << error << ", " << curl_easy_strerror( res ));
+        EXCEPT_PARAM( ID_SERVICE_ERROR, "SDMS DB interface failed. error: " << a_request.error << ", " << curl_easy_strerror( a_request.result ));
     }
 }
 
-
-bool
-DatabaseAPI::dbGetRaw( const char * a_url_path, const vector<pair<string,string>> &a_params, string & a_result )
+long
+DatabaseAPI::dbGet( const char * a_url_path, const vector<pair<string,string>> &a_params, libjson::Value & a_result, bool a_log )
 {
-    a_result.clear();
-
-    string  url;
-    char    error[CURL_ERROR_SIZE];
+    (void)a_log;
 
     a_result.clear();
-    error[0] = 0;
 
-    url.reserve( 512 );
+    DatabaseTransport::Request request;
 
-    // TODO Get URL base from ctor
-    url.append( m_db_url );
-    url.append( a_url_path );
-    url.append( "?client=" );
-    url.append( m_client );
+    dbRequest( request, a_url_path, a_params );
 
-    char * esc_txt;
+    return dbResult( request, a_result );
+}
 
-    for ( vector<pair<string,string>>::const_iterator iparam = a_params.begin(); iparam != a_params.end(); ++iparam )
-    {
-        url.append( "&" );
-        url.append( iparam->first.c_str() );
-        url.append( "=" );
-        esc_txt = curl_easy_escape( m_curl, iparam->second.c_str(), 0 );
-        url.append( esc_txt );
-        curl_free( esc_txt );
-    }
 
-    //DL_TRACE( "get raw url: " << url );
+bool
+DatabaseAPI::dbGetRaw( const char * a_url_path, const vector<pair<string,string>> &a_params, string & a_result )
+{
+    a_result.clear();
 
-    curl_easy_setopt( m_curl, CURLOPT_URL, url.c_str() );
-    curl_easy_setopt( m_curl, CURLOPT_WRITEDATA, &a_result );
-    curl_easy_setopt( m_curl, CURLOPT_ERRORBUFFER, error );
-    curl_easy_setopt( m_curl, CURLOPT_HTTPGET, 1 );
+    DatabaseTransport::Request request;
 
-    CURLcode res = curl_easy_perform( m_curl );
+    dbRequest( request, a_url_path, a_params );
 
-    long http_code = 0;
-    curl_easy_getinfo( m_curl, CURLINFO_RESPONSE_CODE, &http_code );
+    a_result.swap( request.response );
 
-    if ( res == CURLE_OK && ( http_code >= 200 && http_code < 300 ))
+    if ( request.result == CURLE_OK && ( request.http_code >= 200 && request.http_code < 300 ))
         return true;
     else
         return false;
@@ -199,91 +267,194 @@ long
 DatabaseAPI::dbPost( const char * a_url_path, const vector<pair<string,string>> &a_params, const string * a_body, Value & a_result )
 {
     //DL_DEBUG( "dbPost " << a_url_path << " [" << (a_body?*a_body:"") << "]" );
-    static const char * empty_body = "";
 
     a_result.clear();
 
-    string  url;
-    string  res_json;
-    char    error[CURL_ERROR_SIZE];
-
-    error[0] = 0;
-
-    url.reserve( 512 );
-
-    // TODO Get URL base from ctor
-    url.append( m_db_url );
-    url.append( a_url_path );
-    url.append( "?client=" );
-    url.append( m_client );
-
-    char * esc_txt;
-
-    for ( vector<pair<string,string>>::const_iterator iparam = a_params.begin(); iparam != a_params.end(); ++iparam )
-    {
-        url.append( "&" );
-        url.append( iparam->first.c_str() );
-        url.append( "=" );
-        esc_txt = curl_easy_escape( m_curl, iparam->second.c_str(), 0 );
-        url.append( esc_txt );
-        curl_free( esc_txt );
-    }
-
-    //DL_TRACE( "post url: " << url );
-
-    curl_easy_setopt( m_curl, CURLOPT_URL, url.c_str() );
-    curl_easy_setopt( m_curl, CURLOPT_WRITEDATA, &res_json );
-    curl_easy_setopt( m_curl, CURLOPT_ERRORBUFFER, error );
-    curl_easy_setopt( m_curl, CURLOPT_POST, 1 );
+    DatabaseTransport::Request request;
 
     // libcurl seems to no longer work with POSTs without a body, so must set body to an empty string
-    curl_easy_setopt( m_curl, CURLOPT_POSTFIELDS, a_body?a_body->c_str():empty_body );
+    request.post = true;
+    if ( a_body )
+        request.body = *a_body;
 
-    CURLcode res = curl_easy_perform( m_curl );
+    dbRequest( request, a_url_path, a_params );
+
+    return dbResult( request, a_result );
+}
 
-    long http_code = 0;
-    curl_easy_getinfo( m_curl, CURLINFO_RESPONSE_CODE, &http_code );
 
-    if ( res == CURLE_OK )
+/**
+ * Streaming variant of dbResult: a successful response is parsed directly
+ * into a_handler (a libjson::Reader handler, see DatabaseReplyReader) rather
+ * than into a Value. Error responses are handled as by dbResult.
+ */
+template<typename H>
+long
+DatabaseAPI::dbResult( DatabaseTransport::Request & a_request, H & a_handler )
+{
+    if ( a_request.result == CURLE_OK && a_request.http_code >= 200 && a_request.http_code < 300 )
     {
-        if ( res_json.size() )
+        if ( a_request.response.size() )
         {
             try
             {
-                //DL_DEBUG( "PARSE [" << res_json << "]" );
-                a_result.fromString( res_json );
+                libjson::Reader reader;
+
+                reader.parse( a_request.response, a_handler );
             }
             catch( libjson::ParseError & e )
             {
-                DL_DEBUG( "PARSE [" << res_json << "]" );
+                DL_DEBUG( "PARSE [" << a_request.response << "]" );
                 EXCEPT_PARAM( ID_SERVICE_ERROR, "Invalid JSON returned from DB: " << e.toString() );
             }
+            catch( TraceException & e )
+            {
+                DL_ERROR( "INVALID JSON FROM DB: " << a_request.response );
+                EXCEPT_CONTEXT( e, "Invalid response from DB" );
+                throw;
+            }
         }
 
-        if ( http_code >= 200 && http_code < 300 )
-        {
-            return http_code;
-        }
+        return a_request.http_code;
+    }
+
+    Value result;
+
+    return dbResult( a_request, result );
+}
+
+template<typename H>
+long
+DatabaseAPI::dbGet( const char * a_url_path, const vector<pair<string,string>> &a_params, H & a_handler )
+{
+    DatabaseTransport::Request request;
+
+    dbRequest( request, a_url_path, a_params );
+
+    return dbResult( request, a_handler );
+}
+
+template<typename H>
+long
+DatabaseAPI::dbPost( const char * a_url_path, const vector<pair<string,string>> &a_params, const string * a_body, H & a_handler )
+{
+    DatabaseTransport::Request request;
+
+    request.post = true;
+    if ( a_body )
+        request.body = *a_body;
+
+    dbRequest( request, a_url_path, a_params );
+
+    return dbResult( request, a_handler );
+}
+
+
+/**
+ * Looks up a cached reply for the given tag (object ID) and key. On a miss,
+ * returns the generation value to be passed to cachePut. In async mode the
+ * generation of the first run is replayed on subsequent runs so that a write
+ * racing with the original DB call is still detected.
+ */
+bool
+DatabaseAPI::cacheGet( const std::string & a_tag, const std::string & a_key, google::protobuf::Message & a_reply, uint64_t & a_generation )
+{
+    PermCache & cache = PermCache::getInstance();
+
+    if ( !cache.enabled() )
+        return false;
+
+    string value;
+
+    if ( cache.get( a_tag, a_key, value ))
+    {
+        if ( a_reply.ParseFromString( value ))
+            return true;
+
+        a_reply.Clear();
+    }
+
+    a_generation = cache.generation( a_tag );
+
+    if ( m_async_ctx )
+    {
+        if ( m_async_ctx->next_value < m_async_ctx->values.size() )
+            a_generation = m_async_ctx->values[m_async_ctx->next_value];
         else
-        {
-            if ( res_json.size() && a_result.asObject().has( "errorMessage" ))
-            {
-                DL_DEBUG( "dbPost FAILED " << url << " [" << (a_body?*a_body:"") << "]" );
+            m_async_ctx->values.push_back( a_generation );
 
-                EXCEPT_PARAM( ID_BAD_REQUEST, a_result.asObject().asString());
-            }
-            else
-            {
-                EXCEPT_PARAM( ID_BAD_REQUEST, "SDMS DB service call failed. Code: " << http_code << ", err: " << error );
-            }
-        }
+        m_async_ctx->next_value++;
     }
-    else
+
+    return false;
+}
+
+void
+DatabaseAPI::cachePut( const std::string & a_tag, const std::string & a_key, uint64_t a_generation, const google::protobuf::Message & a_reply )
+{
+    PermCache & cache = PermCache::getInstance();
+
+    if ( !cache.enabled() )
+        return;
+
+    string value;
+
+    if ( a_reply.SerializeToString( &value ))
+        cache.put( a_tag, a_key, a_generation, value );
+}
+
+void
+DatabaseAPI::invalidateCache( const std::string & a_id )
+{
+    PermCache::getInstance().invalidate( a_id );
+}
+
+void
+DatabaseAPI::invalidateCache( const Auth::RecordDataReply & a_reply )
+{
+    for ( int i = 0; i < a_reply.data_size(); i++ )
+        invalidateCache( a_reply.data(i).id() );
+
+    for ( int i = 0; i < a_reply.update_size(); i++ )
+        invalidateCache( a_reply.update(i).id() );
+}
+
+void
+DatabaseAPI::invalidateCache( const Auth::CollDataReply & a_reply )
+{
+    for ( int i = 0; i < a_reply.coll_size(); i++ )
+        invalidateCache( a_reply.coll(i).id() );
+
+    for ( int i = 0; i < a_reply.update_size(); i++ )
+        invalidateCache( a_reply.update(i).id() );
+}
+
+void
+DatabaseAPI::invalidateCache( const Auth::NoteDataReply & a_reply )
+{
+    for ( int i = 0; i < a_reply.note_size(); i++ )
+        invalidateCache( a_reply.note(i).subject_id() );
+
+    for ( int i = 0; i < a_reply.update_size(); i++ )
+        invalidateCache( a_reply.update(i).id() );
+}
+
+/// Invalidate targets of the dependencies of new records (their dependency lists change)
+void
+DatabaseAPI::invalidateCacheDeps( const Auth::RecordDataReply & a_reply )
+{
+    for ( int i = 0; i < a_reply.data_size(); i++ )
     {
-        EXCEPT_PARAM( ID_SERVICE_ERROR, "SDMS DB interface failed. error: " << error << ", " << curl_easy_strerror( res ));
+        for ( int j = 0; j < a_reply.data(i).deps_size(); j++ )
+            invalidateCache( a_reply.data(i).deps(j).id() );
     }
 }
 
+void
+DatabaseAPI::invalidateCacheAll()
+{
+    PermCache::getInstance().invalidateAll();
+}
 
 void
 DatabaseAPI::serverPing()
@@ -771,6 +942,8 @@ DatabaseAPI::projUpdate( const Auth::ProjectUpdateRequest & a_request, Auth::Pro
 
     dbGet( "prj/update", params, result );
 
+    invalidateCacheAll();
+
     setProjectData( a_reply, result );
 }
 
@@ -786,7 +959,7 @@ DatabaseAPI::projView( const Auth::ProjectViewRequest & a_request, Auth::Project
 void
 DatabaseAPI::projList( const Auth::ProjectListRequest & a_request, Auth::ListingReply & a_reply )
 {
-    Value result;
+    ListingReplyReader reader( a_reply );
     vector<pair<string,string>> params;
     if ( a_request.has_subject() )
         params.push_back({"subject",a_request.subject()});
@@ -805,9 +978,7 @@ DatabaseAPI::projList( const Auth::ProjectListRequest & a_request, Auth::Listing
     if ( a_request.has_count())
         params.push_back({"count",to_string(a_request.count())});
 
-    dbGet( "prj/list", params, result );
-
-    setListingDataReply( a_reply, result );
+    dbGet( "prj/list", params, reader );
 }
 
 void
@@ -898,7 +1069,7 @@ DatabaseAPI::setProjectData( Auth::ProjectDataReply & a_reply, const Value & a_r
 void
 DatabaseAPI::recordListByAlloc( const Auth::RecordListByAllocRequest & a_request, Auth::ListingReply & a_reply )
 {
-    Value result;
+    ListingReplyReader reader( a_reply );
     vector<pair<string,string>> params;
     params.push_back({"repo",a_request.repo()});
     params.push_back({"subject",a_request.subject()});
@@ -907,26 +1078,36 @@ DatabaseAPI::recordListByAlloc( const Auth::RecordListByAllocRequest & a_request
     if ( a_request.has_count() )
         params.push_back({"count",to_string(a_request.count())});
 
-    dbGet( "/dat/list/by_alloc", params, result );
-
-    setListingDataReply( a_reply, result );
+    dbGet( "/dat/list/by_alloc", params, reader );
 }
 
 
 void
 DatabaseAPI::recordView( const Auth::RecordViewRequest & a_request, Auth::RecordDataReply & a_reply )
 {
-    Value result;
+    string      key;
+    uint64_t    gen = 0;
+    bool        cache = PermCache::isCacheableID( a_request.id() );
 
-    dbGet( "dat/view", {{"id",a_request.id()}}, result );
+    if ( cache )
+    {
+        key = m_client_uid + "|rv";
+        if ( cacheGet( a_request.id(), key, a_reply, gen ))
+            return;
+    }
 
-    setRecordData( a_reply, result );
+    RecordDataReplyReader reader( a_reply );
+
+    dbGet( "dat/view", {{"id",a_request.id()}}, reader );
+
+    if ( cache )
+        cachePut( a_request.id(), key, gen, a_reply );
 }
 
 void
 DatabaseAPI::recordCreate( const Auth::RecordCreateRequest & a_request, Auth::RecordDataReply & a_reply )
 {
-    Value result;
+    RecordDataReplyReader reader( a_reply );
 
     string body;
 
@@ -993,19 +1174,19 @@ DatabaseAPI::recordCreate( const Auth::RecordCreateRequest & a_request, Auth::Re
 
     DL_INFO("dat create: " << body );
 
-    dbPost( "dat/create", {}, &body, result );
+    dbPost( "dat/create", {}, &body, reader );
 
-    setRecordData( a_reply, result );
+    invalidateCacheDeps( a_reply );
 }
 
 void
 DatabaseAPI::recordCreateBatch( const Auth::RecordCreateBatchRequest & a_request, Auth::RecordDataReply & a_reply )
 {
-    Value result;
+    RecordDataReplyReader reader( a_reply );
 
-    dbPost( "dat/create/batch", {}, &a_request.records(), result );
+    dbPost( "dat/create/batch", {}, &a_request.records(), reader );
 
-    setRecordData( a_reply, result );
+    invalidateCacheDeps( a_reply );
 }
 
 void
@@ -1084,6 +1265,9 @@ DatabaseAPI::recordUpdate( const Auth::RecordUpdateRequest & a_request, Auth::Re
     dbPost( "dat/update", {}, &body, result );
 
     setRecordData( a_reply, result );
+
+    invalidateCache( a_request.id() );
+    invalidateCache( a_reply );
 }
 
 
@@ -1094,6 +1278,8 @@ DatabaseAPI::recordUpdateBatch( const Auth::RecordUpdateBatchRequest & a_request
     dbPost( "dat/update/batch", {}, &a_request.records(), result );
 
     setRecordData( a_reply, result );
+
+    invalidateCache( a_reply );
 }
 
 
@@ -1114,6 +1300,9 @@ DatabaseAPI::recordUpdateSize( const Auth::RepoDataSizeReply & a_size_rep )
     body += "]}";
 
     dbPost( "dat/update/size", {}, &body, result );
+
+    for ( int i = 0; i < a_size_rep.size_size(); i++ )
+        invalidateCache( a_size_rep.size(i).id() );
 }
 
 void
@@ -1122,6 +1311,31 @@ DatabaseAPI::recordUpdateSchemaError( const std::string & a_rec_id, const std::s
     libjson::Value result;
 
     dbPost( "dat/update/md_err_msg", {{"id", a_rec_id }}, &a_err_msg, result );
+
+    invalidateCache( a_rec_id );
+}
+
+/// Set schema validation errors of several records (ID, error message pairs) in one DB call
+void
+DatabaseAPI::recordUpdateSchemaErrorBatch( const std::vector<std::pair<std::string,std::string>> & a_errors )
+{
+    libjson::Value result;
+
+    string body = "{\"records\":[";
+
+    for ( size_t i = 0; i < a_errors.size(); i++ )
+    {
+        if ( i > 0 )
+            body += ",";
+        body += "{\"id\":\"" + a_errors[i].first + "\",\"md_err_msg\":\"" + escapeJSON( a_errors[i].second ) + "\"}";
+    }
+
+    body += "]}";
+
+    dbPost( "dat/update/md_err_msg/batch", {}, &body, result );
+
+    for ( size_t i = 0; i < a_errors.size(); i++ )
+        invalidateCache( a_errors[i].first );
 }
 
 void
@@ -1155,7 +1369,7 @@ DatabaseAPI::recordExport( const Auth::RecordExportRequest & a_request, Auth::Re
 void
 DatabaseAPI::recordLock( const Auth::RecordLockRequest & a_request, Auth::ListingReply & a_reply )
 {
-    Value result;
+    ListingReplyReader reader( a_reply );
     string ids;
 
     if ( a_request.id_size() > 0 )
@@ -1173,20 +1387,18 @@ DatabaseAPI::recordLock( const Auth::RecordLockRequest & a_request, Auth::Listin
     else
         ids = "[]";
 
-    dbGet( "dat/lock", {{"ids",ids},{"lock",a_request.lock()?"true":"false"}}, result );
+    dbGet( "dat/lock", {{"ids",ids},{"lock",a_request.lock()?"true":"false"}}, reader );
 
-    setListingDataReply( a_reply, result );
+    invalidateCacheAll();
 }
 
 
 void
 DatabaseAPI::recordGetDependencyGraph( const Auth::RecordGetDependencyGraphRequest & a_request, Auth::ListingReply & a_reply )
 {
-    Value result;
-
-    dbGet( "dat/dep/graph/get", {{"id",a_request.id()}}, result );
+    ListingReplyReader reader( a_reply );
 
-    setListingDataReply( a_reply, result );
+    dbGet( "dat/dep/graph/get", {{"id",a_request.id()}}, reader );
 }
 
 
@@ -1340,20 +1552,23 @@ DatabaseAPI::dataPath( const Auth::DataPathRequest & a_request, Auth::DataPathRe
 void
 DatabaseAPI::generalSearch( const Auth::SearchRequest & a_request, Auth::ListingReply & a_reply )
 {
-    Value result;
+    ListingReplyReader reader( a_reply );
     string qry_begin, qry_end, qry_filter, params;
 
     uint32_t cnt = parseSearchRequest( a_request, qry_begin, qry_end, qry_filter, params );
 
     string body = "{\"mode\":"+to_string(a_request.mode()) + ",\"published\":"+ ((a_request.has_published() && a_request.published())?"true":"false") +
         ",\"qry_begin\":\"" + qry_begin + "\",\"qry_end\":\"" + qry_end + "\",\"qry_filter\":\"" + qry_filter +
-        "\",\"params\":{"+params+"},\"limit\":"+ to_string(cnt)+"}";
+        "\",\"params\":{"+params+"},\"limit\":"+ to_string(cnt);
 
-    DL_DEBUG("Query: [" << body << "]");
+    if ( a_request.has_cont() )
+        body += ",\"cont\":\"" + escapeJSON( a_request.cont() ) + "\"";
 
-    dbPost( "qry/exec/direct", {}, &body, result );
+    body += "}";
+
+    DL_DEBUG("Query: [" << body << "]");
 
-    setListingDataReply( a_reply, result );
+    dbPost( "qry/exec/direct", {}, &body, reader );
 }
 
 
@@ -1361,7 +1576,7 @@ DatabaseAPI::generalSearch( const Auth::SearchRequest & a_request, Auth::Listing
 void
 DatabaseAPI::collListPublished( const Auth::CollListPublishedRequest & a_request, Auth::ListingReply & a_reply )
 {
-    Value result;
+    ListingReplyReader reader( a_reply );
     vector<pair<string,string>> params;
 
     if ( a_request.has_subject() )
@@ -1371,9 +1586,7 @@ DatabaseAPI::collListPublished( const Auth::CollListPublishedRequest & a_request
     if ( a_request.has_count() )
         params.push_back({"count",to_string(a_request.count())});
 
-    dbGet( "col/published/list", params, result );
-
-    setListingDataReply( a_reply, result );
+    dbGet( "col/published/list", params, reader );
 }
 
 void
@@ -1452,33 +1665,52 @@ DatabaseAPI::collUpdate( const Auth::CollUpdateRequest & a_request, Auth::CollDa
     dbPost( "col/update", {}, &body, result );
 
     setCollData( a_reply, result );
+
+    invalidateCache( a_request.id() );
+    invalidateCache( a_reply );
 }
 
 
 void
 DatabaseAPI::collView( const Auth::CollViewRequest & a_request, Auth::CollDataReply & a_reply )
 {
+    string      key;
+    uint64_t    gen = 0;
+    bool        cache = PermCache::isCacheableID( a_request.id() );
+
+    if ( cache )
+    {
+        key = m_client_uid + "|cv";
+        if ( cacheGet( a_request.id(), key, a_reply, gen ))
+            return;
+    }
+
     Value result;
 
     dbGet( "col/view", {{"id",a_request.id()}}, result );
 
     setCollData( a_reply, result );
+
+    if ( cache )
+        cachePut( a_request.id(), key, gen, a_reply );
 }
 
 void
 DatabaseAPI::collRead( const Auth::CollReadRequest & a_request, Auth::ListingReply & a_reply )
 {
-    Value result;
+    ListingReplyReader reader( a_reply );
     vector<pair<string,string>> params;
     params.push_back({"id",a_request.id()});
     if ( a_request.has_offset() )
         params.push_back({"offset",to_string(a_request.offset())});
     if ( a_request.has_count() )
         params.push_back({"count",to_string(a_request.count())});
+    if ( a_request.has_cont() )
+        params.push_back({"cont",a_request.cont()});
+    if ( a_request.has_total() )
+        params.push_back({"total",a_request.total()?"true":"false"});
 
-    dbGet( "col/read", params, result );
-
-    setListingDataReply( a_reply, result );
+    dbGet( "col/read", params, reader );
 }
 
 void
@@ -1517,11 +1749,11 @@ DatabaseAPI::collWrite( const Auth::CollWriteRequest & a_request, Auth::ListingR
         params.push_back({ "remove", rem_list });
     }
 
-    Value result;
+    ListingReplyReader reader( a_reply );
 
-    dbGet( "col/write", params, result );
+    dbGet( "col/write", params, reader );
 
-    setListingDataReply( a_reply, result );
+    invalidateCacheAll();
 }
 
 void
@@ -1545,6 +1777,8 @@ DatabaseAPI::collMove( const Auth::CollMoveRequest & a_request, Anon::AckReply &
 
     Value result;
     dbGet( "col/move", {{"source",a_request.src_id()},{"dest",a_request.dst_id()},{"items",items}}, result );
+
+    invalidateCacheAll();
 }
 
 void
@@ -1702,9 +1936,15 @@ DatabaseAPI::setListingDataReply( Auth::ListingReply & a_reply, const libjson::V
         {
             const Value::Object & obj2 = obj.asObject();
 
-            a_reply.set_offset( obj2.getNumber( "off" ));
-            a_reply.set_count( obj2.getNumber( "cnt" ));
-            a_reply.set_total( obj2.getNumber( "tot" ));
+            // Offset and total are absent for continuation paging (unless total requested)
+            if ( obj2.has( "off" ))
+                a_reply.set_offset( obj2.asNumber() );
+            if ( obj2.has( "cnt" ))
+                a_reply.set_count( obj2.asNumber() );
+            if ( obj2.has( "tot" ))
+                a_reply.set_total( obj2.asNumber() );
+            if ( obj2.has( "next" ))
+                a_reply.set_next( obj2.asString() );
         }
         else
         {
@@ -1783,16 +2023,14 @@ DatabaseAPI::setListingData( ListingData * a_item, const Value::Object & a_obj )
 void
 DatabaseAPI::queryList( const Auth::QueryListRequest & a_request, Auth::ListingReply & a_reply )
 {
-    Value result;
+    ListingReplyReader reader( a_reply );
     vector<pair<string,string>> params;
     if ( a_request.has_offset() )
         params.push_back({"offset",to_string(a_request.offset())});
     if ( a_request.has_count() )
         params.push_back({"count",to_string(a_request.count())});
 
-    dbGet( "qry/list", params, result );
-
-    setListingDataReply( a_reply, result );
+    dbGet( "qry/list", params, reader );
 }
 
 void
@@ -1905,7 +2143,7 @@ DatabaseAPI::queryView( const Auth::QueryViewRequest & a_request, Auth::QueryDat
 void
 DatabaseAPI::queryExec( const Auth::QueryExecRequest & a_request, Auth::ListingReply & a_reply )
 {
-    Value result;
+    ListingReplyReader reader( a_reply );
     vector<pair<string,string>> params;
 
     params.push_back({"id",a_request.id()});
@@ -1913,10 +2151,10 @@ DatabaseAPI::queryExec( const Auth::QueryExecRequest & a_request, Auth::ListingR
         params.push_back({"offset",to_string(a_request.offset())});
     if ( a_request.has_count() )
         params.push_back({"count",to_string(a_request.count())});
+    if ( a_request.has_cont() )
+        params.push_back({"cont",a_request.cont()});
 
-    dbGet( "/qry/exec", params, result );
-
-    setListingDataReply( a_reply, result );
+    dbGet( "/qry/exec", params, reader );
 }
 
 void
@@ -1964,13 +2202,15 @@ DatabaseAPI::aclUpdate( const Auth::ACLUpdateRequest & a_request, Auth::ACLDataR
 
     dbGet( "acl/update", params, result );
 
+    invalidateCacheAll();
+
     setACLData( a_reply, result );
 }
 
 void
 DatabaseAPI::aclSharedList( const Auth::ACLSharedListRequest & a_request,  Auth::ListingReply & a_reply )
 {
-    Value result;
+    ListingReplyReader reader( a_reply );
     vector<pair<string,string>> params;
 
     if ( a_request.has_inc_users() )
@@ -1978,22 +2218,18 @@ DatabaseAPI::aclSharedList( const Auth::ACLSharedListRequest & a_request,  Auth:
     if ( a_request.has_inc_projects() )
         params.push_back({"inc_projects",a_request.inc_projects()?"true":"false"});
 
-    dbGet( "acl/shared/list", params, result );
-
-    setListingDataReply( a_reply, result );
+    dbGet( "acl/shared/list", params, reader );
 }
 
 void
 DatabaseAPI::aclSharedListItems( const Auth::ACLSharedListItemsRequest & a_request,  Auth::ListingReply & a_reply )
 {
-    Value result;
+    ListingReplyReader reader( a_reply );
     vector<pair<string,string>> params;
 
     params.push_back({"owner",a_request.owner()});
 
-    dbGet( "acl/shared/list/items", params, result );
-
-    setListingDataReply( a_reply, result );
+    dbGet( "acl/shared/list/items", params, reader );
 }
 
 void
@@ -2051,6 +2287,8 @@ DatabaseAPI::groupCreate( const Auth::GroupCreateRequest & a_request, Auth::Grou
 
     dbGet( "grp/create", params, result );
 
+    invalidateCacheAll();
+
     setGroupData( a_reply, result );
 }
 
@@ -2094,6 +2332,8 @@ DatabaseAPI::groupUpdate( const Auth::GroupUpdateRequest & a_request, Auth::Grou
 
     dbGet( "grp/update", params, result );
 
+    invalidateCacheAll();
+
     setGroupData( a_reply, result );
 }
 
@@ -2109,6 +2349,8 @@ DatabaseAPI::groupDelete( const Auth::GroupDeleteRequest & a_request, Anon::AckR
         params.push_back({"proj", a_request.uid()});
 
     dbGet( "grp/delete", params, result );
+
+    invalidateCacheAll();
 }
 
 void
@@ -2291,6 +2533,8 @@ DatabaseAPI::repoUpdate( const Auth::RepoUpdateRequest & a_request, Auth::RepoDa
 
     dbPost( "repo/update", {}, &body, result );
 
+    invalidateCacheAll();
+
     setRepoData( &a_reply, 0, result );
 }
 
@@ -2301,6 +2545,8 @@ DatabaseAPI::repoDelete( const Auth::RepoDeleteRequest & a_request, Anon::AckRep
     Value result;
 
     dbGet( "repo/delete", {{"id",a_request.id()}}, result );
+
+    invalidateCacheAll();
 }
 
 void
@@ -2534,6 +2780,8 @@ DatabaseAPI::repoAllocationSet( const Auth::RepoAllocationSetRequest & a_request
     Value result;
 
     dbGet( "repo/alloc/set", {{"repo",a_request.repo()},{"subject",a_request.subject()},{"data_limit",to_string(a_request.data_limit())},{"rec_limit",to_string(a_request.rec_limit())}}, result );
+
+    invalidateCacheAll();
 }
 
 void
@@ -2549,11 +2797,24 @@ DatabaseAPI::repoAllocationSetDefault( const Auth::RepoAllocationSetDefaultReque
         params.push_back({"subject",a_request.subject()});
 
     dbGet( "repo/alloc/set/default", params, result );
+
+    invalidateCacheAll();
 }
 
 void
 DatabaseAPI::checkPerms( const CheckPermsRequest & a_request, CheckPermsReply & a_reply )
 {
+    string      key;
+    uint64_t    gen = 0;
+    bool        cache = PermCache::isCacheableID( a_request.id() );
+
+    if ( cache )
+    {
+        key = m_client_uid + "|chk|" + to_string( a_request.perms() );
+        if ( cacheGet( a_request.id(), key, a_reply, gen ))
+            return;
+    }
+
     Value result;
 
     dbGet( "authz/perm/check", {{ "id", a_request.id()},{ "perms", to_string( a_request.perms()) }}, result );
@@ -2563,11 +2824,25 @@ DatabaseAPI::checkPerms( const CheckPermsRequest & a_request, CheckPermsReply &
     a_reply.set_granted( result.asObject().getBool( "granted" ));
 
     TRANSLATE_END( result )
+
+    if ( cache )
+        cachePut( a_request.id(), key, gen, a_reply );
 }
 
 void
 DatabaseAPI::getPerms( const GetPermsRequest & a_request, GetPermsReply & a_reply )
 {
+    string      key;
+    uint64_t    gen = 0;
+    bool        cache = PermCache::isCacheableID( a_request.id() );
+
+    if ( cache )
+    {
+        key = m_client_uid + "|get|" + ( a_request.has_perms() ? to_string( a_request.perms()) : string( "*" ));
+        if ( cacheGet( a_request.id(), key, a_reply, gen ))
+            return;
+    }
+
     Value result;
     vector<pair<string,string>> params;
     params.push_back({ "id", a_request.id()});
@@ -2581,15 +2856,28 @@ DatabaseAPI::getPerms( const GetPermsRequest & a_request, GetPermsReply & a_repl
     a_reply.set_granted( result.asObject().getNumber( "granted" ));
 
     TRANSLATE_END( result )
+
+    if ( cache )
+        cachePut( a_request.id(), key, gen, a_reply );
 }
 
 void
 DatabaseAPI::repoAuthz( const Auth::RepoAuthzRequest & a_request, Anon::AckReply  & a_reply )
 {
-    (void)a_reply;
+    // Authz results are tagged by repo and are only invalidated by global (permission-affecting) changes
+    string      tag = "authz|" + a_request.repo();
+    string      key = m_client_uid + "|" + a_request.action() + "|" + a_request.file();
+    uint64_t    gen = 0;
+
+    if ( cacheGet( tag, key, a_reply, gen ))
+        return;
+
     Value result;
 
     dbGet( "authz/gridftp", {{"repo",a_request.repo()},{"file",a_request.file()},{"act",a_request.action()}}, result );
+
+    // Only granted access is cached (denial is reported via exception)
+    cachePut( tag, key, gen, a_reply );
 }
 
 void
@@ -2703,6 +2991,9 @@ DatabaseAPI::noteCreate( const NoteCreateRequest & a_request, Auth::NoteDataRepl
     dbPost( "note/create", params, 0, result );
 
     setNoteDataReply( a_reply, result );
+
+    invalidateCache( a_request.subject() );
+    invalidateCache( a_reply );
 }
 
 void
@@ -2724,6 +3015,8 @@ DatabaseAPI::noteUpdate( const NoteUpdateRequest & a_request, Auth::NoteDataRepl
     dbPost( "note/update", params, 0, result );
 
     setNoteDataReply( a_reply, result );
+
+    invalidateCache( a_reply );
 }
 
 void
@@ -2738,6 +3031,8 @@ DatabaseAPI::noteCommentEdit( const Auth::NoteCommentEditRequest & a_request, Au
     dbPost( "note/comment/edit", params, 0, result );
 
     setNoteDataReply( a_reply, result );
+
+    invalidateCache( a_reply );
 }
 
 void
@@ -2766,6 +3061,9 @@ DatabaseAPI::notePurge( uint32_t a_age_sec )
     Value result;
 
     dbGet( "note/purge", {{"age_sec",to_string( a_age_sec )}}, result );
+
+    // Purged notes may belong to any record
+    invalidateCacheAll();
 }
 
 void
@@ -3015,6 +3313,9 @@ DatabaseAPI::schemaRevise( const Auth::SchemaReviseRequest & a_request )
     body.append("}");
 
     dbPost( "schema/revise", {{ "id", a_request.id() }}, &body, result );
+
+    // Referencing schemas may also be affected
+    SchemaCache::getInstance().invalidateAll();
 }
 
 
@@ -3076,6 +3377,8 @@ DatabaseAPI::schemaUpdate( const Auth::SchemaUpdateRequest & a_request )
     //DL_INFO("sch upd " << body );
 
     dbPost( "schema/update", {{"id",a_request.id()}}, &body, result );
+
+    SchemaCache::getInstance().invalidateAll();
 }
 
 void
@@ -3085,6 +3388,8 @@ DatabaseAPI::schemaDelete( const Auth::SchemaDeleteRequest & a_request, Anon::Ac
     libjson::Value result;
 
     dbPost( "schema/delete", {{"id",a_request.id()}}, 0, result );
+
+    SchemaCache::getInstance().invalidateAll();
 }
 
 void
@@ -3205,10 +3510,33 @@ DatabaseAPI::dailyMessage( const Anon::DailyMessageRequest & a_request, Anon::Da
     TRANSLATE_END( result )
 }
 
+/**
+ * @brief Load a page of ready/running task IDs
+ *
+ * @param a_cursor - Cursor from previous page (empty for first page), updated for next page; empty when done
+ * @param a_count - Max number of tasks to return
+ * @param a_result - JSON array of task descriptors ({id,type,client})
+ */
 void
-DatabaseAPI::taskLoadReady( libjson::Value & a_result )
+DatabaseAPI::taskLoadReady( std::string & a_cursor, uint32_t a_count, libjson::Value & a_result )
 {
-    dbGet( "task/reload", {}, a_result );
+    libjson::Value reply;
+    vector<pair<string,string>> params;
+
+    params.push_back({ "count", to_string( a_count )});
+    if ( a_cursor.size() )
+        params.push_back({ "cursor", a_cursor });
+
+    dbGet( "task/reload", params, reply );
+
+    libjson::Value::Object & obj = reply.asObject();
+
+    a_result = obj.getValue( "task" );
+
+    if ( obj.has( "cursor" ))
+        a_cursor = obj.asString();
+    else
+        a_cursor.clear();
 }
 
 
@@ -3223,6 +3551,9 @@ DatabaseAPI::taskRun( const std::string & a_task_id, libjson::Value & a_task_rep
         params.push_back({ "step", to_string( *a_step )});
 
     dbGet( "task/run", params, a_task_reply );
+
+    // Task steps may change record ownership, location, size, or existence
+    invalidateCacheAll();
 }
 
 
@@ -3378,6 +3709,8 @@ DatabaseAPI::taskInitRecordCollectionDelete( const std::vector<std::string> & a_
 
     dbPost( "dat/delete", {}, &body, a_result );
 
+    invalidateCacheAll();
+
     setTaskDataReply( a_reply, a_result );
 }
 
@@ -3403,6 +3736,8 @@ DatabaseAPI::taskInitRecordAllocChange( const Auth::RecordAllocChangeRequest & a
 
     dbPost( "dat/alloc_chg", {}, &body, a_result );
 
+    invalidateCacheAll();
+
     TRANSLATE_BEGIN()
 
     const Value::Object & obj = a_result.asObject();
@@ -3445,6 +3780,8 @@ DatabaseAPI::taskInitRecordOwnerChange( const Auth::RecordOwnerChangeRequest & a
 
     dbPost( "dat/owner_chg", {}, &body, a_result );
 
+    invalidateCacheAll();
+
     TRANSLATE_BEGIN()
 
     const Value::Object & obj = a_result.asObject();
@@ -3484,6 +3821,8 @@ DatabaseAPI::taskInitProjectDelete( const Auth::ProjectDeleteRequest & a_request
 
     dbPost( "prj/delete", {}, &body, a_result );
 
+    invalidateCacheAll();
+
     setTaskDataReply( a_reply, a_result );
 }
 
@@ -3494,6 +3833,8 @@ DatabaseAPI::taskInitRepoAllocationCreate( const Auth::RepoAllocationCreateReque
     dbGet( "repo/alloc/create", {{"subject",a_request.subject()},{"repo",a_request.repo()},
         {"data_limit",to_string(a_request.data_limit())},{"rec_limit",to_string(a_request.rec_limit())}}, a_result );
 
+    invalidateCacheAll();
+
     setTaskDataReply( a_reply, a_result );
 }
 
@@ -3503,6 +3844,8 @@ DatabaseAPI::taskInitRepoAllocationDelete( const Auth::RepoAllocationDeleteReque
 {
     dbGet( "repo/alloc/delete", {{"subject",a_request.subject()},{"repo",a_request.repo()}}, a_result );
 
+    invalidateCacheAll();
+
     setTaskDataReply( a_reply, a_result );
 }
 
@@ -3813,80 +4156,148 @@ DatabaseAPI::metricsPurge( uint32_t a_timestamp )
     dbPost( "metrics/purge", {{ "timestamp", to_string(a_timestamp) }}, 0, result );
 }
 
+/**
+ * @brief Get the AQL fragments and bind parameters of a search request
+ *
+ * AQL fragments are taken from the search plan cache, or compiled and cached
+ * on a miss; bind parameters are always set from the request.
+ */
 uint32_t
 DatabaseAPI::parseSearchRequest( const Auth::SearchRequest & a_request, std::string & a_qry_begin, std::string & a_qry_end, std::string & a_qry_filter, std::string & a_params )
 {
+    SearchPlanCache &       cache = SearchPlanCache::getInstance();
+    SearchPlanCache::Plan   plan;
+    string                  key = searchPlanKey( a_request );
+
+    if ( !cache.find( key, plan ))
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        compileSearchPlan( a_request, plan );
+
+        cache.store( key, plan, CoreMetrics::usecSince( start ));
+    }
+
+    a_qry_begin = plan.qry_begin;
+    a_qry_end = plan.qry_end;
+    a_qry_filter = plan.qry_filter;
+
+    return setSearchParams( a_request, a_params );
+}
+
+
+/// Search results can be keyset paged unless sorted by relevance (text score)
+static inline bool
+searchKeyset( const Auth::SearchRequest & a_request )
+{
+    return !( a_request.has_sort() && a_request.sort() == SORT_RELEVANCE && a_request.has_text() );
+}
+
+/// Append a length-prefixed string to a search plan key (keeps free text from colliding with other fields)
+static inline void
+appendKeyString( std::string & a_key, const std::string & a_str )
+{
+    a_key += to_string( a_str.size() ) + ":" + a_str;
+}
+
+/**
+ * @brief Build the search plan cache key of a request
+ *
+ * Must cover every request field that compileSearchPlan uses.
+ */
+std::string
+DatabaseAPI::searchPlanKey( const Auth::SearchRequest & a_request )
+{
+    string key = to_string( a_request.mode() );
+
+    key += ( a_request.has_published() && a_request.published() ) ? 'P' : '-';
+    key += a_request.has_owner() ? 'O' : '-';
+    key += a_request.cat_tags_size() > 0 ? 'C' : '-';
+    key += a_request.tags_size() > 0 ? 'T' : '-';
+    key += a_request.has_creator() ? 'U' : '-';
+    key += a_request.has_from() ? 'F' : '-';
+    key += a_request.has_to() ? 'E' : '-';
+
+    if ( a_request.mode() == SM_DATA )
+    {
+        key += a_request.has_sch_id() ? 'S' : '-';
+        key += a_request.has_meta_err() ? 'R' : '-';
+    }
+
+    key += a_request.has_sort() ? to_string( a_request.sort() ) : "-";
+    key += ( a_request.has_sort_rev() && a_request.sort_rev() ) ? 'V' : '-';
+
+    key += '|';
+    if ( a_request.has_text() )
+        appendKeyString( key, a_request.text() );
+
+    key += '|';
+    if ( a_request.has_id() )
+        appendKeyString( key, a_request.id() );
+
+    key += '|';
+    if ( a_request.mode() == SM_DATA && a_request.has_meta() )
+        appendKeyString( key, a_request.meta() );
+
+    return key;
+}
+
+
+/// Compile the AQL fragments of a search request (values of bind parameters are not used)
+void
+DatabaseAPI::compileSearchPlan( const Auth::SearchRequest & a_request, SearchPlanCache::Plan & a_plan )
+{
+    string & qry_begin = a_plan.qry_begin;
+    string & qry_end = a_plan.qry_end;
+    string & qry_filter = a_plan.qry_filter;
     string view = (a_request.mode()==SM_DATA?"dataview":"collview");
 
     if ( a_request.has_published() && a_request.published() )
     {
-        a_qry_begin = string("for i in ") + view + " search i.public == true";
+        qry_begin = string("for i in ") + view + " search i.public == true";
         if ( a_request.has_owner() )
         {
-            a_qry_begin += " and i.owner == @owner";
-            a_params += ",\"owner\":\"" + a_request.owner() + "\"";
+            qry_begin += " and i.owner == @owner";
         }
     }
     else
     {
-        a_qry_begin = string("for i in ") + view + " search i.owner == @owner";
-        a_params += ",\"owner\":\"" + (a_request.has_owner()?a_request.owner():m_client_uid) + "\"";
+        qry_begin = string("for i in ") + view + " search i.owner == @owner";
     }
 
     if ( a_request.has_text() > 0 )
     {
-        a_qry_begin += " and analyzer(" + parseSearchTextPhrase( a_request.text(), "i" ) + ",'text_en')";
+        qry_begin += " and analyzer(" + parseSearchTextPhrase( a_request.text(), "i" ) + ",'text_en')";
     }
 
     if ( a_request.cat_tags_size() > 0 )
     {
-        a_qry_begin += " and @ctags all in i.cat_tags";
-
-        a_params += ",\"ctags\":[";
-        for ( int i = 0; i < a_request.cat_tags_size(); ++i )
-        {
-            if ( i > 0 )
-                a_params += ",";
-            a_params += "\"" + a_request.cat_tags(i) + "\"";
-        }
-        a_params += "]";
+        qry_begin += " and @ctags all in i.cat_tags";
     }
 
     if ( a_request.tags_size() > 0 )
     {
-        a_qry_begin += " and @tags all in i.tags";
-
-        a_params += ",\"tags\":[";
-        for ( int i = 0; i < a_request.tags_size(); ++i )
-        {
-            if ( i > 0 )
-                a_params += ",";
-            a_params += "\"" + a_request.tags(i) + "\"";
-        }
-        a_params += "]";
+        qry_begin += " and @tags all in i.tags";
     }
 
     if ( a_request.has_id() )
     {
-        a_qry_begin += " and " + parseSearchIdAlias( a_request.id(), "i" );
+        qry_begin += " and " + parseSearchIdAlias( a_request.id(), "i" );
     }
 
     if ( a_request.has_creator() )
     {
-        a_qry_begin += " and i.creator == @creator";
-        a_params += ",\"creator\":\"" + a_request.creator() + "\"";
+        qry_begin += " and i.creator == @creator";
     }
 
     if ( a_request.has_from() )
     {
-        a_qry_begin += " and i.ut >= @utfr";
-        a_params += ",\"utfr\":" + to_string( a_request.from() );
+        qry_begin += " and i.ut >= @utfr";
     }
 
     if ( a_request.has_to() )
     {
-        a_qry_begin += " and i.ut <= @utto";
-        a_params += ",\"utto\":" + to_string( a_request.to() );
+        qry_begin += " and i.ut <= @utto";
     }
 
     // Data-only search options
@@ -3894,77 +4305,134 @@ DatabaseAPI::parseSearchRequest( const Auth::SearchRequest & a_request, std::str
     {
         if ( a_request.has_sch_id() > 0 )
         {
-            a_qry_begin += " and i.sch_id == @sch";
-            a_params += ",\"sch_id\":\"" + a_request.sch_id() + "\"";
+            qry_begin += " and i.sch_id == @sch";
         }
 
         if ( a_request.has_meta_err() )
         {
-            a_qry_begin += " and i.md_err == true";
+            qry_begin += " and i.md_err == true";
         }
 
         if ( a_request.has_meta() )
         {
-            a_qry_filter = parseSearchMetadata( a_request.meta() );
+            qry_filter = parseSearchMetadata( a_request.meta() );
         }
     }
 
-    if ( a_request.coll_size() > 0 )
-    {
-        a_params += ",\"cols\":[";
-        for ( int i = 0; i < a_request.coll_size(); i++ ){
-            if ( i > 0 )
-                a_params += ",";
-            a_params += "\"" + a_request.coll(i) + "\"";
-        }
-        a_params += "]";
-    }
-
-    bool sort_relevance = false;
-
-    a_qry_end += " let name = (for j in u filter j._id == i.owner return concat(j.name_last,', ', j.name_first)) sort ";
+    string sort_key = "i.title";
+    bool sort_desc = a_request.has_sort_rev() && a_request.sort_rev();
 
     if ( a_request.has_sort() )
     {
         switch( a_request.sort() )
         {
             case SORT_OWNER:
-                a_qry_end += "i.name";
+                sort_key = "i.name";
                 break;
             case SORT_TIME_CREATE:
-                a_qry_end += "i.ct";
+                sort_key = "i.ct";
                 break;
             case SORT_TIME_UPDATE:
-                a_qry_end += "i.ut";
+                sort_key = "i.ut";
                 break;
             case SORT_RELEVANCE:
-                if ( a_request.has_text() )
-                {
-                    a_qry_end += "BM25(i) DESC";
-                    sort_relevance = true;
-                }
-                else
-                {
-                    a_qry_end += "i.title";
-                }
-                break;
             case SORT_TITLE:
             default:
-                a_qry_end += "i.title";
                 break;
         }
+    }
+
+    if ( searchKeyset( a_request ))
+    {
+        // Keyset paging: when continuing (@kc), skip past sort key (@ks) and ID (@ki) of last item of previous page
+        string dir = sort_desc ? " DESC" : "", cmp = sort_desc ? " < " : " > ";
+
+        qry_end += " filter !@kc or " + sort_key + cmp + "@ks or (" + sort_key + " == @ks and i._id" + cmp + "@ki)";
+        qry_end += " let name = (for j in u filter j._id == i.owner return concat(j.name_last,', ', j.name_first)) sort ";
+        qry_end += sort_key + dir + ", i._id" + dir;
+    }
+    else
+    {
+        qry_end += " let name = (for j in u filter j._id == i.owner return concat(j.name_last,', ', j.name_first)) sort BM25(i) DESC";
+    }
+
+    qry_end += " limit @off,@cnt";
+
+    qry_end += string(" return distinct {_id:i._id,title:i.title,'desc':i['desc'],owner:i.owner,owner_name:name,alias:i.alias")+(a_request.mode() == SM_DATA?",size:i.size,md_err:i.md_err":"");
+
+    // Sort key of keyset-paged results is returned for continuation tokens (removed by DB)
+    if ( searchKeyset( a_request ))
+        qry_end += ",sk:" + sort_key;
+
+    qry_end += "}";
 
-        if ( a_request.has_sort_rev() && a_request.sort_rev() && !sort_relevance )
+    qry_begin = escapeJSON( qry_begin );
+    qry_end = escapeJSON( qry_end );
+    qry_filter = escapeJSON( qry_filter );
+}
+
+
+/// Set the bind parameters (JSON object members) of a search request, returns result count limit
+uint32_t
+DatabaseAPI::setSearchParams( const Auth::SearchRequest & a_request, std::string & a_params )
+{
+    if ( a_request.has_published() && a_request.published() )
+    {
+        if ( a_request.has_owner() )
+            a_params += ",\"owner\":\"" + a_request.owner() + "\"";
+    }
+    else
+    {
+        a_params += ",\"owner\":\"" + (a_request.has_owner()?a_request.owner():m_client_uid) + "\"";
+    }
+
+    if ( a_request.cat_tags_size() > 0 )
+    {
+        a_params += ",\"ctags\":[";
+        for ( int i = 0; i < a_request.cat_tags_size(); ++i )
         {
-            a_qry_end += " DESC";
+            if ( i > 0 )
+                a_params += ",";
+            a_params += "\"" + a_request.cat_tags(i) + "\"";
         }
+        a_params += "]";
     }
-    else
+
+    if ( a_request.tags_size() > 0 )
     {
-        a_qry_end += " i.title";
+        a_params += ",\"tags\":[";
+        for ( int i = 0; i < a_request.tags_size(); ++i )
+        {
+            if ( i > 0 )
+                a_params += ",";
+            a_params += "\"" + a_request.tags(i) + "\"";
+        }
+        a_params += "]";
     }
 
-    a_qry_end += " limit @off,@cnt";
+    if ( a_request.has_creator() )
+        a_params += ",\"creator\":\"" + a_request.creator() + "\"";
+
+    if ( a_request.has_from() )
+        a_params += ",\"utfr\":" + to_string( a_request.from() );
+
+    if ( a_request.has_to() )
+        a_params += ",\"utto\":" + to_string( a_request.to() );
+
+    // Schema ID is translated to the "sch" parameter by the DB
+    if ( a_request.mode() == SM_DATA && a_request.has_sch_id() > 0 )
+        a_params += ",\"sch_id\":\"" + a_request.sch_id() + "\"";
+
+    if ( a_request.coll_size() > 0 )
+    {
+        a_params += ",\"cols\":[";
+        for ( int i = 0; i < a_request.coll_size(); i++ ){
+            if ( i > 0 )
+                a_params += ",";
+            a_params += "\"" + a_request.coll(i) + "\"";
+        }
+        a_params += "]";
+    }
 
     uint32_t cnt = a_request.has_count()?a_request.count():50,
              off = a_request.has_offset()?a_request.offset():0;
@@ -3972,15 +4440,13 @@ DatabaseAPI::parseSearchRequest( const Auth::SearchRequest & a_request, std::str
     a_params += ",\"off\":" + to_string( off );
     a_params += ",\"cnt\":" + to_string( cnt );
 
+    // Keyset parameters are set by the DB from the continuation token
+    if ( searchKeyset( a_request ))
+        a_params += ",\"kc\":false,\"ks\":null,\"ki\":null";
+
     // Get rid of leading delimiter
     a_params[0] = ' ';
 
-    a_qry_end += string(" return distinct {_id:i._id,title:i.title,'desc':i['desc'],owner:i.owner,owner_name:name,alias:i.alias")+(a_request.mode() == SM_DATA?",size:i.size,md_err:i.md_err":"")+"}";
-
-    a_qry_begin = escapeJSON( a_qry_begin );
-    a_qry_end = escapeJSON( a_qry_end );
-    a_qry_filter = escapeJSON( a_qry_filter );
-
     return cnt;
 }
 
@@ -4,11 +4,14 @@
 
 #include <string>
 #include <vector>
+#include <chrono>
 #include <curl/curl.h>
 #include "SDMS.pb.h"
 #include "SDMS_Anon.pb.h"
 #include "SDMS_Auth.pb.h"
 #include "libjson.hpp"
+#include "DatabaseTransport.hpp"
+#include "SearchPlanCache.hpp"
 
 namespace SDMS {
 namespace Core {
@@ -24,9 +27,54 @@ public:
         uint32_t    expiration;
     };
 
+    /**
+     * @brief Captured DB calls of an asynchronously executed request
+     *
+     * When an async context is set, the first DB call that has no stored
+     * result is submitted to the transport and a DeferredCall is thrown to
+     * unwind the caller. Once the call completes the caller is re-run from the
+     * start and prior calls are replayed from the stored results, in order.
+     * Only callers that are deterministic and have no side-effects outside of
+     * DB calls (i.e. pass-through DB methods) may be executed this way.
+     */
+    struct AsyncContext
+    {
+        AsyncContext() : next(0), next_value(0), db_usec(0) {}
+        ~AsyncContext();
+
+        /// Reset replay positions prior to re-running caller
+        void rewind()
+        {
+            next = 0;
+            next_value = 0;
+        }
+
+        std::vector<DatabaseTransport::Request*>    calls;          ///< Issued DB calls in call order
+        size_t                                      next;           ///< Replay position
+        std::vector<uint64_t>                       values;         ///< Values that must be stable across runs
+        size_t                                      next_value;     ///< Replay position of values
+        std::function<void()>                       on_complete;    ///< Called (from transport thread) when a call completes
+        uint64_t                                    db_usec;        ///< Total time of completed DB calls (microseconds)
+        std::chrono::steady_clock::time_point       deadline;       ///< Deadline of originating request (default = none)
+    };
+
+    /// Thrown when a DB call has been deferred for an AsyncContext
+    struct DeferredCall {};
+
     DatabaseAPI( const std::string & a_db_url, const std::string & a_db_user, const std::string & a_db_pass );
     ~DatabaseAPI();
 
+    void setAsyncContext( AsyncContext * a_ctx ) { m_async_ctx = a_ctx; }
+
+    /// Get total time (microseconds) of synchronous DB calls since last call, then reset
+    uint64_t takeDBTime() { uint64_t t = m_db_usec; m_db_usec = 0; return t; }
+
+    /// Set deadline of synchronous DB calls (default time_point = none); DB calls are limited to the remaining time
+    void setDeadline( std::chrono::steady_clock::time_point a_deadline ) { m_deadline = a_deadline; }
+
+    /// Get deadline of synchronous DB calls
+    std::chrono::steady_clock::time_point getDeadline() const { return m_deadline; }
+
     void serverPing();
 
     void setClient( const std::string & a_client );
@@ -70,6 +118,7 @@ public:
     //void recordUpdatePostPut( const std::string & a_data_id, size_t a_file_size, time_t a_mod_time, const std::string & a_src_path, const std::string * a_ext = 0 );
     void recordUpdateSize( const Auth::RepoDataSizeReply & a_sizes );
     void recordUpdateSchemaError( const std::string & a_rec_id, const std::string & a_err_msg );
+    void recordUpdateSchemaErrorBatch( const std::vector<std::pair<std::string,std::string>> & a_errors );
     void recordExport( const Auth::RecordExportRequest & a_request, Auth::RecordExportReply & a_reply );
     void recordLock( const Auth::RecordLockRequest & a_request, Auth::ListingReply & a_reply );
     //void recordSearch( const Auth::RecordSearchRequest & a_request, Auth::ListingReply & a_reply );
@@ -153,7 +202,7 @@ public:
     void noteListBySubject( const Auth::NoteListBySubjectRequest & a_request, Auth::NoteDataReply & a_reply );
     void notePurge( uint32_t a_age_sec );
 
-    void taskLoadReady( libjson::Value & a_result );
+    void taskLoadReady( std::string & a_cursor, uint32_t a_count, libjson::Value & a_result );
     void taskRun( const std::string & a_task_id, libjson::Value & a_task_reply, int * a_step = 0, std::string * a_err_msg = 0 );
     void taskAbort( const std::string & a_task_id, const std::string & a_msg, libjson::Value & a_task_reply );
 
@@ -192,6 +241,22 @@ private:
     long dbGet( const char * a_url_path, const std::vector<std::pair<std::string,std::string>> &a_params, libjson::Value & a_result, bool a_log = true );
     bool dbGetRaw( const char * a_url_path, const std::vector<std::pair<std::string,std::string>> &a_params, std::string & a_result );
     long dbPost( const char * a_url_path, const std::vector<std::pair<std::string,std::string>> &a_params, const std::string * a_body, libjson::Value & a_result );
+    void dbRequest( DatabaseTransport::Request & a_request, const char * a_url_path, const std::vector<std::pair<std::string,std::string>> &a_params );
+    long dbResult( DatabaseTransport::Request & a_request, libjson::Value & a_result );
+    template<typename H>
+    long dbGet( const char * a_url_path, const std::vector<std::pair<std::string,std::string>> &a_params, H & a_handler );
+    template<typename H>
+    long dbPost( const char * a_url_path, const std::vector<std::pair<std::string,std::string>> &a_params, const std::string * a_body, H & a_handler );
+    template<typename H>
+    long dbResult( DatabaseTransport::Request & a_request, H & a_handler );
+    bool cacheGet( const std::string & a_tag, const std::string & a_key, google::protobuf::Message & a_reply, uint64_t & a_generation );
+    void cachePut( const std::string & a_tag, const std::string & a_key, uint64_t a_generation, const google::protobuf::Message & a_reply );
+    void invalidateCache( const std::string & a_id );
+    void invalidateCache( const Auth::RecordDataReply & a_reply );
+    void invalidateCache( const Auth::CollDataReply & a_reply );
+    void invalidateCache( const Auth::NoteDataReply & a_reply );
+    void invalidateCacheDeps( const Auth::RecordDataReply & a_reply );
+    void invalidateCacheAll();
 
     void setAuthStatus( Anon::AuthStatusReply & a_reply, const libjson::Value & a_result );
     void setUserData( Auth::UserDataReply & a_reply, const libjson::Value & a_result );
@@ -226,15 +291,23 @@ private:
     //uint32_t parseCatalogSearchRequest( const Auth::CatalogSearchRequest & a_request, std::string & a_query, std::string & a_params, bool a_partial = false );
     //void parseRecordSearchPublishedRequest( const Auth::RecordSearchPublishedRequest & a_request, std::string & a_query, std::string & a_params );
     uint32_t    parseSearchRequest( const Auth::SearchRequest & a_request, std::string & a_qry_begin, std::string & a_qry_end, std::string & a_filter, std::string & a_params );
+    std::string searchPlanKey( const Auth::SearchRequest & a_request );
+    void        compileSearchPlan( const Auth::SearchRequest & a_request, SearchPlanCache::Plan & a_plan );
+    uint32_t    setSearchParams( const Auth::SearchRequest & a_request, std::string & a_params );
     std::string parseSearchTextPhrase( const std::string & a_phrase, const std::string & a_iter );
     std::string parseSearchTerms( const std::string & a_key, const std::vector<std::string> & a_terms, const std::string & a_iter );
     std::string parseSearchMetadata( const std::string & a_query, const std::string & a_iter = "i" );
     std::string parseSearchIdAlias( const std::string & a_query, const std::string & a_iter );
 
-    CURL *      m_curl;
-    char *      m_client;
-    std::string m_client_uid;
-    std::string m_db_url;
+    DatabaseTransport & m_transport;
+    AsyncContext *      m_async_ctx;
+    uint64_t            m_db_usec;
+    std::chrono::steady_clock::time_point m_deadline;
+    char *              m_client;
+    std::string         m_client_uid;
+    std::string         m_db_url;
+    std::string         m_db_user;
+    std::string         m_db_pass;
 };
 
 }}
@@ -0,0 +1,492 @@
+#ifndef DATABASEREPLYREADER_HPP
+#define DATABASEREPLYREADER_HPP
+
+#include <string>
+#include "libjson.hpp"
+#include "TraceException.hpp"
+#include "SDMS.pb.h"
+#include "SDMS_Auth.pb.h"
+
+namespace SDMS {
+namespace Core {
+
+#define REPLY_READER_MAX_DEPTH 8
+
+/**
+ * @brief SAX handler that translates DB replies directly into protobuf messages
+ *
+ * Used with libjson::Reader to fill ListingReply and RecordDataReply messages
+ * from the raw DB response without building a libjson::Value tree. The
+ * nesting of the reply is tracked as a stack of contexts; keys that are not
+ * translated are skipped without being decoded, and null values are treated
+ * as absent. Values of an unexpected type, or objects missing required
+ * fields, raise an exception (as the Value-based translators do).
+ *
+ * Use the ListingReplyReader and RecordDataReplyReader subclasses.
+ */
+class DatabaseReplyReader
+{
+public:
+    inline void startObject()
+    {
+        switch ( m_ctx[m_depth] )
+        {
+        case CTX_ROOT:
+            if ( m_record_reply )
+                return push( CTX_RECORD_REPLY );
+            break;
+        case CTX_LISTING:
+            // Item is created on first key as element may be paging info instead
+            m_item = 0;
+            return push( CTX_ITEM );
+        case CTX_ITEM:
+            if ( m_field == F_PAGING )
+                return push( CTX_PAGING );
+            break;
+        case CTX_UPDATES:
+            m_item = m_record_reply->add_update();
+            return push( CTX_ITEM );
+        case CTX_RECORDS:
+            m_record = m_record_reply->add_data();
+            return push( CTX_RECORD );
+        case CTX_DEPS:
+            m_dep = m_deps->Add();
+            return push( CTX_DEP );
+        default:
+            break;
+        }
+
+        invalidValue();
+    }
+
+    inline void endObject()
+    {
+        switch ( m_ctx[m_depth] )
+        {
+        case CTX_ITEM:
+            if ( m_item && !( m_item->has_id() && m_item->has_title() ))
+                EXCEPT( 1, "Listing missing required fields" );
+            break;
+        case CTX_RECORD:
+            if ( !( m_record->has_id() && m_record->has_title() ))
+                EXCEPT( 1, "Record missing required fields" );
+            break;
+        case CTX_DEP:
+            if ( !( m_dep->has_id() && m_dep->has_type() && m_dep->has_dir() ))
+                EXCEPT( 1, "Dependency missing required fields" );
+            break;
+        default:
+            break;
+        }
+
+        m_depth--;
+    }
+
+    inline void startArray()
+    {
+        switch ( m_ctx[m_depth] )
+        {
+        case CTX_ROOT:
+            if ( m_listing_reply )
+                return push( CTX_LISTING );
+            break;
+        case CTX_ITEM:
+            if ( m_field == F_DEPS )
+            {
+                m_item->set_deps_avail( true );
+                m_deps = m_item->mutable_dep();
+                return push( CTX_DEPS );
+            }
+            break;
+        case CTX_RECORD_REPLY:
+            if ( m_field == F_RESULTS )
+                return push( CTX_RECORDS );
+            else if ( m_field == F_UPDATES )
+                return push( CTX_UPDATES );
+            break;
+        case CTX_RECORD:
+            if ( m_field == F_TAGS )
+                return push( CTX_TAGS );
+            else if ( m_field == F_DEPS )
+            {
+                m_deps = m_record->mutable_deps();
+                return push( CTX_DEPS );
+            }
+            break;
+        default:
+            break;
+        }
+
+        invalidValue();
+    }
+
+    inline void endArray()
+    {
+        m_depth--;
+    }
+
+    /// Maps key to field of current context; returns true (skip value) for untranslated keys
+    inline bool key( const std::string & a_key )
+    {
+        switch ( m_ctx[m_depth] )
+        {
+        case CTX_ITEM:
+            if ( m_listing_reply && a_key == "paging" )
+            {
+                m_field = F_PAGING;
+                return false;
+            }
+
+            if ( !m_item )
+                m_item = m_listing_reply->add_item();
+
+            m_field = itemField( a_key );
+            break;
+        case CTX_RECORD:
+            m_field = recordField( a_key );
+            break;
+        case CTX_DEP:
+            m_field = depField( a_key );
+            break;
+        case CTX_PAGING:
+            m_field = pagingField( a_key );
+            break;
+        case CTX_RECORD_REPLY:
+            m_field = a_key == "results" ? F_RESULTS : ( a_key == "updates" ? F_UPDATES : F_NONE );
+            break;
+        default:
+            m_field = F_NONE;
+            break;
+        }
+
+        return m_field == F_NONE || m_field == F_MD;
+    }
+
+    inline void raw( const char * a_json, size_t a_len )
+    {
+        if ( m_field == F_MD && m_ctx[m_depth] == CTX_RECORD )
+            m_record->set_metadata( a_json, a_len );
+    }
+
+    inline void stringValue( const std::string & a_value )
+    {
+        switch ( m_ctx[m_depth] )
+        {
+        case CTX_ITEM:
+            switch ( m_field )
+            {
+            case F_ID:          m_item->set_id( a_value ); return;
+            case F_KEY:         if ( !m_item->has_id() ) m_item->set_id( a_value ); return;
+            case F_TITLE:       m_item->set_title( a_value ); return;
+            case F_ALIAS:       m_item->set_alias( a_value ); return;
+            case F_OWNER:       m_item->set_owner( a_value ); return;
+            case F_OWNER_NAME:  m_item->set_owner_name( a_value ); return;
+            case F_CREATOR:     m_item->set_creator( a_value ); return;
+            case F_DESC:        m_item->set_desc( a_value ); return;
+            default: break;
+            }
+            break;
+        case CTX_RECORD:
+            switch ( m_field )
+            {
+            case F_ID:          m_record->set_id( a_value ); return;
+            case F_TITLE:       m_record->set_title( a_value ); return;
+            case F_ALIAS:       m_record->set_alias( a_value ); return;
+            case F_OWNER:       m_record->set_owner( a_value ); return;
+            case F_CREATOR:     m_record->set_creator( a_value ); return;
+            case F_DESC:        m_record->set_desc( a_value ); return;
+            case F_MD_ERR_MSG:  m_record->set_md_err_msg( a_value ); return;
+            case F_SCH_ID:      m_record->set_sch_id( a_value ); return;
+            case F_REPO_ID:     m_record->set_repo_id( a_value ); return;
+            case F_SOURCE:      m_record->set_source( a_value ); return;
+            case F_EXT:         m_record->set_ext( a_value ); return;
+            case F_PARENT_ID:   m_record->set_parent_id( a_value ); return;
+            default: break;
+            }
+            break;
+        case CTX_TAGS:
+            m_record->add_tags( a_value );
+            return;
+        case CTX_PAGING:
+            if ( m_field == F_NEXT )
+            {
+                m_listing_reply->set_next( a_value );
+                return;
+            }
+            break;
+        case CTX_DEP:
+            switch ( m_field )
+            {
+            case F_ID:          m_dep->set_id( a_value ); return;
+            case F_ALIAS:       m_dep->set_alias( a_value ); return;
+            default: break;
+            }
+            break;
+        default:
+            break;
+        }
+
+        invalidValue();
+    }
+
+    inline void numberValue( double a_value )
+    {
+        switch ( m_ctx[m_depth] )
+        {
+        case CTX_ITEM:
+            switch ( m_field )
+            {
+            case F_SIZE:        m_item->set_size( a_value ); return;
+            case F_NOTES:       m_item->set_notes( a_value ); return;
+            case F_GEN:         m_item->set_gen( a_value ); return;
+            default: break;
+            }
+            break;
+        case CTX_RECORD:
+            switch ( m_field )
+            {
+            case F_SIZE:        m_record->set_size( a_value ); return;
+            case F_CT:          m_record->set_ct( a_value ); return;
+            case F_UT:          m_record->set_ut( a_value ); return;
+            case F_DT:          m_record->set_dt( a_value ); return;
+            case F_NOTES:       m_record->set_notes( a_value ); return;
+            default: break;
+            }
+            break;
+        case CTX_DEP:
+            switch ( m_field )
+            {
+            case F_TYPE:        m_dep->set_type((DependencyType)(unsigned short) a_value ); return;
+            case F_DIR:         m_dep->set_dir((DependencyDir)(unsigned short) a_value ); return;
+            case F_NOTES:       m_dep->set_notes( a_value ); return;
+            default: break;
+            }
+            break;
+        case CTX_PAGING:
+            switch ( m_field )
+            {
+            case F_OFF:         m_listing_reply->set_offset( a_value ); return;
+            case F_CNT:         m_listing_reply->set_count( a_value ); return;
+            case F_TOT:         m_listing_reply->set_total( a_value ); return;
+            default: break;
+            }
+            break;
+        default:
+            break;
+        }
+
+        invalidValue();
+    }
+
+    inline void boolValue( bool a_value )
+    {
+        switch ( m_ctx[m_depth] )
+        {
+        case CTX_ITEM:
+            switch ( m_field )
+            {
+            case F_EXTERNAL:    m_item->set_external( a_value ); return;
+            case F_LOCKED:      m_item->set_locked( a_value ); return;
+            default: break;
+            }
+            break;
+        case CTX_RECORD:
+            switch ( m_field )
+            {
+            case F_EXTERNAL:    m_record->set_external( a_value ); return;
+            case F_EXT_AUTO:    m_record->set_ext_auto( a_value ); return;
+            case F_LOCKED:      m_record->set_locked( a_value ); return;
+            default: break;
+            }
+            break;
+        default:
+            break;
+        }
+
+        invalidValue();
+    }
+
+    inline void nullValue()
+    {
+    }
+
+protected:
+    DatabaseReplyReader( Auth::ListingReply * a_listing_reply, Auth::RecordDataReply * a_record_reply ) :
+        m_listing_reply( a_listing_reply ), m_record_reply( a_record_reply ), m_depth( 0 ), m_field( F_NONE ),
+        m_item( 0 ), m_record( 0 ), m_dep( 0 ), m_deps( 0 )
+    {
+        m_ctx[0] = CTX_ROOT;
+    }
+
+private:
+    enum Context : uint8_t
+    {
+        CTX_ROOT,
+        CTX_LISTING,        ///< Top-level array of ListingReply
+        CTX_ITEM,           ///< ListingData object (or paging object in ListingReply)
+        CTX_PAGING,
+        CTX_DEPS,
+        CTX_DEP,
+        CTX_RECORD_REPLY,   ///< Top-level object of RecordDataReply
+        CTX_RECORDS,
+        CTX_RECORD,
+        CTX_TAGS,
+        CTX_UPDATES
+    };
+
+    enum Field : uint8_t
+    {
+        F_NONE,
+        F_ID,
+        F_KEY,
+        F_TITLE,
+        F_ALIAS,
+        F_OWNER,
+        F_OWNER_NAME,
+        F_CREATOR,
+        F_DESC,
+        F_SIZE,
+        F_EXTERNAL,
+        F_NOTES,
+        F_LOCKED,
+        F_GEN,
+        F_DEPS,
+        F_PAGING,
+        F_OFF,
+        F_CNT,
+        F_TOT,
+        F_NEXT,
+        F_TYPE,
+        F_DIR,
+        F_TAGS,
+        F_MD,
+        F_MD_ERR_MSG,
+        F_SCH_ID,
+        F_REPO_ID,
+        F_SOURCE,
+        F_EXT,
+        F_EXT_AUTO,
+        F_CT,
+        F_UT,
+        F_DT,
+        F_PARENT_ID,
+        F_RESULTS,
+        F_UPDATES
+    };
+
+    inline void push( Context a_ctx )
+    {
+        if ( ++m_depth == REPLY_READER_MAX_DEPTH )
+            EXCEPT( 1, "DB reply nesting too deep" );
+
+        m_ctx[m_depth] = a_ctx;
+        m_field = F_NONE;
+    }
+
+    inline void invalidValue()
+    {
+        EXCEPT_PARAM( 1, "Unexpected value type in DB reply (context " << (int)m_ctx[m_depth] << ", field " << (int)m_field << ")" );
+    }
+
+    static Field itemField( const std::string & a_key )
+    {
+        if ( a_key == "id" )            return F_ID;
+        if ( a_key == "title" )         return F_TITLE;
+        if ( a_key == "alias" )         return F_ALIAS;
+        if ( a_key == "owner" )         return F_OWNER;
+        if ( a_key == "creator" )       return F_CREATOR;
+        if ( a_key == "size" )          return F_SIZE;
+        if ( a_key == "notes" )         return F_NOTES;
+        if ( a_key == "locked" )        return F_LOCKED;
+        if ( a_key == "external" )      return F_EXTERNAL;
+        if ( a_key == "desc" )          return F_DESC;
+        if ( a_key == "owner_name" )    return F_OWNER_NAME;
+        if ( a_key == "_id" )           return F_KEY;
+        if ( a_key == "gen" )           return F_GEN;
+        if ( a_key == "deps" )          return F_DEPS;
+
+        return F_NONE;
+    }
+
+    static Field recordField( const std::string & a_key )
+    {
+        if ( a_key == "id" )            return F_ID;
+        if ( a_key == "title" )         return F_TITLE;
+        if ( a_key == "alias" )         return F_ALIAS;
+        if ( a_key == "owner" )         return F_OWNER;
+        if ( a_key == "creator" )       return F_CREATOR;
+        if ( a_key == "desc" )          return F_DESC;
+        if ( a_key == "tags" )          return F_TAGS;
+        if ( a_key == "md" )            return F_MD;
+        if ( a_key == "md_err_msg" )    return F_MD_ERR_MSG;
+        if ( a_key == "sch_id" )        return F_SCH_ID;
+        if ( a_key == "external" )      return F_EXTERNAL;
+        if ( a_key == "repo_id" )       return F_REPO_ID;
+        if ( a_key == "size" )          return F_SIZE;
+        if ( a_key == "source" )        return F_SOURCE;
+        if ( a_key == "ext" )           return F_EXT;
+        if ( a_key == "ext_auto" )      return F_EXT_AUTO;
+        if ( a_key == "ct" )            return F_CT;
+        if ( a_key == "ut" )            return F_UT;
+        if ( a_key == "dt" )            return F_DT;
+        if ( a_key == "locked" )        return F_LOCKED;
+        if ( a_key == "parent_id" )     return F_PARENT_ID;
+        if ( a_key == "notes" )         return F_NOTES;
+        if ( a_key == "deps" )          return F_DEPS;
+
+        return F_NONE;
+    }
+
+    static Field depField( const std::string & a_key )
+    {
+        if ( a_key == "id" )            return F_ID;
+        if ( a_key == "type" )          return F_TYPE;
+        if ( a_key == "dir" )           return F_DIR;
+        if ( a_key == "alias" )         return F_ALIAS;
+        if ( a_key == "notes" )         return F_NOTES;
+
+        return F_NONE;
+    }
+
+    static Field pagingField( const std::string & a_key )
+    {
+        if ( a_key == "off" )           return F_OFF;
+        if ( a_key == "cnt" )           return F_CNT;
+        if ( a_key == "tot" )           return F_TOT;
+        if ( a_key == "next" )          return F_NEXT;
+
+        return F_NONE;
+    }
+
+    Auth::ListingReply *        m_listing_reply;
+    Auth::RecordDataReply *     m_record_reply;
+    Context                     m_ctx[REPLY_READER_MAX_DEPTH];
+    size_t                      m_depth;
+    Field                       m_field;
+    ListingData *               m_item;
+    RecordData *                m_record;
+    DependencyData *            m_dep;
+    google::protobuf::RepeatedPtrField<DependencyData> * m_deps;
+};
+
+/// Translates a DB listing reply (array of listing objects and optional paging object)
+class ListingReplyReader : public DatabaseReplyReader
+{
+public:
+    ListingReplyReader( Auth::ListingReply & a_reply ) :
+        DatabaseReplyReader( &a_reply, 0 )
+    {}
+};
+
+/// Translates a DB record reply (object with "results" records and "updates" listings)
+class RecordDataReplyReader : public DatabaseReplyReader
+{
+public:
+    RecordDataReplyReader( Auth::RecordDataReply & a_reply ) :
+        DatabaseReplyReader( 0, &a_reply )
+    {}
+};
+
+}}
+
+#endif
@@ -0,0 +1,317 @@
+#include <condition_variable>
+#include <algorithm>
+#include <string.h>
+#include "Util.hpp"
+#include "DynaLog.hpp"
+#include "TraceException.hpp"
+#include "DatabaseTransport.hpp"
+#include "SDMS.pb.h"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+#define IO_POLL_TIMEOUT 1000
+
+DatabaseTransport::DatabaseTransport() :
+    m_config(Config::getInstance()),
+    m_multi(0),
+    m_io_thread(0),
+    m_coalesced(0)
+{
+    m_multi = curl_multi_init();
+    if ( !m_multi )
+        EXCEPT( ID_INTERNAL_ERROR, "libcurl multi init failed" );
+
+    // Bound connection pool to DB service; excess requests are queued by libcurl
+    curl_multi_setopt( m_multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)m_config.db_max_conn );
+    curl_multi_setopt( m_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)m_config.db_max_conn );
+    curl_multi_setopt( m_multi, CURLMOPT_MAXCONNECTS, (long)m_config.db_max_conn );
+    curl_multi_setopt( m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+
+    DL_DEBUG( "DB transport max connections: " << m_config.db_max_conn << ", timeout: " << m_config.db_timeout << " ms" );
+
+    m_io_thread = new thread( &DatabaseTransport::ioThread, this );
+}
+
+DatabaseTransport::~DatabaseTransport()
+{
+}
+
+DatabaseTransport &
+DatabaseTransport::getInstance()
+{
+    static DatabaseTransport * transport = new DatabaseTransport();
+
+    return *transport;
+}
+
+/**
+ * @brief Perform a DB request and wait for it to complete
+ *
+ * The calling thread blocks until the request finishes or fails. Result
+ * status, HTTP code, and response body are returned in the request.
+ */
+void
+DatabaseTransport::perform( Request & a_request )
+{
+    mutex               done_mutex;
+    condition_variable  done_cvar;
+    bool                done = false;
+
+    a_request.on_complete = [&]( Request & )
+    {
+        lock_guard<mutex> lock( done_mutex );
+        done = true;
+        done_cvar.notify_one();
+    };
+
+    submit( a_request );
+
+    unique_lock<mutex> lock( done_mutex );
+    while ( !done )
+        done_cvar.wait( lock );
+}
+
+/**
+ * @brief Queue a DB request for asynchronous completion
+ *
+ * The request must remain valid until its on_complete callback has been
+ * invoked (from the transport I/O thread).
+ */
+void
+DatabaseTransport::submit( Request & a_request )
+{
+    {
+        lock_guard<mutex> lock( m_mutex );
+
+        if ( a_request.coalesce_key.size() )
+        {
+            chrono::steady_clock::time_point deadline = deadlineOf( a_request );
+            unordered_map<string,Flight>::iterator f = m_flights.find( a_request.coalesce_key );
+
+            if ( f == m_flights.end() )
+            {
+                Flight & flight = m_flights[a_request.coalesce_key];
+                flight.leader = &a_request;
+                flight.deadline = deadline;
+            }
+            else if ( deadline <= f->second.deadline )
+            {
+                // Completed with leader's result
+                f->second.waiters.push_back( &a_request );
+                m_coalesced.fetch_add( 1, memory_order_relaxed );
+                return;
+            }
+            // Else in-flight call may time out first; perform independently
+        }
+
+        m_pending.push_back( &a_request );
+    }
+
+    curl_multi_wakeup( m_multi );
+}
+
+void
+DatabaseTransport::ioThread()
+{
+    deque<Request*>     starting;
+    CURLMsg *           msg;
+    int                 running, queued;
+
+    while ( 1 )
+    {
+        {
+            lock_guard<mutex> lock( m_mutex );
+            starting.swap( m_pending );
+        }
+
+        for ( deque<Request*>::iterator r = starting.begin(); r != starting.end(); r++ )
+            startRequest( **r );
+
+        starting.clear();
+
+        curl_multi_perform( m_multi, &running );
+
+        while (( msg = curl_multi_info_read( m_multi, &queued )))
+        {
+            if ( msg->msg == CURLMSG_DONE )
+                finishRequest( msg->easy_handle, msg->data.result );
+        }
+
+        curl_multi_poll( m_multi, 0, 0, IO_POLL_TIMEOUT, 0 );
+    }
+}
+
+void
+DatabaseTransport::startRequest( Request & a_request )
+{
+    CURL * handle = acquireHandle();
+
+    if ( !handle )
+    {
+        DL_ERROR( "DB transport libcurl init failed" );
+        a_request.result = CURLE_FAILED_INIT;
+        completeRequest( a_request );
+        return;
+    }
+
+    a_request.response.clear();
+    a_request.error[0] = 0;
+    a_request.http_code = 0;
+
+    curl_easy_setopt( handle, CURLOPT_URL, a_request.url.c_str() );
+    curl_easy_setopt( handle, CURLOPT_USERNAME, a_request.user );
+    curl_easy_setopt( handle, CURLOPT_PASSWORD, a_request.pass );
+    curl_easy_setopt( handle, CURLOPT_WRITEDATA, &a_request.response );
+    curl_easy_setopt( handle, CURLOPT_ERRORBUFFER, a_request.error );
+    curl_easy_setopt( handle, CURLOPT_TIMEOUT_MS, (long)timeoutOf( a_request ));
+    curl_easy_setopt( handle, CURLOPT_PRIVATE, &a_request );
+
+    if ( a_request.post )
+    {
+        curl_easy_setopt( handle, CURLOPT_POST, 1 );
+        curl_easy_setopt( handle, CURLOPT_POSTFIELDSIZE, (long)a_request.body.size() );
+        curl_easy_setopt( handle, CURLOPT_POSTFIELDS, a_request.body.c_str() );
+    }
+    else
+    {
+        curl_easy_setopt( handle, CURLOPT_HTTPGET, 1 );
+    }
+
+    CURLMcode res = curl_multi_add_handle( m_multi, handle );
+    if ( res != CURLM_OK )
+    {
+        DL_ERROR( "DB transport failed to add request: " << curl_multi_strerror( res ));
+        releaseHandle( handle );
+        a_request.result = CURLE_FAILED_INIT;
+        completeRequest( a_request );
+    }
+}
+
+void
+DatabaseTransport::finishRequest( CURL * a_handle, CURLcode a_result )
+{
+    Request * request = 0;
+
+    curl_easy_getinfo( a_handle, CURLINFO_PRIVATE, (char**)&request );
+    curl_easy_getinfo( a_handle, CURLINFO_RESPONSE_CODE, &request->http_code );
+    request->result = a_result;
+
+    curl_multi_remove_handle( m_multi, a_handle );
+    releaseHandle( a_handle );
+
+    completeRequest( *request );
+}
+
+/**
+ * @brief Invoke completion handlers of a request and of any coalesced waiters
+ *
+ * Results are copied to waiters before any handler runs, as a synchronous
+ * request may be released as soon as its handler returns.
+ */
+void
+DatabaseTransport::completeRequest( Request & a_request )
+{
+    vector<Request*> waiters;
+
+    if ( a_request.coalesce_key.size() )
+    {
+        lock_guard<mutex> lock( m_mutex );
+        unordered_map<string,Flight>::iterator f = m_flights.find( a_request.coalesce_key );
+
+        if ( f != m_flights.end() && f->second.leader == &a_request )
+        {
+            waiters.swap( f->second.waiters );
+            m_flights.erase( f );
+        }
+    }
+
+    for ( vector<Request*>::iterator w = waiters.begin(); w != waiters.end(); w++ )
+    {
+        (*w)->result = a_request.result;
+        (*w)->http_code = a_request.http_code;
+        (*w)->response = a_request.response;
+        memcpy( (*w)->error, a_request.error, CURL_ERROR_SIZE );
+    }
+
+    waiters.insert( waiters.begin(), &a_request );
+
+    for ( vector<Request*>::iterator r = waiters.begin(); r != waiters.end(); r++ )
+    {
+        try
+        {
+            (*r)->on_complete( **r );
+        }
+        catch( exception & e )
+        {
+            DL_ERROR( "DB transport completion handler failed: " << e.what() );
+        }
+    }
+}
+
+/// Effective timeout (msec) of a request, 0 if none
+uint32_t
+DatabaseTransport::timeoutOf( const Request & a_request ) const
+{
+    if ( !m_config.db_timeout )
+        return a_request.timeout_ms;
+
+    return a_request.timeout_ms ? min( a_request.timeout_ms, m_config.db_timeout ) : m_config.db_timeout;
+}
+
+/// Absolute deadline of a request submitted now, max if it has no timeout
+chrono::steady_clock::time_point
+DatabaseTransport::deadlineOf( const Request & a_request ) const
+{
+    uint32_t timeout = timeoutOf( a_request );
+
+    if ( !timeout )
+        return chrono::steady_clock::time_point::max();
+
+    return chrono::steady_clock::now() + chrono::milliseconds( timeout );
+}
+
+CURL *
+DatabaseTransport::acquireHandle()
+{
+    CURL * handle;
+
+    if ( m_handle_pool.size() )
+    {
+        handle = m_handle_pool.back();
+        m_handle_pool.pop_back();
+        return handle;
+    }
+
+    handle = curl_easy_init();
+    if ( !handle )
+        return 0;
+
+    // HTTP/2 lets requests share multiplexed connections. Over TLS it is negotiated via ALPN
+    // (falling back to HTTP/1.1); plain http requires prior knowledge (h2c), which has no
+    // fallback, so it is only used if enabled with config.db_h2c
+    if ( m_config.db_h2c && m_config.db_url.compare( 0, 7, "http://" ) == 0 )
+        curl_easy_setopt( handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE );
+    else
+        curl_easy_setopt( handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS );
+    curl_easy_setopt( handle, CURLOPT_PIPEWAIT, 1L );
+    curl_easy_setopt( handle, CURLOPT_WRITEFUNCTION, curlResponseWriteCB );
+    curl_easy_setopt( handle, CURLOPT_SSL_VERIFYPEER, 0 );
+    curl_easy_setopt( handle, CURLOPT_TCP_NODELAY, 1 );
+    curl_easy_setopt( handle, CURLOPT_TCP_KEEPALIVE, 1L );
+    curl_easy_setopt( handle, CURLOPT_TCP_KEEPIDLE, 60L );
+    curl_easy_setopt( handle, CURLOPT_TCP_KEEPINTVL, 30L );
+    curl_easy_setopt( handle, CURLOPT_NOSIGNAL, 1L );
+
+    return handle;
+}
+
+void
+DatabaseTransport::releaseHandle( CURL * a_handle )
+{
+    m_handle_pool.push_back( a_handle );
+}
+
+}}
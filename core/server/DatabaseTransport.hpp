@@ -0,0 +1,108 @@
+#ifndef DATABASETRANSPORT_HPP
+#define DATABASETRANSPORT_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include <curl/curl.h>
+#include "Config.hpp"
+
+namespace SDMS {
+namespace Core {
+
+/**
+ * @brief Shared HTTP transport used by all DatabaseAPI instances
+ *
+ * Owns a single libcurl multi handle that is driven by a dedicated I/O
+ * thread. Connections to the DB service are held in the multi handle's
+ * connection cache and are shared by every request, so client workers, task
+ * workers, and server maintenance threads no longer each pay for their own
+ * TCP (and TLS) connection. HTTP/2 multiplexing is used when the DB server
+ * negotiates it over TLS, otherwise requests fall back to keep-alive HTTP/1.1
+ * connections. For http:// DB urls, HTTP/2 is used with prior knowledge
+ * (h2c) if config.db_h2c is enabled (the DB server must support it);
+ * otherwise requests use HTTP/1.1. The number of connections is bounded by
+ * config.db_max_conn; requests beyond that limit queue inside libcurl until
+ * a connection frees.
+ *
+ * Requests may be performed synchronously (perform) or submitted for
+ * asynchronous completion (submit), in which case the request's callback is
+ * invoked on the transport I/O thread and must not block.
+ *
+ * Read requests with a coalesce key are single-flight: while a request with
+ * the same key is in progress, later requests wait for it and receive a copy
+ * of its result rather than issuing their own DB call. A request only joins
+ * an in-flight call whose deadline is not earlier than its own.
+ */
+class DatabaseTransport
+{
+public:
+    struct Request
+    {
+        Request() :
+            post( false ), timeout_ms( 0 ), user( 0 ), pass( 0 ), result( CURLE_OK ), http_code( 0 )
+        {
+            error[0] = 0;
+        }
+
+        std::string                     url;
+        bool                            post;
+        std::string                     body;
+        uint32_t                        timeout_ms;     // 0 = use config.db_timeout (otherwise lesser of the two, 0 = none)
+        std::string                     coalesce_key;   // Non-empty = share result with identical in-flight request
+        const char *                    user;
+        const char *                    pass;
+        std::string                     response;
+        CURLcode                        result;
+        long                            http_code;
+        char                            error[CURL_ERROR_SIZE];
+        std::function<void(Request&)>   on_complete;
+    };
+
+    static DatabaseTransport & getInstance();
+
+    void        perform( Request & a_request );
+    void        submit( Request & a_request );
+
+    /// Number of requests served by joining an identical in-flight request
+    inline uint64_t coalesced() const { return m_coalesced.load( std::memory_order_relaxed ); }
+
+private:
+    struct Flight
+    {
+        Request *               leader;
+        std::chrono::steady_clock::time_point deadline; ///< Max if leader has no timeout
+        std::vector<Request*>   waiters;
+    };
+
+    DatabaseTransport();
+    ~DatabaseTransport();
+
+    void        ioThread();
+    void        startRequest( Request & a_request );
+    void        finishRequest( CURL * a_handle, CURLcode a_result );
+    void        completeRequest( Request & a_request );
+    uint32_t    timeoutOf( const Request & a_request ) const;
+    std::chrono::steady_clock::time_point deadlineOf( const Request & a_request ) const;
+    CURL *      acquireHandle();
+    void        releaseHandle( CURL * a_handle );
+
+    Config &                m_config;
+    CURLM *                 m_multi;
+    std::thread *           m_io_thread;
+    std::mutex              m_mutex;
+    std::deque<Request*>    m_pending;
+    std::vector<CURL*>      m_handle_pool;
+    std::unordered_map<std::string,Flight>  m_flights;
+    std::atomic<uint64_t>   m_coalesced;
+};
+
+}}
+
+#endif
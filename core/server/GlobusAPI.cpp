@@ -460,6 +460,94 @@ GlobusAPI::checkTransferStatus( const std::string & a_task_id, const std::string
     }
 }
 
+/**
+ * @brief Get status of multiple transfer tasks with a single API call
+ *
+ * Status is mapped as for single-task checks, but event lists are not
+ * inspected (callers should check tasks with faults individually). Tasks not
+ * returned by Globus are omitted from a_info.
+ */
+void
+GlobusAPI::checkTransferStatus( const std::vector<std::string> & a_task_ids, const std::string & a_acc_tok, std::map<std::string,XfrInfo> & a_info )
+{
+    DL_DEBUG( "GlobusAPI::checkTransferStatus, " << a_task_ids.size() << " tasks" );
+
+    string raw_result;
+    string filter = "task_id:";
+
+    for ( vector<string>::const_iterator t = a_task_ids.begin(); t != a_task_ids.end(); t++ )
+    {
+        if ( t != a_task_ids.begin() )
+            filter += ",";
+        filter += *t;
+    }
+
+    long code = get( m_curl_xfr, m_config.glob_xfr_url, "task_list", a_acc_tok, {{"filter",filter},{"fields","task_id,status,nice_status,faults"},{"limit",to_string( a_task_ids.size() )}}, raw_result );
+
+    try
+    {
+        if ( !raw_result.size() )
+            EXCEPT_PARAM( ID_SERVICE_ERROR, "Empty response. Code: " << code );
+
+        Value result;
+
+        result.fromString( raw_result );
+
+        Value::Object & resp_obj = result.asObject();
+
+        checkResponsCode( code, resp_obj );
+
+        string & data_type = resp_obj.getString( "DATA_TYPE" );
+
+        if ( data_type.compare( "task_list" ) != 0 )
+            EXCEPT( ID_SERVICE_ERROR, "Invalid DATA_TYPE field." );
+
+        Value::Array & arr = resp_obj.getArray( "DATA" );
+
+        for ( Value::ArrayIter i = arr.begin(); i != arr.end(); i++ )
+        {
+            Value::Object & dobj = i->asObject();
+            XfrInfo & info = a_info[dobj.getString( "task_id" )];
+            string & status = dobj.getString( "status" );
+
+            if ( status == "SUCCEEDED" )
+                info.status = XS_SUCCEEDED;
+            else if ( status == "FAILED" || status == "INACTIVE" )
+                info.status = XS_FAILED;
+            else
+                info.status = XS_ACTIVE;
+
+            if ( dobj.has( "nice_status" ) && dobj.value().isString() )
+                info.nice_status = dobj.asString();
+            else
+                info.nice_status.clear();
+
+            if ( dobj.has( "faults" ) && dobj.value().isNumber() )
+                info.faults = (uint32_t)dobj.asNumber();
+            else
+                info.faults = 0;
+        }
+    }
+    catch( libjson::ParseError & e )
+    {
+        DL_DEBUG("PARSE FAILED!");
+        DL_DEBUG( raw_result );
+        EXCEPT_PARAM( ID_SERVICE_ERROR, "Globus task list API call returned invalid JSON." );
+    }
+    catch( TraceException & e )
+    {
+        DL_DEBUG( raw_result );
+        e.addContext( "Globus task list API call failed." );
+        throw;
+    }
+    catch( ... )
+    {
+        DL_DEBUG("UNEXPECTED/MISSING JSON!");
+        DL_DEBUG( raw_result );
+        EXCEPT_PARAM( ID_SERVICE_ERROR, "Globus task list API call returned unexpected content" );
+    }
+}
+
 void
 GlobusAPI::cancelTask( const std::string & a_task_id, const std::string & a_acc_tok )
 {
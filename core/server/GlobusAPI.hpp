@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <curl/curl.h>
 #include "libjson.hpp"
 #include "Config.hpp"
@@ -32,6 +33,13 @@ public:
         virtual void    cb_CancelTransfer() = 0;
     };
 
+    struct XfrInfo
+    {
+        XfrStatus       status;
+        uint32_t        faults;
+        std::string     nice_status;
+    };
+
     struct EndpointInfo
     {
         std::string id;
@@ -47,6 +55,7 @@ public:
 
     std::string transfer( const std::string & a_src_ep, const std::string & a_dst_ep, const std::vector<std::pair<std::string,std::string>> & a_files, bool a_encrypt, const std::string & a_acc_token );
     bool        checkTransferStatus( const std::string & a_task_id, const std::string & a_acc_tok, XfrStatus & a_status, std::string & a_err_msg );
+    void        checkTransferStatus( const std::vector<std::string> & a_task_ids, const std::string & a_acc_tok, std::map<std::string,XfrInfo> & a_info );
     void        cancelTask( const std::string & a_task_id, const std::string & a_acc_tok );
     void        getEndpointInfo( const std::string & a_ep_id, const std::string & a_acc_token, EndpointInfo & a_ep_info );
     void        refreshAccessToken( const std::string & a_ref_tok, std::string & a_new_acc_tok, uint32_t & a_expires_in );
@@ -2,6 +2,7 @@
 #define ICORESERVER_HPP
 
 #include <string>
+#include "MsgMetrics.hpp"
 
 namespace SDMS {
 namespace Core {
@@ -10,7 +11,8 @@ class ICoreServer
 {
 public:
     virtual void authenticateClient( const std::string & a_cert_uid, const std::string & a_uid ) = 0;
-    virtual void metricsUpdateMsgCount( const std::string & a_uid, uint16_t a_msg_type ) = 0;
+    virtual void clientKeysChanged( const std::string & a_uid, const std::string & a_pub_key ) = 0;
+    virtual MsgMetrics * metricsCreate() = 0;
 };
 
 }}
@@ -2,8 +2,10 @@
 #define ITASKMGR_HPP
 
 #include <string>
+#include <chrono>
 #include "libjson.hpp"
 #include "ITaskWorker.hpp"
+#include "SDMS.pb.h"
 
 namespace SDMS {
 namespace Core {
@@ -22,25 +24,65 @@ public:
     typedef std::chrono::system_clock::time_point   timepoint_t;
     typedef std::chrono::system_clock::duration     duration_t;
 
+    /// Scheduling lanes, in dispatch priority order
+    enum TaskLane
+    {
+        TL_QUICK = 0,       ///< Short-running tasks (allocations, deletes, size updates)
+        TL_TRANSFER,        ///< Long-running tasks involving data transfers
+        TL_COUNT
+    };
+
     struct Task
     {
-        Task( const std::string & a_id ) :
-            task_id( a_id ), cancel(false), retry_count(0)
+        Task( const std::string & a_id, uint32_t a_lane, const std::string & a_owner ) :
+            task_id( a_id ), owner( a_owner ), lane( a_lane ), cancel(false), retry_count(0), resume(false), step(0), chunk_step(-1), chunk_done(0)
         {}
 
         ~Task()
         {}
 
         std::string         task_id;
+        std::string         owner;
+        uint32_t            lane;
         bool                cancel;
         uint32_t            retry_count;
         timepoint_t         retry_time;
         timepoint_t         retry_fail_time;
+        timepoint_t         queued_time;
+        bool                resume;     ///< Task is resuming after a monitored transfer
+        int                 step;       ///< Step to report when resumed
+        std::string         err_msg;    ///< Transfer error to report when resumed
+        std::string         xfr_id;     ///< Globus task ID of transfer being monitored
+        std::string         xfr_token;  ///< Access token for transfer monitoring
+        int                 chunk_step; ///< Step of a partially completed chunked repo command (-1 if none)
+        size_t              chunk_done; ///< Items of chunk_step completed, resumed on retry
     };
 
+    /// Initial lane of a task based on its type (TaskType)
+    static inline uint32_t laneForType( uint32_t a_type )
+    {
+        switch ( a_type )
+        {
+        case TT_DATA_GET:
+        case TT_DATA_PUT:
+        case TT_REC_CHG_ALLOC:
+        case TT_REC_CHG_OWNER:
+            return TL_TRANSFER;
+        default:
+            return TL_QUICK;
+        }
+    }
+
+    /// Lane of a task being retried based on the failed command (TaskCommand)
+    static inline uint32_t laneForCommand( uint32_t a_cmd )
+    {
+        return a_cmd == TC_RAW_DATA_TRANSFER ? TL_TRANSFER : TL_QUICK;
+    }
+
     virtual Task *      getNextTask( ITaskWorker * a_worker ) = 0;
     virtual bool        retryTask( Task * a_task ) = 0;
     virtual void        newTasks( const libjson::Value & a_tasks ) = 0;
+    virtual void        monitorTransfer( Task * a_task ) = 0;
 };
 
 }}
@@ -13,7 +13,8 @@ namespace Core {
  * 
  * Next/prev attrib are for worker pool linked list. 'run' flag tells mgr if
  * the worker is in the pool or not (run == true means not in pool, run == 
- * false means a spurious wake).
+ * false means a spurious wake). 'lane' is the scheduling lane of the task
+ * currently assigned to the worker (UINT32_MAX if none).
  */
 class ITaskWorker
 {
@@ -21,7 +22,8 @@ public:
     ITaskWorker( uint32_t a_id ) :
         m_id( a_id ),
         m_run( false ),
-        m_next( 0 )
+        m_next( 0 ),
+        m_lane( UINT32_MAX )
         //m_prev( 0 ),
     {
     }
@@ -38,6 +40,7 @@ private:
     uint32_t                    m_id;
     bool                        m_run;
     ITaskWorker *               m_next;
+    uint32_t                    m_lane;
     //ITaskWorker *               m_prev;
     std::condition_variable     m_cvar;
 
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include "LatencyHistogram.hpp"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+#define LAT_HIST_HALF   ( 1 << ( LAT_HIST_SUB_BITS - 1 ))
+
+LatencyHistogram::LatencyHistogram() :
+    m_count( 0 ),
+    m_sum( 0 ),
+    m_max( 0 )
+{
+    for ( size_t i = 0; i < LAT_HIST_BUCKETS; i++ )
+        m_counts[i].store( 0, memory_order_relaxed );
+}
+
+void
+LatencyHistogram::record( uint64_t a_usec )
+{
+    m_counts[bucketIndex( a_usec )].fetch_add( 1, memory_order_relaxed );
+    m_count.fetch_add( 1, memory_order_relaxed );
+    m_sum.fetch_add( a_usec, memory_order_relaxed );
+
+    uint64_t max = m_max.load( memory_order_relaxed );
+
+    while ( a_usec > max && !m_max.compare_exchange_weak( max, a_usec, memory_order_relaxed ))
+        ;
+}
+
+/**
+ * @brief Get count, sum, max, and percentiles (as bucket upper bounds, clamped to max)
+ */
+void
+LatencyHistogram::summarize( Summary & a_summary ) const
+{
+    const double    pct[4] = { 0.5, 0.9, 0.99, 0.999 };
+    uint64_t *      res[4] = { &a_summary.p50, &a_summary.p90, &a_summary.p99, &a_summary.p999 };
+    uint64_t        counts[LAT_HIST_BUCKETS];
+    uint64_t        total = 0, cum = 0;
+    size_t          i, p = 0;
+
+    for ( i = 0; i < LAT_HIST_BUCKETS; i++ )
+    {
+        counts[i] = m_counts[i].load( memory_order_relaxed );
+        total += counts[i];
+    }
+
+    a_summary.count = total;
+    a_summary.sum = m_sum.load( memory_order_relaxed );
+    a_summary.max = m_max.load( memory_order_relaxed );
+
+    for ( i = 0; i < 4; i++ )
+        *res[i] = 0;
+
+    if ( !total )
+        return;
+
+    for ( i = 0; i < LAT_HIST_BUCKETS && p < 4; i++ )
+    {
+        cum += counts[i];
+
+        while ( p < 4 && cum >= pct[p] * total )
+        {
+            *res[p] = min( bucketMax( i ), a_summary.max );
+            p++;
+        }
+    }
+}
+
+size_t
+LatencyHistogram::bucketIndex( uint64_t a_value )
+{
+    if ( a_value >= ( 1ULL << LAT_HIST_MAX_BITS ))
+        a_value = ( 1ULL << LAT_HIST_MAX_BITS ) - 1;
+
+    if ( a_value < ( 1 << LAT_HIST_SUB_BITS ))
+        return a_value;
+
+    // Magnitude is chosen so that value >> mag falls in [half, 2*half)
+    size_t mag = ( 63 - __builtin_clzll( a_value )) - ( LAT_HIST_SUB_BITS - 1 );
+
+    return mag * LAT_HIST_HALF + ( a_value >> mag );
+}
+
+uint64_t
+LatencyHistogram::bucketMax( size_t a_index )
+{
+    if ( a_index < ( 1 << LAT_HIST_SUB_BITS ))
+        return a_index;
+
+    size_t mag = a_index / LAT_HIST_HALF - 1;
+    uint64_t sub = a_index % LAT_HIST_HALF + LAT_HIST_HALF;
+
+    return (( sub + 1 ) << mag ) - 1;
+}
+
+}}
@@ -0,0 +1,58 @@
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace SDMS {
+namespace Core {
+
+/// Sub-bucket resolution (bits); buckets are at most 1/16 of their value wide
+#define LAT_HIST_SUB_BITS   5
+/// Largest recordable value is 2^LAT_HIST_MAX_BITS - 1 microseconds (~19 hours)
+#define LAT_HIST_MAX_BITS   36
+#define LAT_HIST_BUCKETS    (( LAT_HIST_MAX_BITS - LAT_HIST_SUB_BITS + 2 ) << ( LAT_HIST_SUB_BITS - 1 ))
+
+/**
+ * @brief Log-linear latency histogram (HdrHistogram-style bucketing)
+ *
+ * Values (in microseconds) below 2^LAT_HIST_SUB_BITS are counted exactly;
+ * larger values fall into buckets whose width is bounded relative to the
+ * value, so percentiles carry a fixed relative error. Recording uses relaxed
+ * atomics only and may be done concurrently from any number of threads.
+ * Summaries read the counters without stopping writers and are therefore
+ * approximate while recording is in progress.
+ */
+class LatencyHistogram
+{
+public:
+    struct Summary
+    {
+        uint64_t    count;
+        uint64_t    sum;
+        uint64_t    max;
+        uint64_t    p50;
+        uint64_t    p90;
+        uint64_t    p99;
+        uint64_t    p999;
+    };
+
+    LatencyHistogram();
+
+    void        record( uint64_t a_usec );
+    void        summarize( Summary & a_summary ) const;
+
+private:
+    static size_t   bucketIndex( uint64_t a_value );
+    static uint64_t bucketMax( size_t a_index );
+
+    std::atomic<uint64_t>   m_counts[LAT_HIST_BUCKETS];
+    std::atomic<uint64_t>   m_count;
+    std::atomic<uint64_t>   m_sum;
+    std::atomic<uint64_t>   m_max;
+};
+
+}}
+
+#endif
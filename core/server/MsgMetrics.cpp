@@ -0,0 +1,101 @@
+#include <thread>
+#include "MsgMetrics.hpp"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+MsgMetrics::MsgMetrics() :
+    m_active( 0 ),
+    m_received( 0 )
+{
+}
+
+MsgMetrics::~MsgMetrics()
+{
+}
+
+/**
+ * @brief Count a processed message (owning worker thread only)
+ *
+ * The busy flag of the active block is raised before the active index is
+ * re-checked; if collect() switched blocks in between, the update moves to
+ * the new active block. Both steps are sequentially consistent so that
+ * collect() can not miss an update in progress.
+ */
+void
+MsgMetrics::update( const std::string & a_uid, uint16_t a_msg_type )
+{
+    uint32_t    idx;
+    Block *     block;
+
+    while ( 1 )
+    {
+        idx = m_active.load();
+        block = &m_block[idx];
+        block->busy.store( true );
+
+        if ( m_active.load() == idx )
+            break;
+
+        block->busy.store( false, memory_order_release );
+    }
+
+    if ( a_msg_type < MSG_METRICS_TYPES )
+        block->type_counts[a_msg_type]++;
+
+    user_counts_t & counts = block->user_counts[a_uid];
+    user_counts_t::iterator c = counts.begin();
+
+    for ( ; c != counts.end(); c++ )
+    {
+        if ( c->first == a_msg_type )
+        {
+            c->second++;
+            break;
+        }
+    }
+
+    if ( c == counts.end() )
+        counts.push_back( make_pair( a_msg_type, 1 ));
+
+    block->busy.store( false, memory_order_release );
+}
+
+/**
+ * @brief Add counts since last call into a_user_counts and a_type_counts (metrics thread only)
+ *
+ * a_type_counts must be sized to MSG_METRICS_TYPES. Per-user totals are not
+ * computed here.
+ */
+void
+MsgMetrics::collect( std::map<std::string,counts_t> & a_user_counts, std::vector<uint32_t> & a_type_counts )
+{
+    uint32_t    idx = m_active.load();
+    Block &     block = m_block[idx];
+
+    m_active.store( idx ^ 1 );
+
+    // Wait for an update that started before the switch (at most one)
+    while ( block.busy.load() )
+        this_thread::yield();
+
+    for ( size_t t = 0; t < MSG_METRICS_TYPES; t++ )
+    {
+        a_type_counts[t] += block.type_counts[t];
+        block.type_counts[t] = 0;
+    }
+
+    for ( unordered_map<string,user_counts_t>::iterator u = block.user_counts.begin(); u != block.user_counts.end(); u++ )
+    {
+        counts_t & counts = a_user_counts[u->first];
+
+        for ( user_counts_t::iterator c = u->second.begin(); c != u->second.end(); c++ )
+            counts[c->first] += c->second;
+    }
+
+    block.user_counts.clear();
+}
+
+}}
@@ -0,0 +1,73 @@
+#ifndef MSGMETRICS_HPP
+#define MSGMETRICS_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <stdint.h>
+
+namespace SDMS {
+namespace Core {
+
+/// Message types below this value are counted in the dense per-type array (protocol IDs 0 - 3)
+#define MSG_METRICS_TYPES 0x400
+
+/**
+ * @brief Per-worker message request counters
+ *
+ * Each client worker owns one instance and is its only writer; the metrics
+ * thread is the only reader. Counters are double-buffered: the writer updates
+ * the active block without locking, and collect() switches the active block
+ * then waits only for an update already in progress on the retired block
+ * before reading and resetting it.
+ *
+ * Per-type totals are kept in a dense array indexed by message type, and
+ * per-user counts in a compact list of (type, count) pairs per user ID (users
+ * typically send few distinct message types within a metrics period).
+ */
+class MsgMetrics
+{
+public:
+    /// Maps message type to count (type 0 holds total when collected)
+    typedef std::map<uint16_t,uint32_t>     counts_t;
+
+    MsgMetrics();
+    ~MsgMetrics();
+
+    /// Count a message received from the worker queue (owning worker thread only)
+    inline void receive()
+    {
+        m_received.store( m_received.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    }
+
+    /// Total messages received from the worker queue
+    inline uint64_t received() const
+    {
+        return m_received.load( std::memory_order_relaxed );
+    }
+
+    void        update( const std::string & a_uid, uint16_t a_msg_type );
+    void        collect( std::map<std::string,counts_t> & a_user_counts, std::vector<uint32_t> & a_type_counts );
+
+private:
+    typedef std::vector<std::pair<uint16_t,uint32_t>>   user_counts_t;
+
+    struct Block
+    {
+        Block() : busy( false ), type_counts( MSG_METRICS_TYPES, 0 ) {}
+
+        std::atomic<bool>                               busy;
+        std::vector<uint32_t>                           type_counts;
+        std::unordered_map<std::string,user_counts_t>   user_counts;
+    };
+
+    Block                   m_block[2];
+    std::atomic<uint32_t>   m_active;
+    std::atomic<uint64_t>   m_received;
+};
+
+}}
+
+#endif
@@ -0,0 +1,221 @@
+#include "DynaLog.hpp"
+#include "PermCache.hpp"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+PermCache::PermCache() :
+    m_ttl( Config::getInstance().perm_cache_ttl ),
+    m_shard_max( Config::getInstance().perm_cache_max / PERM_CACHE_SHARDS + 1 ),
+    m_generation(0),
+    m_hits(0),
+    m_misses(0),
+    m_evictions(0),
+    m_invalidations(0)
+{
+    DL_DEBUG( "Permission cache TTL: " << m_ttl.count() << " sec, max entries: " << Config::getInstance().perm_cache_max );
+}
+
+PermCache::~PermCache()
+{
+}
+
+PermCache &
+PermCache::getInstance()
+{
+    static PermCache * cache = new PermCache();
+
+    return *cache;
+}
+
+/**
+ * @brief Get current generation for entries with given tag
+ *
+ * Must be called before issuing the DB request whose reply will be cached.
+ */
+uint64_t
+PermCache::generation( const std::string & a_tag )
+{
+    Shard & shard = getShard( a_tag );
+    lock_guard<mutex> lock( shard.mutex );
+
+    clearIfStale( shard );
+
+    return shard.generation + shard.cleared;
+}
+
+bool
+PermCache::get( const std::string & a_tag, const std::string & a_key, std::string & a_value )
+{
+    Shard & shard = getShard( a_tag );
+    lock_guard<mutex> lock( shard.mutex );
+
+    clearIfStale( shard );
+
+    tag_map_t::iterator t = shard.tags.find( a_tag );
+    if ( t != shard.tags.end() )
+    {
+        entry_map_t::iterator e = t->second.find( a_key );
+        if ( e != t->second.end() )
+        {
+            if ( e->second.expires > chrono::steady_clock::now() )
+            {
+                a_value = e->second.value;
+                m_hits++;
+                return true;
+            }
+
+            t->second.erase( e );
+            shard.count--;
+
+            if ( t->second.empty() )
+                shard.tags.erase( t );
+        }
+    }
+
+    m_misses++;
+
+    return false;
+}
+
+/**
+ * @brief Store a reply value (moved from a_value)
+ *
+ * The value is discarded if the tag has been invalidated since a_generation
+ * was obtained from generation().
+ */
+void
+PermCache::put( const std::string & a_tag, const std::string & a_key, uint64_t a_generation, std::string & a_value )
+{
+    Shard & shard = getShard( a_tag );
+    lock_guard<mutex> lock( shard.mutex );
+
+    clearIfStale( shard );
+
+    if ( a_generation != shard.generation + shard.cleared )
+        return;
+
+    timepoint_t now = chrono::steady_clock::now();
+
+    if ( shard.count >= m_shard_max )
+        evict( shard, now );
+
+    entry_map_t & entries = shard.tags[a_tag];
+    pair<entry_map_t::iterator,bool> ins = entries.insert( make_pair( a_key, Entry() ));
+
+    if ( ins.second )
+        shard.count++;
+
+    ins.first->second.value.swap( a_value );
+    ins.first->second.expires = now + m_ttl;
+}
+
+void
+PermCache::invalidate( const std::string & a_tag )
+{
+    Shard & shard = getShard( a_tag );
+    lock_guard<mutex> lock( shard.mutex );
+
+    clearIfStale( shard );
+
+    shard.generation++;
+    m_invalidations++;
+
+    tag_map_t::iterator t = shard.tags.find( a_tag );
+    if ( t != shard.tags.end() )
+    {
+        shard.count -= t->second.size();
+        shard.tags.erase( t );
+    }
+}
+
+/**
+ * @brief Invalidate all entries
+ *
+ * Shards are cleared lazily on next access to keep this call O(1).
+ */
+void
+PermCache::invalidateAll()
+{
+    m_generation++;
+    m_invalidations++;
+}
+
+void
+PermCache::getStats( Stats & a_stats )
+{
+    a_stats.hits = m_hits;
+    a_stats.misses = m_misses;
+    a_stats.evictions = m_evictions;
+    a_stats.invalidations = m_invalidations;
+    a_stats.entries = 0;
+
+    for ( size_t i = 0; i < PERM_CACHE_SHARDS; i++ )
+    {
+        lock_guard<mutex> lock( m_shards[i].mutex );
+
+        clearIfStale( m_shards[i] );
+        a_stats.entries += m_shards[i].count;
+    }
+}
+
+/// Shard mutex must be held by caller
+void
+PermCache::clearIfStale( Shard & a_shard )
+{
+    uint64_t gen = m_generation;
+
+    if ( a_shard.cleared != gen )
+    {
+        a_shard.tags.clear();
+        a_shard.count = 0;
+        a_shard.cleared = gen;
+    }
+}
+
+/**
+ * Removes expired entries from shard; if shard is still above its low-water
+ * mark (PERM_CACHE_EVICT_PCT of capacity), drops entries of arbitrary tags
+ * until below it. Evicting in bulk means a full shard is scanned about once
+ * per PERM_CACHE_EVICT_PCT of capacity puts, rather than on every put. Shard
+ * mutex must be held by caller.
+ */
+void
+PermCache::evict( Shard & a_shard, timepoint_t a_now )
+{
+    tag_map_t::iterator t;
+    entry_map_t::iterator e;
+    size_t low_water = m_shard_max * PERM_CACHE_EVICT_PCT / 100;
+
+    for ( t = a_shard.tags.begin(); t != a_shard.tags.end(); )
+    {
+        for ( e = t->second.begin(); e != t->second.end(); )
+        {
+            if ( e->second.expires <= a_now )
+            {
+                e = t->second.erase( e );
+                a_shard.count--;
+                m_evictions++;
+            }
+            else
+                e++;
+        }
+
+        if ( t->second.empty() )
+            t = a_shard.tags.erase( t );
+        else
+            t++;
+    }
+
+    while ( a_shard.count > low_water && a_shard.tags.size() )
+    {
+        t = a_shard.tags.begin();
+        a_shard.count -= t->second.size();
+        m_evictions += t->second.size();
+        a_shard.tags.erase( t );
+    }
+}
+
+}}
@@ -0,0 +1,105 @@
+#ifndef PERMCACHE_HPP
+#define PERMCACHE_HPP
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "Config.hpp"
+
+namespace SDMS {
+namespace Core {
+
+#define PERM_CACHE_SHARDS 16
+#define PERM_CACHE_EVICT_PCT 90     // Shard fill (percent of capacity) after eviction
+
+/**
+ * @brief Sharded, TTL-bounded cache of DB permission and view replies
+ *
+ * Shared by all DatabaseAPI instances in the core server. Entries hold
+ * serialized reply messages and are grouped by a tag (the object ID the
+ * reply pertains to) so that writes to an object can invalidate all cached
+ * replies for that object regardless of client. Writes with wide-reaching
+ * permission effects (ACL, group, ownership, collection linkage changes)
+ * invalidate the entire cache.
+ *
+ * To avoid caching a result that raced with a concurrent write, callers
+ * obtain a generation value before issuing the DB request and pass it back
+ * to put(); entries are discarded if an invalidation occurred in between.
+ */
+class PermCache
+{
+public:
+    struct Stats
+    {
+        uint64_t    hits;
+        uint64_t    misses;
+        uint64_t    evictions;
+        uint64_t    invalidations;
+        size_t      entries;
+    };
+
+    static PermCache & getInstance();
+
+    /// Only canonical record and collection IDs are cacheable (aliases can't be invalidated)
+    static inline bool isCacheableID( const std::string & a_id )
+    {
+        return a_id.size() > 2 && a_id[1] == '/' && ( a_id[0] == 'd' || a_id[0] == 'c' );
+    }
+
+    inline bool     enabled() const { return m_ttl.count() > 0; }
+    uint64_t        generation( const std::string & a_tag );
+    bool            get( const std::string & a_tag, const std::string & a_key, std::string & a_value );
+    void            put( const std::string & a_tag, const std::string & a_key, uint64_t a_generation, std::string & a_value );
+    void            invalidate( const std::string & a_tag );
+    void            invalidateAll();
+    void            getStats( Stats & a_stats );
+
+private:
+    typedef std::chrono::steady_clock::time_point   timepoint_t;
+
+    struct Entry
+    {
+        std::string     value;
+        timepoint_t     expires;
+    };
+
+    typedef std::unordered_map<std::string,Entry>           entry_map_t;
+    typedef std::unordered_map<std::string,entry_map_t>     tag_map_t;
+
+    struct Shard
+    {
+        Shard() : count(0), generation(0), cleared(0) {}
+
+        std::mutex      mutex;
+        tag_map_t       tags;
+        size_t          count;
+        uint64_t        generation;
+        uint64_t        cleared;    ///< Global generation at last clear of shard
+    };
+
+    PermCache();
+    ~PermCache();
+
+    inline Shard & getShard( const std::string & a_tag )
+    {
+        return m_shards[std::hash<std::string>()( a_tag ) % PERM_CACHE_SHARDS];
+    }
+
+    void            clearIfStale( Shard & a_shard );
+    void            evict( Shard & a_shard, timepoint_t a_now );
+
+    std::chrono::seconds    m_ttl;
+    size_t                  m_shard_max;
+    Shard                   m_shards[PERM_CACHE_SHARDS];
+    std::atomic<uint64_t>   m_generation;
+    std::atomic<uint64_t>   m_hits;
+    std::atomic<uint64_t>   m_misses;
+    std::atomic<uint64_t>   m_evictions;
+    std::atomic<uint64_t>   m_invalidations;
+};
+
+}}
+
+#endif
@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include "DynaLog.hpp"
+#include "TraceException.hpp"
+#include "RepoConnMgr.hpp"
+#include "SDMS.pb.h"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+#define IO_POLL_TIMEOUT 1000
+#define REPO_BACKOFF_MIN 1000   // msec
+#define REPO_BACKOFF_MAX 60000  // msec
+#define REPO_LATE_REPLY_MAX 600000 // msec a timed out context is reserved for its late reply
+#define REPO_SEND_HWM 1000      // Requests queued per connection before a send fails
+
+RepoConnMgr::RepoConnMgr() :
+    m_config( Config::getInstance() ),
+    m_io_thread( 0 )
+{
+    m_stats.repos = 0;
+    m_stats.down = 0;
+    m_stats.in_flight = 0;
+    m_stats.reconnects = 0;
+    m_stats.resets = 0;
+    m_stats.timeouts = 0;
+
+    if ( pipe( m_wake_pipe ) != 0 )
+        EXCEPT( ID_INTERNAL_ERROR, "Failed to create repo connection wake-up pipe" );
+
+    fcntl( m_wake_pipe[0], F_SETFL, O_NONBLOCK );
+    fcntl( m_wake_pipe[1], F_SETFL, O_NONBLOCK );
+
+    m_io_thread = new thread( &RepoConnMgr::ioThread, this );
+}
+
+RepoConnMgr::~RepoConnMgr()
+{
+}
+
+RepoConnMgr &
+RepoConnMgr::getInstance()
+{
+    static RepoConnMgr * mgr = new RepoConnMgr();
+
+    return *mgr;
+}
+
+/**
+ * The I/O thread completes every call by its deadline; as a backstop, the
+ * caller gives up REPO_WAIT_MARGIN msec after that. The call is then left to
+ * the I/O thread, which frees it (and any reply) when it completes.
+ */
+bool
+RepoConnMgr::sendRecv( const std::string & a_repo_id, MsgBuf::Message & a_msg, MsgBuf::Message *& a_reply, uint32_t a_timeout )
+{
+    struct Call
+    {
+        Call() : done( false ), abandoned( false ) {}
+
+        Request             request;
+        mutex               done_mutex;
+        condition_variable  done_cvar;
+        bool                done;
+        bool                abandoned;
+    };
+
+    Call *      call = new Call();
+    bool        ok;
+
+    call->request.repo_id = a_repo_id;
+    call->request.timeout = a_timeout;
+    call->request.on_complete = [call]( Request & )
+    {
+        unique_lock<mutex> lock( call->done_mutex );
+
+        if ( call->abandoned )
+        {
+            lock.unlock();
+            delete call->request.reply;
+            delete call;
+            return;
+        }
+
+        call->done = true;
+        call->done_cvar.notify_one();
+    };
+
+    try
+    {
+        submit( call->request, a_msg );
+    }
+    catch( ... )
+    {
+        delete call;
+        throw;
+    }
+
+    {
+        unique_lock<mutex> lock( call->done_mutex );
+        timepoint_t backstop = call->request.deadline + chrono::milliseconds( REPO_WAIT_MARGIN );
+
+        while ( !call->done )
+        {
+            if ( call->done_cvar.wait_until( lock, backstop ) == cv_status::timeout && !call->done )
+            {
+                DL_ERROR( "Repo " << a_repo_id << " call not completed " << REPO_WAIT_MARGIN << " ms past its timeout, abandoned" );
+                call->abandoned = true;
+                return false;
+            }
+        }
+    }
+
+    ok = ( call->request.reply != 0 );
+    if ( ok )
+        a_reply = call->request.reply;
+
+    delete call;
+
+    return ok;
+}
+
+void
+RepoConnMgr::submit( Request & a_request, MsgBuf::Message & a_msg )
+{
+    if ( m_config.repos.find( a_request.repo_id ) == m_config.repos.end() )
+        EXCEPT_PARAM( 1, "Task refers to non-existent repo server: " << a_request.repo_id );
+
+    a_request.buf.serialize( a_msg );
+    a_request.reply = 0;
+    a_request.deadline = chrono::steady_clock::now() + chrono::milliseconds( a_request.timeout );
+
+    {
+        lock_guard<mutex> lock( m_mutex );
+        m_pending.push_back( &a_request );
+    }
+
+    char c = 0;
+    if ( write( m_wake_pipe[1], &c, 1 ) < 0 && errno != EAGAIN )
+        DL_ERROR( "Repo connection wake-up write failed: " << errno );
+}
+
+void
+RepoConnMgr::getStats( Stats & a_stats )
+{
+    lock_guard<mutex> lock( m_mutex );
+
+    a_stats = m_stats;
+}
+
+void
+RepoConnMgr::ioThread()
+{
+    deque<Request*>                 starting;
+    vector<zmq_pollitem_t>          items;
+    vector<map<string,Conn>::iterator> item_conns;
+    map<string,Conn>::iterator      c;
+    deque<Request*>::iterator       q;
+    map<uint16_t,Request*>::iterator f;
+    map<uint16_t,timepoint_t>::iterator e;
+    Request *                       request;
+    timepoint_t                     now;
+    long                            timeout;
+    size_t                          i, repos, down, in_flight, resets, timeouts;
+    bool                            stale;
+    char                            buf[64];
+
+    while ( 1 )
+    {
+        try
+        {
+            {
+                lock_guard<mutex> lock( m_mutex );
+                starting.swap( m_pending );
+            }
+
+            now = chrono::steady_clock::now();
+
+            for ( deque<Request*>::iterator r = starting.begin(); r != starting.end(); r++ )
+                startRequest( **r, now );
+
+            starting.clear();
+
+            // Poll wake-up pipe and open connections until the nearest request deadline
+            items.resize( 1 );
+            items[0].socket = 0;
+            items[0].fd = m_wake_pipe[0];
+            items[0].events = ZMQ_POLLIN;
+            item_conns.clear();
+            timeout = IO_POLL_TIMEOUT;
+
+            for ( c = m_conns.begin(); c != m_conns.end(); c++ )
+            {
+                if ( !c->second.comm )
+                    continue;
+
+                items.resize( items.size() + 1 );
+                c->second.comm->getPollInfo( items.back() );
+                item_conns.push_back( c );
+
+                // Queued requests wait for the socket to become writable, i.e. connected
+                if ( c->second.queued.size() )
+                    items.back().events |= ZMQ_POLLOUT;
+
+                for ( q = c->second.queued.begin(); q != c->second.queued.end(); q++ )
+                    timeout = min<long>( timeout, max<long>( 0, chrono::duration_cast<chrono::milliseconds>( (*q)->deadline - now ).count() + 1 ));
+
+                for ( f = c->second.in_flight.begin(); f != c->second.in_flight.end(); f++ )
+                    timeout = min<long>( timeout, max<long>( 0, chrono::duration_cast<chrono::milliseconds>( f->second->deadline - now ).count() + 1 ));
+            }
+
+            for ( i = 0; i < items.size(); i++ )
+                items[i].revents = 0;
+
+            zmq_poll( &items[0], items.size(), timeout );
+
+            if ( items[0].revents & ZMQ_POLLIN )
+            {
+                while ( read( m_wake_pipe[0], buf, sizeof( buf )) > 0 )
+                {}
+            }
+
+            now = chrono::steady_clock::now();
+
+            for ( i = 0; i < item_conns.size(); i++ )
+            {
+                if ( items[i+1].revents & ZMQ_POLLIN )
+                    recvReply( item_conns[i]->second, item_conns[i]->first );
+
+                if (( items[i+1].revents & ZMQ_POLLOUT ) && item_conns[i]->second.comm )
+                {
+                    item_conns[i]->second.connected = true;
+                    sendQueued( item_conns[i]->second, item_conns[i]->first, now );
+                }
+            }
+
+            // A request without reply by its deadline fails alone; its connection stays up
+            now = chrono::steady_clock::now();
+            repos = down = in_flight = resets = timeouts = 0;
+
+            for ( c = m_conns.begin(); c != m_conns.end(); c++ )
+            {
+                // A repository that does not accept a connection within the timeout of a call is down
+                for ( q = c->second.queued.begin(); q != c->second.queued.end() && (*q)->deadline > now; q++ );
+
+                if ( q != c->second.queued.end() )
+                {
+                    DL_ERROR( "Repo " << c->first << " connect timed out" );
+                    failConn( c->second, c->first, now );
+                }
+
+                stale = false;
+
+                for ( f = c->second.in_flight.begin(); f != c->second.in_flight.end(); )
+                {
+                    if ( f->second->deadline <= now )
+                    {
+                        DL_WARN( "Repo " << c->first << " request timed out, context: " << f->first );
+
+                        c->second.expired[f->first] = now + chrono::milliseconds( REPO_LATE_REPLY_MAX );
+                        request = f->second;
+                        f = c->second.in_flight.erase( f );
+                        timeouts++;
+
+                        if ( c->second.last_reply < request->deadline - chrono::milliseconds( request->timeout ))
+                            stale = true;
+
+                        completeRequest( *request, 0 );
+                    }
+                    else
+                        f++;
+                }
+
+                if ( stale )
+                {
+                    DL_WARN( "Repo " << c->first << " sent no reply since a timed out call was made, recreating connection" );
+                    closeConn( c->second );
+                    resets++;
+                }
+
+                for ( e = c->second.expired.begin(); e != c->second.expired.end(); )
+                {
+                    if ( e->second <= now )
+                        e = c->second.expired.erase( e );
+                    else
+                        e++;
+                }
+
+                if ( c->second.comm )
+                    repos++;
+                else if ( c->second.failures )
+                    down++;
+
+                in_flight += c->second.queued.size() + c->second.in_flight.size();
+            }
+
+            lock_guard<mutex> lock( m_mutex );
+            m_stats.resets += resets;
+            m_stats.timeouts += timeouts;
+            m_stats.repos = repos;
+            m_stats.down = down;
+            m_stats.in_flight = in_flight;
+        }
+        catch( TraceException & e )
+        {
+            DL_ERROR( "Repo connection I/O: " << e.toString() );
+        }
+        catch( exception & e )
+        {
+            DL_ERROR( "Repo connection I/O: " << e.what() );
+        }
+        catch( ... )
+        {
+            DL_ERROR( "Repo connection I/O: unknown exception" );
+        }
+    }
+}
+
+/// Send a queued request on the connection of its repository, opening it if needed
+void
+RepoConnMgr::startRequest( Request & a_request, timepoint_t a_now )
+{
+    Conn & conn = m_conns[a_request.repo_id];
+
+    if ( !conn.comm )
+    {
+        if ( conn.failures && a_now < conn.retry_time )
+        {
+            // Repository is down - fail fast until backoff expires
+            completeRequest( a_request, 0 );
+            return;
+        }
+
+        conn.address = m_config.repos[a_request.repo_id]->address();
+
+        // Unsent requests of a stale or failed connection are dropped when it is closed
+        MsgComm::SocketOptions opts;
+
+        opts.immediate = true;
+        opts.send_hwm = REPO_SEND_HWM;
+        opts.linger = 0;
+
+        try
+        {
+            conn.comm = new MsgComm( conn.address, MsgComm::DEALER, false, &m_config.sec_ctx, 0, &opts );
+            conn.connected = false;
+        }
+        catch( TraceException & e )
+        {
+            DL_ERROR( "Repo " << a_request.repo_id << " connect failed: " << e.toString() );
+            completeRequest( a_request, 0 );
+            failConn( conn, a_request.repo_id, a_now );
+            return;
+        }
+
+        DL_INFO( "Repo " << a_request.repo_id << " connected at " << conn.address );
+
+        if ( conn.failures )
+        {
+            lock_guard<mutex> lock( m_mutex );
+            m_stats.reconnects++;
+        }
+    }
+
+    conn.queued.push_back( &a_request );
+    sendQueued( conn, a_request.repo_id, a_now );
+}
+
+/**
+ * Sends the queued requests of a connection without blocking. Until the
+ * connection is established, requests stay queued (the I/O thread resumes
+ * sending when the socket becomes writable); after that, a request that can
+ * not be sent right away (send queue full, or connection lost) is a
+ * transport failure.
+ */
+void
+RepoConnMgr::sendQueued( Conn & a_conn, const std::string & a_repo_id, timepoint_t a_now )
+{
+    Request *   request;
+    uint16_t    context;
+
+    while ( a_conn.queued.size() )
+    {
+        request = a_conn.queued.front();
+
+        if ( a_conn.in_flight.size() + a_conn.expired.size() >= 0xFFFF )
+        {
+            DL_ERROR( "Repo " << a_repo_id << " has too many calls in progress" );
+            a_conn.queued.pop_front();
+            completeRequest( *request, 0 );
+            continue;
+        }
+
+        // Context identifies the reply; skip values still in use or awaiting a late reply
+        while ( a_conn.in_flight.find( a_conn.next_ctx ) != a_conn.in_flight.end() || a_conn.expired.find( a_conn.next_ctx ) != a_conn.expired.end() )
+            a_conn.next_ctx++;
+
+        // Sending clears the frame, so the context is kept here
+        context = a_conn.next_ctx;
+        request->buf.getFrame().context = context;
+
+        try
+        {
+            if ( !a_conn.comm->send( request->buf, false, true ))
+            {
+                if ( !a_conn.connected )
+                    return;
+
+                DL_ERROR( "Repo " << a_repo_id << " send queue full or connection lost" );
+                failConn( a_conn, a_repo_id, a_now );
+                return;
+            }
+        }
+        catch( TraceException & e )
+        {
+            DL_ERROR( "Repo " << a_repo_id << " send failed: " << e.toString() );
+            failConn( a_conn, a_repo_id, a_now );
+            return;
+        }
+
+        a_conn.next_ctx++;
+        a_conn.connected = true;
+        a_conn.queued.pop_front();
+        a_conn.in_flight[context] = request;
+    }
+}
+
+/// Receive pending replies of a connection and complete their requests
+void
+RepoConnMgr::recvReply( Conn & a_conn, const std::string & a_repo_id )
+{
+    MsgBuf                          buf;
+    MsgBuf::Message *               reply;
+    map<uint16_t,Request*>::iterator f;
+    Request *                       request;
+    int                             events;
+    size_t                          events_len;
+
+    do
+    {
+        if ( !a_conn.comm->recv( buf, false, 1 ))
+            break;
+
+        a_conn.last_reply = chrono::steady_clock::now();
+
+        f = a_conn.in_flight.find( buf.getFrame().context );
+
+        if ( f == a_conn.in_flight.end() )
+        {
+            a_conn.expired.erase( buf.getFrame().context );
+            DL_DEBUG( "Repo " << a_repo_id << " late reply discarded, context: " << buf.getFrame().context );
+        }
+        else
+        {
+            request = f->second;
+            a_conn.in_flight.erase( f );
+            a_conn.failures = 0;
+            reply = 0;
+
+            try
+            {
+                reply = buf.unserialize();
+            }
+            catch( TraceException & e )
+            {
+                DL_ERROR( "Repo " << a_repo_id << " invalid reply: " << e.toString() );
+            }
+
+            completeRequest( *request, reply );
+        }
+
+        events_len = sizeof( events );
+    }
+    while ( zmq_getsockopt( a_conn.comm->getSocket(), ZMQ_EVENTS, &events, &events_len ) == 0 && ( events & ZMQ_POLLIN ));
+}
+
+/// Close a connection, failing its queued requests and requests in progress
+void
+RepoConnMgr::closeConn( Conn & a_conn )
+{
+    deque<Request*>         queued;
+    map<uint16_t,Request*>  in_flight;
+
+    queued.swap( a_conn.queued );
+    in_flight.swap( a_conn.in_flight );
+    a_conn.expired.clear();
+
+    delete a_conn.comm;
+    a_conn.comm = 0;
+    a_conn.connected = false;
+
+    for ( deque<Request*>::iterator q = queued.begin(); q != queued.end(); q++ )
+        completeRequest( **q, 0 );
+
+    for ( map<uint16_t,Request*>::iterator f = in_flight.begin(); f != in_flight.end(); f++ )
+        completeRequest( *f->second, 0 );
+}
+
+/**
+ * Closes a connection after a transport error, failing its requests in
+ * progress, and starts a reconnect backoff that doubles with each consecutive
+ * failure.
+ */
+void
+RepoConnMgr::failConn( Conn & a_conn, const std::string & a_repo_id, timepoint_t a_now )
+{
+    closeConn( a_conn );
+
+    uint32_t backoff = REPO_BACKOFF_MIN << min<uint32_t>( a_conn.failures, 6 );
+
+    backoff = min<uint32_t>( backoff, REPO_BACKOFF_MAX );
+    a_conn.failures++;
+    a_conn.retry_time = a_now + chrono::milliseconds( backoff );
+
+    DL_WARN( "Repo " << a_repo_id << " down, reconnect in " << backoff << " ms" );
+}
+
+void
+RepoConnMgr::completeRequest( Request & a_request, MsgBuf::Message * a_reply )
+{
+    // Callback is moved out first, as it may free the request
+    function<void( Request & )> on_complete;
+
+    on_complete.swap( a_request.on_complete );
+    a_request.reply = a_reply;
+    on_complete( a_request );
+}
+
+}}
@@ -0,0 +1,143 @@
+#ifndef REPOCONNMGR_HPP
+#define REPOCONNMGR_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+#include "MsgComm.hpp"
+#include "Config.hpp"
+
+#define REPO_WAIT_MARGIN 10000  // msec callers wait past a call's timeout before abandoning it
+
+namespace SDMS {
+namespace Core {
+
+/**
+ * @brief Shared, persistent connections from the core server to repository servers
+ *
+ * Holds one long-lived DEALER connection per repository (from config.repos),
+ * owned by a dedicated I/O thread, so that repository calls from task
+ * workers do not each pay for a new socket and CURVE handshake. Concurrent
+ * calls to the same repository are multiplexed over its connection; replies
+ * are matched to calls by frame context, as the repository server returns
+ * the context of each request with its reply.
+ *
+ * A call that times out fails on its own; other calls on the connection are
+ * unaffected. Its context is reserved for a while so that a late reply is
+ * recognized and dropped rather than matched to a newer call. If no reply at
+ * all has arrived on the connection since the call was made, the socket is
+ * presumed stale and is recreated (with linger 0, so requests still queued
+ * on it are dropped rather than delivered after a reconnect).
+ *
+ * Sockets queue messages only on completed connections, with a bounded send
+ * queue, and the I/O thread never blocks on a send. Calls wait for the
+ * connection to be established, up to their timeout. Only transport errors
+ * (connect failures or timeouts, a full send queue, or send failures) mark a
+ * repository as down: the connection is closed (failing the calls in
+ * progress on it), and calls made before the reconnect backoff expires fail
+ * immediately. The next call after that reconnects. The backoff doubles with
+ * each consecutive failure, and any reply resets it.
+ */
+class RepoConnMgr
+{
+public:
+    struct Stats
+    {
+        size_t      repos;          ///< Repositories with an open connection
+        size_t      down;           ///< Repositories in reconnect backoff
+        size_t      in_flight;      ///< Calls awaiting a reply
+        uint64_t    reconnects;     ///< Connections re-opened after a failure
+        uint64_t    resets;         ///< Stale connections recreated after calls timed out
+        uint64_t    timeouts;       ///< Calls that timed out
+    };
+
+    /**
+     * @brief Asynchronous request to a repository server
+     *
+     * The caller sets repo_id, timeout and on_complete; the rest is set by
+     * submit() and the I/O thread.
+     */
+    struct Request
+    {
+        Request() : timeout( 0 ), reply( 0 ) {}
+
+        std::string             repo_id;
+        uint32_t                timeout;    ///< Reply timeout in msec
+        std::function<void( Request & )> on_complete; ///< Called from I/O thread
+        MsgBuf                  buf;        ///< Serialized request
+        std::chrono::steady_clock::time_point deadline;
+        MsgBuf::Message *       reply;      ///< Reply message, null on failure
+    };
+
+    static RepoConnMgr & getInstance();
+
+    /**
+     * @brief Send a request to a repository server and wait for the reply
+     *
+     * Returns false if no reply is received within a_timeout msec (or the
+     * repository is down). On success, a_reply is set to the reply message,
+     * which the caller must free. Throws if the repository is not configured.
+     */
+    bool        sendRecv( const std::string & a_repo_id, MsgBuf::Message & a_msg, MsgBuf::Message *& a_reply, uint32_t a_timeout );
+
+    /**
+     * @brief Queue a request without waiting for its reply
+     *
+     * a_msg is serialized before returning. a_request must remain valid until
+     * its on_complete callback has run, at which point its reply (null on
+     * timeout or failure) is owned by the caller. on_complete must not block;
+     * it may free a_request. Throws if the repository is not configured.
+     */
+    void        submit( Request & a_request, MsgBuf::Message & a_msg );
+
+    void        getStats( Stats & a_stats );
+
+private:
+    typedef std::chrono::steady_clock::time_point   timepoint_t;
+
+    struct Conn
+    {
+        Conn() : comm( 0 ), connected( false ), next_ctx( 0 ), failures( 0 ) {}
+
+        std::string             address;
+        MsgComm *               comm;       ///< Null while closed
+        bool                    connected;  ///< Socket has accepted a message since it was opened
+        uint16_t                next_ctx;
+        std::deque<Request*>    queued;     ///< Waiting for the connection to be established
+        std::map<uint16_t,Request*> in_flight; ///< By frame context
+        std::map<uint16_t,timepoint_t> expired; ///< Contexts of timed out calls, reserved until given time
+        timepoint_t             last_reply; ///< Receipt of latest reply
+        uint32_t                failures;   ///< Consecutive connection failures
+        timepoint_t             retry_time; ///< End of reconnect backoff
+    };
+
+    RepoConnMgr();
+    ~RepoConnMgr();
+
+    void        ioThread();
+    void        startRequest( Request & a_request, timepoint_t a_now );
+    void        sendQueued( Conn & a_conn, const std::string & a_repo_id, timepoint_t a_now );
+    void        recvReply( Conn & a_conn, const std::string & a_repo_id );
+    void        closeConn( Conn & a_conn );
+    void        failConn( Conn & a_conn, const std::string & a_repo_id, timepoint_t a_now );
+    void        completeRequest( Request & a_request, MsgBuf::Message * a_reply );
+
+    Config &                        m_config;
+    std::thread *                   m_io_thread;
+    int                             m_wake_pipe[2];     ///< Wakes I/O thread when calls are queued
+    std::mutex                      m_mutex;
+    std::deque<Request*>            m_pending;
+    std::map<std::string,Conn>      m_conns;            ///< By repo ID (I/O thread only)
+    Stats                           m_stats;            ///< Guarded by m_mutex
+};
+
+}}
+
+#endif
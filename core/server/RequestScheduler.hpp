@@ -0,0 +1,293 @@
+#ifndef REQUESTSCHEDULER_HPP
+#define REQUESTSCHEDULER_HPP
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdint.h>
+
+namespace SDMS {
+namespace Core {
+
+/**
+ * @brief Admission control and fair queuing of client requests
+ *
+ * Requests are admitted per user ID through a token bucket (rate limiting)
+ * and bounded per-user and total queue lengths; rejected requests are given a
+ * retry-after estimate. Admitted requests are queued per user within one of
+ * two traffic classes (interactive and bulk). Dispatch selects a class by
+ * weighted fair queuing (class virtual time advances by 1/weight per
+ * dispatch), then serves the users of that class round-robin, one request per
+ * turn, so a single busy user can not starve others in the same class.
+ *
+ * Queued items are owned by the scheduler until popped. Not thread-safe; used
+ * only by a message router thread. Stats may be read from other threads.
+ */
+template<typename T>
+class RequestScheduler
+{
+public:
+    typedef std::chrono::steady_clock::time_point   timepoint_t;
+
+    enum TrafficClass
+    {
+        TC_INTERACTIVE = 0,
+        TC_BULK,
+        TC_COUNT
+    };
+
+    struct Stats
+    {
+        size_t      queued;
+        size_t      users;
+        uint64_t    dispatched;
+        uint64_t    rejected_rate;      ///< Rejected by per-user rate limit
+        uint64_t    rejected_queue;     ///< Rejected by per-user or total queue limit
+    };
+
+    /**
+     * @param a_user_rate - Sustained requests/sec per user (0 = no rate limit)
+     * @param a_user_burst - Token bucket depth per user
+     * @param a_user_queue_max - Max queued requests per user and class
+     * @param a_queue_max - Max queued requests in total
+     * @param a_interactive_weight - Dispatch weight of interactive class
+     * @param a_bulk_weight - Dispatch weight of bulk class
+     */
+    RequestScheduler( double a_user_rate, uint32_t a_user_burst, uint32_t a_user_queue_max, uint32_t a_queue_max, uint32_t a_interactive_weight, uint32_t a_bulk_weight ) :
+        m_user_rate( a_user_rate ),
+        m_user_burst( std::max( 1u, a_user_burst )),
+        m_user_queue_max( a_user_queue_max ),
+        m_queue_max( a_queue_max ),
+        m_vtime( 0 ),
+        m_size( 0 ),
+        m_interval( 0 ),
+        m_queued( 0 ),
+        m_users( 0 ),
+        m_dispatched( 0 ),
+        m_rejected_rate( 0 ),
+        m_rejected_queue( 0 )
+    {
+        m_class[TC_INTERACTIVE].cost = 1.0 / std::max( 1u, a_interactive_weight );
+        m_class[TC_BULK].cost = 1.0 / std::max( 1u, a_bulk_weight );
+    }
+
+    ~RequestScheduler()
+    {
+        for ( typename user_map_t::iterator u = m_user_map.begin(); u != m_user_map.end(); u++ )
+        {
+            for ( size_t c = 0; c < TC_COUNT; c++ )
+            {
+                for ( typename std::deque<T*>::iterator i = u->second.queue[c].begin(); i != u->second.queue[c].end(); i++ )
+                    delete *i;
+            }
+        }
+    }
+
+    inline bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    /**
+     * @brief Admit and queue a request
+     *
+     * @param a_limit - Apply rate limit (false for trusted system clients)
+     * @return 0 if request was queued; otherwise suggested retry delay (msec)
+     *         and the item remains owned by the caller.
+     */
+    uint32_t push( const std::string & a_uid, TrafficClass a_class, T * a_item, timepoint_t a_now, bool a_limit = true )
+    {
+        User & user = m_user_map[a_uid];
+        std::deque<T*> & queue = user.queue[a_class];
+
+        if ( !user.init )
+        {
+            user.init = true;
+            user.tokens = m_user_burst;
+            user.last = a_now;
+            inc( m_users, 1 );
+        }
+
+        if ( m_size >= m_queue_max || queue.size() >= m_user_queue_max )
+        {
+            inc( m_rejected_queue, 1 );
+            // Estimated time for the requests ahead (of this user or in total) to drain
+            return retryAfter( std::min( m_size, ( queue.size() + 1 ) * std::max<size_t>( 1, m_class[TC_INTERACTIVE].active.size() + m_class[TC_BULK].active.size() )));
+        }
+
+        if ( a_limit && m_user_rate > 0 )
+        {
+            refill( user, a_now );
+
+            if ( user.tokens < 1.0 )
+            {
+                inc( m_rejected_rate, 1 );
+                return clampRetry(( 1.0 - user.tokens ) * 1000.0 / m_user_rate );
+            }
+
+            user.tokens -= 1.0;
+        }
+
+        if ( queue.empty() )
+        {
+            Class & cls = m_class[a_class];
+
+            // Idle class may not bank dispatch credit
+            if ( cls.active.empty() )
+                cls.vtime = std::max( cls.vtime, m_vtime );
+
+            cls.active.push_back( &user );
+        }
+
+        queue.push_back( a_item );
+        m_size++;
+        inc( m_queued, 1 );
+
+        return 0;
+    }
+
+    /// Dequeue next request (scheduler must not be empty); ownership passes to caller
+    T * pop( timepoint_t a_now, TrafficClass & a_class )
+    {
+        size_t c, sel = TC_COUNT;
+
+        for ( c = 0; c < TC_COUNT; c++ )
+        {
+            if ( !m_class[c].active.empty() && ( sel == TC_COUNT || m_class[c].vtime < m_class[sel].vtime ))
+                sel = c;
+        }
+
+        Class & cls = m_class[sel];
+        User * user = cls.active.front();
+        T * item = user->queue[sel].front();
+
+        m_vtime = cls.vtime;
+        cls.vtime += cls.cost;
+
+        user->queue[sel].pop_front();
+        cls.active.pop_front();
+
+        if ( !user->queue[sel].empty() )
+            cls.active.push_back( user );
+
+        // Track average dispatch interval while backlogged (for retry-after estimates)
+        if ( m_last_pop != timepoint_t() )
+        {
+            uint64_t usec = std::chrono::duration_cast<std::chrono::microseconds>( a_now - m_last_pop ).count();
+            m_interval = m_interval ? ( m_interval * 7 + usec ) / 8 : usec;
+        }
+        m_last_pop = --m_size ? a_now : timepoint_t();
+
+        inc( m_queued, -1 );
+        inc( m_dispatched, 1 );
+
+        a_class = (TrafficClass)sel;
+        return item;
+    }
+
+    /// Remove state of users with no queued requests and full token buckets
+    void purge( timepoint_t a_now )
+    {
+        typename user_map_t::iterator u = m_user_map.begin();
+
+        while ( u != m_user_map.end() )
+        {
+            if ( u->second.queue[TC_INTERACTIVE].empty() && u->second.queue[TC_BULK].empty() )
+            {
+                refill( u->second, a_now );
+
+                if ( m_user_rate <= 0 || u->second.tokens >= m_user_burst )
+                {
+                    u = m_user_map.erase( u );
+                    inc( m_users, -1 );
+                    continue;
+                }
+            }
+
+            u++;
+        }
+    }
+
+    void getStats( Stats & a_stats ) const
+    {
+        a_stats.queued = m_queued.load( std::memory_order_relaxed );
+        a_stats.users = m_users.load( std::memory_order_relaxed );
+        a_stats.dispatched = m_dispatched.load( std::memory_order_relaxed );
+        a_stats.rejected_rate = m_rejected_rate.load( std::memory_order_relaxed );
+        a_stats.rejected_queue = m_rejected_queue.load( std::memory_order_relaxed );
+    }
+
+private:
+    struct User
+    {
+        User() : init( false ), tokens( 0 ) {}
+
+        bool            init;
+        double          tokens;
+        timepoint_t     last;
+        std::deque<T*>  queue[TC_COUNT];
+    };
+
+    struct Class
+    {
+        Class() : vtime( 0 ), cost( 1 ) {}
+
+        double              vtime;
+        double              cost;
+        std::deque<User*>   active;     ///< Users with queued requests, in service order
+    };
+
+    typedef std::unordered_map<std::string,User>    user_map_t;
+
+    void refill( User & a_user, timepoint_t a_now )
+    {
+        double secs = std::chrono::duration<double>( a_now - a_user.last ).count();
+
+        if ( secs > 0 )
+        {
+            a_user.tokens = std::min( (double)m_user_burst, a_user.tokens + secs * m_user_rate );
+            a_user.last = a_now;
+        }
+    }
+
+    uint32_t retryAfter( size_t a_ahead ) const
+    {
+        // Assume 1 msec per request if no dispatch history
+        return clampRetry(( a_ahead * ( m_interval ? m_interval : 1000 )) / 1000.0 );
+    }
+
+    static uint32_t clampRetry( double a_msec )
+    {
+        return (uint32_t) std::min( 30000.0, std::max( 100.0, a_msec ));
+    }
+
+    /// Single-writer update of stats read by other threads
+    template<typename V, typename D>
+    static inline void inc( std::atomic<V> & a_val, D a_delta )
+    {
+        a_val.store( a_val.load( std::memory_order_relaxed ) + a_delta, std::memory_order_relaxed );
+    }
+
+    double                  m_user_rate;
+    uint32_t                m_user_burst;
+    size_t                  m_user_queue_max;
+    size_t                  m_queue_max;
+    user_map_t              m_user_map;
+    Class                   m_class[TC_COUNT];
+    double                  m_vtime;            ///< Virtual time of last dispatch
+    size_t                  m_size;
+    timepoint_t             m_last_pop;
+    uint64_t                m_interval;         ///< Avg dispatch interval while backlogged (usec)
+    std::atomic<size_t>     m_queued;
+    std::atomic<size_t>     m_users;
+    std::atomic<uint64_t>   m_dispatched;
+    std::atomic<uint64_t>   m_rejected_rate;
+    std::atomic<uint64_t>   m_rejected_queue;
+};
+
+}}
+
+#endif
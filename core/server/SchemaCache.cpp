@@ -0,0 +1,280 @@
+#include <algorithm>
+#include "DynaLog.hpp"
+#include "TraceException.hpp"
+#include "SchemaCache.hpp"
+#include "SDMS.pb.h"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+SchemaCache::SchemaCache() :
+    m_ttl( Config::getInstance().schema_cache_ttl ),
+    m_max( Config::getInstance().schema_cache_max ),
+    m_generation(0),
+    m_hits(0),
+    m_misses(0),
+    m_invalidations(0)
+{
+    DL_DEBUG( "Schema cache TTL: " << m_ttl.count() << " sec, max entries: " << m_max );
+}
+
+SchemaCache::~SchemaCache()
+{
+}
+
+SchemaCache &
+SchemaCache::getInstance()
+{
+    static SchemaCache * cache = new SchemaCache();
+
+    return *cache;
+}
+
+/**
+ * @brief Get compiled validator of a schema on behalf of a client
+ *
+ * On a miss, the schema is loaded with a_loader (which also checks that the
+ * client may view the schema), compiled, and cached. A cached validator is
+ * only returned once the client's access to the schemas it references has
+ * been checked. Load, access and compile errors are thrown.
+ */
+SchemaCache::validator_t
+SchemaCache::getValidator( const std::string & a_id, const std::string & a_uid, const loader_t & a_loader )
+{
+    string          uid = a_uid.compare( 0, 2, "u/" ) == 0 ? a_uid : ( "u/" + a_uid );
+    uint64_t        gen;
+    Entry           entry;
+    validator_t     validator;
+    vector<string>  unchecked;
+    libjson::Value  ref;
+
+    {
+        lock_guard<mutex> lock( m_mutex );
+        timepoint_t now = chrono::steady_clock::now();
+        Entry * e = find( a_id, now );
+
+        if ( e && e->validator && ( e->pub || e->owner == uid ))
+        {
+            validator = e->validator;
+            uncheckedRefs( *e, uid, now, unchecked );
+        }
+
+        gen = m_generation;
+    }
+
+    if ( !validator )
+    {
+        m_misses++;
+
+        load( a_id, a_loader, entry );
+
+        // Client has access; use validator compiled for another client if present
+        lock_guard<mutex> lock( m_mutex );
+        timepoint_t now = chrono::steady_clock::now();
+        Entry * e = find( a_id, now );
+
+        if ( e && e->validator && gen == m_generation )
+        {
+            validator = e->validator;
+            uncheckedRefs( *e, uid, now, unchecked );
+        }
+    }
+    else
+        m_hits++;
+
+    if ( validator )
+    {
+        // Loader throws if client may not view a referenced schema
+        for ( vector<string>::iterator r = unchecked.begin(); r != unchecked.end(); r++ )
+            a_loader( *r, ref );
+
+        return validator;
+    }
+
+    entry.validator = compile( entry.def, uid, a_loader, &entry.refs );
+
+    store( a_id, entry, gen );
+
+    return entry.validator;
+}
+
+/**
+ * @brief Compile a schema, resolving $refs from the cache or with a_loader
+ *
+ * Cached definitions of referenced schemas are only used if public or owned
+ * by a_uid; others are loaded with a_loader (which checks access). If a_refs
+ * is given, it receives the IDs of all referenced schemas. The returned
+ * validator does not reference a_loader after compilation.
+ */
+SchemaCache::validator_t
+SchemaCache::compile( const nlohmann::json & a_schema, const std::string & a_uid, const loader_t & a_loader, std::vector<std::string> * a_refs )
+{
+    string uid = a_uid.compare( 0, 2, "u/" ) == 0 ? a_uid : ( "u/" + a_uid );
+
+    // Refs are only resolved while the root schema is set; loader is released after
+    shared_ptr<const loader_t*> loader = make_shared<const loader_t*>( &a_loader );
+
+    shared_ptr<nlohmann::json_schema::json_validator> validator = make_shared<nlohmann::json_schema::json_validator>(
+        [this,loader,uid,a_refs]( const nlohmann::json_uri & a_uri, nlohmann::json & a_value )
+        {
+            if ( !*loader )
+                EXCEPT( ID_INTERNAL_ERROR, "Schema reference can not be resolved after compilation" );
+
+            resolveRef( a_uri, a_value, uid, **loader, a_refs );
+        });
+
+    try
+    {
+        validator->set_root_schema( a_schema );
+    }
+    catch( ... )
+    {
+        *loader = 0;
+        throw;
+    }
+
+    *loader = 0;
+
+    return validator;
+}
+
+/// Invalidate all entries (called after any schema change)
+void
+SchemaCache::invalidateAll()
+{
+    lock_guard<mutex> lock( m_mutex );
+
+    m_entries.clear();
+    m_generation++;
+    m_invalidations++;
+}
+
+void
+SchemaCache::getStats( Stats & a_stats )
+{
+    a_stats.hits = m_hits.load();
+    a_stats.misses = m_misses.load();
+    a_stats.invalidations = m_invalidations.load();
+
+    lock_guard<mutex> lock( m_mutex );
+    a_stats.entries = m_entries.size();
+}
+
+/// Load and parse a schema record
+void
+SchemaCache::load( const std::string & a_id, const loader_t & a_loader, Entry & a_entry )
+{
+    libjson::Value sch;
+
+    a_loader( a_id, sch );
+
+    const libjson::Value::Object & obj = sch.asArray().begin()->asObject();
+
+    a_entry.def = nlohmann::json::parse( obj.getValue( "def" ).toString() );
+
+    if ( obj.has( "pub" ))
+        a_entry.pub = obj.asBool();
+
+    if ( obj.has( "own_id" ) && !obj.value().isNull() )
+        a_entry.owner = obj.asString();
+}
+
+/// Cache an entry unless the cache was invalidated since a_generation was read
+void
+SchemaCache::store( const std::string & a_id, Entry & a_entry, uint64_t a_generation )
+{
+    if ( !enabled() )
+        return;
+
+    lock_guard<mutex> lock( m_mutex );
+
+    if ( a_generation != m_generation )
+        return;
+
+    entry_map_t::iterator e = m_entries.find( a_id );
+
+    // Do not replace a compiled entry with a (concurrently loaded) reference-only entry
+    if ( e != m_entries.end() && e->second.validator && !a_entry.validator )
+        return;
+
+    if ( e == m_entries.end() && m_entries.size() >= m_max )
+        m_entries.clear();
+
+    a_entry.expires = chrono::steady_clock::now() + m_ttl;
+    m_entries[a_id] = a_entry;
+}
+
+/// Find an unexpired entry (m_mutex must be held)
+SchemaCache::Entry *
+SchemaCache::find( const std::string & a_id, timepoint_t a_now )
+{
+    entry_map_t::iterator e = m_entries.find( a_id );
+
+    if ( e == m_entries.end() )
+        return 0;
+
+    if ( e->second.expires <= a_now )
+    {
+        m_entries.erase( e );
+        return 0;
+    }
+
+    return &e->second;
+}
+
+/**
+ * Collects the schemas referenced by a cached validator that are neither
+ * public nor owned by a_uid, per their cached entries; references without
+ * an entry are collected too (m_mutex must be held).
+ */
+void
+SchemaCache::uncheckedRefs( const Entry & a_entry, const std::string & a_uid, timepoint_t a_now, std::vector<std::string> & a_ids )
+{
+    Entry * e;
+
+    for ( vector<string>::const_iterator r = a_entry.refs.begin(); r != a_entry.refs.end(); r++ )
+    {
+        e = find( *r, a_now );
+
+        if ( !e || !( e->pub || e->owner == a_uid ))
+            a_ids.push_back( *r );
+    }
+}
+
+/// Schema loader callback of validators; a $ref path is the ID of the referenced schema
+void
+SchemaCache::resolveRef( const nlohmann::json_uri & a_uri, nlohmann::json & a_value, const std::string & a_uid, const loader_t & a_loader, std::vector<std::string> * a_refs )
+{
+    string      id = a_uri.path().substr( 1 ); // Skip leading "/"
+    uint64_t    gen;
+    Entry       entry;
+
+    if ( a_refs && std::find( a_refs->begin(), a_refs->end(), id ) == a_refs->end() )
+        a_refs->push_back( id );
+
+    {
+        lock_guard<mutex> lock( m_mutex );
+        Entry * e = find( id, chrono::steady_clock::now() );
+
+        // Definitions of non-public schemas are only used for their owner; others load (and check access)
+        if ( e && ( e->pub || e->owner == a_uid ))
+        {
+            a_value = e->def;
+            return;
+        }
+
+        gen = m_generation;
+    }
+
+    DL_DEBUG( "Load schema ref, scheme: " << a_uri.scheme() << ", path: " << a_uri.path() << ", id: " << id );
+
+    load( id, a_loader, entry );
+
+    a_value = entry.def;
+
+    store( id, entry, gen );
+}
+
+}}
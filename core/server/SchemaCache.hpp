@@ -0,0 +1,127 @@
+#ifndef SCHEMACACHE_HPP
+#define SCHEMACACHE_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include <nlohmann/json-schema.hpp>
+#include "libjson.hpp"
+#include "Config.hpp"
+
+namespace SDMS {
+namespace Core {
+
+/**
+ * @brief Shared cache of compiled metadata schema validators
+ *
+ * Entries are keyed by schema ID ("id:ver") and hold the parsed schema
+ * definition and, once the schema has been used as a root schema, its
+ * compiled validator (with all $refs resolved). Definitions loaded to resolve
+ * $refs are cached too, so compiling a schema only loads the referenced
+ * schemas that are not yet cached. Compiled validators are immutable and may
+ * be used by any number of threads at once.
+ *
+ * Validators of non-public schemas are only served from the cache to the
+ * schema owner; other clients load the schema record from the DB (which
+ * checks permissions) before the cached validator is used. The same applies
+ * to the schemas a validator references: cached definitions resolve $refs
+ * only for their owner (or if public), and before a cached validator is
+ * served, the client's access to each non-public schema it references that
+ * the client does not own is checked with the loader. A schema change
+ * can affect every schema that references it, so any schema update,
+ * revision, or deletion invalidates the whole cache. Entries expire after
+ * config.schema_cache_ttl seconds, and the cache is cleared when it reaches
+ * config.schema_cache_max entries.
+ */
+class SchemaCache
+{
+public:
+    typedef std::shared_ptr<const nlohmann::json_schema::json_validator>    validator_t;
+
+    /// Loads a schema record (as returned by DatabaseAPI::schemaView) on behalf of the current client
+    typedef std::function<void( const std::string & a_id, libjson::Value & a_result )>  loader_t;
+
+    struct Stats
+    {
+        uint64_t    hits;
+        uint64_t    misses;
+        uint64_t    invalidations;
+        size_t      entries;
+    };
+
+    static SchemaCache & getInstance();
+
+    inline bool     enabled() const { return m_ttl.count() > 0; }
+    validator_t     getValidator( const std::string & a_id, const std::string & a_uid, const loader_t & a_loader );
+    validator_t     compile( const nlohmann::json & a_schema, const std::string & a_uid, const loader_t & a_loader, std::vector<std::string> * a_refs = 0 );
+    void            invalidateAll();
+    void            getStats( Stats & a_stats );
+
+private:
+    typedef std::chrono::steady_clock::time_point   timepoint_t;
+
+    struct Entry
+    {
+        Entry() : pub( false ) {}
+
+        nlohmann::json  def;
+        bool            pub;
+        std::string     owner;
+        validator_t     validator;  ///< Compiled validator (null until used as root schema)
+        std::vector<std::string> refs; ///< IDs of schemas referenced by validator
+        timepoint_t     expires;
+    };
+
+    typedef std::unordered_map<std::string,Entry>   entry_map_t;
+
+    SchemaCache();
+    ~SchemaCache();
+
+    void            load( const std::string & a_id, const loader_t & a_loader, Entry & a_entry );
+    void            store( const std::string & a_id, Entry & a_entry, uint64_t a_generation );
+    Entry *         find( const std::string & a_id, timepoint_t a_now );
+    void            uncheckedRefs( const Entry & a_entry, const std::string & a_uid, timepoint_t a_now, std::vector<std::string> & a_ids );
+    void            resolveRef( const nlohmann::json_uri & a_uri, nlohmann::json & a_value, const std::string & a_uid, const loader_t & a_loader, std::vector<std::string> * a_refs );
+
+    std::chrono::seconds    m_ttl;
+    size_t                  m_max;
+    std::mutex              m_mutex;
+    entry_map_t             m_entries;
+    uint64_t                m_generation;   ///< Incremented on invalidation (guarded by m_mutex)
+    std::atomic<uint64_t>   m_hits;
+    std::atomic<uint64_t>   m_misses;
+    std::atomic<uint64_t>   m_invalidations;
+};
+
+/**
+ * @brief Schema validation error handler that appends error descriptions to a string
+ */
+class SchemaErrorCollector : public nlohmann::json_schema::basic_error_handler
+{
+public:
+    explicit SchemaErrorCollector( std::string & a_errors ) : m_errors( a_errors ) {}
+
+    void error( const nlohmann::json_pointer<nlohmann::basic_json<>> & a_ptr, const nlohmann::json & a_inst, const std::string & a_err_msg ) override
+    {
+        (void) a_inst;
+        const std::string & path = a_ptr.to_string();
+
+        if ( m_errors.size() == 0 )
+            m_errors = "Schema Validation Error(s):\n";
+
+        m_errors += "At " + (path.size()?path:"top-level") + ": " + a_err_msg + "\n";
+    }
+
+private:
+    std::string &   m_errors;
+};
+
+}}
+
+#endif
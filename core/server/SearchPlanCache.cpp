@@ -0,0 +1,80 @@
+#include "DynaLog.hpp"
+#include "SearchPlanCache.hpp"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+SearchPlanCache::SearchPlanCache() :
+    m_max( Config::getInstance().search_plan_cache_max ),
+    m_hits(0),
+    m_misses(0),
+    m_compile_usec(0)
+{
+    DL_DEBUG( "Search plan cache max entries: " << m_max );
+}
+
+SearchPlanCache::~SearchPlanCache()
+{
+}
+
+SearchPlanCache &
+SearchPlanCache::getInstance()
+{
+    static SearchPlanCache * cache = new SearchPlanCache();
+
+    return *cache;
+}
+
+/// Get plan of a request shape; returns false on a miss
+bool
+SearchPlanCache::find( const std::string & a_key, Plan & a_plan )
+{
+    if ( enabled() )
+    {
+        lock_guard<mutex> lock( m_mutex );
+        unordered_map<string,Plan>::const_iterator p = m_plans.find( a_key );
+
+        if ( p != m_plans.end() )
+        {
+            a_plan = p->second;
+            m_hits++;
+            return true;
+        }
+    }
+
+    m_misses++;
+
+    return false;
+}
+
+/// Cache a newly compiled plan and account for its compile time
+void
+SearchPlanCache::store( const std::string & a_key, const Plan & a_plan, uint64_t a_compile_usec )
+{
+    m_compile_usec += a_compile_usec;
+
+    if ( !enabled() )
+        return;
+
+    lock_guard<mutex> lock( m_mutex );
+
+    if ( m_plans.size() >= m_max && m_plans.find( a_key ) == m_plans.end() )
+        m_plans.clear();
+
+    m_plans[a_key] = a_plan;
+}
+
+void
+SearchPlanCache::getStats( Stats & a_stats )
+{
+    a_stats.hits = m_hits.load();
+    a_stats.misses = m_misses.load();
+    a_stats.compile_usec = m_compile_usec.load();
+
+    lock_guard<mutex> lock( m_mutex );
+    a_stats.entries = m_plans.size();
+}
+
+}}
@@ -0,0 +1,66 @@
+#ifndef SEARCHPLANCACHE_HPP
+#define SEARCHPLANCACHE_HPP
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+#include "Config.hpp"
+
+namespace SDMS {
+namespace Core {
+
+/**
+ * @brief Shared cache of compiled search query plans
+ *
+ * A plan holds the (JSON-escaped) AQL fragments of a search request, with all
+ * request values that are passed as bind parameters (owner, tags, creator,
+ * time range, schema, collections, paging) left as parameter slots. Plans are
+ * keyed by the shape of the request: the options that alter the AQL, and the
+ * text, ID/alias, and metadata expressions that are compiled into it. A
+ * repeated search (e.g. paging through results) only needs its bind
+ * parameters filled in. Plans do not depend on DB state, so entries do not
+ * expire; the cache is cleared when it reaches config.search_plan_cache_max
+ * entries (0 disables the cache).
+ */
+class SearchPlanCache
+{
+public:
+    struct Plan
+    {
+        std::string     qry_begin;
+        std::string     qry_end;
+        std::string     qry_filter;
+    };
+
+    struct Stats
+    {
+        uint64_t    hits;
+        uint64_t    misses;
+        uint64_t    compile_usec;   ///< Total time spent compiling plans
+        size_t      entries;
+    };
+
+    static SearchPlanCache & getInstance();
+
+    inline bool     enabled() const { return m_max > 0; }
+    bool            find( const std::string & a_key, Plan & a_plan );
+    void            store( const std::string & a_key, const Plan & a_plan, uint64_t a_compile_usec );
+    void            getStats( Stats & a_stats );
+
+private:
+    SearchPlanCache();
+    ~SearchPlanCache();
+
+    size_t                                  m_max;
+    std::mutex                              m_mutex;
+    std::unordered_map<std::string,Plan>    m_plans;
+    std::atomic<uint64_t>                   m_hits;
+    std::atomic<uint64_t>                   m_misses;
+    std::atomic<uint64_t>                   m_compile_usec;
+};
+
+}}
+
+#endif
@@ -15,16 +15,23 @@ using namespace std;
 namespace SDMS {
 namespace Core {
 
+#define RETRY_WHEEL_SLOTS 1024
+
 
 
 TaskMgr::TaskMgr():
     m_config(Config::getInstance()),
+    m_page_size( max( m_config.task_load_page_size, (uint32_t)1 )),
+    m_loading(true),
+    m_tasks_retry( chrono::seconds( 1 ), RETRY_WHEEL_SLOTS ),
     m_worker_next(0),
-    m_maint_thread(0)
+    m_maint_thread(0),
+    m_xfr_monitor(0)
 {
     TaskWorker *worker;
 
     m_maint_thread = new thread( &TaskMgr::maintenanceThread, this );
+    m_xfr_monitor = new TransferMonitor( [this]( Task * a_task ){ resumeTask( a_task ); });
 
     unique_lock<mutex>   lock( m_worker_mutex );
 
@@ -52,28 +59,25 @@ TaskMgr::TaskMgr():
 
     DL_DEBUG("TaskMgr creating " << m_config.num_task_worker_threads << " task worker threads." );
 
+    // Transfer tasks may not occupy the workers reserved for quick tasks
+    m_lanes[TL_QUICK].max_running = m_config.num_task_worker_threads;
+    if ( m_config.num_task_worker_threads > m_config.task_quick_workers )
+        m_lanes[TL_TRANSFER].max_running = m_config.num_task_worker_threads - m_config.task_quick_workers;
+    else
+        m_lanes[TL_TRANSFER].max_running = 1;
+
+    DL_DEBUG("TaskMgr max transfer workers: " << m_lanes[TL_TRANSFER].max_running );
+
+    // Workers add themselves to the idle worker list when they first request a task
     for ( uint32_t i = 0; i < m_config.num_task_worker_threads; i++ )
     {
         worker = new TaskWorker( *this, i );
-        if ( i )
-        {
-            m_workers.back()->m_next = worker;
-        }
-
         m_workers.push_back( worker );
     }
 
-    m_worker_next = m_workers.front();
-
     lock.unlock();
 
-    // Load ready & running tasks and schedule workers
-    // TODO This will break if there are too many tasks - must implement a paging system
-    // to load chunks of tasks.
-    DatabaseAPI  db( m_config.db_url, m_config.db_user, m_config.db_pass );
-    libjson::Value tasks;
-    db.taskLoadReady( tasks );
-    newTasks( tasks );
+    loadReadyTasks();
 }
 
 TaskMgr::~TaskMgr()
@@ -88,6 +92,50 @@ TaskMgr::getInstance()
     return *mgr;
 }
 
+const char *
+TaskMgr::laneName( uint32_t a_lane )
+{
+    switch ( a_lane )
+    {
+    case TL_QUICK:      return "quick";
+    case TL_TRANSFER:   return "transfer";
+    default:            return "unknown";
+    }
+}
+
+/**
+ * @brief Load ready & running tasks from DB and schedule workers
+ *
+ * Tasks are loaded in pages (task_load_page_size) and workers are scheduled
+ * as each page arrives, so startup time-to-first-task and reply sizes do not
+ * depend on the size of the task backlog. Tasks unblocked by workers while
+ * loading is in progress may also be returned by later pages; these are
+ * recorded by newTasks() and skipped here.
+ */
+void
+TaskMgr::loadReadyTasks()
+{
+    DatabaseAPI     db( m_config.db_url, m_config.db_user, m_config.db_pass );
+    libjson::Value  tasks;
+    string          cursor;
+    size_t          count = 0, pages = 0;
+
+    do
+    {
+        db.taskLoadReady( cursor, m_page_size, tasks );
+        count += scheduleTasks( tasks.asArray(), true );
+        pages++;
+    }
+    while ( cursor.size() );
+
+    lock_guard<mutex> lock( m_worker_mutex );
+
+    m_loading = false;
+    m_load_skip.clear();
+
+    DL_INFO( "TaskMgr loaded " << count << " ready task(s) in " << pages << " page(s)" );
+}
+
 /**
  * @brief Task background maintenance thread
  *
@@ -100,8 +148,9 @@ TaskMgr::maintenanceThread()
     duration_t                              purge_per = chrono::seconds( m_config.task_purge_period );
     timepoint_t                             now = chrono::system_clock::now();
     timepoint_t                             purge_next = now + purge_per;
-    timepoint_t                             timeout;
-    multimap<timepoint_t,Task*>::iterator   t;
+    timepoint_t                             timeout, next_retry;
+    vector<Task*>                           retry_tasks;
+    vector<Task*>::iterator                 t;
     unique_lock<mutex>                      sched_lock( m_worker_mutex, defer_lock );
     unique_lock<mutex>                      maint_lock( m_maint_mutex );
 
@@ -109,27 +158,16 @@ TaskMgr::maintenanceThread()
 
     while( 1 )
     {
-        // Default timeout is time until next purge
+        // Default timeout is time until next purge, adjust if a task retry should happen sooner
         timeout = purge_next;
-        //DL_INFO( "MAINT: Next purge: " << chrono::duration_cast<chrono::seconds>( purge_next.time_since_epoch()).count() );
-        //DL_INFO( "MAINT: tasks in retry queue: " << m_tasks_retry.size() );
+        next_retry = m_tasks_retry.nextExpiry();
 
-        // Adjust timeout if a task retry should happen sooner
-        t = m_tasks_retry.begin();
-        if ( t != m_tasks_retry.end() )
-        {
-            //DL_INFO( "MAINT: Check next task retry: " << t->second->task_id );
-            if ( t->first < purge_next )
-            {
-                timeout = t->first;
-                //DL_INFO( "MAINT: timeout based on next retry: " << chrono::duration_cast<chrono::seconds>( t->first.time_since_epoch()).count() );
-            }
-        }
+        if ( next_retry < timeout )
+            timeout = next_retry;
 
         DL_INFO( "MAINT: timeout: " << chrono::duration_cast<chrono::seconds>( timeout.time_since_epoch()).count() );
 
-        // TODO - WHY are we using a mutex here that is used nowhere else? Is this left over from
-        // previous design where worker threads needed be to excluded? ANALYZE AND FIX
+        // Maintenance mutex guards the retry timer wheel, which is shared with retryTask()
 
         if ( timeout > now )
         {
@@ -149,27 +187,26 @@ TaskMgr::maintenanceThread()
         }
 
         maint_lock.lock();
-        sched_lock.lock();
 
         // Reschedule tasks for retry
         DL_INFO( "MAINT: tasks in retry queue: " << m_tasks_retry.size() );
 
-        //worker = m_worker_next;
+        m_tasks_retry.expire( now, [&retry_tasks]( Task * a_task ){ retry_tasks.push_back( a_task ); });
 
-        for ( t = m_tasks_retry.begin(); t != m_tasks_retry.end(); )
+        if ( retry_tasks.size() )
         {
-            if ( t->first <= now )
+            sched_lock.lock();
+
+            for ( t = retry_tasks.begin(); t != retry_tasks.end(); t++ )
             {
-                DL_INFO( "MAINT: rescheduling failed task " << t->second->task_id );
+                DL_INFO( "MAINT: rescheduling failed task " << (*t)->task_id );
 
-                retryTaskAndScheduleWorker( t->second );
-                t = m_tasks_retry.erase( t );
+                queueTaskAndScheduleWorker( *t );
             }
-            else
-                break;
-        }
 
-        sched_lock.unlock();
+            sched_lock.unlock();
+            retry_tasks.clear();
+        }
 
         now = chrono::system_clock::now();
     }
@@ -199,30 +236,26 @@ TaskMgr::purgeTaskHistory() const
 /**
  * @brief Public method to add a new task to the "ready" queue
  * @param a_task_id - Task ID for NEW or READY task
+ * @param a_type - Task type (TaskType)
+ * @param a_owner - Task owner (client ID)
  *
  * Adds task to ready queue and schedules a worker if available. Called by
  * ClientWorkers or other external entities.
- *
- * NOTE: Takes ownership of JSON value leaving a NULL value in place.
  */
 void
-TaskMgr::newTask( const std::string & a_task_id )
+TaskMgr::newTask( const std::string & a_task_id, uint32_t a_type, const std::string & a_owner )
 {
     DL_DEBUG("TaskMgr scheduling 1 new task");
 
-    // TODO BREAKS FAIR SCHEDULING - under heavy loading, this method will allow new tasks
-    // to take priority over older tasks that may not be loaded. When off-loading is 
-    // added, need to check here for overflow and only schedule if system is below
-    // capacity.
     lock_guard<mutex> lock( m_worker_mutex );
 
-    addNewTaskAndScheduleWorker( a_task_id );
+    addNewTaskAndScheduleWorker( a_task_id, a_type, a_owner );
 }
 
 /**
  * @brief Internal method to add one or more new tasks
  * 
- * @param a_tasks JSON array of task IDs for NEW and READY tasks
+ * @param a_tasks JSON array of task descriptors ({id,type,client}) for NEW and READY tasks
  *
  * Adds task(s) to ready queue and schedules workers if available. Called by
  * TaskWorkers after finalizing a task returns new and/or unblocked tasks.
@@ -233,16 +266,10 @@ TaskMgr::newTasks( const libjson::Value & a_tasks )
     try
     {
         const libjson::Value::Array & arr = a_tasks.asArray();
-        libjson::Value::ArrayConstIter t = arr.begin();
 
         DL_DEBUG("TaskMgr scheduling " << arr.size() << " new task(s)");
 
-        lock_guard<mutex> lock( m_worker_mutex );
-
-        for ( ; t != arr.end(); t++ )
-        {
-            addNewTaskAndScheduleWorker( t->asString() );
-        }
+        scheduleTasks( arr, false );
     }
     catch(...)
     {
@@ -250,42 +277,222 @@ TaskMgr::newTasks( const libjson::Value & a_tasks )
     }
 }
 
+/**
+ * @brief Private method to add tasks and schedule workers in bounded chunks
+ *
+ * @param a_tasks - JSON array of task descriptors
+ * @param a_loading - True if tasks are from startup loading
+ * @return Number of tasks scheduled
+ *
+ * The scheduling lock is released after every chunk (task_load_page_size) so
+ * that large batches do not stall workers waiting in getNextTask().
+ */
+size_t
+TaskMgr::scheduleTasks( const libjson::Value::Array & a_tasks, bool a_loading )
+{
+    libjson::Value::ArrayConstIter t = a_tasks.begin();
+    size_t n, count = 0;
+
+    while ( t != a_tasks.end() )
+    {
+        lock_guard<mutex> lock( m_worker_mutex );
+
+        for ( n = 0; n < m_page_size && t != a_tasks.end(); n++, t++ )
+        {
+            const libjson::Value::Object & obj = t->asObject();
+            const string & task_id = obj.getString( "id" );
+
+            if ( m_loading )
+            {
+                if ( !a_loading )
+                    m_load_skip.insert( task_id );
+                else if ( m_load_skip.erase( task_id ))
+                    continue;
+            }
+
+            addNewTaskAndScheduleWorker( task_id, (uint32_t)obj.getNumber( "type" ), obj.getString( "client" ));
+            count++;
+        }
+    }
+
+    return count;
+}
+
 
 /**
- * @brief Private method to add task and schedule
- * 
- * @param a_task - JSON task descriptor
+ * @brief Private method to create task and schedule
  *
  * NOTE: must be called with m_worker_mutex held by caller
  */
 void
-TaskMgr::addNewTaskAndScheduleWorker( const std::string & a_task_id )
+TaskMgr::addNewTaskAndScheduleWorker( const std::string & a_task_id, uint32_t a_type, const std::string & a_owner )
 {
     // TODO Add logic to limit max number of ready tasks in memory
 
-    m_tasks_ready.push_back( new Task( a_task_id ));
+    queueTaskAndScheduleWorker( new Task( a_task_id, laneForType( a_type ), a_owner ));
+}
 
-    if ( m_worker_next )
+/**
+ * @brief Private method to queue a new or retried task and schedule
+ *
+ * Task is added to the owner's queue in the task's lane. A worker is woken
+ * only if the lane has capacity for another running task.
+ *
+ * NOTE: must be called with m_worker_mutex held by caller
+ */
+void
+TaskMgr::queueTaskAndScheduleWorker( Task * a_task )
+{
+    Lane & lane = m_lanes[a_task->lane];
+    deque<Task*> & queue = lane.queues[a_task->owner];
+
+    if ( queue.empty() )
+        lane.owners.push_back( a_task->owner );
+
+    a_task->queued_time = chrono::system_clock::now();
+    queue.push_back( a_task );
+    lane.depth++;
+
+    if ( lane.running < lane.max_running )
+        wakeNextWorker();
+}
+
+/**
+ * @brief Hand off a task waiting on a Globus transfer to the transfer monitor
+ *
+ * Called by task workers after submitting a transfer. The worker gives up
+ * ownership of the task and may process other tasks in the mean time.
+ */
+void
+TaskMgr::monitorTransfer( Task * a_task )
+{
+    m_xfr_monitor->monitor( a_task );
+}
+
+/**
+ * @brief Requeue a task after its monitored transfer completed or failed
+ *
+ * Called from the transfer monitor thread. Remaining steps after a transfer
+ * are short, so the task is placed in the quick lane.
+ */
+void
+TaskMgr::resumeTask( Task * a_task )
+{
+    lock_guard<mutex> lock( m_worker_mutex );
+
+    a_task->lane = TL_QUICK;
+    queueTaskAndScheduleWorker( a_task );
+}
+
+/**
+ * @brief Get highest priority lane that has ready tasks and spare capacity
+ * @return Lane index, or TL_COUNT if no task can be dispatched
+ *
+ * NOTE: must be called with m_worker_mutex held by caller
+ */
+uint32_t
+TaskMgr::nextLane() const
+{
+    for ( uint32_t l = 0; l < TL_COUNT; l++ )
     {
-        DL_DEBUG("Waking task worker " << m_worker_next->id() );
-        m_worker_next->m_run = true;
-        m_worker_next->m_cvar.notify_one();
-        m_worker_next = m_worker_next->m_next?m_worker_next->m_next:0;
+        if ( m_lanes[l].depth && m_lanes[l].running < m_lanes[l].max_running )
+            return l;
     }
+
+    return TL_COUNT;
 }
 
-void
-TaskMgr::retryTaskAndScheduleWorker( Task * a_task )
+/**
+ * @brief Dequeue next task from lane, rotating between owners
+ *
+ * NOTE: must be called with m_worker_mutex held by caller
+ */
+TaskMgr::Task *
+TaskMgr::popTask( uint32_t a_lane )
 {
-    m_tasks_ready.push_back( a_task );
+    Lane &      lane = m_lanes[a_lane];
+    string      owner = lane.owners.front();
+    Task *      task;
+    uint64_t    latency;
+
+    lane.owners.pop_front();
+
+    unordered_map<string,deque<Task*>>::iterator q = lane.queues.find( owner );
+
+    task = q->second.front();
+    q->second.pop_front();
+
+    if ( q->second.empty() )
+        lane.queues.erase( q );
+    else
+        lane.owners.push_back( owner );
+
+    latency = chrono::duration_cast<chrono::microseconds>( chrono::system_clock::now() - task->queued_time ).count();
+
+    lane.depth--;
+    lane.running++;
+    lane.dispatched++;
+    lane.latency_tot += latency;
+    if ( latency > lane.latency_max )
+        lane.latency_max = latency;
 
+    return task;
+}
+
+/**
+ * @brief Wake most recently idled worker, if any
+ *
+ * NOTE: must be called with m_worker_mutex held by caller
+ */
+void
+TaskMgr::wakeNextWorker()
+{
     if ( m_worker_next )
     {
         DL_DEBUG("Waking task worker " << m_worker_next->id() );
         m_worker_next->m_run = true;
         m_worker_next->m_cvar.notify_one();
-        m_worker_next = m_worker_next->m_next?m_worker_next->m_next:0;
+        m_worker_next = m_worker_next->m_next;
+    }
+}
+
+/**
+ * @brief Get per-lane scheduling metrics
+ *
+ * Dispatch counts and latencies are reset on each call unless a_reset is false.
+ */
+void
+TaskMgr::getStats( LaneStats a_stats[TL_COUNT], size_t & a_retry_depth, size_t & a_xfr_count, bool a_reset )
+{
+    {
+        lock_guard<mutex> lock( m_worker_mutex );
+
+        for ( uint32_t l = 0; l < TL_COUNT; l++ )
+        {
+            Lane & lane = m_lanes[l];
+            LaneStats & stats = a_stats[l];
+
+            stats.depth = lane.depth;
+            stats.running = lane.running;
+            stats.max_running = lane.max_running;
+            stats.dispatched = lane.dispatched;
+            stats.latency_avg = lane.dispatched ? lane.latency_tot / lane.dispatched : 0;
+            stats.latency_max = lane.latency_max;
+
+            if ( a_reset )
+            {
+                lane.dispatched = 0;
+                lane.latency_tot = 0;
+                lane.latency_max = 0;
+            }
+        }
     }
+
+    a_xfr_count = m_xfr_monitor->size();
+
+    lock_guard<mutex> lock( m_maint_mutex );
+
+    a_retry_depth = m_tasks_retry.size();
 }
 
 
@@ -340,25 +547,37 @@ TaskMgr::cancelTask( const std::string & a_task_id )
 TaskMgr::Task *
 TaskMgr::getNextTask( ITaskWorker * a_worker )
 {
-    Task * task = 0;
+    Task *      task = 0;
+    uint32_t    lane;
 
     unique_lock<mutex> lock( m_worker_mutex );
 
-    if ( m_tasks_ready.empty() )
+    // Release lane slot held by worker's previous task (if any)
+    if ( a_worker->m_lane < TL_COUNT )
     {
-        // No work right now, put worker at front of ready worker queue
+        m_lanes[a_worker->m_lane].running--;
+        a_worker->m_lane = UINT32_MAX;
+    }
+
+    while (( lane = nextLane() ) == TL_COUNT )
+    {
+        // No work right now, put worker at front of idle worker list
         a_worker->m_run = false;
         a_worker->m_next = m_worker_next;
         m_worker_next = a_worker;
 
-        // Sleep until work available, run flag suppresses spurious wakes
-        while ( m_tasks_ready.empty() || !a_worker->m_run )
+        // Sleep until woken, run flag suppresses spurious wakes. If the task
+        // was taken by another worker, the loop puts this worker back to sleep.
+        while ( !a_worker->m_run )
             a_worker->m_cvar.wait( lock );
     }
 
-    // Pop next task from ready queue and place in running map
-    task = m_tasks_ready.front();
-    m_tasks_ready.pop_front();
+    task = popTask( lane );
+    a_worker->m_lane = lane;
+
+    // Pass on remaining work (i.e. lane capacity freed by previous task) to an idle worker
+    if ( nextLane() != TL_COUNT )
+        wakeNextWorker();
 
     return task;
 }
@@ -392,7 +611,7 @@ TaskMgr::retryTask( Task * a_task )
 
         lock_guard<mutex> lock( m_maint_mutex );
 
-        m_tasks_retry.insert( make_pair( a_task->retry_time, a_task ));
+        m_tasks_retry.insert( a_task->retry_time, a_task );
         m_maint_cvar.notify_one();
     }
     else if ( now < a_task->retry_fail_time )
@@ -408,7 +627,7 @@ TaskMgr::retryTask( Task * a_task )
 
         lock_guard<mutex> lock(m_maint_mutex);
 
-        m_tasks_retry.insert( make_pair( a_task->retry_time, a_task ));
+        m_tasks_retry.insert( a_task->retry_time, a_task );
         m_maint_cvar.notify_one();
     }
     else
@@ -7,6 +7,8 @@
 #include <list>
 #include <deque>
 #include <map>
+#include <unordered_set>
+#include <unordered_map>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -14,22 +16,63 @@
 #include "ITaskMgr.hpp"
 #include "ITaskWorker.hpp"
 #include "Config.hpp"
+#include "TimerWheel.hpp"
+#include "TransferMonitor.hpp"
 #include "SDMS_Auth.pb.h"
 #include "SDMS.pb.h"
 
 namespace SDMS {
 namespace Core {
 
+/**
+ * @brief Schedules tasks onto task workers
+ *
+ * Ready tasks are queued in per-class lanes (see ITaskMgr::TaskLane) that are
+ * served in priority order. Within a lane, tasks are queued per owner (client)
+ * and owners are served round-robin so that a single user with a large
+ * backlog can not starve others. The number of workers that may run tasks
+ * from the transfer lane is capped so that some workers always remain
+ * available for quick tasks. Tasks with transient failures are held in a timer
+ * wheel by the maintenance thread until their retry time. Tasks waiting on
+ * Globus transfers are held by the transfer monitor and do not occupy a
+ * worker until the transfer completes.
+ */
 class TaskMgr : public ITaskMgr
 {
 public:
+    struct LaneStats
+    {
+        size_t      depth;          ///< Number of queued tasks
+        size_t      running;        ///< Number of tasks assigned to workers
+        size_t      max_running;    ///< Max number of workers for lane
+        uint64_t    dispatched;     ///< Tasks dispatched since last call
+        uint64_t    latency_avg;    ///< Avg queue-to-dispatch latency (usec) since last call
+        uint64_t    latency_max;    ///< Max queue-to-dispatch latency (usec) since last call
+    };
+
     static TaskMgr & getInstance();
+    static const char * laneName( uint32_t a_lane );
 
     // Public interface used by CoreWorkers
-    void    newTask( const std::string & a_task_id );
+    void    newTask( const std::string & a_task_id, uint32_t a_type, const std::string & a_owner );
     void    cancelTask( const std::string & a_task_id );
+    void    getStats( LaneStats a_stats[TL_COUNT], size_t & a_retry_depth, size_t & a_xfr_count, bool a_reset = true );
 
 private:
+    struct Lane
+    {
+        Lane() : depth(0), running(0), max_running(0), dispatched(0), latency_tot(0), latency_max(0) {}
+
+        std::unordered_map<std::string,std::deque<Task*>>   queues;     ///< Ready tasks per owner
+        std::deque<std::string>                             owners;     ///< Round-robin order of owners with ready tasks
+        size_t                                              depth;
+        size_t                                              running;
+        size_t                                              max_running;
+        uint64_t                                            dispatched;
+        uint64_t                                            latency_tot;
+        uint64_t                                            latency_max;
+    };
+
     TaskMgr();
     ~TaskMgr();
 
@@ -37,21 +80,31 @@ private:
     Task *      getNextTask( ITaskWorker * a_worker );
     bool        retryTask( Task * a_task );
     void        newTasks( const libjson::Value & a_tasks );
+    void        monitorTransfer( Task * a_task );
 
     // Private methods
     void        maintenanceThread();
-    void        addNewTaskAndScheduleWorker( const std::string & a_task_id );
-    void        retryTaskAndScheduleWorker( Task * a_task );
+    void        loadReadyTasks();
+    size_t      scheduleTasks( const libjson::Value::Array & a_tasks, bool a_loading );
+    void        addNewTaskAndScheduleWorker( const std::string & a_task_id, uint32_t a_type, const std::string & a_owner );
+    void        queueTaskAndScheduleWorker( Task * a_task );
+    void        resumeTask( Task * a_task );
+    uint32_t    nextLane() const;
+    Task *      popTask( uint32_t a_lane );
     void        wakeNextWorker();
     void        purgeTaskHistory() const;
 
     Config &                            m_config;
-    std::deque<Task*>                   m_tasks_ready;
-    std::multimap<timepoint_t,Task*>    m_tasks_retry;
+    size_t                              m_page_size;
+    bool                                m_loading;
+    std::unordered_set<std::string>     m_load_skip;
+    Lane                                m_lanes[TL_COUNT];
+    TimerWheel<Task*>                   m_tasks_retry;
     std::mutex                          m_worker_mutex;
     std::vector<ITaskWorker*>           m_workers;
     ITaskWorker *                       m_worker_next;
     std::thread *                       m_maint_thread;
+    TransferMonitor *                   m_xfr_monitor;
     std::mutex                          m_maint_mutex;
     std::condition_variable             m_maint_cvar;
 };
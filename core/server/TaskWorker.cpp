@@ -1,8 +1,17 @@
 #include "unistd.h"
+#include <list>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
 #include "DynaLog.hpp"
 #include "Config.hpp"
 #include "ITaskMgr.hpp"
 #include "TaskWorker.hpp"
+#include "RepoConnMgr.hpp"
 
 using namespace std;
 using namespace libjson;
@@ -17,6 +26,7 @@ TaskWorker::TaskWorker( ITaskMgr & a_mgr, uint32_t a_worker_id ) :
     ITaskWorker( a_worker_id ),
     m_mgr( a_mgr ),
     m_thread( 0 ),
+    m_step( 0 ),
     m_db( Config::getInstance().db_url , Config::getInstance().db_user, Config::getInstance().db_pass )
 {
     m_thread = new thread( &TaskWorker::workerThread, this );
@@ -30,9 +40,10 @@ TaskWorker::~TaskWorker()
  * @brief Thread method for TaskWorker task processing.
  *
  * Basic loop of getting a task from TaskMgr, processing, then reporting back to TaskMgr.
- * All steps of a task are processed unless a non-permanent failure occurs. Task control
- * objects (Task*) are released by the TaskMgr when either retryTask or getNextTask are
- * called.
+ * All steps of a task are processed unless a non-permanent failure occurs, or a Globus
+ * transfer has been submitted (the task is then handed to the transfer monitor and resumed
+ * later by any worker). Task control objects (Task*) are released by the TaskMgr when either
+ * retryTask or getNextTask are called.
  */
 void
 TaskWorker::workerThread()
@@ -56,6 +67,17 @@ TaskWorker::workerThread()
         err_msg.clear();
         first = true;
 
+        // A task resuming after a monitored transfer reports the transfer step (or error)
+        if ( m_task->resume )
+        {
+            DL_DEBUG("Task worker " << id() << " resuming task " << m_task->task_id << " at step " << m_task->step );
+
+            first = false;
+            step = m_task->step;
+            err_msg.swap( m_task->err_msg );
+            m_task->resume = false;
+        }
+
         while ( true )
         {
             try
@@ -84,6 +106,8 @@ TaskWorker::workerThread()
                 else if ( cmd != TC_STOP )
                     EXCEPT(1,"Reply missing step value" );
 
+                m_step = step;
+
                 switch ( cmd )
                 {
                 case TC_RAW_DATA_TRANSFER:
@@ -113,8 +137,20 @@ TaskWorker::workerThread()
                 if ( cmd == TC_STOP )
                     break;
 
+                if ( m_task->xfr_id.size() )
+                {
+                    // Transfer submitted - monitor owns task until transfer finishes, so clear ptr and exit inner while loop
+                    m_task->step = step;
+                    m_mgr.monitorTransfer( m_task );
+                    m_task = 0;
+                    break;
+                }
+
                 if ( retry )
                 {
+                    // Retry is scheduled in lane of the failed command, not the task type
+                    m_task->lane = ITaskMgr::laneForCommand( cmd );
+
                     if ( m_mgr.retryTask( m_task ))
                     {
                         DL_DEBUG("Task worker " << id() << " aborting task " << m_task->task_id );
@@ -231,26 +267,9 @@ TaskWorker::cmdRawDataTransfer( const Value & a_task_params )
     {
         DL_DEBUG( "Begin transfer of " << files_v.size() << " files" );
 
-        string glob_task_id = m_glob.transfer( src_ep, dst_ep, files_v, encrypted, acc_tok );
-
-        // Monitor Globus transfer
-
-        GlobusAPI::XfrStatus    xfr_status;
-        string                  err_msg;
-
-        do
-        {
-            sleep( 5 );
-
-            if ( m_glob.checkTransferStatus( glob_task_id, acc_tok, xfr_status, err_msg ))
-            {
-                // Transfer task needs to be cancelled
-                m_glob.cancelTask( glob_task_id, acc_tok );
-            }
-        } while( xfr_status < GlobusAPI::XS_SUCCEEDED );
-
-        if ( xfr_status == GlobusAPI::XS_FAILED )
-            EXCEPT( 1, err_msg );
+        // Globus transfer is tracked by the transfer monitor (see workerThread)
+        m_task->xfr_id = m_glob.transfer( src_ep, dst_ep, files_v, encrypted, acc_tok );
+        m_task->xfr_token = acc_tok;
     }
     else
     {
@@ -270,38 +289,27 @@ TaskWorker::cmdRawDataDelete( const  Value & a_task_params )
 
     Auth::RepoDataDeleteRequest     del_req;
     RecordDataLocation *            loc;
-    MsgBuf::Message *               reply;
     const string &                  repo_id = obj.getString( "repo_id" );
     const string &                  path = obj.getString( "repo_path" );
     const Value::Array &            ids = obj.getArray( "ids" );
-    Value::ArrayConstIter           id = ids.begin();
-    size_t                          i = 0, j, sz = ids.size();
-    size_t                          chunk = Config::getInstance().repo_chunk_size;
 
     // Issue #603 - break large requests into chunks to reduce likelihood of timeouts
 
-
-    while ( i < sz )
-    {
-        j = min( i + chunk, sz );
-
-        for ( ; i < j; i++, id++ )
+    return repoSendChunks( repo_id, ids.size(), del_req,
+        [&]( size_t a_begin, size_t a_end )
         {
-            loc = del_req.add_loc();
-            loc->set_id( id->asString() );
-            loc->set_path( path + id->asString().substr(2) );
-        }
+            del_req.clear_loc();
 
-        if ( repoSendRecv( repo_id, del_req, reply ))
+            for ( size_t i = a_begin; i < a_end; i++ )
+            {
+                loc = del_req.add_loc();
+                loc->set_id( ids[i].asString() );
+                loc->set_path( path + ids[i].asString().substr(2) );
+            }
+        },
+        []( size_t, size_t, MsgBuf::Message & )
         {
-            return true;
-        }
-
-        delete reply;
-        del_req.clear_loc();
-    }
-
-    return false;
+        });
 }
 
 
@@ -316,36 +324,32 @@ TaskWorker::cmdRawDataUpdateSize( const  Value & a_task_params )
     const string &                  path = obj.getString( "repo_path" );
     const Value::Array &            ids = obj.getArray( "ids" );
     Auth::RepoDataGetSizeRequest    sz_req;
-    Auth::RepoDataSizeReply *       sz_rep;
     RecordDataLocation *            loc;
-    MsgBuf::Message *               reply;
 
-    for ( Value::ArrayConstIter id = ids.begin(); id != ids.end(); id++ )
-    {
-        loc = sz_req.add_loc();
-        loc->set_id( id->asString() );
-        loc->set_path( path + id->asString().substr(2) );
-    }
-
-    if ( repoSendRecv( repo_id, sz_req, reply ))
-        return true;
+    return repoSendChunks( repo_id, ids.size(), sz_req,
+        [&]( size_t a_begin, size_t a_end )
+        {
+            sz_req.clear_loc();
 
-    if (( sz_rep = dynamic_cast<Auth::RepoDataSizeReply*>( reply )) != 0 )
-    {
-        if ( sz_rep->size_size() != (int)ids.size() )
-            EXCEPT_PARAM( 1, "Mismatched result size with RepoDataSizeReply from repo: " << repo_id );
+            for ( size_t i = a_begin; i < a_end; i++ )
+            {
+                loc = sz_req.add_loc();
+                loc->set_id( ids[i].asString() );
+                loc->set_path( path + ids[i].asString().substr(2) );
+            }
+        },
+        [&]( size_t a_begin, size_t a_end, MsgBuf::Message & a_reply )
+        {
+            Auth::RepoDataSizeReply * sz_rep = dynamic_cast<Auth::RepoDataSizeReply*>( &a_reply );
 
-        m_db.recordUpdateSize( *sz_rep );
+            if ( !sz_rep )
+                EXCEPT_PARAM( 1, "Unexpected reply to RepoDataSizeReply from repo: " << repo_id );
 
-        delete reply;
-    }
-    else
-    {
-        delete reply;
-        EXCEPT_PARAM( 1, "Unexpected reply to RepoDataSizeReply from repo: " << repo_id );
-    }
+            if ( sz_rep->size_size() != (int)( a_end - a_begin ))
+                EXCEPT_PARAM( 1, "Mismatched result size with RepoDataSizeReply from repo: " << repo_id );
 
-    return false;
+            m_db.recordUpdateSize( *sz_rep );
+        });
 }
 
 
@@ -460,41 +464,246 @@ TaskWorker::checkEncryption( const GlobusAPI::EndpointInfo & a_ep_info1, const G
 bool
 TaskWorker::repoSendRecv( const string & a_repo_id, MsgBuf::Message & a_msg, MsgBuf::Message *& a_reply )
 {
-    Config & config = Config::getInstance();
+    if ( !RepoConnMgr::getInstance().sendRecv( a_repo_id, a_msg, a_reply, Config::getInstance().repo_timeout ))
+    {
+        DL_ERROR( "Timeout waiting for response from " << a_repo_id );
+        return true;
+    }
+
+    try
+    {
+        repoCheckNack( *a_reply );
+    }
+    catch( ... )
+    {
+        delete a_reply;
+        throw;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Send a chunked repository request with a window of chunks in flight
+ *
+ * Items [0,a_count) are sent in chunks, with up to config.repo_window chunks
+ * in flight; a_build fills a_msg with the items of a chunk, and a_reply is
+ * called (on this thread) with the reply to each chunk. Chunk size starts at
+ * config.repo_chunk_size and adapts to repository latency: it is halved when
+ * a chunk takes longer than a tenth of config.repo_timeout, and grows when a
+ * chunk takes less than half of that.
+ *
+ * The contiguous count of completed items is kept on the task, so a retry of
+ * the same step resumes after it rather than resending every chunk. Returns
+ * true (retry) if any chunk timed out; a timed out chunk fails alone, so
+ * chunks already in flight still complete and count toward that progress. On
+ * any error, chunks still in flight are drained before returning or throwing.
+ * As a backstop, chunks not completed REPO_WAIT_MARGIN msec past their
+ * timeout are left to the repo connection I/O thread (which then frees them)
+ * and the step is retried.
+ */
+bool
+TaskWorker::repoSendChunks( const string & a_repo_id, size_t a_count, MsgBuf::Message & a_msg,
+    const function<void( size_t, size_t )> & a_build,
+    const function<void( size_t, size_t, MsgBuf::Message & )> & a_reply )
+{
+    struct Chunk
+    {
+        size_t                              begin;
+        size_t                              end;
+        chrono::steady_clock::time_point    start;
+        RepoConnMgr::Request                request;
+    };
+
+    // Completion state, shared with the on_complete callbacks of the chunks
+    struct Window
+    {
+        Window() : abandoned( false ) {}
+
+        mutex                               comp_mutex;
+        condition_variable                  comp_cvar;
+        deque<Chunk*>                       completed;
+        bool                                abandoned;
+    };
+
+    Config &                config = Config::getInstance();
+    RepoConnMgr &           conn_mgr = RepoConnMgr::getInstance();
+    size_t                  window = max<size_t>( 1, config.repo_window );
+    size_t                  chunk_size = max<size_t>( 1, config.repo_chunk_size );
+    size_t                  chunk_min = max<size_t>( 1, chunk_size / 10 );
+    size_t                  chunk_max = chunk_size * 10;
+    long                    target = max<long>( 1, config.repo_timeout / 10 );
+    size_t                  next = 0, done, in_flight = 0;
+    long                    elapsed;
+    bool                    retry = false;
+    exception_ptr           error;
+    list<Chunk*>            chunks;
+    list<Chunk*>::iterator  c;
+    Chunk *                 ch;
+    chrono::steady_clock::time_point backstop;
+    map<size_t,size_t>      finished;   // Completed ranges past the contiguous prefix
+    shared_ptr<Window>      win = make_shared<Window>();
+
+    if ( m_task->chunk_step == m_step )
+    {
+        next = min( m_task->chunk_done, a_count );
+        DL_DEBUG( "Task " << m_task->task_id << " resuming step " << m_step << " at " << next << " of " << a_count );
+    }
 
-    map<string,RepoData*>::iterator rd = config.repos.find( a_repo_id );
-    if ( rd == config.repos.end() )
-        EXCEPT_PARAM( 1, "Task refers to non-existent repo server: " << a_repo_id );
+    done = next;
 
-    MsgComm comm( rd->second->address(), MsgComm::DEALER, false, &config.sec_ctx );
+    while ( 1 )
+    {
+        // Fill the window
+        while ( !retry && !error && next < a_count && in_flight < window )
+        {
+            ch = new Chunk();
+            ch->begin = next;
+            ch->end = min( next + chunk_size, a_count );
+            ch->request.repo_id = a_repo_id;
+            ch->request.timeout = config.repo_timeout;
+            ch->request.on_complete = [win,ch]( RepoConnMgr::Request & )
+            {
+                unique_lock<mutex> lock( win->comp_mutex );
 
-    comm.send( a_msg );
+                if ( win->abandoned )
+                {
+                    lock.unlock();
+                    delete ch->request.reply;
+                    delete ch;
+                    return;
+                }
 
-    MsgBuf buffer;
+                win->completed.push_back( ch );
+                win->comp_cvar.notify_one();
+            };
+
+            try
+            {
+                a_build( ch->begin, ch->end );
+                ch->start = chrono::steady_clock::now();
+                conn_mgr.submit( ch->request, a_msg );
+            }
+            catch( ... )
+            {
+                error = current_exception();
+                delete ch;
+                break;
+            }
+
+            chunks.push_back( ch );
+            next = ch->end;
+            in_flight++;
+        }
+
+        if ( !in_flight )
+            break;
+
+        backstop = chrono::steady_clock::time_point::max();
+        for ( c = chunks.begin(); c != chunks.end(); c++ )
+            backstop = min( backstop, (*c)->request.deadline + chrono::milliseconds( REPO_WAIT_MARGIN ));
+
+        {
+            unique_lock<mutex> lock( win->comp_mutex );
+
+            while ( win->completed.empty() )
+            {
+                if ( win->comp_cvar.wait_until( lock, backstop ) == cv_status::timeout && win->completed.empty() )
+                    break;
+            }
+
+            if ( win->completed.empty() )
+            {
+                // Chunks still in flight are freed by their callbacks
+                DL_ERROR( "Task " << m_task->task_id << " chunks to " << a_repo_id << " not completed " << REPO_WAIT_MARGIN << " ms past their timeout, abandoned" );
+                win->abandoned = true;
+                retry = true;
+                break;
+            }
+
+            ch = win->completed.front();
+            win->completed.pop_front();
+        }
+
+        in_flight--;
+
+        if ( !ch->request.reply )
+        {
+            if ( !retry )
+                DL_ERROR( "Timeout waiting for response from " << a_repo_id );
 
-    if ( !comm.recv( buffer, false, config.repo_timeout ))
+            retry = true;
+        }
+        else
+        {
+            elapsed = chrono::duration_cast<chrono::milliseconds>( chrono::steady_clock::now() - ch->start ).count();
+
+            try
+            {
+                repoCheckNack( *ch->request.reply );
+
+                if ( !error )
+                {
+                    a_reply( ch->begin, ch->end, *ch->request.reply );
+
+                    finished[ch->begin] = ch->end;
+
+                    while ( finished.size() && finished.begin()->first == done )
+                    {
+                        done = finished.begin()->second;
+                        finished.erase( finished.begin() );
+                    }
+
+                    if ( elapsed > target )
+                        chunk_size = max( chunk_min, chunk_size / 2 );
+                    else if ( elapsed < target / 2 )
+                        chunk_size = min( chunk_max, chunk_size + chunk_size / 4 + 1 );
+                }
+            }
+            catch( ... )
+            {
+                if ( !error )
+                    error = current_exception();
+            }
+
+            delete ch->request.reply;
+        }
+
+        chunks.remove( ch );
+        delete ch;
+    }
+
+    if ( done < a_count )
     {
-        DL_ERROR( "Timeout waiting for response from " << a_repo_id );
-        cerr.flush();
-        return true;
+        m_task->chunk_step = m_step;
+        m_task->chunk_done = done;
+
+        DL_DEBUG( "Task " << m_task->task_id << " step " << m_step << " completed " << done << " of " << a_count );
     }
     else
     {
-        // Check for NACK
-        a_reply = buffer.unserialize();
+        m_task->chunk_step = -1;
+        m_task->chunk_done = 0;
+    }
 
-        Anon::NackReply * nack = dynamic_cast<Anon::NackReply*>( a_reply );
-        if ( nack != 0 )
-        {
-            ErrorCode code = nack->err_code();
-            string  msg = nack->has_err_msg()?nack->err_msg():"Unknown service error";
+    if ( error )
+        rethrow_exception( error );
 
-            delete a_reply;
+    return retry;
+}
 
-            EXCEPT( code, msg );
-        }
+/// Throws the error of a NACK reply from a repository server
+void
+TaskWorker::repoCheckNack( MsgBuf::Message & a_reply )
+{
+    Anon::NackReply * nack = dynamic_cast<Anon::NackReply*>( &a_reply );
+
+    if ( nack != 0 )
+    {
+        ErrorCode code = nack->err_code();
+        string  msg = nack->has_err_msg()?nack->err_msg():"Unknown service error";
 
-        return false;
+        EXCEPT( code, msg );
     }
 }
 
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <thread>
+#include <functional>
 #include "DatabaseAPI.hpp"
 #include "GlobusAPI.hpp"
 #include "ITaskMgr.hpp"
@@ -30,10 +31,15 @@ private:
     bool        checkEncryption( const GlobusAPI::EndpointInfo & a_ep_info, Encryption a_encrypt );
     bool        checkEncryption( const GlobusAPI::EndpointInfo & a_ep_info1, const GlobusAPI::EndpointInfo & a_ep_info2, Encryption a_encrypt );
     bool        repoSendRecv( const std::string & a_repo_id, MsgBuf::Message & a_msg, MsgBuf::Message *& a_reply );
+    bool        repoSendChunks( const std::string & a_repo_id, size_t a_count, MsgBuf::Message & a_msg,
+                    const std::function<void( size_t, size_t )> & a_build,
+                    const std::function<void( size_t, size_t, MsgBuf::Message & )> & a_reply );
+    void        repoCheckNack( MsgBuf::Message & a_reply );
 
     ITaskMgr &                  m_mgr;
     std::thread *               m_thread;
     ITaskMgr::Task *            m_task;
+    int                         m_step;     ///< Step of current task command
     DatabaseAPI                 m_db;
     GlobusAPI                   m_glob;
 };
@@ -0,0 +1,138 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <stdint.h>
+
+namespace SDMS {
+namespace Core {
+
+/**
+ * @brief Hashed timer wheel for coarse-grained timeouts
+ *
+ * Items are placed into one of a fixed number of slots based on their expiry
+ * tick; items further out than one revolution of the wheel stay in their slot
+ * until the wheel comes around to their tick. Insertion is O(1) and expiry is
+ * proportional to the number of ticks elapsed plus the number of items that
+ * share the visited slots. Not thread-safe; callers must provide locking.
+ */
+template<typename T, typename Clock = std::chrono::system_clock>
+class TimerWheel
+{
+public:
+    typedef typename Clock::time_point  timepoint_t;
+    typedef typename Clock::duration    duration_t;
+
+    TimerWheel( duration_t a_tick, size_t a_slots, timepoint_t a_start = Clock::now() ) :
+        m_tick_len( a_tick ),
+        m_slots( a_slots ),
+        m_tick( toTick( a_start )),
+        m_size( 0 )
+    {}
+
+    inline size_t size() const
+    {
+        return m_size;
+    }
+
+    inline bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    /// Items scheduled in the past expire on next call to expire()
+    void insert( timepoint_t a_when, const T & a_item )
+    {
+        uint64_t tick = toTick( a_when );
+
+        if ( tick < m_tick )
+            tick = m_tick;
+
+        m_slots[tick % m_slots.size()].push_back( std::make_pair( tick, a_item ));
+        m_size++;
+    }
+
+    /**
+     * @brief Remove all items expiring at or before a_now
+     *
+     * Expired items are passed to a_func in approximate (per-tick) expiry order.
+     */
+    template<typename F>
+    void expire( timepoint_t a_now, F a_func )
+    {
+        uint64_t    now = toTick( a_now );
+        size_t      n = m_slots.size();
+
+        // Visit each slot at most once per call, even if more than one revolution has elapsed
+        if ( now >= m_tick && now - m_tick >= n )
+            m_tick = now - n + 1;
+
+        for ( ; m_tick <= now && m_size; m_tick++ )
+            expireSlot( m_slots[m_tick % n], now, a_func );
+
+        if ( m_tick <= now )
+            m_tick = now + 1;
+    }
+
+    /**
+     * @brief Get time of next non-empty slot
+     *
+     * Result may be earlier than the actual next expiry if the slot also holds
+     * items for later revolutions. Returns timepoint_t::max() if empty.
+     */
+    timepoint_t nextExpiry() const
+    {
+        if ( !m_size )
+            return timepoint_t::max();
+
+        size_t n = m_slots.size();
+
+        for ( uint64_t t = m_tick; t < m_tick + n; t++ )
+        {
+            if ( m_slots[t % n].size() )
+                return timepoint_t( m_tick_len * t );
+        }
+
+        return timepoint_t( m_tick_len * ( m_tick + n ));
+    }
+
+private:
+    typedef std::vector<std::pair<uint64_t,T>>  slot_t;
+
+    inline uint64_t toTick( timepoint_t a_time ) const
+    {
+        return a_time.time_since_epoch() / m_tick_len;
+    }
+
+    template<typename F>
+    void expireSlot( slot_t & a_slot, uint64_t a_now, F & a_func )
+    {
+        size_t i = 0;
+
+        while ( i < a_slot.size() )
+        {
+            if ( a_slot[i].first <= a_now )
+            {
+                T item = a_slot[i].second;
+
+                a_slot[i] = a_slot.back();
+                a_slot.pop_back();
+                m_size--;
+                a_func( item );
+            }
+            else
+                i++;
+        }
+    }
+
+    duration_t              m_tick_len;
+    std::vector<slot_t>     m_slots;
+    uint64_t                m_tick;     ///< Next tick to be processed
+    size_t                  m_size;
+};
+
+}}
+
+#endif
@@ -0,0 +1,312 @@
+#include "DynaLog.hpp"
+#include "TraceException.hpp"
+#include "Config.hpp"
+#include "TransferMonitor.hpp"
+
+using namespace std;
+
+namespace SDMS {
+namespace Core {
+
+#define XFR_BATCH_MAX   100
+#define XFR_MAX_ERRORS  5
+#define XFR_WHEEL_SLOTS 256
+
+TransferMonitor::TransferMonitor( resume_cb_t a_resume ) :
+    m_resume( a_resume ),
+    m_poll_min( chrono::seconds( Config::getInstance().xfr_poll_min )),
+    m_poll_max( chrono::seconds( max( Config::getInstance().xfr_poll_min, Config::getInstance().xfr_poll_max ))),
+    m_count( 0 ),
+    m_run( true ),
+    m_due( chrono::seconds( 1 ), XFR_WHEEL_SLOTS ),
+    m_thread( 0 )
+{
+    m_thread = new thread( &TransferMonitor::monitorThread, this );
+}
+
+/**
+ * Stops monitor thread; tasks of transfers still being monitored are not
+ * resumed (they will be reloaded from the DB on restart).
+ */
+TransferMonitor::~TransferMonitor()
+{
+    {
+        lock_guard<mutex> lock( m_mutex );
+        m_run = false;
+        m_cvar.notify_one();
+    }
+
+    m_thread->join();
+    delete m_thread;
+
+    m_due.expire( timepoint_t::max(), []( Transfer * a_xfr ){ delete a_xfr; });
+
+    for ( vector<Transfer*>::iterator x = m_new.begin(); x != m_new.end(); x++ )
+        delete *x;
+}
+
+/**
+ * @brief Start monitoring transfer of a suspended task
+ *
+ * The task must have xfr_id, xfr_token, and step set. Ownership of the task
+ * passes to the monitor until it is handed back via the resume callback.
+ */
+void
+TransferMonitor::monitor( ITaskMgr::Task * a_task )
+{
+    DL_DEBUG( "Monitoring transfer " << a_task->xfr_id << " for task " << a_task->task_id );
+
+    lock_guard<mutex> lock( m_mutex );
+
+    m_new.push_back( new Transfer( a_task, m_poll_min ));
+    m_count++;
+    m_cvar.notify_one();
+}
+
+size_t
+TransferMonitor::size()
+{
+    lock_guard<mutex> lock( m_mutex );
+
+    return m_count;
+}
+
+void
+TransferMonitor::monitorThread()
+{
+    vector<Transfer*>           added, due;
+    vector<Transfer*>::iterator x;
+    timepoint_t                 now, next;
+    unique_lock<mutex>          lock( m_mutex, defer_lock );
+
+    while ( 1 )
+    {
+        lock.lock();
+
+        if ( !m_run )
+            break;
+
+        if ( m_new.empty() )
+        {
+            next = m_due.nextExpiry();
+
+            if ( next == timepoint_t::max() )
+                m_cvar.wait( lock );
+            else if ( next > chrono::system_clock::now() )
+                m_cvar.wait_until( lock, next );
+        }
+
+        if ( !m_run )
+            break;
+
+        added.swap( m_new );
+        lock.unlock();
+
+        now = chrono::system_clock::now();
+
+        // First poll of new transfers is after the minimum poll interval
+        for ( x = added.begin(); x != added.end(); x++ )
+            m_due.insert( now + (*x)->interval, *x );
+
+        added.clear();
+
+        m_due.expire( now, [&due]( Transfer * a_xfr ){ due.push_back( a_xfr ); });
+
+        if ( due.size() )
+        {
+            try
+            {
+                poll( due );
+            }
+            catch( exception & e )
+            {
+                DL_ERROR( "Transfer monitor: " << e.what() );
+            }
+            catch( ... )
+            {
+                DL_ERROR( "Transfer monitor: unknown exception" );
+            }
+
+            due.clear();
+        }
+    }
+}
+
+/**
+ * @brief Poll due transfers, grouped by access token and batch size
+ */
+void
+TransferMonitor::poll( vector<Transfer*> & a_due )
+{
+    map<string,vector<Transfer*>>               groups;
+    map<string,vector<Transfer*>>::iterator     g;
+    size_t                                      i, n;
+
+    for ( vector<Transfer*>::iterator x = a_due.begin(); x != a_due.end(); x++ )
+        groups[(*x)->task->xfr_token].push_back( *x );
+
+    DL_DEBUG( "Transfer monitor polling " << a_due.size() << " transfer(s), " << groups.size() << " token(s)" );
+
+    for ( g = groups.begin(); g != groups.end(); g++ )
+    {
+        for ( i = 0; i < g->second.size(); i += n )
+        {
+            n = min( g->second.size() - i, (size_t)XFR_BATCH_MAX );
+            pollBatch( &g->second[i], n );
+        }
+    }
+}
+
+/**
+ * @brief Poll a batch of transfers sharing the same access token
+ *
+ * Transfers that report new faults, or that are missing from the batch reply,
+ * are checked individually (including their event lists).
+ */
+void
+TransferMonitor::pollBatch( Transfer ** a_batch, size_t a_count )
+{
+    vector<string>                                  ids;
+    map<string,GlobusAPI::XfrInfo>                  info;
+    map<string,GlobusAPI::XfrInfo>::iterator        inf;
+    Transfer *                                      xfr;
+    size_t                                          i;
+    bool                                            changed;
+
+    for ( i = 0; i < a_count; i++ )
+        ids.push_back( a_batch[i]->task->xfr_id );
+
+    try
+    {
+        m_glob.checkTransferStatus( ids, a_batch[0]->task->xfr_token, info );
+    }
+    catch( TraceException & e )
+    {
+        // Batch failures are treated as transient - back off and try again
+        DL_ERROR( "Transfer monitor batch poll failed: " << e.toString() );
+
+        for ( i = 0; i < a_count; i++ )
+            reschedule( a_batch[i], false );
+
+        return;
+    }
+
+    for ( i = 0; i < a_count; i++ )
+    {
+        xfr = a_batch[i];
+        inf = info.find( xfr->task->xfr_id );
+
+        if ( inf == info.end() )
+        {
+            checkTransfer( xfr );
+            continue;
+        }
+
+        xfr->errors = 0;
+
+        switch ( inf->second.status )
+        {
+        case GlobusAPI::XS_SUCCEEDED:
+            finish( xfr, "" );
+            break;
+        case GlobusAPI::XS_FAILED:
+            try
+            {
+                m_glob.cancelTask( xfr->task->xfr_id, xfr->task->xfr_token );
+            }
+            catch( TraceException & e )
+            {
+                DL_WARN( "Transfer monitor cancel of " << xfr->task->xfr_id << " failed: " << e.toString() );
+            }
+            finish( xfr, inf->second.nice_status.size() ? inf->second.nice_status : "Globus transfer failed" );
+            break;
+        default:
+            if ( inf->second.faults > xfr->faults )
+            {
+                xfr->faults = inf->second.faults;
+                checkTransfer( xfr );
+            }
+            else
+            {
+                changed = inf->second.nice_status != xfr->nice_status;
+                xfr->nice_status = inf->second.nice_status;
+                reschedule( xfr, changed );
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Check a single transfer, including events that should be treated as fatal
+ */
+void
+TransferMonitor::checkTransfer( Transfer * a_xfr )
+{
+    GlobusAPI::XfrStatus    status;
+    string                  err_msg;
+
+    try
+    {
+        if ( m_glob.checkTransferStatus( a_xfr->task->xfr_id, a_xfr->task->xfr_token, status, err_msg ))
+        {
+            // Transfer task needs to be cancelled
+            m_glob.cancelTask( a_xfr->task->xfr_id, a_xfr->task->xfr_token );
+            finish( a_xfr, err_msg );
+        }
+        else if ( status == GlobusAPI::XS_SUCCEEDED )
+        {
+            finish( a_xfr, "" );
+        }
+        else
+        {
+            a_xfr->errors = 0;
+            reschedule( a_xfr, true );
+        }
+    }
+    catch( TraceException & e )
+    {
+        if ( ++a_xfr->errors >= XFR_MAX_ERRORS )
+            finish( a_xfr, e.toString() );
+        else
+            reschedule( a_xfr, false );
+    }
+}
+
+/**
+ * @brief Schedule next poll; interval is reset on a status change and doubles otherwise
+ */
+void
+TransferMonitor::reschedule( Transfer * a_xfr, bool a_changed )
+{
+    if ( a_changed )
+        a_xfr->interval = m_poll_min;
+    else
+        a_xfr->interval = min( a_xfr->interval * 2, m_poll_max );
+
+    m_due.insert( chrono::system_clock::now() + a_xfr->interval, a_xfr );
+}
+
+void
+TransferMonitor::finish( Transfer * a_xfr, const string & a_err_msg )
+{
+    ITaskMgr::Task * task = a_xfr->task;
+
+    DL_DEBUG( "Transfer " << task->xfr_id << " for task " << task->task_id << ( a_err_msg.size() ? " failed: " + a_err_msg : " completed" ));
+
+    delete a_xfr;
+
+    {
+        lock_guard<mutex> lock( m_mutex );
+        m_count--;
+    }
+
+    task->resume = true;
+    task->err_msg = a_err_msg;
+    task->xfr_id.clear();
+    task->xfr_token.clear();
+
+    m_resume( task );
+}
+
+}}
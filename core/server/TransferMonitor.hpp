@@ -0,0 +1,78 @@
+#ifndef TRANSFERMONITOR_HPP
+#define TRANSFERMONITOR_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "ITaskMgr.hpp"
+#include "GlobusAPI.hpp"
+#include "TimerWheel.hpp"
+
+namespace SDMS {
+namespace Core {
+
+/**
+ * @brief Tracks active Globus transfers on behalf of suspended tasks
+ *
+ * Task workers hand off a task after submitting its Globus transfer, so that
+ * no worker thread is held for the lifetime of the transfer. The monitor
+ * thread polls due transfers in batches (one task_list call per access token
+ * and batch) and backs off the poll interval of each transfer while its
+ * status is unchanged. When a transfer succeeds or fails, the owning task is
+ * handed back through the resume callback with its err_msg set on failure.
+ */
+class TransferMonitor
+{
+public:
+    typedef std::function<void( ITaskMgr::Task * )>  resume_cb_t;
+
+    TransferMonitor( resume_cb_t a_resume );
+    ~TransferMonitor();
+
+    void        monitor( ITaskMgr::Task * a_task );
+    size_t      size();
+
+private:
+    typedef ITaskMgr::timepoint_t   timepoint_t;
+    typedef ITaskMgr::duration_t    duration_t;
+
+    struct Transfer
+    {
+        Transfer( ITaskMgr::Task * a_task, duration_t a_interval ) :
+            task( a_task ), interval( a_interval ), faults( 0 ), errors( 0 )
+        {}
+
+        ITaskMgr::Task *    task;
+        duration_t          interval;
+        uint32_t            faults;
+        uint32_t            errors;
+        std::string         nice_status;
+    };
+
+    void        monitorThread();
+    void        poll( std::vector<Transfer*> & a_due );
+    void        pollBatch( Transfer ** a_batch, size_t a_count );
+    void        checkTransfer( Transfer * a_xfr );
+    void        reschedule( Transfer * a_xfr, bool a_changed );
+    void        finish( Transfer * a_xfr, const std::string & a_err_msg );
+
+    resume_cb_t                     m_resume;
+    duration_t                      m_poll_min;
+    duration_t                      m_poll_max;
+    size_t                          m_count;
+    bool                            m_run;
+    TimerWheel<Transfer*>           m_due;
+    std::vector<Transfer*>          m_new;
+    std::mutex                      m_mutex;
+    std::condition_variable         m_cvar;
+    GlobusAPI                       m_glob;
+    std::thread *                   m_thread;
+};
+
+}}
+
+#endif
@@ -44,17 +44,49 @@ int main( int a_argc, char ** a_argv )
             ("db-url,u",po::value<string>( &config.db_url ),"DB url")
             ("db-user,U",po::value<string>( &config.db_user ),"DB user name")
             ("db-pass,P",po::value<string>( &config.db_pass ),"DB password")
+            ("db-max-conn",po::value<uint32_t>( &config.db_max_conn ),"Max number of pooled DB connections")
+            ("db-timeout",po::value<uint32_t>( &config.db_timeout ),"DB request timeout (msec, 0 = none)")
+            ("db-h2c",po::value<bool>( &config.db_h2c ),"Use HTTP/2 without TLS (prior knowledge) for http:// DB urls; the DB server must support it")
             ("glob-oauth-url",po::value<string>( &config.glob_oauth_url ),"Globus authorization API base URL")
             ("glob-xfr-url",po::value<string>( &config.glob_xfr_url ),"Globus transfer API base URL")
             ("client-id",po::value<string>( &config.client_id ),"Client ID")
             ("client-secret",po::value<string>( &config.client_secret ),"Client secret")
             ("task-purge-age",po::value<uint32_t>( &config.task_purge_age ),"Task purge age (seconds)")
             ("task-purge-per",po::value<uint32_t>( &config.task_purge_period ),"Task purge period (seconds)")
+            ("task-load-page",po::value<uint32_t>( &config.task_load_page_size ),"Max number of tasks loaded or scheduled per batch")
             ("metrics-per",po::value<uint32_t>( &config.metrics_period ),"Metrics update period (seconds)")
             ("metrics-purge-per",po::value<uint32_t>( &config.metrics_purge_period ),"Metrics purge period (seconds)")
             ("metrics-purge-age",po::value<uint32_t>( &config.metrics_purge_age ),"Metrics purge age (seconds)")
+            ("perm-cache-ttl",po::value<uint32_t>( &config.perm_cache_ttl ),"Permission/view cache TTL (seconds, 0 = disabled)")
+            ("perm-cache-max",po::value<uint32_t>( &config.perm_cache_max ),"Permission/view cache max entries")
+            ("schema-cache-ttl",po::value<uint32_t>( &config.schema_cache_ttl ),"Compiled schema cache TTL (seconds, 0 = disabled)")
+            ("schema-cache-max",po::value<uint32_t>( &config.schema_cache_max ),"Compiled schema cache max entries")
+            ("search-plan-cache-max",po::value<uint32_t>( &config.search_plan_cache_max ),"Compiled search plan cache max entries (0 = disabled)")
+            ("zap-cache-max",po::value<uint32_t>( &config.zap_cache_max ),"Client key cache max entries")
+            ("zap-cache-ttl",po::value<uint32_t>( &config.zap_cache_ttl ),"Client key cache TTL (seconds, 0 = disabled)")
+            ("zap-cache-neg-ttl",po::value<uint32_t>( &config.zap_cache_neg_ttl ),"Client key cache TTL for unknown/anonymous keys (seconds, 0 = disabled)")
+            ("io-threads",po::value<uint32_t>( &config.io_threads ),"Number of ZeroMQ I/O threads (encryption and network I/O)")
+            ("io-cpus",po::value<string>( &config.io_cpus ),"CPU affinity of ZeroMQ I/O threads (comma-separated CPU numbers)")
+            ("router-shards",po::value<uint32_t>( &config.router_shards ),"Number of message router shards (client workers are divided among shards)")
+            ("sched-user-rate",po::value<uint32_t>( &config.sched_user_rate ),"Max sustained requests/sec per user (0 = no limit)")
+            ("sched-user-burst",po::value<uint32_t>( &config.sched_user_burst ),"Max request burst per user")
+            ("sched-user-queue",po::value<uint32_t>( &config.sched_user_queue ),"Max queued requests per user (per router shard)")
+            ("sched-queue-max",po::value<uint32_t>( &config.sched_queue_max ),"Max queued requests (per router shard)")
+            ("sched-web-weight",po::value<uint32_t>( &config.sched_web_weight ),"Scheduling weight of interactive (web) requests")
+            ("sched-bulk-weight",po::value<uint32_t>( &config.sched_bulk_weight ),"Scheduling weight of bulk (CLI/API) requests")
             ("client-threads",po::value<uint32_t>( &config.num_client_worker_threads ),"Number of client worker threads")
+            ("client-async",po::value<bool>( &config.client_async ),"Process DB requests asynchronously in client workers")
+            ("client-async-max",po::value<uint32_t>( &config.client_async_max ),"Max in-flight async requests per client worker")
+            ("batch-max-items",po::value<uint32_t>( &config.batch_max_items ),"Max sub-requests per batch request")
+            ("batch-concurrency",po::value<uint32_t>( &config.batch_concurrency ),"Max concurrently processed sub-requests per batch request")
+            ("batch-validate",po::value<bool>( &config.batch_validate ),"Validate metadata of batch record creates and updates against their schemas (default false)")
+            ("compute-threads",po::value<uint32_t>( &config.compute_threads ),"Number of shared compute threads for batch record validation (0 = number of CPU cores)")
+            ("stream-chunk-size",po::value<uint32_t>( &config.stream_chunk_size ),"Max size of partial reply frames of streamed listing/export/task replies (bytes, 0 = no streaming)")
             ("task-threads",po::value<uint32_t>( &config.num_task_worker_threads ),"Number of task worker threads")
+            ("task-quick-threads",po::value<uint32_t>( &config.task_quick_workers ),"Number of task worker threads reserved for non-transfer tasks")
+            ("repo-window",po::value<uint32_t>( &config.repo_window ),"Max chunks of a raw data delete/size task in flight to a repository")
+            ("xfr-poll-min",po::value<uint32_t>( &config.xfr_poll_min ),"Min Globus transfer status poll interval (seconds)")
+            ("xfr-poll-max",po::value<uint32_t>( &config.xfr_poll_max ),"Max Globus transfer status poll interval (seconds)")
             ("cfg",po::value<string>( &cfg_file ),"Use config file for options")
             ("gen-keys",po::bool_switch( &gen_keys ),"Generate new server keys then exit")
             ;
@@ -64,7 +64,9 @@ Client::Client( const std::string & a_host, uint32_t a_port, uint32_t a_timeout,
     m_host( a_host ),
     m_port( a_port ),
     m_cred_dir( a_client_cred_dir ),
-    m_timeout( a_timeout )
+    m_timeout( a_timeout ),
+    m_send_timeout( false ),
+    m_stream( false )
 {
     REG_PROTO( SDMS::Anon );
     REG_PROTO( SDMS::Auth );
@@ -120,6 +122,10 @@ Client::Client( const std::string & a_host, uint32_t a_port, uint32_t a_timeout,
         if ( reply->major() != VER_MAJOR || reply->minor() != VER_MINOR )
             EXCEPT(0,"Incompatible server version (update client)");
 
+        // Older servers reject extended frames, so only use what the server supports
+        m_send_timeout = reply->mapi_minor() >= 4;
+        m_stream = reply->mapi_minor() >= 7;
+
         delete reply;
     }
     catch(...)
@@ -180,7 +186,8 @@ void Client::send( RQT & a_request, RPT *& a_reply, uint16_t a_context )
     MsgBuf::Message * reply = 0;
     MsgBuf::Frame frame;
 
-    m_comm->send( a_request, a_context );
+    // Large replies may be streamed; recv merges the partial frames
+    m_comm->send( a_request, a_context, m_send_timeout ? m_timeout : 0, m_stream ? MsgBuf::FLAG_STREAM : 0 );
 
     cout << "recv\n";
 
@@ -1168,6 +1175,62 @@ Client::groupRemove( const std::string & a_group_id, const std::vector<std::stri
     return spGroupDataReply( rep );
 }
 
+/**
+ * Sends a_requests to the server in a single BatchRequest. On return,
+ * a_replies holds the reply to each request, in request order (caller must
+ * free); a request that failed has a NackReply. Only requests handled
+ * directly by the DB may be batched. Requests are processed concurrently
+ * unless a_ordered is set.
+ */
+void
+Client::batch( const std::vector<MsgBuf::Message*> & a_requests, std::vector<MsgBuf::Message*> & a_replies, bool a_ordered )
+{
+    Auth::BatchRequest  req;
+    Auth::BatchReply *  rep;
+    MsgBuf              buf;
+    MsgBuf::Frame       frame;
+
+    for ( vector<MsgBuf::Message*>::const_iterator r = a_requests.begin(); r != a_requests.end(); ++r )
+    {
+        BatchItem * item = req.add_item();
+
+        buf.serialize( **r );
+        item->set_msg_type( buf.getMsgType() );
+        if ( buf.getFrame().size )
+            item->set_data( buf.getBuffer(), buf.getFrame().size );
+    }
+
+    if ( a_ordered )
+        req.set_ordered( true );
+
+    send<>( req, rep, m_ctx++ );
+
+    spBatchReply reply( rep );
+    MsgBuf::Message * msg;
+
+    a_replies.clear();
+
+    for ( int i = 0; i < reply->item_size(); i++ )
+    {
+        const BatchItem & item = reply->item( i );
+
+        frame.size = item.data().size();
+        frame.proto_id = item.msg_type() >> 8;
+        frame.msg_id = item.msg_type() & 0xFF;
+
+        if (( msg = MsgBuf::unserialize( frame, item.data().data() )) == 0 )
+        {
+            for ( vector<MsgBuf::Message*>::iterator m = a_replies.begin(); m != a_replies.end(); ++m )
+                delete *m;
+            a_replies.clear();
+
+            EXCEPT_PARAM( 0, "Batch reply parse failed, item: " << i );
+        }
+
+        a_replies.push_back( msg );
+    }
+}
+
 string
 Client::messageToJSON( const ::google::protobuf::Message * a_msg )
 {
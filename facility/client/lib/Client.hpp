@@ -33,6 +33,7 @@ typedef std::shared_ptr<Auth::XfrDataReply> spXfrDataReply;
 typedef std::shared_ptr<Auth::ACLDataReply> spACLDataReply;
 typedef std::shared_ptr<Auth::GroupDataReply> spGroupDataReply;
 typedef std::shared_ptr<Auth::UserGetRecentEPReply> spUserGetRecentEPReply;
+typedef std::shared_ptr<Auth::BatchReply> spBatchReply;
 
 
 enum DestFlags : uint16_t
@@ -144,6 +145,8 @@ public:
     spGroupDataReply    groupAdd( const std::string & a_group_id, const std::vector<std::string> & a_uids );
     spGroupDataReply    groupRemove( const std::string & a_group_id, const std::vector<std::string> & a_uids );
 
+    void                batch( const std::vector<MsgBuf::Message*> & a_requests, std::vector<MsgBuf::Message*> & a_replies, bool a_ordered = false );
+
     std::string         messageToJSON( const ::google::protobuf::Message * a_msg );
 
     static bool         verifyCredentials( const std::string & a_cred_path );
@@ -163,6 +166,8 @@ private:
     std::string                 m_uid;
     MsgComm *                   m_comm;
     uint32_t                    m_timeout;
+    bool                        m_send_timeout;     ///< Server accepts request timeouts (message API minor 4+)
+    bool                        m_stream;           ///< Server can stream replies (message API minor 7+)
     uint16_t                    m_ctx;
     std::condition_variable     m_start_cvar;
     std::mutex                  m_mutex;
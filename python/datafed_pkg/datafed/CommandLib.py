@@ -1000,7 +1000,7 @@ class API:
         return self._mapi.sendRecv( msg )
 
     def collectionItemsList( self, coll_id, offset = 0, count = 20,
-                             context = None ):
+                             context = None, cont = None, total = True ):
         """
         List items in collection
 
@@ -1016,6 +1016,11 @@ class API:
             Number (limit) of listing results for (cleaner) paging
         context : str, Optional. Default = None
             User ID or project ID to use for alias resolution.
+        cont : str, Optional. Default = None
+            Continuation token ("next" field of previous reply); replaces
+            offset and keeps the cost of deep pages constant
+        total : bool, Optional. Default = True
+            Compute the total number of items in the collection
 
         Returns
         -------
@@ -1029,8 +1034,13 @@ class API:
         """
         msg = auth.CollReadRequest()
         msg.count = count
-        msg.offset = offset
         msg.id = self._resolve_id( coll_id, context )
+        msg.total = total
+
+        if cont:
+            msg.cont = cont
+        else:
+            msg.offset = offset
 
         return self._mapi.sendRecv( msg )
 
@@ -1266,7 +1276,7 @@ class API:
         return self._mapi.sendRecv( msg )
 
 
-    def queryExec( self, query_id, offset = 0, count = 20 ):
+    def queryExec( self, query_id, offset = 0, count = 20, cont = None ):
         """
         Execute a stored query and return matches.
 
@@ -1278,6 +1288,8 @@ class API:
             Offset of listing results for paging
         count : int, Optional. Default = 20
             Number (limit) of listing results for (cleaner) paging
+        cont : str, Optional. Default = None
+            Continuation token ("next" field of previous reply); replaces offset
 
         Returns
         -------
@@ -1294,13 +1306,16 @@ class API:
         msg.offset = offset
         msg.count = count
 
+        if cont:
+            msg.cont = cont
+
         return self._mapi.sendRecv( msg )
 
 
     def queryDirect( self, coll_mode = None, coll = None, id = None, text = None,
         tags = None, schema = None, meta = None, meta_err = None, owner = None, creator = None,
         time_from = None, time_to = None, public = None, category = None, sort = None, sort_rev = None,
-        offset = 0, count = 20 ):
+        offset = 0, count = 20, cont = None ):
         """
         Directly run a manually entered query and return matches
 
@@ -1314,6 +1329,8 @@ class API:
             Description of query
         meta : str, Optional. Default = None
             Query expression
+        cont : str, Optional. Default = None
+            Continuation token ("next" field of previous reply); replaces offset
 
         Returns
         -------
@@ -1330,6 +1347,9 @@ class API:
         self._buildSearchRequest( msg, coll_mode, coll, id, text, tags, schema, meta,
             meta_err, owner, creator, time_from, time_to, public, category, sort, sort_rev, offset, count )
 
+        if cont:
+            msg.cont = cont
+
         return self._mapi.sendRecv( msg )
 
 
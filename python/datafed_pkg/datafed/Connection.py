@@ -22,6 +22,10 @@ import time
 import inspect
 import sys
 
+# Frame flags (sent in extended frame, see MsgBuf.hpp)
+FLAG_STREAM = 0x01      # Request: client accepts a reply streamed as partial frames
+FLAG_PARTIAL = 0x02     # Reply: partial frame, more frames of the reply follow
+
 ##
 # @class Connection
 # @brief Provides low-level message-oriented communication
@@ -134,7 +138,10 @@ class Connection:
     # parses and creates a new protobuf message class based on received
     # framing. The new message object, the message name (defined in the
     # associated proto file), and re-association context are returned as
-    # a tuple. On timeout, (None,None,None) is returned.
+    # a tuple. On timeout, (None,None,None) is returned. A streamed reply
+    # arrives as a sequence of partial frames (each holding part of the
+    # results); these are merged into one message as they are received, and
+    # the timeout applies to each frame.
     #
     # @param timeout - Timeout in milliseconds
     # @return Tuple of message, message type, and re-association context
@@ -142,47 +149,79 @@ class Connection:
     # @exception Exception: if unregistered message type is received.
     #
     def recv( self, a_timeout=1000 ):
+        msg_type, ctxt, flags, data = self._recvFrame( a_timeout )
+        if msg_type == None:
+            return None, None, None
+
+        # find message descriptor based on type (descriptor index)
+
+        if not (msg_type in self._msg_desc_by_type):
+            raise Exception( "received unregistered message type: {}".format( msg_type ))
+
+        desc = self._msg_desc_by_type[msg_type]
+
+        if data:
+            # Create message by parsing content
+            reply = google.protobuf.reflection.ParseMessage( desc, data )
+        else:
+            # No content, just create message instance
+            reply = google.protobuf.reflection.MakeClass( desc )()
+
+        while flags & FLAG_PARTIAL:
+            part_type, part_ctxt, flags, data = self._recvFrame( a_timeout )
+            if part_type == None:
+                return None, None, None
+
+            if part_type != msg_type or part_ctxt != ctxt:
+                raise Exception( "received invalid partial reply frame, type: {}, context: {}".format( part_type, part_ctxt ))
+
+            if data:
+                reply.MergeFromString( data )
+
+        return reply, desc.name, ctxt
+
+    ##
+    # @brief Receive one message frame
+    #
+    # @param timeout - Timeout in milliseconds
+    # @return Tuple of message type, re-association context, frame flags,
+    #   and serialized message (None if no content)
+    # @retval (int,int,int,bytes) or (None,None,None,None) on timeout
+    #
+    def _recvFrame( self, a_timeout ):
         # Wait for data to arrive
         ready = self._socket.poll( a_timeout )
         if ready > 0:
             # receive null frame
             nf = self._socket.recv( 0 )
 
-            # receive custom frame header and unpack
+            # receive custom frame header and unpack (flags follow timeout in extended frame)
             frame_data = self._socket.recv( 0 )
-            frame_values = struct.unpack( '>LBBH', frame_data )
+            frame_values = struct.unpack( '>LBBH', frame_data[:8] )
             msg_type = (frame_values[1] << 8) | frame_values[2]
+            flags = struct.unpack( '>L', frame_data[12:16] )[0] if len( frame_data ) == 16 else 0
 
-            # find message descriptor based on type (descriptor index)
-
-            if not (msg_type in self._msg_desc_by_type):
-                raise Exception( "received unregistered message type: {}".format( msg_type ))
+            data = self._socket.recv( 0 ) if frame_values[0] > 0 else None
 
-            desc = self._msg_desc_by_type[msg_type]
-
-            if frame_values[0] > 0:
-                # Create message by parsing content
-                data = self._socket.recv( 0 )
-                reply = google.protobuf.reflection.ParseMessage( desc, data )
-            else:
-                # No content, just create message instance
-                reply = google.protobuf.reflection.MakeClass( desc )()
-
-
-            return reply, desc.name, frame_values[3]
+            return msg_type, frame_values[3], flags, data
         else:
-            return None, None, None
+            return None, None, None, None
 
     ##
     # @brief Send a message
     #
-    # Serializes and sends framing and message payload over connection.
+    # Serializes and sends framing and message payload over connection. If a
+    # timeout or flags are given, an extended frame is sent so that the
+    # server can discard the request if it can not be processed in time, and
+    # (with FLAG_STREAM) may stream a large reply.
     #
     # @param message - The protobuf message object to be sent
     # @param ctxt - Reply re-association value (int)
+    # @param timeout - Request timeout in milliseconds (0 = none)
+    # @param flags - Frame flags (0 = none)
     # @exception Exception: if unregistered message type is sent.
     #
-    def send( self, message, ctxt ):
+    def send( self, message, ctxt, timeout = 0, flags = 0 ):
         # Find msg type by descriptor look-up
         if not (message.DESCRIPTOR in self._msg_type_by_desc):
             raise Exception( "Attempt to send unregistered message type.")
@@ -195,8 +234,13 @@ class Connection:
         data = message.SerializeToString()
         data_sz = len( data )
 
-        # Build the message frame, to match C-struct MessageFrame
-        frame = struct.pack( '>LBBH', data_sz, msg_type >> 8, msg_type & 0xFF, ctxt )
+        # Build the message frame, to match C-struct MessageFrame (plus timeout and flags if extended)
+        if flags:
+            frame = struct.pack( '>LBBHLL', data_sz, msg_type >> 8, msg_type & 0xFF, ctxt, timeout, flags )
+        elif timeout > 0:
+            frame = struct.pack( '>LBBHL', data_sz, msg_type >> 8, msg_type & 0xFF, ctxt, timeout )
+        else:
+            frame = struct.pack( '>LBBH', data_sz, msg_type >> 8, msg_type & 0xFF, ctxt )
 
         if data_sz > 0:
             # Send frame and payload
@@ -206,6 +250,39 @@ class Connection:
             # Send frame (no payload)
             self._socket.send( frame, 0 )
 
+    ##
+    # @brief Get message type of a protobuf message
+    #
+    # @param message - Protobuf message object
+    # @return Numeric message type (as used in framing)
+    # @retval int
+    # @exception Exception: if message type is unregistered.
+    #
+    def getMessageType( self, message ):
+        if not (message.DESCRIPTOR in self._msg_type_by_desc):
+            raise Exception( "Unregistered message type.")
+        return self._msg_type_by_desc[message.DESCRIPTOR]
+
+    ##
+    # @brief Parse a serialized protobuf message of a given message type
+    #
+    # @param msg_type - Numeric message type
+    # @param data - Serialized message (bytes)
+    # @return Tuple of message and message type (name)
+    # @retval (object,str)
+    # @exception Exception: if message type is unregistered.
+    #
+    def parseMessage( self, msg_type, data ):
+        if not (msg_type in self._msg_desc_by_type):
+            raise Exception( "Unregistered message type: {}".format( msg_type ))
+
+        desc = self._msg_desc_by_type[msg_type]
+
+        if len( data ) > 0:
+            return google.protobuf.reflection.ParseMessage( desc, data ), desc.name
+        else:
+            return google.protobuf.reflection.MakeClass( desc )(), desc.name
+
     ##
     # @brief Reset connection
     #
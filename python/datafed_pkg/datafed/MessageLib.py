@@ -71,6 +71,9 @@ class API:
         self._auth = False
         self._nack_except = True
         self._timeout = 30000
+        # Request timeouts and streamed replies are only requested once server version is known to support them
+        self._send_timeout = False
+        self._stream = False
 
         if not server_host:
             raise Exception("Server host is not defined")
@@ -162,6 +165,9 @@ class API:
             reply.mapi_minor < Version_pb2.VER_MAPI_MINOR or reply.mapi_minor > ( Version_pb2.VER_MAPI_MINOR + 9 ):
             raise Exception( "Incompatible server version {}.{}.{}:{}".format(reply.major,reply.mapi_major,reply.mapi_minor,reply.client_py))
 
+        self._send_timeout = True
+        self._stream = True
+
         if reply.client_py > Version_pb2.VER_CLIENT_PY:
             self.new_client_avail = "{}.{}.{}:{}".format(reply.major,reply.mapi_major,reply.mapi_minor,reply.client_py)
         else:
@@ -304,8 +310,9 @@ class API:
     # @exception Exception: On message context mismatch (out of sync)
     #
     def sendRecv( self, msg, timeout = None, nack_except = None ):
-        self.send( msg )
         _timeout = (timeout if timeout != None else self._timeout)
+        # Server discards request if not processed before timeout
+        self.send( msg, _timeout if self._send_timeout and _timeout > 0 else 0, self._stream )
         reply, mt, ctxt = self.recv( _timeout, nack_except )
         if reply == None:
             return None, None
@@ -314,16 +321,56 @@ class API:
         return reply, mt
 
 
+    ## @brief Send a batch of requests to DataFed server in one round trip and receive the replies.
+    #
+    # Only requests handled directly by the DataFed database may be batched
+    # (e.g. views, listings, and permission checks). Requests are processed
+    # concurrently by the server unless ordered is set.
+    #
+    # @param msgs: List of protobuf request messages
+    # @param timeout: Timeout in milliseconds
+    # @param ordered: Process requests sequentially, in order
+    # @return A list of (reply, type) tuples, one per request in request
+    #   order. A failed request has a NackReply (exceptions are not raised
+    #   for individual requests). On timeout, returns None.
+    # @retval list of (obj,str)
+    # @exception Exception: If the batch as a whole is rejected (and NACK
+    #   exceptions are enabled).
+    #
+    def sendRecvBatch( self, msgs, timeout = None, ordered = False ):
+        req = auth.BatchRequest()
+
+        for msg in msgs:
+            item = req.item.add()
+            item.msg_type = self._conn.getMessageType( msg )
+            item.data = msg.SerializeToString()
+
+        if ordered:
+            req.ordered = True
+
+        reply, mt = self.sendRecv( req, timeout )
+        if reply == None:
+            return None
+
+        if mt != "BatchReply":
+            return [( reply, mt )] * len( msgs )
+
+        return [ self._conn.parseMessage( item.msg_type, item.data ) for item in reply.item ]
+
+
     ## @brief Asynchronously send a protobuf message to DataFed server.
     #
     # @param msg: Protobuf message to send to the server
+    # @param timeout: Optional request timeout in milliseconds (0 = none)
+    # @param stream: Allow server to stream a large reply (received
+    #   in parts and merged by recv)
     # @return Auto-generated message re-association context int
     #    value (match to context in subsequent reply).
     # @retval int
     #
-    def send( self, msg ):
+    def send( self, msg, timeout = 0, stream = False ):
         self._ctxt += 1
-        self._conn.send( msg, self._ctxt )
+        self._conn.send( msg, self._ctxt, timeout, Connection.FLAG_STREAM if stream else 0 )
         return self._ctxt
 
 
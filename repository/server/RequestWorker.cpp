@@ -23,10 +23,20 @@ namespace Repo {
 
 map<uint16_t,RequestWorker::msg_fun_t> RequestWorker::m_msg_handlers;
 
+/// Size of initial arena block; request/reply messages fit without further allocation
+#define ARENA_BLOCK_SIZE 16384
+
 
 RequestWorker::RequestWorker( size_t a_tid ) :
     m_config(Config::getInstance()), m_tid(a_tid), m_worker_thread(0), m_run(true)
 {
+    google::protobuf::ArenaOptions arena_opt;
+
+    m_arena_block = new char[ARENA_BLOCK_SIZE];
+    arena_opt.initial_block = m_arena_block;
+    arena_opt.initial_block_size = ARENA_BLOCK_SIZE;
+    m_arena = new google::protobuf::Arena( arena_opt );
+
     setupMsgHandlers();
     m_worker_thread = new thread( &RequestWorker::workerThread, this );
 }
@@ -35,6 +45,9 @@ RequestWorker::~RequestWorker()
 {
     stop();
     wait();
+
+    delete m_arena;
+    delete[] m_arena_block;
 }
 
 void
@@ -143,6 +156,9 @@ RequestWorker::workerThread()
         {
             DL_ERROR( "W" << m_tid << " unknown exception type" );
         }
+
+        // Frees request and reply messages of last request
+        m_arena->Reset();
     }
 
     DL_DEBUG( "W" << m_tid << " thread exiting" );
@@ -151,14 +167,14 @@ RequestWorker::workerThread()
 
 #define PROC_MSG_BEGIN( msgclass, replyclass ) \
 msgclass *request = 0; \
-::google::protobuf::Message *base_msg = m_msg_buf.unserialize(); \
+::google::protobuf::Message *base_msg = m_msg_buf.unserialize( m_arena ); \
 if ( base_msg ) \
 { \
     request = dynamic_cast<msgclass*>( base_msg ); \
     if ( request ) \
     { \
         DL_TRACE( "Rcvd [" << request->DebugString() << "]"); \
-        replyclass reply; \
+        replyclass & reply = *google::protobuf::Arena::CreateMessage<replyclass>( m_arena ); \
         try \
         {
 
@@ -194,7 +210,6 @@ if ( base_msg ) \
     else { \
         DL_ERROR( "W"<<m_tid<<": dynamic cast of msg buffer failed!" );\
     } \
-    delete base_msg; \
 } \
 else { \
     DL_ERROR( "W"<<m_tid<<": buffer parse failed due to unregistered msg type." ); \
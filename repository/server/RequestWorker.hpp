@@ -38,6 +38,8 @@ private:
     bool                m_run;
 
     MsgBuf              m_msg_buf;
+    char *              m_arena_block;
+    google::protobuf::Arena * m_arena;
 
     typedef void (RequestWorker::*msg_fun_t)();
     static std::map<uint16_t,msg_fun_t> m_msg_handlers;
@@ -8,9 +8,11 @@
 #endif
 
 #include "libjson.hpp"
+#include "DatabaseReplyReader.hpp"
 
 using namespace std;
 using namespace libjson;
+using namespace SDMS;
 
 #if defined(_WIN32) || defined(_WIN64)
 
@@ -367,6 +369,20 @@ void perfTest()
         elapsed = timerElapsed();
 
         cout << "Completed " << ntest << " translations in " << elapsed << " sec, " << 1000.0 * elapsed / ntest << " msec per translation\n";
+
+        timerStart();
+
+        for ( i = 0; i < ntest; i++ )
+        {
+            v.fromString( json );
+            parse1( v, result );
+        }
+
+        timerStop();
+        elapsed = timerElapsed();
+
+        cout << "Completed " << ntest << " parse+lookups in " << elapsed << " sec, " << 1000.0 * elapsed / ntest << " msec per parse+lookup, "
+            << ( json.size() * ntest ) / ( elapsed * 1024 * 1024 ) << " MB/s\n";
     }
     catch ( TraceException & e )
     {
@@ -375,6 +391,289 @@ void perfTest()
 }
 
 
+/**
+ * Builds a DB listing reply (as returned for collection reads and searches)
+ * with a_count items and paging info.
+ */
+string buildListingJSON( size_t a_count )
+{
+    string json = "[";
+
+    for ( size_t i = 0; i < a_count; i++ )
+    {
+        json += "{\"id\":\"d/" + to_string( 10000000 + i ) + "\",\"title\":\"Data record title text for item number " + to_string( i ) +
+            "\",\"alias\":" + ( i & 1 ? "null" : "\"alias_" + to_string( i ) + "\"" ) +
+            ",\"owner\":\"u/someuser\",\"creator\":\"u/someuser\",\"size\":" + to_string( 1024 * i ) +
+            ",\"external\":false,\"notes\":0,\"locked\":" + ( i & 2 ? "true" : "false" ) +
+            ",\"desc\":\"Longer description text for data record with \\\"escaped\\\" characters\\n\"},";
+    }
+
+    json += "{\"paging\":{\"off\":0,\"cnt\":" + to_string( a_count ) + ",\"tot\":" + to_string( a_count * 10 ) + "}}]";
+
+    return json;
+}
+
+/**
+ * Builds a DB record reply with a_count records (metadata, tags, and deps)
+ */
+string buildRecordJSON( size_t a_count )
+{
+    string json = "{\"results\":[";
+
+    for ( size_t i = 0; i < a_count; i++ )
+    {
+        if ( i )
+            json += ",";
+
+        json += "{\"id\":\"d/" + to_string( 10000000 + i ) + "\",\"title\":\"Record title\",\"alias\":null,\"owner\":\"u/someuser\"," +
+            "\"creator\":\"u/someuser\",\"desc\":\"Description\",\"tags\":[\"tag1\",\"tag2\",\"tag3\"]," +
+            "\"md\":{\"a\":1,\"b\":[1,2,3],\"c\":{\"d\":\"text\",\"e\":true}},\"external\":false,\"repo_id\":\"repo/test\"," +
+            "\"size\":1000000,\"source\":\"\",\"ext\":\".dat\",\"ext_auto\":true,\"ct\":1600000000,\"ut\":1600000001," +
+            "\"locked\":false,\"parent_id\":\"c/1234\",\"notes\":0,\"_rev\":\"abc\",\"_key\":\"" + to_string( 10000000 + i ) + "\"," +
+            "\"deps\":[{\"id\":\"d/1\",\"alias\":null,\"type\":0,\"dir\":0},{\"id\":\"d/2\",\"alias\":\"a2\",\"type\":1,\"dir\":1}]}";
+    }
+
+    json += "],\"updates\":[{\"id\":\"c/1234\",\"title\":\"Parent\",\"owner\":\"u/someuser\"}]}";
+
+    return json;
+}
+
+/// Same translation as DatabaseAPI::setListingData (Value-based)
+void domListingData( ListingData * a_item, const Value::Object & a_obj )
+{
+    if ( a_obj.has( "id" ))
+        a_item->set_id( a_obj.asString() );
+    else if ( a_obj.has( "_id" ))
+        a_item->set_id( a_obj.asString() );
+
+    a_item->set_title( a_obj.getString( "title" ));
+
+    if ( a_obj.has( "alias" ) && !a_obj.value().isNull( ))
+        a_item->set_alias( a_obj.asString() );
+    if ( a_obj.has( "owner" ) && !a_obj.value().isNull( ))
+        a_item->set_owner( a_obj.asString() );
+    if ( a_obj.has( "owner_name" ) && !a_obj.value().isNull( ))
+        a_item->set_owner_name( a_obj.asString() );
+    if ( a_obj.has( "creator" ) && !a_obj.value().isNull( ))
+        a_item->set_creator( a_obj.asString() );
+    if ( a_obj.has( "desc" ) && !a_obj.value().isNull( ))
+        a_item->set_desc( a_obj.asString() );
+    if ( a_obj.has( "size" ) && !a_obj.value().isNull( ))
+        a_item->set_size( a_obj.asNumber() );
+    if ( a_obj.has( "external" ) && !a_obj.value().isNull( ))
+        a_item->set_external( a_obj.asBool() );
+    if ( a_obj.has( "notes" ))
+        a_item->set_notes( a_obj.asNumber() );
+    if ( a_obj.has( "locked" ) && !a_obj.value().isNull( ))
+        a_item->set_locked( a_obj.asBool() );
+    if ( a_obj.has( "gen" ))
+        a_item->set_gen( a_obj.asNumber() );
+}
+
+/// Same translation as DatabaseAPI::setListingDataReply (Value-based)
+void domListingReply( Auth::ListingReply & a_reply, const Value & a_result )
+{
+    const Value::Array & arr = a_result.asArray();
+
+    for ( Value::ArrayConstIter i = arr.begin(); i != arr.end(); i++ )
+    {
+        const Value::Object & obj = i->asObject();
+
+        if ( obj.has( "paging" ))
+        {
+            const Value::Object & obj2 = obj.asObject();
+
+            a_reply.set_offset( obj2.getNumber( "off" ));
+            a_reply.set_count( obj2.getNumber( "cnt" ));
+            a_reply.set_total( obj2.getNumber( "tot" ));
+        }
+        else
+            domListingData( a_reply.add_item(), obj );
+    }
+}
+
+/// Same translation as DatabaseAPI::setRecordData (Value-based)
+void domRecordReply( Auth::RecordDataReply & a_reply, const Value & a_result )
+{
+    const Value::Object & res_obj = a_result.asObject();
+    Value::ArrayConstIter i, k;
+    RecordData * rec;
+    DependencyData * deps;
+
+    if ( res_obj.has( "results" ))
+    {
+        const Value::Array & arr = res_obj.asArray();
+
+        for ( i = arr.begin(); i != arr.end(); i++ )
+        {
+            const Value::Object & obj = i->asObject();
+
+            rec = a_reply.add_data();
+            rec->set_id( obj.getString( "id" ));
+            rec->set_title( obj.getString( "title" ));
+
+            if ( obj.has( "alias" ) && !obj.value().isNull() )
+                rec->set_alias( obj.asString() );
+            if ( obj.has( "owner" ))
+                rec->set_owner( obj.asString() );
+            if ( obj.has( "creator" ))
+                rec->set_creator( obj.asString() );
+            if ( obj.has( "desc" ))
+                rec->set_desc( obj.asString() );
+            if ( obj.has( "tags" ))
+            {
+                const Value::Array & arr2 = obj.asArray();
+                for ( k = arr2.begin(); k != arr2.end(); k++ )
+                    rec->add_tags( k->asString() );
+            }
+            if ( obj.has( "md" ))
+                rec->set_metadata( obj.value().toString() );
+            if ( obj.has( "md_err_msg" ))
+                rec->set_md_err_msg( obj.asString() );
+            if ( obj.has( "sch_id" ))
+                rec->set_sch_id( obj.asString() );
+            if ( obj.has( "external" ))
+                rec->set_external( obj.asBool() );
+            if ( obj.has( "repo_id" ))
+                rec->set_repo_id( obj.asString() );
+            if ( obj.has( "size" ))
+                rec->set_size( obj.asNumber() );
+            if ( obj.has( "source" ))
+                rec->set_source( obj.asString() );
+            if ( obj.has( "ext" ))
+                rec->set_ext( obj.asString() );
+            if ( obj.has( "ext_auto" ))
+                rec->set_ext_auto( obj.asBool() );
+            if ( obj.has( "ct" ))
+                rec->set_ct( obj.asNumber() );
+            if ( obj.has( "ut" ))
+                rec->set_ut( obj.asNumber() );
+            if ( obj.has( "dt" ))
+                rec->set_dt( obj.asNumber() );
+            if ( obj.has( "locked" ))
+                rec->set_locked( obj.asBool() );
+            if ( obj.has( "parent_id" ))
+                rec->set_parent_id( obj.asString() );
+            if ( obj.has( "notes" ))
+                rec->set_notes( obj.asNumber() );
+            if ( obj.has( "deps" ))
+            {
+                const Value::Array & arr2 = obj.asArray();
+
+                for ( k = arr2.begin(); k != arr2.end(); k++ )
+                {
+                    const Value::Object & obj2 = k->asObject();
+
+                    deps = rec->add_deps();
+                    deps->set_id( obj2.getString( "id" ));
+                    deps->set_type((DependencyType)(unsigned short) obj2.getNumber( "type" ));
+                    deps->set_dir((DependencyDir)(unsigned short) obj2.getNumber( "dir" ));
+
+                    if ( obj2.has( "alias" ) && !obj2.value().isNull( ))
+                        deps->set_alias( obj2.asString() );
+                }
+            }
+        }
+    }
+
+    if ( res_obj.has( "updates" ))
+    {
+        const Value::Array & arr = res_obj.asArray();
+
+        for ( i = arr.begin(); i != arr.end(); i++ )
+            domListingData( a_reply.add_update(), i->asObject() );
+    }
+}
+
+/// Re-formats record metadata so DOM and SAX results can be compared
+void normalizeMetadata( Auth::ListingReply & )
+{
+}
+
+void normalizeMetadata( Auth::RecordDataReply & a_reply )
+{
+    Value md;
+
+    for ( int i = 0; i < a_reply.data_size(); i++ )
+    {
+        if ( a_reply.data(i).has_metadata() )
+        {
+            md.fromString( a_reply.data(i).metadata() );
+            a_reply.mutable_data(i)->set_metadata( md.toString() );
+        }
+    }
+}
+
+/**
+ * Compares DOM (Value + translate) and SAX (Reader + reply reader) translation
+ * of a DB reply into protobuf message type RP. Results of both paths must
+ * match (metadata is compared as parsed JSON since formatting may differ).
+ */
+template<typename RP, typename RD>
+void saxTest( const char * a_label, const string & a_json, size_t a_ntest, void (*a_dom_fn)( RP &, const Value & ))
+{
+    Value   v;
+    Reader  reader;
+    RP      dom_reply, sax_reply;
+    double  elapsed;
+
+    timerDef();
+
+    timerStart();
+
+    for ( size_t i = 0; i < a_ntest; i++ )
+    {
+        dom_reply.Clear();
+        v.fromString( a_json );
+        a_dom_fn( dom_reply, v );
+    }
+
+    timerStop();
+    elapsed = timerElapsed();
+
+    cout << "  " << a_label << " DOM parse+translate: " << 1000.0 * elapsed / a_ntest << " msec, "
+        << ( a_json.size() * a_ntest ) / ( elapsed * 1024 * 1024 ) << " MB/s\n";
+
+    timerStart();
+
+    for ( size_t i = 0; i < a_ntest; i++ )
+    {
+        sax_reply.Clear();
+        RD rd( sax_reply );
+        reader.parse( a_json, rd );
+    }
+
+    timerStop();
+    elapsed = timerElapsed();
+
+    cout << "  " << a_label << " SAX translate:       " << 1000.0 * elapsed / a_ntest << " msec, "
+        << ( a_json.size() * a_ntest ) / ( elapsed * 1024 * 1024 ) << " MB/s\n";
+
+    normalizeMetadata( dom_reply );
+    normalizeMetadata( sax_reply );
+
+    if ( dom_reply.SerializeAsString() != sax_reply.SerializeAsString() )
+        EXCEPT_PARAM( 1, a_label << " SAX translation does not match DOM translation" );
+}
+
+void saxPerfTest()
+{
+    size_t counts[] = { 10, 1000, 10000 };
+
+    for ( size_t c = 0; c < sizeof( counts ) / sizeof( counts[0] ); c++ )
+    {
+        string listing = buildListingJSON( counts[c] );
+        string records = buildRecordJSON( counts[c] );
+        size_t ntest = 20000000 / listing.size() + 1;
+
+        cout << counts[c] << " items (listing " << listing.size() << " bytes, records " << records.size() << " bytes), " << ntest << " iterations\n";
+
+        saxTest<Auth::ListingReply,Core::ListingReplyReader>( "ListingReply   ", listing, ntest, domListingReply );
+        saxTest<Auth::RecordDataReply,Core::RecordDataReplyReader>( "RecordDataReply", records, ntest, domRecordReply );
+    }
+}
+
+
 int main( int argc, char** argv )
 {
     (void) argc;
@@ -385,6 +684,7 @@ int main( int argc, char** argv )
     try
     {
         perfTest();
+        saxPerfTest();
         return 0;
     }
     catch ( TraceException& e )
@@ -0,0 +1,371 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include "TraceException.hpp"
+#include "MsgBuf.hpp"
+#include "MsgComm.hpp"
+#include "SDMS.pb.h"
+#include "SDMS_Anon.pb.h"
+
+using namespace std;
+using namespace SDMS;
+
+/**
+ * Load generator for the core server front end.
+ *
+ * Measures request/reply throughput (messages/sec) over CURVE-encrypted
+ * connections from a number of concurrent clients, each keeping a window of
+ * requests in-flight. Two modes are supported:
+ *
+ * Local mode (default) runs an in-process echo server that mirrors the core
+ * secure interface (CURVE ROUTER socket with a separate context) and sweeps
+ * the number of ZeroMQ I/O threads of the server context, showing how
+ * encryption and socket I/O scale with I/O threads.
+ *
+ * Remote mode (--host) sends VersionRequests to a running core server. These
+ * are handled by client workers without DB access, so the result reflects
+ * the core I/O, routing, and worker front end. Run against the core with
+ * different --io-threads / --router-shards settings to compare.
+ */
+
+struct Options
+{
+    Options() :
+        port( 7512 ), clients( 8 ), window( 16 ), duration( 5 ), size( 1024 ), io_threads_max( 8 ), client_io_threads( 4 )
+    {}
+
+    string      host;
+    uint32_t    port;
+    string      server_key;
+    uint32_t    clients;
+    uint32_t    window;
+    uint32_t    duration;
+    uint32_t    size;
+    uint32_t    io_threads_max;
+    uint32_t    client_io_threads;
+};
+
+static atomic<bool>     g_run;
+static atomic<uint64_t> g_replies;
+
+
+/**
+ * In-process echo server: every request is returned unchanged to the sender.
+ */
+void echoServer( void * a_ctx, const string & a_address, const MsgComm::SecurityContext & a_sec_ctx, atomic<bool> & a_ready )
+{
+    MsgComm         comm( a_address, MsgComm::ROUTER, true, &a_sec_ctx, a_ctx );
+    void *          sock = comm.getSocket();
+    zmq_pollitem_t  item;
+    zmq_msg_t       msg;
+    int             more;
+
+    comm.getPollInfo( item );
+    a_ready = true;
+
+    while ( g_run )
+    {
+        if ( zmq_poll( &item, 1, 100 ) < 1 )
+            continue;
+
+        while ( 1 )
+        {
+            zmq_msg_init( &msg );
+
+            if ( zmq_msg_recv( &msg, sock, ZMQ_DONTWAIT ) < 0 )
+            {
+                zmq_msg_close( &msg );
+                break;
+            }
+
+            more = zmq_msg_more( &msg );
+            zmq_msg_send( &msg, sock, more ? ZMQ_SNDMORE : 0 );
+        }
+    }
+}
+
+/**
+ * Echo client: keeps a_window raw requests of a_size bytes in-flight.
+ */
+void echoClient( void * a_ctx, const string & a_address, const MsgComm::SecurityContext & a_sec_ctx, uint32_t a_window, uint32_t a_size )
+{
+    MsgComm         comm( a_address, MsgComm::DEALER, false, &a_sec_ctx, a_ctx );
+    void *          sock = comm.getSocket();
+    zmq_pollitem_t  item;
+    string          payload( a_size, 'x' );
+    char            reply[64];
+    uint32_t        in_flight;
+
+    comm.getPollInfo( item );
+
+    for ( in_flight = 0; in_flight < a_window; in_flight++ )
+        zmq_send( sock, payload.data(), payload.size(), 0 );
+
+    while ( in_flight )
+    {
+        if ( zmq_poll( &item, 1, 1000 ) < 1 )
+        {
+            if ( !g_run )
+                break;
+            continue;
+        }
+
+        while ( zmq_recv( sock, reply, sizeof( reply ), ZMQ_DONTWAIT ) >= 0 )
+        {
+            in_flight--;
+            g_replies++;
+
+            if ( g_run )
+            {
+                zmq_send( sock, payload.data(), payload.size(), 0 );
+                in_flight++;
+            }
+        }
+    }
+}
+
+/**
+ * Core client: keeps a_window VersionRequests in-flight.
+ */
+void coreClient( void * a_ctx, const string & a_address, const MsgComm::SecurityContext & a_sec_ctx, uint32_t a_window )
+{
+    MsgComm                 comm( a_address, MsgComm::DEALER, false, &a_sec_ctx, a_ctx );
+    Anon::VersionRequest    request;
+    MsgBuf                  buf;
+    uint32_t                in_flight;
+
+    for ( in_flight = 0; in_flight < a_window; in_flight++ )
+        comm.send( request );
+
+    while ( in_flight )
+    {
+        if ( !comm.recv( buf, false, 1000 ))
+        {
+            if ( !g_run )
+                break;
+            continue;
+        }
+
+        in_flight--;
+        g_replies++;
+
+        if ( g_run )
+        {
+            comm.send( request );
+            in_flight++;
+        }
+    }
+}
+
+void makeClientKeys( MsgComm::SecurityContext & a_sec_ctx )
+{
+    char pub_key[41];
+    char priv_key[41];
+
+    if ( zmq_curve_keypair( pub_key, priv_key ) != 0 )
+        EXCEPT( 1, "Key generation failed" );
+
+    a_sec_ctx.is_server = false;
+    a_sec_ctx.public_key = pub_key;
+    a_sec_ctx.private_key = priv_key;
+}
+
+/**
+ * Runs clients against a_address for the configured duration, returns messages/sec
+ */
+double runClients( const Options & a_opt, const string & a_address, const string & a_server_key, bool a_core )
+{
+    void *                      ctx = zmq_ctx_new();
+    vector<MsgComm::SecurityContext> sec( a_opt.clients );
+    vector<thread*>             clients;
+    uint64_t                    start_count;
+    chrono::steady_clock::time_point start;
+    double                      elapsed;
+
+    zmq_ctx_set( ctx, ZMQ_IO_THREADS, a_opt.client_io_threads );
+
+    g_replies = 0;
+    g_run = true;
+
+    for ( uint32_t c = 0; c < a_opt.clients; c++ )
+    {
+        makeClientKeys( sec[c] );
+        sec[c].server_key = a_server_key;
+
+        if ( a_core )
+            clients.push_back( new thread( coreClient, ctx, a_address, cref( sec[c] ), a_opt.window ));
+        else
+            clients.push_back( new thread( echoClient, ctx, a_address, cref( sec[c] ), a_opt.window, a_opt.size ));
+    }
+
+    // Exclude connection set-up (CURVE handshake) from measurement
+    this_thread::sleep_for( chrono::seconds( 1 ));
+
+    start_count = g_replies;
+    start = chrono::steady_clock::now();
+
+    this_thread::sleep_for( chrono::seconds( a_opt.duration ));
+
+    elapsed = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    uint64_t count = g_replies - start_count;
+
+    g_run = false;
+
+    for ( vector<thread*>::iterator t = clients.begin(); t != clients.end(); t++ )
+    {
+        (*t)->join();
+        delete *t;
+    }
+
+    zmq_ctx_term( ctx );
+
+    return count / elapsed;
+}
+
+void localSweep( const Options & a_opt )
+{
+    char        pub_key[41];
+    char        priv_key[41];
+    double      rate, base = 0;
+
+    if ( zmq_curve_keypair( pub_key, priv_key ) != 0 )
+        EXCEPT( 1, "Key generation failed" );
+
+    MsgComm::SecurityContext sec;
+    sec.is_server = true;
+    sec.public_key = pub_key;
+    sec.private_key = priv_key;
+
+    cout << "Clients: " << a_opt.clients << ", window: " << a_opt.window << ", payload: " << a_opt.size << " bytes, duration: " << a_opt.duration << " sec\n";
+    cout << "io-threads  msgs/sec  speed-up\n";
+
+    for ( uint32_t n = 1; n <= a_opt.io_threads_max; n *= 2 )
+    {
+        void *          ctx = zmq_ctx_new();
+        atomic<bool>    ready( false );
+        string          address = "tcp://127.0.0.1:" + to_string( a_opt.port );
+
+        zmq_ctx_set( ctx, ZMQ_IO_THREADS, n );
+
+        g_run = true;
+        thread server( echoServer, ctx, address, cref( sec ), ref( ready ));
+
+        while ( !ready )
+            this_thread::sleep_for( chrono::milliseconds( 10 ));
+
+        rate = runClients( a_opt, address, pub_key, false );
+
+        // Clients clear run flag when done
+        server.join();
+        zmq_ctx_term( ctx );
+
+        if ( n == 1 )
+            base = rate;
+
+        cout.width( 10 );
+        cout << n;
+        cout.width( 10 );
+        cout << (uint64_t)rate;
+        cout.width( 10 );
+        cout << ( base > 0 ? rate / base : 0 ) << "\n";
+    }
+}
+
+void usage()
+{
+    cout << "Usage: loadgen [options]\n";
+    cout << "  --host <host>          Core server host (remote mode; default is local echo sweep)\n";
+    cout << "  --port <port>          Core server port, or local echo server port (default 7512)\n";
+    cout << "  --server-key <key>     Core server public key (remote mode)\n";
+    cout << "  --clients <n>          Number of concurrent clients (default 8)\n";
+    cout << "  --window <n>           In-flight requests per client (default 16)\n";
+    cout << "  --duration <sec>       Measurement duration per run (default 5)\n";
+    cout << "  --size <bytes>         Echo payload size (local mode, default 1024)\n";
+    cout << "  --io-threads <n>       Max server I/O threads for sweep (local mode, default 8)\n";
+    cout << "  --client-io-threads <n> Client context I/O threads (default 4)\n";
+}
+
+int main( int argc, char** argv )
+{
+    Options opt;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        string arg = argv[i];
+
+        if ( arg == "--help" )
+        {
+            usage();
+            return 0;
+        }
+
+        if ( i + 1 == argc )
+        {
+            usage();
+            return 1;
+        }
+
+        string val = argv[++i];
+
+        if ( arg == "--host" )
+            opt.host = val;
+        else if ( arg == "--port" )
+            opt.port = atoi( val.c_str() );
+        else if ( arg == "--server-key" )
+            opt.server_key = val;
+        else if ( arg == "--clients" )
+            opt.clients = atoi( val.c_str() );
+        else if ( arg == "--window" )
+            opt.window = atoi( val.c_str() );
+        else if ( arg == "--duration" )
+            opt.duration = atoi( val.c_str() );
+        else if ( arg == "--size" )
+            opt.size = atoi( val.c_str() );
+        else if ( arg == "--io-threads" )
+            opt.io_threads_max = atoi( val.c_str() );
+        else if ( arg == "--client-io-threads" )
+            opt.client_io_threads = atoi( val.c_str() );
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if ( !opt.clients || !opt.window || !opt.duration || !opt.io_threads_max || !opt.client_io_threads )
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        if ( opt.host.size() )
+        {
+            if ( opt.server_key.size() != 40 )
+                EXCEPT( 1, "Remote mode requires a valid server public key" );
+
+            cout << "Core front end: " << opt.host << ":" << opt.port << ", clients: " << opt.clients << ", window: " << opt.window << "\n";
+
+            double rate = runClients( opt, "tcp://" + opt.host + ":" + to_string( opt.port ), opt.server_key, true );
+
+            cout << "msgs/sec: " << (uint64_t)rate << "\n";
+        }
+        else
+        {
+            localSweep( opt );
+        }
+    }
+    catch ( TraceException& e )
+    {
+        cout << "Error: " << e.toString( true ) << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,262 @@
+#include <iostream>
+#include <memory>
+#include <algorithm>
+#include <string.h>
+#include <time.h>
+#include "TraceException.hpp"
+#include "MsgBuf.hpp"
+#include "MsgComm.hpp"
+#include "SDMS.pb.h"
+#include "SDMS_Anon.pb.h"
+#include "SDMS_Auth.pb.h"
+
+using namespace std;
+using namespace SDMS;
+
+// Define local vars need by timer functions
+#define timerDef() struct timespec _T0 = {0,0}, _T1 = {0,0}; (void)_T0; (void)_T1;
+
+// Start timer
+#define timerStart() clock_gettime(CLOCK_REALTIME,&_T0)
+
+// Stop timer
+#define timerStop() clock_gettime(CLOCK_REALTIME,&_T1)
+
+// Calc elapsed time
+#define timerElapsed() ((_T1.tv_sec - _T0.tv_sec) + ((_T1.tv_nsec - _T0.tv_nsec)*1.0e-9))
+
+
+/**
+ * Builds a large listing reply similar to those returned for big collections
+ * and search results.
+ */
+void buildListing( Auth::ListingReply & a_reply, size_t a_count )
+{
+    ListingData * item;
+
+    for ( size_t i = 0; i < a_count; i++ )
+    {
+        item = a_reply.add_item();
+        item->set_id( "d/" + to_string( 10000000 + i ));
+        item->set_title( "Data record title text for item number " + to_string( i ));
+        item->set_alias( "alias_" + to_string( i ));
+        item->set_owner( "u/someuser" );
+        item->set_creator( "u/someuser" );
+        item->set_size( 1024.0 * i );
+        item->set_desc( "Longer description text for data record used to bulk up the listing message payload" );
+    }
+
+    a_reply.set_offset( 0 );
+    a_reply.set_count( a_count );
+    a_reply.set_total( a_count );
+}
+
+/**
+ * Emulates the previous receive path: message body copied from zeromq message
+ * into the MsgBuf buffer, then unserialized.
+ */
+void recvCopy( zmq_msg_t & a_msg, MsgBuf & a_buf )
+{
+    a_buf.ensureCapacity( a_buf.getFrame().size );
+    memcpy( a_buf.getBuffer(), zmq_msg_data( &a_msg ), a_buf.getFrame().size );
+    zmq_msg_close( &a_msg );
+}
+
+/**
+ * Current receive path: MsgBuf takes ownership of zeromq message.
+ */
+void recvAttach( zmq_msg_t & a_msg, MsgBuf & a_buf )
+{
+    a_buf.attachMessage( a_msg );
+    zmq_msg_close( &a_msg );
+}
+
+void recvTest( const string & a_payload, const MsgBuf::Frame & a_frame, size_t a_ntest, bool a_zero_copy, bool a_parse, bool a_arena = false )
+{
+    MsgBuf                          buf;
+    zmq_msg_t                       msg;
+    ::google::protobuf::Message *   reply;
+    ::google::protobuf::Arena       arena;
+    double                          elapsed;
+
+    buf.getFrame() = a_frame;
+
+    timerDef();
+    timerStart();
+
+    for ( size_t i = 0; i < a_ntest; i++ )
+    {
+        // Stands in for zmq_msg_recv (same cost for both paths)
+        zmq_msg_init_size( &msg, a_payload.size() );
+        memcpy( zmq_msg_data( &msg ), a_payload.data(), a_payload.size() );
+
+        if ( a_zero_copy )
+            recvAttach( msg, buf );
+        else
+            recvCopy( msg, buf );
+
+        if ( a_parse )
+        {
+            reply = buf.unserialize( a_arena ? &arena : 0 );
+            if ( !reply )
+                EXCEPT( 1, "Unserialize failed" );
+
+            // Arena is reset per message, as done by message handlers
+            if ( a_arena )
+                arena.Reset();
+            else
+                delete reply;
+        }
+    }
+
+    timerStop();
+    elapsed = timerElapsed();
+
+    cout << ( a_zero_copy ? "  zero-copy" : "  copy     " ) << ( a_parse ? ( a_arena ? " recv+parse (arena): " : " recv+parse:         " ) : " recv:               " )
+        << 1.0e6 * elapsed / a_ntest << " usec/msg, "
+        << ( a_payload.size() * a_ntest ) / ( elapsed * 1024 * 1024 ) << " MB/s\n";
+}
+
+/**
+ * Round-trip over an inproc socket pair using MsgComm (zero-copy send and
+ * receive paths).
+ */
+void commTest( Auth::ListingReply & a_reply, size_t a_ntest )
+{
+    MsgComm     server( "inproc://msgbuf_test", MsgComm::ROUTER, true );
+    MsgComm     client( "inproc://msgbuf_test", MsgComm::DEALER, false );
+    MsgBuf      in_buf, out_buf;
+    double      elapsed;
+
+    timerDef();
+    timerStart();
+
+    for ( size_t i = 0; i < a_ntest; i++ )
+    {
+        out_buf.serialize( a_reply );
+        client.send( out_buf );
+
+        if ( !server.recv( in_buf, false, 5000 ))
+            EXCEPT( 1, "Server recv timeout" );
+
+        // Echo received body back without re-serializing
+        server.send( in_buf );
+
+        if ( !client.recv( in_buf, false, 5000 ))
+            EXCEPT( 1, "Client recv timeout" );
+    }
+
+    timerStop();
+    elapsed = timerElapsed();
+
+    cout << "  MsgComm inproc round-trip: " << 1.0e6 * elapsed / a_ntest << " usec/msg\n";
+}
+
+/**
+ * Streamed reply over an inproc socket pair: the server sends a listing as
+ * partial frames (as client workers do), and the client merges them on
+ * receipt. The merged reply must match the original.
+ */
+void streamTest( Auth::ListingReply & a_reply, int a_chunk )
+{
+    MsgComm             server( "inproc://msgbuf_stream_test", MsgComm::ROUTER, true );
+    MsgComm             client( "inproc://msgbuf_stream_test", MsgComm::DEALER, false );
+    MsgBuf              buf;
+    MsgBuf::Message *   msg = 0;
+    MsgBuf::Frame       frame;
+    Auth::ListingReply  part;
+    Anon::AckReply      req;
+    int                 beg, end, frames = 0;
+
+    client.send( req, 7, 0, MsgBuf::FLAG_STREAM );
+
+    if ( !server.recv( buf, false, 5000 ))
+        EXCEPT( 1, "Server recv timeout" );
+
+    if ( buf.getFlags() != MsgBuf::FLAG_STREAM || buf.getTimeout() != 0 || buf.getFrame().context != 7 )
+        EXCEPT( 1, "Request flags or context not received" );
+
+    for ( beg = 0; beg < a_reply.item_size(); beg = end )
+    {
+        end = min( beg + a_chunk, a_reply.item_size() );
+        part.Clear();
+
+        for ( int i = beg; i < end; i++ )
+            *part.add_item() = a_reply.item( i );
+
+        if ( end == a_reply.item_size() )
+        {
+            part.set_offset( a_reply.offset() );
+            part.set_count( a_reply.count() );
+            part.set_total( a_reply.total() );
+        }
+
+        // Send clears the frame of the reused buffer, as in ClientWorker::sendStream
+        buf.serialize( part );
+        buf.getFrame().context = 7;
+        buf.setFlags( end < a_reply.item_size() ? MsgBuf::FLAG_PARTIAL : 0 );
+        server.send( buf );
+        frames++;
+    }
+
+    if ( !client.recv( msg, frame, 5000 ))
+        EXCEPT( 1, "Client recv timeout" );
+
+    unique_ptr<MsgBuf::Message> reply( msg );
+
+    if ( frame.context != 7 || reply->SerializeAsString() != a_reply.SerializeAsString() )
+        EXCEPT( 1, "Merged streamed reply does not match" );
+
+    cout << "  Streamed reply: " << frames << " frames merged\n";
+}
+
+void perfTest()
+{
+    size_t counts[] = { 10, 1000, 10000 };
+    size_t ntest;
+
+    for ( size_t c = 0; c < sizeof( counts ) / sizeof( counts[0] ); c++ )
+    {
+        Auth::ListingReply  reply;
+        MsgBuf              buf;
+        string              payload;
+
+        buildListing( reply, counts[c] );
+        buf.serialize( reply );
+        payload.assign( buf.getBuffer(), buf.getFrame().size );
+        ntest = 100000000 / ( payload.size() + 1000 ) + 10;
+
+        cout << "ListingReply, " << counts[c] << " items, " << payload.size() << " bytes, " << ntest << " iterations\n";
+
+        recvTest( payload, buf.getFrame(), ntest, false, false );
+        recvTest( payload, buf.getFrame(), ntest, true, false );
+        recvTest( payload, buf.getFrame(), ntest, false, true );
+        recvTest( payload, buf.getFrame(), ntest, true, true );
+        recvTest( payload, buf.getFrame(), ntest, true, true, true );
+        commTest( reply, ntest );
+        streamTest( reply, 400 );
+    }
+}
+
+
+int main( int argc, char** argv )
+{
+    (void) argc;
+    (void) argv;
+
+    cout << "MsgBuf Test\n";
+
+    try
+    {
+        REG_PROTO( SDMS::Anon );
+        REG_PROTO( SDMS::Auth );
+
+        perfTest();
+        return 0;
+    }
+    catch ( TraceException& e )
+    {
+        cout << "Error: " << e.toString( true ) << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,391 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <zmq.h>
+
+#define DEF_DYNALOG
+#include "DynaLog.hpp"
+#include "TraceException.hpp"
+#include "MsgComm.hpp"
+#include "Config.hpp"
+#include "RepoConnMgr.hpp"
+#include "SDMS.pb.h"
+#include "SDMS_Anon.pb.h"
+#include "SDMS_Auth.pb.h"
+
+using namespace std;
+using namespace SDMS;
+using namespace SDMS::Core;
+
+#define REPO_ID         "repo/test"
+#define REPO_ADDRESS    "inproc://repoconn_test"
+#define CALL_TIMEOUT    300     // msec
+#define LATE_DELAY      600     // msec, reply delay of slow requests
+
+
+/**
+ * Minimal mock of a repository server that answers RepoDataGetSizeRequests
+ * with the numeric part of each record ID as its size. Requests for record
+ * "d/slow" are answered only after LATE_DELAY msec (after the caller has
+ * timed out), with a reply that would be accepted if matched to a newer call.
+ * Requests for record "d/drop" are never answered.
+ */
+class MockRepo
+{
+public:
+    MockRepo( const MsgComm::SecurityContext & a_sec_ctx ) :
+        m_requests( 0 ), m_late_sent( 0 ),
+        m_comm( REPO_ADDRESS, MsgComm::ROUTER, true, &a_sec_ctx )
+    {
+        m_thread = thread( &MockRepo::serverThread, this );
+        m_thread.detach();
+    }
+
+    atomic<uint32_t>    m_requests;
+    atomic<uint32_t>    m_late_sent;
+
+private:
+    struct Late
+    {
+        chrono::steady_clock::time_point    due;
+        MsgBuf *                            buf;
+    };
+
+    void serverThread()
+    {
+        MsgBuf                  buf;
+        MsgBuf::Message *       msg;
+        deque<Late>             late;
+
+        while ( 1 )
+        {
+            while ( late.size() && late.front().due <= chrono::steady_clock::now() )
+            {
+                m_comm.send( *late.front().buf );
+                delete late.front().buf;
+                late.pop_front();
+                m_late_sent++;
+            }
+
+            if ( !m_comm.recv( buf, false, 50 ))
+                continue;
+
+            m_requests++;
+            msg = buf.unserialize();
+
+            Auth::RepoDataGetSizeRequest *  req = dynamic_cast<Auth::RepoDataGetSizeRequest*>( msg );
+            Auth::RepoDataSizeReply         reply;
+            RecordDataSize *                sz;
+            bool                            slow = false;
+            bool                            drop = false;
+
+            for ( int i = 0; req && i < req->loc_size(); i++ )
+            {
+                sz = reply.add_size();
+                sz->set_id( req->loc(i).id() );
+
+                if ( req->loc(i).id() == "d/slow" )
+                {
+                    slow = true;
+                    sz->set_size( 999999 );
+                }
+                else if ( req->loc(i).id() == "d/drop" )
+                    drop = true;
+                else
+                    sz->set_size( stoi( req->loc(i).id().substr( 2 )));
+            }
+
+            delete msg;
+
+            if ( drop )
+                continue;
+
+            if ( slow )
+            {
+                Late l;
+
+                l.due = chrono::steady_clock::now() + chrono::milliseconds( LATE_DELAY );
+                l.buf = new MsgBuf();
+                memcpy( l.buf->getRouteBuffer(), buf.getRouteBuffer(), buf.getRouteMaxLen() );
+                l.buf->serialize( reply );
+                l.buf->getFrame().context = buf.getFrame().context;
+                late.push_back( l );
+            }
+            else
+            {
+                buf.serialize( reply );
+                m_comm.send( buf );
+            }
+        }
+    }
+
+    MsgComm     m_comm;
+    thread      m_thread;
+};
+
+
+/// Check that a reply holds the sizes of the records of a chunk; false if not
+bool checkReply( MsgBuf::Message * a_reply, size_t a_begin, size_t a_end )
+{
+    Auth::RepoDataSizeReply * reply = dynamic_cast<Auth::RepoDataSizeReply*>( a_reply );
+
+    if ( !reply || reply->size_size() != (int)( a_end - a_begin ))
+        return false;
+
+    for ( size_t i = a_begin; i < a_end; i++ )
+    {
+        if ( reply->size( i - a_begin ).id() != "d/" + to_string( i ) || reply->size( i - a_begin ).size() != i )
+            return false;
+    }
+
+    return true;
+}
+
+
+/// Fill a size request with records [a_begin,a_end), or a single record ID if given
+void buildRequest( Auth::RepoDataGetSizeRequest & a_req, size_t a_begin, size_t a_end, const char * a_id = 0 )
+{
+    RecordDataLocation * loc;
+
+    a_req.clear_loc();
+
+    if ( a_id )
+    {
+        loc = a_req.add_loc();
+        loc->set_id( a_id );
+        loc->set_path( "/data/x" );
+        return;
+    }
+
+    for ( size_t j = a_begin; j < a_end; j++ )
+    {
+        loc = a_req.add_loc();
+        loc->set_id( "d/" + to_string( j ));
+        loc->set_path( "/data/" + to_string( j ));
+    }
+}
+
+
+/**
+ * Sends a window of chunked size requests to one repository (as task workers
+ * do for raw data deletes and size updates), where one chunk is not answered
+ * in time. Checks that only that chunk fails, that the connection stays up,
+ * and that its late reply is dropped rather than completing a later call.
+ */
+bool chunkTimeoutTest( MockRepo & a_mock, size_t a_chunks, size_t a_chunk_size, size_t a_slow )
+{
+    struct Chunk
+    {
+        size_t                  begin;
+        size_t                  end;
+        RepoConnMgr::Request    request;
+    };
+
+    RepoConnMgr &               mgr = RepoConnMgr::getInstance();
+    RepoConnMgr::Stats          stats;
+    vector<Chunk>               chunks( a_chunks );
+    Auth::RepoDataGetSizeRequest req;
+    RecordDataLocation *        loc;
+    mutex                       done_mutex;
+    condition_variable          done_cvar;
+    size_t                      i, j, done = 0, errors = 0;
+
+    for ( i = 0; i < a_chunks; i++ )
+    {
+        Chunk & ch = chunks[i];
+
+        ch.begin = i * a_chunk_size;
+        ch.end = ch.begin + a_chunk_size;
+        ch.request.repo_id = REPO_ID;
+        ch.request.timeout = CALL_TIMEOUT;
+        ch.request.on_complete = [&]( RepoConnMgr::Request & )
+        {
+            lock_guard<mutex> lock( done_mutex );
+            done++;
+            done_cvar.notify_one();
+        };
+
+        req.clear_loc();
+
+        for ( j = ch.begin; j < ch.end; j++ )
+        {
+            loc = req.add_loc();
+            loc->set_id( i == a_slow && j == ch.begin ? string( "d/slow" ) : "d/" + to_string( j ));
+            loc->set_path( "/data/" + to_string( j ));
+        }
+
+        mgr.submit( ch.request, req );
+    }
+
+    {
+        unique_lock<mutex> lock( done_mutex );
+        while ( done < a_chunks )
+        {
+            if ( done_cvar.wait_for( lock, chrono::seconds( 10 )) == cv_status::timeout )
+            {
+                cout << "  Timeout, " << done << " of " << a_chunks << " chunks completed\n";
+                return false;
+            }
+        }
+    }
+
+    for ( i = 0; i < a_chunks; i++ )
+    {
+        Chunk & ch = chunks[i];
+
+        if ( i == a_slow )
+        {
+            if ( ch.request.reply )
+            {
+                cout << "  Slow chunk " << i << " did not time out\n";
+                errors++;
+            }
+        }
+        else if ( !checkReply( ch.request.reply, ch.begin, ch.end ))
+        {
+            cout << "  Chunk " << i << " failed or has wrong reply\n";
+            errors++;
+        }
+
+        delete ch.request.reply;
+    }
+
+    // Wait for the late reply, then make sure a new call gets its own reply
+    while ( a_mock.m_late_sent == 0 )
+        this_thread::sleep_for( chrono::milliseconds( 10 ));
+
+    this_thread::sleep_for( chrono::milliseconds( 100 ));
+
+    MsgBuf::Message * reply = 0;
+
+    buildRequest( req, 0, a_chunk_size );
+
+    if ( !mgr.sendRecv( REPO_ID, req, reply, CALL_TIMEOUT ) || !checkReply( reply, 0, a_chunk_size ))
+    {
+        cout << "  Call after timeout failed or has wrong reply\n";
+        errors++;
+    }
+
+    delete reply;
+
+    mgr.getStats( stats );
+
+    cout << "  " << a_chunks << " chunks, " << a_mock.m_requests << " requests, timeouts: " << stats.timeouts << ", down: " << stats.down << ", reconnects: " << stats.reconnects << "\n";
+
+    if ( stats.timeouts != 1 || stats.down != 0 || stats.reconnects != 0 || stats.resets != 0 || stats.repos != 1 )
+    {
+        cout << "  Unexpected connection stats\n";
+        errors++;
+    }
+
+    return errors == 0;
+}
+
+
+/**
+ * Sends a call that the repository never answers, with no other reply on the
+ * connection. Checks that the connection is recreated (rather than marked
+ * down) and that the next call succeeds on the new connection.
+ */
+bool staleConnTest( size_t a_chunk_size )
+{
+    RepoConnMgr &               mgr = RepoConnMgr::getInstance();
+    RepoConnMgr::Stats          stats, prev;
+    Auth::RepoDataGetSizeRequest req;
+    MsgBuf::Message *           reply = 0;
+    size_t                      errors = 0;
+
+    mgr.getStats( prev );
+
+    buildRequest( req, 0, 0, "d/drop" );
+
+    if ( mgr.sendRecv( REPO_ID, req, reply, CALL_TIMEOUT ))
+    {
+        cout << "  Unanswered call did not time out\n";
+        delete reply;
+        errors++;
+    }
+
+    reply = 0;
+    buildRequest( req, 0, a_chunk_size );
+
+    if ( !mgr.sendRecv( REPO_ID, req, reply, CALL_TIMEOUT ) || !checkReply( reply, 0, a_chunk_size ))
+    {
+        cout << "  Call after reset failed or has wrong reply\n";
+        errors++;
+    }
+
+    delete reply;
+
+    mgr.getStats( stats );
+
+    cout << "  timeouts: " << stats.timeouts - prev.timeouts << ", resets: " << stats.resets - prev.resets << ", down: " << stats.down << "\n";
+
+    if ( stats.timeouts - prev.timeouts != 1 || stats.resets - prev.resets != 1 || stats.down != 0 || stats.reconnects != 0 || stats.repos != 1 )
+    {
+        cout << "  Unexpected connection stats\n";
+        errors++;
+    }
+
+    return errors == 0;
+}
+
+
+int main( int argc, char** argv )
+{
+    (void) argc;
+    (void) argv;
+
+    cout << "Repo Connection Test\n";
+
+    try
+    {
+        DL_SET_LEVEL( DynaLog::DL_ERROR_LEV );
+
+        REG_PROTO( SDMS::Anon );
+        REG_PROTO( SDMS::Auth );
+
+        char                        pub_key[41], priv_key[41];
+        MsgComm::SecurityContext    server_ctx;
+        Config &                    config = Config::getInstance();
+        RepoData *                  repo = new RepoData();
+
+        zmq_curve_keypair( pub_key, priv_key );
+        server_ctx.is_server = true;
+        server_ctx.public_key = pub_key;
+        server_ctx.private_key = priv_key;
+
+        zmq_curve_keypair( pub_key, priv_key );
+        config.sec_ctx.is_server = false;
+        config.sec_ctx.public_key = pub_key;
+        config.sec_ctx.private_key = priv_key;
+        config.sec_ctx.server_key = server_ctx.public_key;
+
+        repo->set_id( REPO_ID );
+        repo->set_address( REPO_ADDRESS );
+        config.repos[REPO_ID] = repo;
+
+        MockRepo mock( server_ctx );
+
+        if ( !chunkTimeoutTest( mock, 8, 10, 3 ) || !staleConnTest( 10 ))
+        {
+            cout << "FAILED\n";
+            return 1;
+        }
+
+        cout << "PASSED\n";
+        return 0;
+    }
+    catch ( TraceException& e )
+    {
+        cout << "Error: " << e.toString( true ) << "\n";
+        return 1;
+    }
+}
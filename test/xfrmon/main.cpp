@@ -0,0 +1,407 @@
+#include <iostream>
+#include <string>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define DEF_DYNALOG
+#include "DynaLog.hpp"
+#include "TraceException.hpp"
+#include "Config.hpp"
+#include "TransferMonitor.hpp"
+
+using namespace std;
+using namespace SDMS;
+using namespace SDMS::Core;
+
+// Define local vars need by timer functions
+#define timerDef() struct timespec _T0 = {0,0}, _T1 = {0,0}; (void)_T0; (void)_T1;
+
+// Start timer
+#define timerStart() clock_gettime(CLOCK_REALTIME,&_T0)
+
+// Stop timer
+#define timerStop() clock_gettime(CLOCK_REALTIME,&_T1)
+
+// Calc elapsed time
+#define timerElapsed() ((_T1.tv_sec - _T0.tv_sec) + ((_T1.tv_nsec - _T0.tv_nsec)*1.0e-9))
+
+
+/**
+ * Minimal mock of the Globus transfer API (task_list, task view, event_list,
+ * and cancel) served over HTTP/1.1 on the loopback interface. Each mock task
+ * stays ACTIVE for a set number of status polls, then reports its final state.
+ */
+class MockGlobus
+{
+public:
+    struct MockTask
+    {
+        MockTask() : polls(0), polls_done(0), fail(false), faults(0), listed(true), cancelled(false) {}
+
+        uint32_t    polls;
+        uint32_t    polls_done;
+        bool        fail;
+        uint32_t    faults;
+        bool        listed;     ///< If false, task is omitted from task_list replies
+        bool        cancelled;
+    };
+
+    MockGlobus() : m_port(0), m_requests(0), m_list_requests(0)
+    {
+        struct sockaddr_in  addr;
+        socklen_t           len = sizeof( addr );
+        int                 opt = 1;
+
+        m_sock = socket( AF_INET, SOCK_STREAM, 0 );
+        setsockopt( m_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof( opt ));
+
+        memset( &addr, 0, sizeof( addr ));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+        addr.sin_port = 0;
+
+        if ( bind( m_sock, (struct sockaddr*)&addr, sizeof( addr )) || listen( m_sock, 8 ))
+            EXCEPT( 1, "Mock server bind/listen failed" );
+
+        getsockname( m_sock, (struct sockaddr*)&addr, &len );
+        m_port = ntohs( addr.sin_port );
+
+        m_thread = thread( &MockGlobus::serverThread, this );
+        m_thread.detach();
+    }
+
+    void addTask( const string & a_id, const MockTask & a_task )
+    {
+        lock_guard<mutex> lock( m_mutex );
+        m_tasks[a_id] = a_task;
+    }
+
+    MockTask getTask( const string & a_id )
+    {
+        lock_guard<mutex> lock( m_mutex );
+        return m_tasks[a_id];
+    }
+
+    uint16_t                m_port;
+    atomic<size_t>          m_requests;
+    atomic<size_t>          m_list_requests;
+
+private:
+    static string decode( const string & a_str )
+    {
+        string  res;
+        size_t  i;
+
+        for ( i = 0; i < a_str.size(); i++ )
+        {
+            if ( a_str[i] == '%' && i + 2 < a_str.size() )
+            {
+                res += (char)strtol( a_str.substr( i + 1, 2 ).c_str(), 0, 16 );
+                i += 2;
+            }
+            else
+                res += a_str[i];
+        }
+
+        return res;
+    }
+
+    static string getParam( const string & a_query, const string & a_name )
+    {
+        size_t p = a_query.find( a_name + "=" );
+
+        if ( p == string::npos )
+            return string();
+
+        p += a_name.size() + 1;
+
+        return decode( a_query.substr( p, a_query.find( '&', p ) - p ));
+    }
+
+    const char * status( MockTask & a_task )
+    {
+        if ( a_task.polls_done < a_task.polls )
+            return "ACTIVE";
+
+        return a_task.fail ? "FAILED" : "SUCCEEDED";
+    }
+
+    string handle( const string & a_target )
+    {
+        size_t  q = a_target.find( '?' );
+        string  path = decode( a_target.substr( 0, q ));
+        string  query = q == string::npos ? string() : a_target.substr( q + 1 );
+        string  reply;
+
+        lock_guard<mutex> lock( m_mutex );
+
+        m_requests++;
+
+        if ( path == "/task_list" )
+        {
+            string  filter = getParam( query, "filter" ).substr( 8 );
+            size_t  p = 0, e;
+            bool    first = true;
+
+            m_list_requests++;
+            reply = "{\"DATA_TYPE\":\"task_list\",\"DATA\":[";
+
+            while ( p < filter.size() )
+            {
+                e = filter.find( ',', p );
+                if ( e == string::npos )
+                    e = filter.size();
+
+                map<string,MockTask>::iterator t = m_tasks.find( filter.substr( p, e - p ));
+                if ( t != m_tasks.end() && t->second.listed )
+                {
+                    reply += string( first ? "" : "," ) + "{\"DATA_TYPE\":\"task\",\"task_id\":\"" + t->first + "\",\"status\":\"" + status( t->second )
+                        + "\",\"nice_status\":" + ( t->second.fail && t->second.polls_done >= t->second.polls ? "\"PERMISSION_DENIED\"" : "\"OK\"" )
+                        + ",\"faults\":" + to_string( t->second.faults ) + "}";
+                    t->second.polls_done++;
+                    first = false;
+                }
+
+                p = e + 1;
+            }
+
+            reply += "]}";
+        }
+        else if ( path.compare( 0, 6, "/task/" ) == 0 )
+        {
+            string id = path.substr( 6 );
+            string op;
+
+            if (( q = id.find( '/' )) != string::npos )
+            {
+                op = id.substr( q + 1 );
+                id = id.substr( 0, q );
+            }
+
+            MockTask & task = m_tasks[id];
+
+            if ( op == "cancel" )
+            {
+                task.cancelled = true;
+                reply = "{\"code\":\"Canceled\"}";
+            }
+            else if ( op == "event_list" )
+                reply = "{\"DATA_TYPE\":\"event_list\",\"DATA\":[]}";
+            else
+            {
+                reply = string( "{\"status\":\"" ) + status( task ) + "\",\"nice_status\":\"" + ( task.fail ? "PERMISSION_DENIED" : "OK" ) + "\"}";
+                task.polls_done++;
+            }
+        }
+        else
+            reply = "{\"message\":\"Not found\"}";
+
+        return reply;
+    }
+
+    void serverThread()
+    {
+        while ( 1 )
+        {
+            int conn = accept( m_sock, 0, 0 );
+            if ( conn < 0 )
+                continue;
+
+            thread( &MockGlobus::connThread, this, conn ).detach();
+        }
+    }
+
+    void connThread( int a_conn )
+    {
+        string  buf, target, reply, resp;
+        char    tmp[4096];
+        size_t  hdr_end, clen, p;
+        ssize_t n;
+
+        while ( 1 )
+        {
+            while (( hdr_end = buf.find( "\r\n\r\n" )) == string::npos )
+            {
+                if (( n = recv( a_conn, tmp, sizeof( tmp ), 0 )) <= 0 )
+                {
+                    close( a_conn );
+                    return;
+                }
+                buf.append( tmp, n );
+            }
+
+            clen = 0;
+            if (( p = buf.find( "Content-Length: " )) != string::npos && p < hdr_end )
+                clen = strtoul( buf.c_str() + p + 16, 0, 10 );
+
+            while ( buf.size() < hdr_end + 4 + clen )
+            {
+                if (( n = recv( a_conn, tmp, sizeof( tmp ), 0 )) <= 0 )
+                {
+                    close( a_conn );
+                    return;
+                }
+                buf.append( tmp, n );
+            }
+
+            p = buf.find( ' ' );
+            target = buf.substr( p + 1, buf.find( ' ', p + 1 ) - p - 1 );
+            buf.erase( 0, hdr_end + 4 + clen );
+
+            reply = handle( target );
+            resp = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + to_string( reply.size() ) + "\r\n\r\n" + reply;
+
+            if ( send( a_conn, resp.c_str(), resp.size(), MSG_NOSIGNAL ) < 0 )
+            {
+                close( a_conn );
+                return;
+            }
+        }
+    }
+
+    int                     m_sock;
+    thread                  m_thread;
+    mutex                   m_mutex;
+    map<string,MockTask>    m_tasks;
+};
+
+
+/**
+ * Submits a set of transfers with varying lifetimes and outcomes to the
+ * transfer monitor and checks that each owning task is resumed exactly once
+ * with the expected result, and that polling is batched.
+ */
+bool monitorTest( MockGlobus & a_mock, size_t a_count )
+{
+    mutex                           done_mutex;
+    condition_variable              done_cvar;
+    vector<ITaskMgr::Task*>         done;
+    vector<ITaskMgr::Task*>         tasks;
+    map<string,MockGlobus::MockTask> expect;
+    size_t                          i, errors = 0, polls = 0;
+    double                          elapsed;
+
+    TransferMonitor monitor( [&]( ITaskMgr::Task * a_task )
+    {
+        lock_guard<mutex> lock( done_mutex );
+        done.push_back( a_task );
+        done_cvar.notify_one();
+    });
+
+    for ( i = 0; i < a_count; i++ )
+    {
+        MockGlobus::MockTask    mt;
+        string                  xfr_id = "xfr-" + to_string( i );
+
+        mt.polls = 1 + i % 4;
+        mt.fail = ( i % 10 == 9 );
+        mt.faults = ( i % 25 == 3 ) ? 1 : 0;
+        mt.listed = ( i % 50 != 7 );
+        polls += mt.polls + 1;
+
+        a_mock.addTask( xfr_id, mt );
+        expect[xfr_id] = mt;
+
+        ITaskMgr::Task * task = new ITaskMgr::Task( "task/" + to_string( i ), ITaskMgr::TL_TRANSFER, "u/user" + to_string( i % 3 ));
+        task->xfr_id = xfr_id;
+        task->xfr_token = "token" + to_string( i % 3 );
+        task->step = 1;
+        tasks.push_back( task );
+    }
+
+    timerDef();
+    timerStart();
+
+    for ( i = 0; i < a_count; i++ )
+        monitor.monitor( tasks[i] );
+
+    {
+        unique_lock<mutex> lock( done_mutex );
+        while ( done.size() < a_count )
+        {
+            if ( done_cvar.wait_for( lock, chrono::seconds( 60 )) == cv_status::timeout )
+            {
+                cout << "  Timeout, " << done.size() << " of " << a_count << " transfers finished\n";
+                return false;
+            }
+        }
+    }
+
+    timerStop();
+    elapsed = timerElapsed();
+
+    for ( i = 0; i < a_count; i++ )
+    {
+        ITaskMgr::Task * task = tasks[i];
+        string xfr_id = "xfr-" + to_string( i );
+        MockGlobus::MockTask & mt = expect[xfr_id];
+
+        if ( !task->resume || task->xfr_id.size() || task->step != 1 )
+        {
+            cout << "  Task " << task->task_id << " not resumed correctly\n";
+            errors++;
+        }
+        else if ( mt.fail != ( task->err_msg.size() > 0 ))
+        {
+            cout << "  Task " << task->task_id << " unexpected result: [" << task->err_msg << "]\n";
+            errors++;
+        }
+        else if ( mt.fail && !a_mock.getTask( xfr_id ).cancelled )
+        {
+            cout << "  Failed transfer " << xfr_id << " not cancelled\n";
+            errors++;
+        }
+
+        delete task;
+    }
+
+    cout << "  " << a_count << " transfers in " << elapsed << " sec, " << monitor.size() << " still monitored\n";
+    cout << "  HTTP requests: " << a_mock.m_requests << " (" << a_mock.m_list_requests << " batched), per-transfer polling would need at least " << 2 * polls << "\n";
+
+    return errors == 0 && monitor.size() == 0;
+}
+
+
+int main( int argc, char** argv )
+{
+    (void) argc;
+    (void) argv;
+
+    cout << "Transfer Monitor Test\n";
+
+    try
+    {
+        DL_SET_LEVEL( DynaLog::DL_WARN_LEV );
+
+        MockGlobus      mock;
+        Config &        config = Config::getInstance();
+
+        config.glob_xfr_url = "http://127.0.0.1:" + to_string( mock.m_port ) + "/";
+        config.xfr_poll_min = 1;
+        config.xfr_poll_max = 2;
+
+        if ( !monitorTest( mock, 500 ))
+        {
+            cout << "FAILED\n";
+            return 1;
+        }
+
+        cout << "PASSED\n";
+        return 0;
+    }
+    catch ( TraceException& e )
+    {
+        cout << "Error: " << e.toString( true ) << "\n";
+        return 1;
+    }
+}